@@ -10,8 +10,13 @@ extern "C" {
 
 typedef enum 
 {
-  GPURealTimeBC6H_ImageFormat_RGBA32F = 0,
-  GPURealTimeBC6H_ImageFormat_BC6H    = 1,
+  GPURealTimeBC6H_ImageFormat_RGBA32F   = 0,
+  GPURealTimeBC6H_ImageFormat_BC6H      = 1,
+  GPURealTimeBC6H_ImageFormat_RGBA16F   = 2,
+  GPURealTimeBC6H_ImageFormat_BC6H_SF16 = 3,
+  GPURealTimeBC6H_ImageFormat_RGB32F    = 4,
+  GPURealTimeBC6H_ImageFormat_RGB16F    = 5,
+  GPURealTimeBC6H_ImageFormat_RGB9E5    = 6,
 } GPURealTimeBC6H_ImageFormat;
 
 typedef enum
@@ -20,19 +25,218 @@ typedef enum
   GPURealTimeBC6H_Preset_Speed   = 1,
 } GPURealTimeBC6H_Preset;
 
+typedef enum
+{
+  GPURealTimeBC6H_Backend_D3D11 = 0,
+  GPURealTimeBC6H_Backend_CPU   = 1,
+} GPURealTimeBC6H_Backend;
+
+typedef enum
+{
+  GPURealTimeBC6H_Container_DDS  = 0,
+  GPURealTimeBC6H_Container_KTX2 = 1,
+} GPURealTimeBC6H_Container;
+
+typedef enum
+{
+  GPURealTimeBC6H_TileOrder_RowStrip = 0,
+  GPURealTimeBC6H_TileOrder_Morton   = 1,
+} GPURealTimeBC6H_TileOrder;
+
+// Zero initialize images (GPURealTimeBC6H_Image image = { 0 };) before filling them in: fields added by later
+// versions, like sliceCount and the pitches, then keep their defaults. Source images whose slices and rows don't
+// fit in dataSize are rejected.
 typedef struct 
 {
+  // In texels for every format, BC6H images included
   unsigned width;
   unsigned height;
   uint8_t* data;
   unsigned dataSize;
+  // Texture arrays and cubemaps (6 slices: +X, -X, +Y, -Y, +Z, -Z) keep their slices slicePitch bytes apart,
+  // 0 means a single slice and a tightly packed array respectively
+  unsigned sliceCount;
+  unsigned slicePitch;
+  // Bytes between rows of an uncompressed source, 0 when tightly packed. Compress, CompressInto and ComputeMetrics
+  // read sub-rectangles of a larger image with data pointing at the first texel and the larger image's rowPitch.
+  unsigned rowPitch;
 } GPURealTimeBC6H_Image;
 
+typedef struct
+{
+  unsigned x;
+  unsigned y;
+  unsigned width;
+  unsigned height;
+} GPURealTimeBC6H_Rect;
+
+typedef enum
+{
+  GPURealTimeBC6H_Stage_LockWait   = 0,
+  GPURealTimeBC6H_Stage_Upload     = 1,
+  GPURealTimeBC6H_Stage_Encode     = 2,
+  GPURealTimeBC6H_Stage_Copy       = 3,
+  GPURealTimeBC6H_Stage_Readback   = 4,
+  GPURealTimeBC6H_Stage_Allocation = 5,
+  GPURealTimeBC6H_Stage_Measure    = 6,
+  GPURealTimeBC6H_Stage_RDO        = 7,
+  GPURealTimeBC6H_Stage_Total      = 8,
+  GPURealTimeBC6H_Stage_Count      = 9,
+} GPURealTimeBC6H_Stage;
+
+// Milliseconds over the latest 256 samples of a stage
+typedef struct
+{
+  uint64_t count;
+  float last;
+  float mean;
+  float p50;
+  float p90;
+  float p99;
+  float max;
+} GPURealTimeBC6H_StageStats;
+
+typedef struct
+{
+  uint64_t compressCount;
+  uint64_t bytesIn;
+  uint64_t bytesOut;
+  uint64_t gpuSamplesDropped;
+  // CPU backend blocks by encoding path: a single color written directly (exact or within a few half float steps)
+  // or the full encoder
+  uint64_t constantBlocks;
+  uint64_t nearConstantBlocks;
+  uint64_t encodedBlocks;
+  // Blocks copied from the block cache instead of encoded, see GPURealTimeBC6H_SetBlockCache
+  uint64_t cachedBlocks;
+  // Encoded blocks which skipped the P2 search, see GPURealTimeBC6H_SetP2Threshold
+  uint64_t p2SkippedBlocks;
+  // Blocks changed by the RDO pass and the estimated LZ compressed bytes before and after it, see GPURealTimeBC6H_SetRDO
+  uint64_t rdoChangedBlocks;
+  uint64_t rdoLZSizeBefore;
+  uint64_t rdoLZSizeAfter;
+  GPURealTimeBC6H_StageStats stages[GPURealTimeBC6H_Stage_Count];
+} GPURealTimeBC6H_Stats;
+
+typedef struct
+{
+  float rgbRMSLE;
+  float lumRMSLE;
+  float psnr;
+} GPURealTimeBC6H_Metrics;
+
 bool GPURealTimeBC6H_Initialize(uint32_t preset);
+bool GPURealTimeBC6H_InitializeBackend(uint32_t preset, uint32_t backend);
+// Encoder effort from 0 (fastest) to 5 (best), the presets start at 2 (Quality) and 1 (Speed).
+// The D3D11 backend runs the Quality shader from 2 up and the Speed shader below it.
+void GPURealTimeBC6H_SetEffort(uint32_t effort);
+uint32_t GPURealTimeBC6H_GetEffort();
+// CPU backend: encodes repeated blocks once through a cache of entryCount blocks (about 220 bytes each), kept
+// across calls until cleared. 0 turns it off. Hits are counted in GPURealTimeBC6H_Stats::cachedBlocks.
+void GPURealTimeBC6H_SetBlockCache(uint32_t entryCount);
+void GPURealTimeBC6H_ClearBlockCache();
+// CPU backend: the order the worker threads take the image in, row strips (the default) or Morton ordered tiles
+void GPURealTimeBC6H_SetTileOrder(uint32_t tileOrder);
+// CPU backend: blocks whose single subset encoding is already under this MSLE skip the two subset (P2) search,
+// 0 turns it off (the default). Skipped blocks are counted in GPURealTimeBC6H_Stats::p2SkippedBlocks.
+void GPURealTimeBC6H_SetP2Threshold(float threshold);
+// Rate distortion optimization for output packed with zstd, deflate or LZ4: blocks take over bytes of the blocks
+// before them where that costs less than lambda (block MSLE, 1e-6 to 1e-4) per saved byte and at most maxErrorRatio
+// times their own error. 0 turns it off (the default), 2 is a good maxErrorRatio.
+void GPURealTimeBC6H_SetRDO(float lambda, float maxErrorRatio);
+// srcImage->sliceCount > 1 compresses all the slices in one call, dstImage receives them back to back
 bool GPURealTimeBC6H_Compress(GPURealTimeBC6H_Image* srcImage, uint32_t format, GPURealTimeBC6H_Image* dstImage);
+// Same as GPURealTimeBC6H_Compress, but into the caller's dstImage->data buffer of dstImage->dataSize bytes,
+// GPURealTimeBC6H_GetCompressedSize at least. Don't free the result with GPURealTimeBC6H_FreeImage.
+bool GPURealTimeBC6H_CompressInto(GPURealTimeBC6H_Image* srcImage, uint32_t format, GPURealTimeBC6H_Image* dstImage);
+// Compresses imageCount sources of the same format with up to depth of them in flight, so the upload, encoding and
+// readback of consecutive images overlap. The callback gets every result in order (ok is false for a failed one)
+// from a pipeline thread. dstImage is only valid during the call, isn't freed by the caller and the callback
+// must not call back into the library.
+typedef void (*GPURealTimeBC6H_BatchCallback)(uint32_t index, const GPURealTimeBC6H_Image* dstImage, bool ok, void* userData);
+bool GPURealTimeBC6H_CompressBatch(GPURealTimeBC6H_Image* srcImages, uint32_t format, uint32_t imageCount, uint32_t depth, GPURealTimeBC6H_BatchCallback callback, void* userData);
+// Encodes again only the blocks the dirty rectangles (in texels) touch and patches them into dstImage, the previous
+// GPURealTimeBC6H_Compress/CompressInto result of a source of the same size. Single slice sources only.
+bool GPURealTimeBC6H_CompressRects(GPURealTimeBC6H_Image* srcImage, uint32_t format, const GPURealTimeBC6H_Rect* rects, uint32_t rectCount, GPURealTimeBC6H_Image* dstImage);
+// 0 when the output doesn't fit in 4 GB, compression of such images fails
+uint32_t GPURealTimeBC6H_GetCompressedSize(uint32_t width, uint32_t height, uint32_t sliceCount);
+// Number of levels of the full mip chain down to 1x1
+uint32_t GPURealTimeBC6H_GetMipLevelNum(uint32_t width, uint32_t height);
+// Builds the mip chain of an RGBA32F image and compresses all its levels in one call (levelNum == 0 for the full chain).
+// dstImage receives the levels back to back, levelOffsets[i] is the byte offset of level i.
+bool GPURealTimeBC6H_CompressMipChain(GPURealTimeBC6H_Image* srcImage, uint32_t levelNum, GPURealTimeBC6H_Image* dstImage, uint32_t* levelOffsets);
+// Writes an RGBA32F image, all of its slices with levelNum mips each (1 for none, 0 for the full chain), as a complete
+// DDS (DX10 header, BC6H_UF16) or KTX2 file. Blocks are encoded straight into the mapped file. A cubemap takes
+// 6 slices per cube with square faces.
+bool GPURealTimeBC6H_CompressToFile(GPURealTimeBC6H_Image* srcImage, uint32_t levelNum, bool cubemap, uint32_t container, const char* path);
+// Same file passed to the write callback front to back, returning false from it stops the compression
+typedef bool (*GPURealTimeBC6H_WriteCallback)(uint64_t offset, const uint8_t* data, uint64_t size, void* userData);
+bool GPURealTimeBC6H_CompressToSink(GPURealTimeBC6H_Image* srcImage, uint32_t levelNum, bool cubemap, uint32_t container, GPURealTimeBC6H_WriteCallback write, void* userData);
+// Streaming compression of images too large to keep in memory: after GPURealTimeBC6H_BeginStream, every
+// GPURealTimeBC6H_CompressRows call takes the next strip of RGBA32F rows (a multiple of 4 rows except the last one)
+// and passes its BC6H block rows to the callback before returning. The callback must not call back into the library.
+typedef void (*GPURealTimeBC6H_BlockRowCallback)(uint32_t firstBlockRow, uint32_t blockRowNum, const uint8_t* blocks, uint32_t dataSize, void* userData);
+bool GPURealTimeBC6H_BeginStream(uint32_t width, uint32_t height, GPURealTimeBC6H_BlockRowCallback callback, void* userData);
+bool GPURealTimeBC6H_CompressRows(const uint8_t* rows, uint32_t rowPitch, uint32_t rowNum);
+// Fails if the stream didn't get all the rows
+bool GPURealTimeBC6H_EndStream();
+// Decodes a BC6H/BC6H_SF16 image (a GPURealTimeBC6H_Compress result) into RGBA16F or RGBA32F of the same size,
+// free the result with GPURealTimeBC6H_FreeImage
+bool GPURealTimeBC6H_Decompress(GPURealTimeBC6H_Image* srcImage, uint32_t srcFormat, uint32_t dstFormat, GPURealTimeBC6H_Image* dstImage);
+// Compares a BC6H/BC6H_SF16 image against its RGBA32F source. blockMSLE is optional,
+// it receives one luminance weighted MSLE per block in row major order.
+bool GPURealTimeBC6H_ComputeMetrics(GPURealTimeBC6H_Image* srcImage, GPURealTimeBC6H_Image* bc6hImage, uint32_t bc6hFormat, GPURealTimeBC6H_Metrics* metrics, float* blockMSLE);
+// Measures every GPURealTimeBC6H_Compress result, GPURealTimeBC6H_GetMetrics returns the latest one
+void GPURealTimeBC6H_SetMeasureQuality(bool measureQuality);
+void GPURealTimeBC6H_GetMetrics(GPURealTimeBC6H_Metrics* metrics);
+// Average GPU time of the compression dispatch in ms, 0 for the CPU backend
+float GPURealTimeBC6H_GetGPUCompressionTime();
+// Doesn't wait for a running GPURealTimeBC6H_Compress, GPU stage timings show up a few calls late
+void GPURealTimeBC6H_GetStats(GPURealTimeBC6H_Stats* stats);
+void GPURealTimeBC6H_ResetStats();
 void GPURealTimeBC6H_FreeImage(GPURealTimeBC6H_Image* dstImage);
 void GPURealTimeBC6H_Release();
 
+// Independent compressor contexts for concurrent compression. Every context owns its device (D3D11), targets and
+// scratch buffers and serializes only its own calls, so separate contexts compress in parallel. The functions above
+// work on a built in default context. CPU contexts can share a worker pool, otherwise each one starts its own workers.
+typedef struct GPURealTimeBC6H_Context GPURealTimeBC6H_Context;
+typedef struct GPURealTimeBC6H_WorkerPool GPURealTimeBC6H_WorkerPool;
+
+// threadCount == 0 means one thread per hardware core, pinThreads binds every worker to its own logical processor.
+// Contexts keep using the pool after it's destroyed, its threads stop with the last one of them.
+GPURealTimeBC6H_WorkerPool* GPURealTimeBC6H_CreateWorkerPool(uint32_t threadCount, bool pinThreads);
+void GPURealTimeBC6H_DestroyWorkerPool(GPURealTimeBC6H_WorkerPool* pool);
+// workerPool is optional, returns NULL when the backend fails to initialize
+GPURealTimeBC6H_Context* GPURealTimeBC6H_CreateContext(uint32_t preset, uint32_t backend, GPURealTimeBC6H_WorkerPool* workerPool);
+void GPURealTimeBC6H_DestroyContext(GPURealTimeBC6H_Context* context);
+
+// Same as the functions without the Context prefix. Results are freed with GPURealTimeBC6H_FreeImage.
+void GPURealTimeBC6H_ContextSetEffort(GPURealTimeBC6H_Context* context, uint32_t effort);
+uint32_t GPURealTimeBC6H_ContextGetEffort(GPURealTimeBC6H_Context* context);
+void GPURealTimeBC6H_ContextSetBlockCache(GPURealTimeBC6H_Context* context, uint32_t entryCount);
+void GPURealTimeBC6H_ContextClearBlockCache(GPURealTimeBC6H_Context* context);
+void GPURealTimeBC6H_ContextSetTileOrder(GPURealTimeBC6H_Context* context, uint32_t tileOrder);
+void GPURealTimeBC6H_ContextSetP2Threshold(GPURealTimeBC6H_Context* context, float threshold);
+void GPURealTimeBC6H_ContextSetRDO(GPURealTimeBC6H_Context* context, float lambda, float maxErrorRatio);
+bool GPURealTimeBC6H_ContextCompress(GPURealTimeBC6H_Context* context, GPURealTimeBC6H_Image* srcImage, uint32_t format, GPURealTimeBC6H_Image* dstImage);
+bool GPURealTimeBC6H_ContextCompressInto(GPURealTimeBC6H_Context* context, GPURealTimeBC6H_Image* srcImage, uint32_t format, GPURealTimeBC6H_Image* dstImage);
+bool GPURealTimeBC6H_ContextCompressBatch(GPURealTimeBC6H_Context* context, GPURealTimeBC6H_Image* srcImages, uint32_t format, uint32_t imageCount, uint32_t depth, GPURealTimeBC6H_BatchCallback callback, void* userData);
+bool GPURealTimeBC6H_ContextCompressRects(GPURealTimeBC6H_Context* context, GPURealTimeBC6H_Image* srcImage, uint32_t format, const GPURealTimeBC6H_Rect* rects, uint32_t rectCount, GPURealTimeBC6H_Image* dstImage);
+bool GPURealTimeBC6H_ContextCompressMipChain(GPURealTimeBC6H_Context* context, GPURealTimeBC6H_Image* srcImage, uint32_t levelNum, GPURealTimeBC6H_Image* dstImage, uint32_t* levelOffsets);
+bool GPURealTimeBC6H_ContextCompressToFile(GPURealTimeBC6H_Context* context, GPURealTimeBC6H_Image* srcImage, uint32_t levelNum, bool cubemap, uint32_t container, const char* path);
+bool GPURealTimeBC6H_ContextCompressToSink(GPURealTimeBC6H_Context* context, GPURealTimeBC6H_Image* srcImage, uint32_t levelNum, bool cubemap, uint32_t container, GPURealTimeBC6H_WriteCallback write, void* userData);
+bool GPURealTimeBC6H_ContextBeginStream(GPURealTimeBC6H_Context* context, uint32_t width, uint32_t height, GPURealTimeBC6H_BlockRowCallback callback, void* userData);
+bool GPURealTimeBC6H_ContextCompressRows(GPURealTimeBC6H_Context* context, const uint8_t* rows, uint32_t rowPitch, uint32_t rowNum);
+bool GPURealTimeBC6H_ContextEndStream(GPURealTimeBC6H_Context* context);
+bool GPURealTimeBC6H_ContextDecompress(GPURealTimeBC6H_Context* context, GPURealTimeBC6H_Image* srcImage, uint32_t srcFormat, uint32_t dstFormat, GPURealTimeBC6H_Image* dstImage);
+bool GPURealTimeBC6H_ContextComputeMetrics(GPURealTimeBC6H_Context* context, GPURealTimeBC6H_Image* srcImage, GPURealTimeBC6H_Image* bc6hImage, uint32_t bc6hFormat, GPURealTimeBC6H_Metrics* metrics, float* blockMSLE);
+void GPURealTimeBC6H_ContextSetMeasureQuality(GPURealTimeBC6H_Context* context, bool measureQuality);
+void GPURealTimeBC6H_ContextGetMetrics(GPURealTimeBC6H_Context* context, GPURealTimeBC6H_Metrics* metrics);
+float GPURealTimeBC6H_ContextGetGPUCompressionTime(GPURealTimeBC6H_Context* context);
+void GPURealTimeBC6H_ContextGetStats(GPURealTimeBC6H_Context* context, GPURealTimeBC6H_Stats* stats);
+void GPURealTimeBC6H_ContextResetStats(GPURealTimeBC6H_Context* context);
+
 
 #ifdef __cplusplus
 }  // extern "C"
@@ -0,0 +1,113 @@
+#include "BC6HBlockCache.h"
+
+#include <string.h>
+
+BC6HBlockCache::BC6HBlockCache(uint32_t entryNum)
+  : m_shards(new SShard[SHARD_NUM])
+{
+  uint32_t setNum = SHARD_NUM;
+  while (setNum * SET_SIZE < entryNum && setNum < (1u << 30) / SET_SIZE)
+    setNum *= 2;
+
+  SSet emptySet = {};
+  m_sets.resize(setNum, emptySet);
+  m_entries.resize(setNum * SET_SIZE);
+  m_setMask = setNum - 1;
+  m_generation = 0;
+}
+
+uint64_t BC6HBlockCache::Hash(const float texels[16][3], uint32_t effort)
+{
+  // Four independent multiply-xorshift streams over the texel bits, so the multiplies don't wait on each other,
+  // merged with a final avalanche to spread the set index bits
+  uint64_t bits[16 * 3 / 2];
+  memcpy(bits, texels, sizeof(bits));
+
+  const uint64_t PRIME = 0x9E3779B97F4A7C15ull;
+  uint64_t streams[4] = { effort, 1, 2, 3 };
+  for (uint32_t i = 0; i < 16 * 3 / 2; i += 4)
+  {
+    for (uint32_t j = 0; j < 4; ++j)
+    {
+      uint64_t x = (streams[j] ^ bits[i + j]) * PRIME;
+      streams[j] = x ^ (x >> 29);
+    }
+  }
+
+  uint64_t hash = streams[0] ^ (streams[1] * 3) ^ (streams[2] * 5) ^ (streams[3] * 7);
+  hash ^= hash >> 33;
+  hash *= 0xFF51AFD7ED558CCDull;
+  hash ^= hash >> 33;
+  return hash | 1;
+}
+
+bool BC6HBlockCache::Matches(const SSet& set, uint32_t way, const SEntry& entry, uint64_t hash, const float texels[16][3], uint32_t effort) const
+{
+  return set.m_hashes[way] == hash && set.m_generations[way] == m_generation && entry.m_effort == effort
+    && memcmp(entry.m_texels, texels, sizeof(entry.m_texels)) == 0;
+}
+
+bool BC6HBlockCache::Find(uint64_t hash, const float texels[16][3], uint32_t effort, uint32_t block[4])
+{
+  uint32_t setIndex = GetSetIndex(hash);
+  const SSet& set = m_sets[setIndex];
+  std::lock_guard<std::mutex> lk(GetShard(hash).m_mutex);
+  for (uint32_t way = 0; way < SET_SIZE; ++way)
+  {
+    const SEntry& entry = m_entries[setIndex * SET_SIZE + way];
+    if (Matches(set, way, entry, hash, texels, effort))
+    {
+      memcpy(block, entry.m_block, sizeof(entry.m_block));
+      return true;
+    }
+  }
+  return false;
+}
+
+void BC6HBlockCache::Insert(uint64_t hash, const float texels[16][3], uint32_t effort, const uint32_t block[4])
+{
+  uint32_t setIndex = GetSetIndex(hash);
+  SSet& set = m_sets[setIndex];
+  std::lock_guard<std::mutex> lk(GetShard(hash).m_mutex);
+  uint32_t dstWay = SET_SIZE;
+  for (uint32_t way = 0; way < SET_SIZE; ++way)
+  {
+    // Another thread may have encoded the same block in the meantime
+    if (Matches(set, way, m_entries[setIndex * SET_SIZE + way], hash, texels, effort))
+      return;
+
+    bool empty = set.m_hashes[way] == 0 || set.m_generations[way] != m_generation;
+    if (dstWay == SET_SIZE && empty)
+      dstWay = way;
+  }
+
+  if (dstWay == SET_SIZE)
+  {
+    dstWay = set.m_next;
+    set.m_next = (set.m_next + 1) % SET_SIZE;
+  }
+
+  set.m_hashes[dstWay] = hash;
+  set.m_generations[dstWay] = m_generation;
+  SEntry& dst = m_entries[setIndex * SET_SIZE + dstWay];
+  dst.m_effort = effort;
+  memcpy(dst.m_texels, texels, sizeof(dst.m_texels));
+  memcpy(dst.m_block, block, sizeof(dst.m_block));
+}
+
+void BC6HBlockCache::Clear()
+{
+  for (uint32_t i = 0; i < SHARD_NUM; ++i)
+    m_shards[i].m_mutex.lock();
+
+  // Wrapping around would bring back the entries of an old generation, so those get emptied for real
+  if (++m_generation == 0)
+  {
+    SSet emptySet = {};
+    for (SSet& set : m_sets)
+      set = emptySet;
+  }
+
+  for (uint32_t i = 0; i < SHARD_NUM; ++i)
+    m_shards[i].m_mutex.unlock();
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdint.h>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Encoded blocks by their texels, so repeated blocks (tiles, atlas padding, procedural maps) go through
+// the encoder once. Shared by the CPU backend threads and kept across compressions until cleared.
+// Fixed size set associative table split into shards with their own lock, a full set replaces its entries
+// round robin. Entries keep their texels, a hash collision can't return a wrong block.
+// The key is the texels and the effort only: every BC6HEncoderSIMD ISA writes the blocks of BC6HEncoderCPU::EncodeBlock
+// bit for bit, so a block cached by one ISA is valid for the others. The P2 threshold isn't part of it either,
+// changing it has to clear the cache.
+class BC6HBlockCache
+{
+public:
+  // entryNum is rounded up to a power of two, at least SET_SIZE * SHARD_NUM
+  explicit BC6HBlockCache(uint32_t entryNum);
+
+  BC6HBlockCache(const BC6HBlockCache&) = delete;
+  BC6HBlockCache& operator=(const BC6HBlockCache&) = delete;
+
+  uint32_t GetEntryNum() const { return m_setMask + 1; }
+
+  static uint64_t Hash(const float texels[16][3], uint32_t effort);
+  // Copies the block encoded from the same texels at the same effort into block
+  bool Find(uint64_t hash, const float texels[16][3], uint32_t effort, uint32_t block[4]);
+  void Insert(uint64_t hash, const float texels[16][3], uint32_t effort, const uint32_t block[4]);
+  void Clear();
+
+private:
+  static const uint32_t SET_SIZE = 4;
+  static const uint32_t SHARD_NUM = 64;
+
+  // Tags of a set share a cache line, a miss doesn't touch the entries
+  struct SSet
+  {
+    // 0 for an empty entry, real hashes have the lowest bit set
+    uint64_t m_hashes[SET_SIZE];
+    // Entries of older generations were cleared
+    uint32_t m_generations[SET_SIZE];
+    uint32_t m_next;
+  };
+
+  struct SEntry
+  {
+    uint32_t m_effort;
+    float m_texels[16][3];
+    uint32_t m_block[4];
+  };
+
+  struct SShard
+  {
+    std::mutex m_mutex;
+  };
+
+  uint32_t GetSetIndex(uint64_t hash) const { return static_cast<uint32_t>(hash >> 1) & m_setMask; }
+  SShard& GetShard(uint64_t hash) { return m_shards[GetSetIndex(hash) % SHARD_NUM]; }
+  bool Matches(const SSet& set, uint32_t way, const SEntry& entry, uint64_t hash, const float texels[16][3], uint32_t effort) const;
+
+  std::vector<SSet> m_sets;
+  // SET_SIZE entries per set
+  std::vector<SEntry> m_entries;
+  std::unique_ptr<SShard[]> m_shards;
+  uint32_t m_setMask;
+  // Clear only starts a new generation instead of touching every entry
+  uint32_t m_generation;
+};
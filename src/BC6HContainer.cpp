@@ -0,0 +1,223 @@
+#include "BC6HContainer.h"
+#include "BC6HMipChain.h"
+
+#include <string.h>
+
+namespace
+{
+  const uint32_t BLOCK_BYTES = 16;
+
+  // DDS
+  const uint32_t DDS_MAGIC = 0x20534444; // "DDS "
+  const uint32_t DDS_HEADER_SIZE = 124;
+  const uint32_t DDS_PIXEL_FORMAT_SIZE = 32;
+  const uint32_t DDS_HEADER_DX10_SIZE = 20;
+  const uint32_t DDSD_CAPS = 0x1;
+  const uint32_t DDSD_HEIGHT = 0x2;
+  const uint32_t DDSD_WIDTH = 0x4;
+  const uint32_t DDSD_PIXELFORMAT = 0x1000;
+  const uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+  const uint32_t DDSD_LINEARSIZE = 0x80000;
+  const uint32_t DDPF_FOURCC = 0x4;
+  const uint32_t FOURCC_DX10 = 0x30315844; // "DX10"
+  const uint32_t DDSCAPS_COMPLEX = 0x8;
+  const uint32_t DDSCAPS_TEXTURE = 0x1000;
+  const uint32_t DDSCAPS_MIPMAP = 0x400000;
+  const uint32_t DDSCAPS2_CUBEMAP_ALLFACES = 0xFE00;
+  const uint32_t DXGI_FORMAT_BC6H_UF16 = 95;
+  const uint32_t DDS_DIMENSION_TEXTURE2D = 3;
+  const uint32_t DDS_RESOURCE_MISC_TEXTURECUBE = 0x4;
+
+  // KTX2
+  const uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+  const uint32_t KTX2_HEADER_SIZE = 80;
+  const uint32_t KTX2_LEVEL_INDEX_ENTRY_SIZE = 24;
+  const uint32_t VK_FORMAT_BC6H_UFLOAT_BLOCK = 143;
+  // Basic data format descriptor with a single 128 bit BC6H sample
+  const uint32_t KTX2_DFD_BLOCK_SIZE = 24 + 16;
+  const uint32_t KTX2_DFD_SIZE = 4 + KTX2_DFD_BLOCK_SIZE;
+  const uint32_t KHR_DF_VERSION = 2;
+  const uint8_t KHR_DF_MODEL_BC6H = 131;
+  const uint8_t KHR_DF_PRIMARIES_BT709 = 1;
+  const uint8_t KHR_DF_TRANSFER_LINEAR = 1;
+  const uint8_t KHR_DF_SAMPLE_DATATYPE_FLOAT = 0x80;
+  const uint32_t FLOAT_ONE = 0x3F800000;
+
+  // Little endian writes into the header
+  struct SWriter
+  {
+    uint8_t* m_dst;
+
+    void U8(uint8_t value) { *m_dst++ = value; }
+    void U32(uint32_t value)
+    {
+      for (uint32_t i = 0; i < 4; ++i)
+        U8(static_cast<uint8_t>(value >> (i * 8)));
+    }
+    void U64(uint64_t value)
+    {
+      U32(static_cast<uint32_t>(value));
+      U32(static_cast<uint32_t>(value >> 32));
+    }
+    void Zero(uint32_t size)
+    {
+      memset(m_dst, 0, size);
+      m_dst += size;
+    }
+  };
+
+  uint64_t GetKTX2LevelOffset(const BC6HContainer::SLayout& layout, uint32_t level)
+  {
+    // Smaller levels come first
+    uint64_t offset = BC6HContainer::GetHeaderSize(BC6HContainer::Format::KTX2, layout);
+    for (uint32_t i = level + 1; i < layout.m_levelNum; ++i)
+      offset += BC6HContainer::GetSurfaceSize(layout, i) * layout.m_sliceNum;
+    return offset;
+  }
+
+  void WriteDDSHeader(const BC6HContainer::SLayout& layout, uint8_t* header)
+  {
+    SWriter writer = { header };
+    writer.U32(DDS_MAGIC);
+
+    uint32_t flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_LINEARSIZE;
+    uint32_t caps = DDSCAPS_TEXTURE;
+    if (layout.m_levelNum > 1)
+    {
+      flags |= DDSD_MIPMAPCOUNT;
+      caps |= DDSCAPS_COMPLEX | DDSCAPS_MIPMAP;
+    }
+    if (layout.m_sliceNum > 1)
+      caps |= DDSCAPS_COMPLEX;
+
+    writer.U32(DDS_HEADER_SIZE);
+    writer.U32(flags);
+    writer.U32(layout.m_height);
+    writer.U32(layout.m_width);
+    writer.U32(static_cast<uint32_t>(BC6HContainer::GetSurfaceSize(layout, 0)));
+    writer.U32(0); // depth
+    writer.U32(layout.m_levelNum);
+    writer.Zero(11 * 4);
+
+    writer.U32(DDS_PIXEL_FORMAT_SIZE);
+    writer.U32(DDPF_FOURCC);
+    writer.U32(FOURCC_DX10);
+    writer.Zero(5 * 4);
+
+    writer.U32(caps);
+    writer.U32(layout.m_cubemap ? DDSCAPS2_CUBEMAP_ALLFACES : 0);
+    writer.Zero(3 * 4);
+
+    writer.U32(DXGI_FORMAT_BC6H_UF16);
+    writer.U32(DDS_DIMENSION_TEXTURE2D);
+    writer.U32(layout.m_cubemap ? DDS_RESOURCE_MISC_TEXTURECUBE : 0);
+    writer.U32(layout.m_cubemap ? layout.m_sliceNum / 6 : layout.m_sliceNum);
+    writer.U32(0); // alpha mode unknown
+  }
+
+  void WriteKTX2Header(const BC6HContainer::SLayout& layout, uint8_t* header)
+  {
+    SWriter writer = { header };
+    memcpy(writer.m_dst, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+    writer.m_dst += sizeof(KTX2_IDENTIFIER);
+
+    // Layer count 0 means not an array
+    uint32_t layerNum = layout.m_cubemap ? layout.m_sliceNum / 6 : layout.m_sliceNum;
+    writer.U32(VK_FORMAT_BC6H_UFLOAT_BLOCK);
+    writer.U32(1); // typeSize
+    writer.U32(layout.m_width);
+    writer.U32(layout.m_height);
+    writer.U32(0); // depth
+    writer.U32(layerNum > 1 ? layerNum : 0);
+    writer.U32(layout.m_cubemap ? 6 : 1);
+    writer.U32(layout.m_levelNum);
+    writer.U32(0); // no supercompression
+
+    uint32_t dfdOffset = KTX2_HEADER_SIZE + KTX2_LEVEL_INDEX_ENTRY_SIZE * layout.m_levelNum;
+    writer.U32(dfdOffset);
+    writer.U32(KTX2_DFD_SIZE);
+    writer.U32(0); // no key/value data
+    writer.U32(0);
+    writer.U64(0); // no supercompression global data
+    writer.U64(0);
+
+    for (uint32_t level = 0; level < layout.m_levelNum; ++level)
+    {
+      uint64_t levelSize = BC6HContainer::GetSurfaceSize(layout, level) * layout.m_sliceNum;
+      writer.U64(GetKTX2LevelOffset(layout, level));
+      writer.U64(levelSize);
+      writer.U64(levelSize);
+    }
+
+    writer.U32(KTX2_DFD_SIZE);
+    writer.U32(0); // Khronos vendor, basic descriptor type
+    writer.U32(KHR_DF_VERSION | (KTX2_DFD_BLOCK_SIZE << 16));
+    writer.U8(KHR_DF_MODEL_BC6H);
+    writer.U8(KHR_DF_PRIMARIES_BT709);
+    writer.U8(KHR_DF_TRANSFER_LINEAR);
+    writer.U8(0); // straight alpha
+    writer.U8(3); // 4x4 blocks, dimensions minus one
+    writer.U8(3);
+    writer.U8(0);
+    writer.U8(0);
+    writer.U8(BLOCK_BYTES);
+    writer.Zero(7);
+
+    // BC6H color channel, bits [0, 128), unsigned float over [0, 1]
+    writer.U32((128 - 1) << 16 | static_cast<uint32_t>(KHR_DF_SAMPLE_DATATYPE_FLOAT) << 24);
+    writer.U32(0); // sample position
+    writer.U32(0);
+    writer.U32(FLOAT_ONE);
+
+    // Levels start 16 byte aligned
+    writer.Zero(static_cast<uint32_t>(header + BC6HContainer::GetHeaderSize(BC6HContainer::Format::KTX2, layout) - writer.m_dst));
+  }
+}
+
+uint64_t BC6HContainer::GetSurfaceSize(const SLayout& layout, uint32_t level)
+{
+  uint64_t widthInBlocks = (BC6HMipChain::GetLevelSize(layout.m_width, level) + 3) / 4;
+  uint64_t heightInBlocks = (BC6HMipChain::GetLevelSize(layout.m_height, level) + 3) / 4;
+  return widthInBlocks * heightInBlocks * BLOCK_BYTES;
+}
+
+uint64_t BC6HContainer::GetHeaderSize(Format format, const SLayout& layout)
+{
+  if (format == Format::DDS)
+    return 4 + DDS_HEADER_SIZE + DDS_HEADER_DX10_SIZE;
+
+  uint64_t size = KTX2_HEADER_SIZE + KTX2_LEVEL_INDEX_ENTRY_SIZE * layout.m_levelNum + KTX2_DFD_SIZE;
+  return (size + BLOCK_BYTES - 1) / BLOCK_BYTES * BLOCK_BYTES;
+}
+
+uint64_t BC6HContainer::GetFileSize(Format format, const SLayout& layout)
+{
+  uint64_t size = GetHeaderSize(format, layout);
+  for (uint32_t level = 0; level < layout.m_levelNum; ++level)
+    size += GetSurfaceSize(layout, level) * layout.m_sliceNum;
+  return size;
+}
+
+uint64_t BC6HContainer::GetSurfaceOffset(Format format, const SLayout& layout, uint32_t level, uint32_t slice)
+{
+  if (format == Format::KTX2)
+    return GetKTX2LevelOffset(layout, level) + slice * GetSurfaceSize(layout, level);
+
+  uint64_t chainSize = 0;
+  uint64_t levelOffset = 0;
+  for (uint32_t i = 0; i < layout.m_levelNum; ++i)
+  {
+    if (i == level)
+      levelOffset = chainSize;
+    chainSize += GetSurfaceSize(layout, i);
+  }
+  return GetHeaderSize(format, layout) + slice * chainSize + levelOffset;
+}
+
+void BC6HContainer::WriteHeader(Format format, const SLayout& layout, uint8_t* header)
+{
+  if (format == Format::DDS)
+    WriteDDSHeader(layout, header);
+  else
+    WriteKTX2Header(layout, header);
+}
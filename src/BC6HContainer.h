@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdint.h>
+
+// DDS and KTX2 file layout for BC6H_UF16 textures with mips, arrays and cubemaps.
+// The header (KTX2 padding included) is followed by the block data of every surface, contiguous and in file order,
+// so a container can be written straight into a mapped file or streamed to a sink front to back.
+namespace BC6HContainer
+{
+  enum struct Format
+  {
+    // DX10 header, DXGI_FORMAT_BC6H_UF16. Slices one after the other, each with its whole mip chain.
+    DDS,
+    // VK_FORMAT_BC6H_UFLOAT_BLOCK. Levels from the smallest to the largest, each with all of its slices.
+    KTX2,
+  };
+
+  struct SLayout
+  {
+    uint32_t m_width;
+    uint32_t m_height;
+    uint32_t m_levelNum;
+    // Array slices, faces included: 6 * cube number for cubemaps (+X, -X, +Y, -Y, +Z, -Z)
+    uint32_t m_sliceNum;
+    bool m_cubemap;
+  };
+
+  // Block bytes of one slice of a level
+  uint64_t GetSurfaceSize(const SLayout& layout, uint32_t level);
+  uint64_t GetHeaderSize(Format format, const SLayout& layout);
+  uint64_t GetFileSize(Format format, const SLayout& layout);
+  uint64_t GetSurfaceOffset(Format format, const SLayout& layout, uint32_t level, uint32_t slice);
+
+  // Fills the GetHeaderSize bytes in front of the block data
+  void WriteHeader(Format format, const SLayout& layout, uint8_t* header);
+}
@@ -0,0 +1,435 @@
+#include "BC6HDecoderCPU.h"
+#include "BC6HDecoderSIMD.h"
+#include "BC6HMath.h"
+#include "ThreadPool.h"
+
+#include <string.h>
+
+namespace
+{
+  const uint32_t BLOCK_SIZE = 4;
+  const uint32_t BLOCK_BYTES = 16;
+
+  // Endpoint fields in the mode bit layouts: w/x are the endpoints of the first subset, y/z of the second one
+  enum Field : uint8_t
+  {
+    END,
+    RW, GW, BW,
+    RX, GX, BX,
+    RY, GY, BY,
+    RZ, GZ, BZ,
+    D,
+  };
+
+  // Consecutive header bits of one field, the first one goes to firstBit.
+  // Some fields are stored in reversed order (firstBit > lastBit).
+  struct SBitRun
+  {
+    uint8_t field;
+    uint8_t firstBit;
+    uint8_t lastBit;
+  };
+
+  struct SModeDesc
+  {
+    bool transformed;
+    bool partitioned;
+    uint8_t endpointBits;
+    uint8_t deltaBits[3];
+    SBitRun runs[24];
+  };
+
+  // Header bits after the mode bits, in the order of the BC6H format spec
+  const SModeDesc MODES[14] =
+  {
+    // 00: 10.555
+    { true, true, 10, { 5, 5, 5 }, {
+      { GY, 4, 4 }, { BY, 4, 4 }, { BZ, 4, 4 }, { RW, 0, 9 }, { GW, 0, 9 }, { BW, 0, 9 }, { RX, 0, 4 }, { GZ, 4, 4 },
+      { GY, 0, 3 }, { GX, 0, 4 }, { BZ, 0, 0 }, { GZ, 0, 3 }, { BX, 0, 4 }, { BZ, 1, 1 }, { BY, 0, 3 }, { RY, 0, 4 },
+      { BZ, 2, 2 }, { RZ, 0, 4 }, { BZ, 3, 3 }, { D, 0, 4 }, { END, 0, 0 } } },
+    // 01: 7.666, written by EncodeP2Pattern
+    { true, true, 7, { 6, 6, 6 }, {
+      { GY, 5, 5 }, { GZ, 4, 5 }, { RW, 0, 6 }, { BZ, 0, 1 }, { BY, 4, 4 }, { GW, 0, 6 }, { BY, 5, 5 }, { BZ, 2, 2 },
+      { GY, 4, 4 }, { BW, 0, 6 }, { BZ, 3, 3 }, { BZ, 5, 5 }, { BZ, 4, 4 }, { RX, 0, 5 }, { GY, 0, 3 }, { GX, 0, 5 },
+      { GZ, 0, 3 }, { BX, 0, 5 }, { BY, 0, 3 }, { RY, 0, 5 }, { RZ, 0, 5 }, { D, 0, 4 }, { END, 0, 0 } } },
+    // 00010: 11.544
+    { true, true, 11, { 5, 4, 4 }, {
+      { RW, 0, 9 }, { GW, 0, 9 }, { BW, 0, 9 }, { RX, 0, 4 }, { RW, 10, 10 }, { GY, 0, 3 }, { GX, 0, 3 }, { GW, 10, 10 },
+      { BZ, 0, 0 }, { GZ, 0, 3 }, { BX, 0, 3 }, { BW, 10, 10 }, { BZ, 1, 1 }, { BY, 0, 3 }, { RY, 0, 4 }, { BZ, 2, 2 },
+      { RZ, 0, 4 }, { BZ, 3, 3 }, { D, 0, 4 }, { END, 0, 0 } } },
+    // 00110: 11.454
+    { true, true, 11, { 4, 5, 4 }, {
+      { RW, 0, 9 }, { GW, 0, 9 }, { BW, 0, 9 }, { RX, 0, 3 }, { RW, 10, 10 }, { GZ, 4, 4 }, { GY, 0, 3 }, { GX, 0, 4 },
+      { GW, 10, 10 }, { GZ, 0, 3 }, { BX, 0, 3 }, { BW, 10, 10 }, { BZ, 1, 1 }, { BY, 0, 3 }, { RY, 0, 3 }, { BZ, 0, 0 },
+      { BZ, 2, 2 }, { RZ, 0, 3 }, { GY, 4, 4 }, { BZ, 3, 3 }, { D, 0, 4 }, { END, 0, 0 } } },
+    // 01010: 11.445
+    { true, true, 11, { 4, 4, 5 }, {
+      { RW, 0, 9 }, { GW, 0, 9 }, { BW, 0, 9 }, { RX, 0, 3 }, { RW, 10, 10 }, { BY, 4, 4 }, { GY, 0, 3 }, { GX, 0, 3 },
+      { GW, 10, 10 }, { BZ, 0, 0 }, { GZ, 0, 3 }, { BX, 0, 4 }, { BW, 10, 10 }, { BY, 0, 3 }, { RY, 0, 3 }, { BZ, 1, 2 },
+      { RZ, 0, 3 }, { BZ, 4, 4 }, { BZ, 3, 3 }, { D, 0, 4 }, { END, 0, 0 } } },
+    // 01110: 9.555, written by EncodeP2Pattern
+    { true, true, 9, { 5, 5, 5 }, {
+      { RW, 0, 8 }, { BY, 4, 4 }, { GW, 0, 8 }, { GY, 4, 4 }, { BW, 0, 8 }, { BZ, 4, 4 }, { RX, 0, 4 }, { GZ, 4, 4 },
+      { GY, 0, 3 }, { GX, 0, 4 }, { BZ, 0, 0 }, { GZ, 0, 3 }, { BX, 0, 4 }, { BZ, 1, 1 }, { BY, 0, 3 }, { RY, 0, 4 },
+      { BZ, 2, 2 }, { RZ, 0, 4 }, { BZ, 3, 3 }, { D, 0, 4 }, { END, 0, 0 } } },
+    // 10010: 8.655
+    { true, true, 8, { 6, 5, 5 }, {
+      { RW, 0, 7 }, { GZ, 4, 4 }, { BY, 4, 4 }, { GW, 0, 7 }, { BZ, 2, 2 }, { GY, 4, 4 }, { BW, 0, 7 }, { BZ, 3, 4 },
+      { RX, 0, 5 }, { GY, 0, 3 }, { GX, 0, 4 }, { BZ, 0, 0 }, { GZ, 0, 3 }, { BX, 0, 4 }, { BZ, 1, 1 }, { BY, 0, 3 },
+      { RY, 0, 5 }, { RZ, 0, 5 }, { D, 0, 4 }, { END, 0, 0 } } },
+    // 10110: 8.565
+    { true, true, 8, { 5, 6, 5 }, {
+      { RW, 0, 7 }, { BZ, 0, 0 }, { BY, 4, 4 }, { GW, 0, 7 }, { GY, 5, 4 }, { BW, 0, 7 }, { GZ, 5, 5 }, { BZ, 4, 4 },
+      { RX, 0, 4 }, { GZ, 4, 4 }, { GY, 0, 3 }, { GX, 0, 5 }, { GZ, 0, 3 }, { BX, 0, 4 }, { BZ, 1, 1 }, { BY, 0, 3 },
+      { RY, 0, 4 }, { BZ, 2, 2 }, { RZ, 0, 4 }, { BZ, 3, 3 }, { D, 0, 4 }, { END, 0, 0 } } },
+    // 11010: 8.556
+    { true, true, 8, { 5, 5, 6 }, {
+      { RW, 0, 7 }, { BZ, 1, 1 }, { BY, 4, 4 }, { GW, 0, 7 }, { BY, 5, 5 }, { GY, 4, 4 }, { BW, 0, 7 }, { BZ, 5, 4 },
+      { RX, 0, 4 }, { GZ, 4, 4 }, { GY, 0, 3 }, { GX, 0, 4 }, { BZ, 0, 0 }, { GZ, 0, 3 }, { BX, 0, 5 }, { BY, 0, 3 },
+      { RY, 0, 4 }, { BZ, 2, 2 }, { RZ, 0, 4 }, { BZ, 3, 3 }, { D, 0, 4 }, { END, 0, 0 } } },
+    // 11110: 6.6.6.6 without transform
+    { false, true, 6, { 6, 6, 6 }, {
+      { RW, 0, 5 }, { GZ, 4, 4 }, { BZ, 0, 1 }, { BY, 4, 4 }, { GW, 0, 5 }, { GY, 5, 5 }, { BY, 5, 5 }, { BZ, 2, 2 },
+      { GY, 4, 4 }, { BW, 0, 5 }, { GZ, 5, 5 }, { BZ, 3, 3 }, { BZ, 5, 5 }, { BZ, 4, 4 }, { RX, 0, 5 }, { GY, 0, 3 },
+      { GX, 0, 5 }, { GZ, 0, 3 }, { BX, 0, 5 }, { BY, 0, 3 }, { RY, 0, 5 }, { RZ, 0, 5 }, { D, 0, 4 }, { END, 0, 0 } } },
+    // 00011: 10.10 without transform, written by EncodeP1
+    { false, false, 10, { 10, 10, 10 }, {
+      { RW, 0, 9 }, { GW, 0, 9 }, { BW, 0, 9 }, { RX, 0, 9 }, { GX, 0, 9 }, { BX, 0, 9 }, { END, 0, 0 } } },
+    // 00111: 11.9
+    { true, false, 11, { 9, 9, 9 }, {
+      { RW, 0, 9 }, { GW, 0, 9 }, { BW, 0, 9 }, { RX, 0, 8 }, { RW, 10, 10 }, { GX, 0, 8 }, { GW, 10, 10 }, { BX, 0, 8 },
+      { BW, 10, 10 }, { END, 0, 0 } } },
+    // 01011: 12.8
+    { true, false, 12, { 8, 8, 8 }, {
+      { RW, 0, 9 }, { GW, 0, 9 }, { BW, 0, 9 }, { RX, 0, 7 }, { RW, 11, 10 }, { GX, 0, 7 }, { GW, 11, 10 }, { BX, 0, 7 },
+      { BW, 11, 10 }, { END, 0, 0 } } },
+    // 01111: 16.4
+    { true, false, 16, { 4, 4, 4 }, {
+      { RW, 0, 9 }, { GW, 0, 9 }, { BW, 0, 9 }, { RX, 0, 3 }, { RW, 15, 10 }, { GX, 0, 3 }, { GW, 15, 10 }, { BX, 0, 3 },
+      { BW, 15, 10 }, { END, 0, 0 } } },
+  };
+
+  // Subset of every texel (bit i set means the second subset) and the index of the second anchor texel
+  const uint16_t PARTITIONS[32] =
+  {
+    0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80,
+    0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+    0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE,
+    0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+  };
+
+  const uint8_t ANCHORS[32] =
+  {
+    15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+    15, 2, 8, 2, 2, 8, 8, 15, 2, 8, 2, 2, 8, 8, 2, 2,
+  };
+
+  const int32_t WEIGHTS3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+  const int32_t WEIGHTS4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+  class BitReader
+  {
+  public:
+    explicit BitReader(const uint8_t* data)
+    {
+      for (uint32_t i = 0; i < 8; ++i)
+      {
+        m_low |= static_cast<uint64_t>(data[i]) << (i * 8);
+        m_high |= static_cast<uint64_t>(data[i + 8]) << (i * 8);
+      }
+    }
+
+    // bitNum <= 32
+    uint32_t ReadBits(uint32_t bitNum)
+    {
+      uint64_t bits;
+      if (m_pos >= 64)
+        bits = m_high >> (m_pos - 64);
+      else if (m_pos > 0)
+        bits = (m_low >> m_pos) | (m_high << (64 - m_pos));
+      else
+        bits = m_low;
+
+      m_pos += bitNum;
+      return static_cast<uint32_t>(bits & ((1ull << bitNum) - 1));
+    }
+
+    void Skip(uint32_t bitNum) { m_pos += bitNum; }
+
+    // Remaining bits, at least 64 of them must have been read already
+    uint64_t ReadRest() const { return m_high >> (m_pos - 64); }
+
+  private:
+    uint64_t m_low = 0;
+    uint64_t m_high = 0;
+    uint32_t m_pos = 0;
+  };
+
+  // Index into MODES or -1 for the reserved modes
+  int32_t ModeIndex(const uint8_t block[16], uint32_t& modeBits)
+  {
+    uint32_t mode = block[0] & 0x1F;
+    if ((mode & 2) == 0)
+    {
+      modeBits = 2;
+      return mode & 1;
+    }
+
+    modeBits = 5;
+    if ((mode & 1) == 0)
+      return 2 + (mode >> 2);
+    return (mode >> 2) < 4 ? 10 + (mode >> 2) : -1;
+  }
+
+  int32_t SignExtend(int32_t x, uint32_t bitNum)
+  {
+    uint32_t signBit = 1u << (bitNum - 1);
+    uint32_t mask = (1u << bitNum) - 1;
+    uint32_t u = static_cast<uint32_t>(x) & mask;
+    return static_cast<int32_t>((u ^ signBit) - signBit);
+  }
+
+  int32_t Unquantize(int32_t x, uint32_t bitNum, bool isSigned)
+  {
+    if (!isSigned)
+    {
+      if (bitNum >= 15)
+        return x;
+      if (x == 0)
+        return 0;
+      if (x == (1 << bitNum) - 1)
+        return 0xFFFF;
+      return ((x << 16) + 0x8000) >> bitNum;
+    }
+
+    if (bitNum >= 16)
+      return x;
+
+    bool negative = x < 0;
+    int32_t absX = negative ? -x : x;
+    int32_t unq;
+    if (absX == 0)
+      unq = 0;
+    else if (absX >= (1 << (bitNum - 1)) - 1)
+      unq = 0x7FFF;
+    else
+      unq = ((absX << 15) + 0x4000) >> (bitNum - 1);
+    return negative ? -unq : unq;
+  }
+
+  // Interpolated value to half bits, same math as BC6HDecoderSIMD.inl
+  uint32_t InterpolateToHalf(int32_t endpoint0, int32_t endpoint1, int32_t weight, bool isSigned)
+  {
+    int32_t x = endpoint0 + (((endpoint1 - endpoint0) * weight + 32) >> 6);
+    if (!isSigned)
+      return static_cast<uint32_t>((x << 5) - x) >> 6;
+
+    bool negative = x < 0;
+    int32_t absX = negative ? -x : x;
+    uint32_t h = static_cast<uint32_t>((absX << 5) - absX) >> 5;
+    return negative ? h | 0x8000 : h;
+  }
+}
+
+void BC6HDecoderCPU::UnpackBlock(const uint8_t block[16], bool isSigned, SUnpackedBlock& unpacked)
+{
+  uint32_t modeBits;
+  int32_t modeIndex = ModeIndex(block, modeBits);
+  if (modeIndex < 0)
+  {
+    memset(&unpacked, 0, sizeof(unpacked));
+    return;
+  }
+
+  const SModeDesc& desc = MODES[modeIndex];
+  BitReader reader(block);
+  reader.Skip(modeBits);
+
+  // [w, x, y, z][r, g, b]
+  int32_t endpoints[4][3] = {};
+  uint32_t partition = 0;
+  for (const SBitRun* run = desc.runs; run->field != END; ++run)
+  {
+    uint32_t value = 0;
+    if (run->firstBit <= run->lastBit)
+    {
+      value = reader.ReadBits(run->lastBit - run->firstBit + 1) << run->firstBit;
+    }
+    else
+    {
+      for (int32_t bit = run->firstBit; bit >= run->lastBit; --bit)
+        value |= reader.ReadBits(1) << bit;
+    }
+
+    if (run->field == D)
+      partition |= value;
+    else
+      endpoints[(run->field - RW) / 3][(run->field - RW) % 3] |= static_cast<int32_t>(value);
+  }
+
+  uint32_t endpointNum = desc.partitioned ? 4 : 2;
+  for (uint32_t c = 0; c < 3; ++c)
+  {
+    if (isSigned)
+      endpoints[0][c] = SignExtend(endpoints[0][c], desc.endpointBits);
+
+    for (uint32_t i = 1; i < endpointNum; ++i)
+    {
+      if (desc.transformed)
+      {
+        // Stored as deltas from the first endpoint
+        int32_t delta = SignExtend(endpoints[i][c], desc.deltaBits[c]);
+        endpoints[i][c] = (endpoints[0][c] + delta) & ((1 << desc.endpointBits) - 1);
+      }
+
+      if (isSigned)
+        endpoints[i][c] = SignExtend(endpoints[i][c], desc.endpointBits);
+    }
+
+    for (uint32_t i = 0; i < endpointNum; ++i)
+      endpoints[i][c] = Unquantize(endpoints[i][c], desc.endpointBits, isSigned);
+  }
+
+  // Indices fill the rest of the block after the header (82 bits with 2 subsets, 65 with 1), anchor texels drop their top bit
+  uint64_t indices = reader.ReadRest();
+  if (desc.partitioned)
+  {
+    uint32_t anchor = ANCHORS[partition];
+    for (uint32_t i = 0; i < 16; ++i)
+    {
+      uint32_t bitNum = i == 0 || i == anchor ? 2 : 3;
+      unpacked.weights[i] = WEIGHTS3[indices & ((1u << bitNum) - 1)];
+      indices >>= bitNum;
+    }
+  }
+  else
+  {
+    unpacked.weights[0] = WEIGHTS4[indices & 0x7];
+    indices >>= 3;
+    for (uint32_t i = 1; i < 16; ++i)
+    {
+      unpacked.weights[i] = WEIGHTS4[indices & 0xF];
+      indices >>= 4;
+    }
+  }
+
+  memcpy(unpacked.endpoints, endpoints, sizeof(unpacked.endpoints));
+  unpacked.subsets = desc.partitioned ? PARTITIONS[partition] : 0;
+}
+
+void BC6HDecoderCPU::DecodeBlock(const uint8_t block[16], bool isSigned, uint16_t texels[16][4])
+{
+  SUnpackedBlock unpacked;
+  UnpackBlock(block, isSigned, unpacked);
+
+  for (uint32_t i = 0; i < 16; ++i)
+  {
+    const int32_t (*endpoints)[3] = unpacked.endpoints[(unpacked.subsets >> i) & 1];
+    for (uint32_t c = 0; c < 3; ++c)
+      texels[i][c] = static_cast<uint16_t>(InterpolateToHalf(endpoints[0][c], endpoints[1][c], unpacked.weights[i], isSigned));
+    texels[i][3] = 0x3C00;
+  }
+}
+
+void BC6HDecoderCPU::DecompressImage(const uint8_t* blocks, uint32_t width, uint32_t height, bool isSigned, OutputFormat format, uint32_t rowPitch, BC6HEncoderSIMD::ISA isa, ThreadPool* pool, uint8_t* texels)
+{
+  uint32_t widthInBlocks = (width + BLOCK_SIZE - 1) / BLOCK_SIZE;
+  uint32_t heightInBlocks = (height + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+  BC6HDecoderSIMD::DecodeBlocksFunc decodeBlocks = BC6HDecoderSIMD::GetDecodeBlocks(isa);
+  uint32_t laneNum = decodeBlocks ? BC6HEncoderSIMD::GetLaneNum(isa) : 1;
+  bool toFloat = format == OutputFormat::RGBA32F;
+
+  // Writes texels of a block that fall inside of the image, rgb holds half or float bits [16][3][stride]
+  auto storeBlock = [&](uint32_t blockX, uint32_t blockY, const uint32_t* rgb, uint32_t stride)
+  {
+    uint32_t blockWidth = width - blockX * BLOCK_SIZE < BLOCK_SIZE ? width - blockX * BLOCK_SIZE : BLOCK_SIZE;
+    uint32_t blockHeight = height - blockY * BLOCK_SIZE < BLOCK_SIZE ? height - blockY * BLOCK_SIZE : BLOCK_SIZE;
+    for (uint32_t y = 0; y < blockHeight; ++y)
+    {
+      uint8_t* dstRow = texels + static_cast<size_t>(blockY * BLOCK_SIZE + y) * rowPitch;
+      const uint32_t* src = rgb + y * BLOCK_SIZE * 3 * stride;
+      if (toFloat)
+      {
+        float* dst = reinterpret_cast<float*>(dstRow) + blockX * BLOCK_SIZE * 4;
+        for (uint32_t x = 0; x < blockWidth; ++x, src += 3 * stride, dst += 4)
+        {
+          dst[0] = BC6HMath::AsFloat(src[0]);
+          dst[1] = BC6HMath::AsFloat(src[stride]);
+          dst[2] = BC6HMath::AsFloat(src[2 * stride]);
+          dst[3] = 1.0f;
+        }
+      }
+      else
+      {
+        uint16_t* dst = reinterpret_cast<uint16_t*>(dstRow) + blockX * BLOCK_SIZE * 4;
+        for (uint32_t x = 0; x < blockWidth; ++x, src += 3 * stride, dst += 4)
+        {
+          dst[0] = static_cast<uint16_t>(src[0]);
+          dst[1] = static_cast<uint16_t>(src[stride]);
+          dst[2] = static_cast<uint16_t>(src[2 * stride]);
+          dst[3] = 0x3C00;
+        }
+      }
+    }
+  };
+
+  auto decodeRow = [&](uint32_t blockY)
+  {
+    const uint8_t* srcRow = blocks + static_cast<size_t>(blockY) * widthInBlocks * BLOCK_BYTES;
+
+    if (!decodeBlocks)
+    {
+      for (uint32_t blockX = 0; blockX < widthInBlocks; ++blockX)
+      {
+        uint16_t halves[16][4];
+        DecodeBlock(srcRow + blockX * BLOCK_BYTES, isSigned, halves);
+
+        uint32_t rgb[16][3];
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+          for (uint32_t c = 0; c < 3; ++c)
+            rgb[i][c] = toFloat ? BC6HMath::AsUint(BC6HMath::F16ToF32(halves[i][c])) : halves[i][c];
+        }
+        storeBlock(blockX, blockY, rgb[0], 1);
+      }
+      return;
+    }
+
+    // Structure of arrays for up to 16 lanes, the last group is padded with copies of its last block
+    int32_t endpointsSoA[2 * 2 * 3 * 16];
+    int32_t subsetsSoA[16];
+    int32_t weightsSoA[16 * 16];
+    uint32_t texelsSoA[16 * 3 * 16];
+    for (uint32_t groupX = 0; groupX < widthInBlocks; groupX += laneNum)
+    {
+      uint32_t groupSize = widthInBlocks - groupX < laneNum ? widthInBlocks - groupX : laneNum;
+      for (uint32_t lane = 0; lane < laneNum; ++lane)
+      {
+        SUnpackedBlock unpacked;
+        UnpackBlock(srcRow + (groupX + (lane < groupSize ? lane : groupSize - 1)) * BLOCK_BYTES, isSigned, unpacked);
+
+        const int32_t* endpoints = unpacked.endpoints[0][0];
+        for (uint32_t i = 0; i < 2 * 2 * 3; ++i)
+          endpointsSoA[i * laneNum + lane] = endpoints[i];
+        subsetsSoA[lane] = static_cast<int32_t>(unpacked.subsets);
+        for (uint32_t i = 0; i < 16; ++i)
+          weightsSoA[i * laneNum + lane] = unpacked.weights[i];
+      }
+
+      decodeBlocks(endpointsSoA, subsetsSoA, weightsSoA, isSigned, toFloat, texelsSoA);
+      for (uint32_t lane = 0; lane < groupSize; ++lane)
+        storeBlock(groupX + lane, blockY, texelsSoA + lane, laneNum);
+    }
+  };
+
+  if (pool)
+  {
+    pool->ParallelFor(heightInBlocks, decodeRow);
+  }
+  else
+  {
+    for (uint32_t blockY = 0; blockY < heightInBlocks; ++blockY)
+      decodeRow(blockY);
+  }
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+#include "BC6HEncoderSIMD.h"
+
+class ThreadPool;
+
+// BC6H decoder for all 14 modes, both BC6H_UF16 and BC6H_SF16.
+// Blocks are unpacked one by one, endpoint interpolation and the half/float conversion
+// run lane-wide over groups of blocks with the same ISA kernels as the encoder.
+namespace BC6HDecoderCPU
+{
+  enum struct OutputFormat
+  {
+    RGBA16F,
+    RGBA32F,
+  };
+
+  // Endpoints unquantized to 16 bits, weights are in [0, 64]. Reserved modes unpack to black.
+  struct SUnpackedBlock
+  {
+    int32_t endpoints[2][2][3];
+    // Bit i is set when texel i belongs to the second subset
+    uint32_t subsets;
+    int32_t weights[16];
+  };
+
+  void UnpackBlock(const uint8_t block[16], bool isSigned, SUnpackedBlock& unpacked);
+
+  // Decodes one block to RGBA half floats, alpha is 1
+  void DecodeBlock(const uint8_t block[16], bool isSigned, uint16_t texels[16][4]);
+
+  // Decodes tightly packed blocks into a width x height image, one block row per task
+  void DecompressImage(const uint8_t* blocks, uint32_t width, uint32_t height, bool isSigned, OutputFormat format, uint32_t rowPitch, BC6HEncoderSIMD::ISA isa, ThreadPool* pool, uint8_t* texels);
+}
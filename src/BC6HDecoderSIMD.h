@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stdint.h>
+#include "BC6HEncoderSIMD.h"
+
+// Lane-wide part of BC6HDecoderCPU: endpoint interpolation, unquantization and the
+// half to float conversion for one block per lane. Built into the same per ISA
+// translation units as the encoder kernels.
+namespace BC6HDecoderSIMD
+{
+  // Structure of arrays of SUnpackedBlock fields: endpoints [2][2][3][laneNum], subsets [laneNum], weights [16][laneNum]
+  // texels: [16][3][laneNum] half bits, or float bits with toFloat
+  typedef void (*DecodeBlocksFunc)(const int32_t* endpoints, const int32_t* subsets, const int32_t* weights, bool isSigned, bool toFloat, uint32_t* texels);
+
+  // Returns nullptr for ISA::Scalar
+  DecodeBlocksFunc GetDecodeBlocks(BC6HEncoderSIMD::ISA isa);
+
+#if BC6H_SIMD_X86
+  void DecodeBlocksSSE41(const int32_t* endpoints, const int32_t* subsets, const int32_t* weights, bool isSigned, bool toFloat, uint32_t* texels);
+  void DecodeBlocksAVX2(const int32_t* endpoints, const int32_t* subsets, const int32_t* weights, bool isSigned, bool toFloat, uint32_t* texels);
+  void DecodeBlocksAVX512(const int32_t* endpoints, const int32_t* subsets, const int32_t* weights, bool isSigned, bool toFloat, uint32_t* texels);
+#endif
+}
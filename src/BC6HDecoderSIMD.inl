@@ -0,0 +1,44 @@
+// Lane-wide version of the BC6HDecoderCPU interpolation, every lane decodes one block.
+// Included by the per ISA translation units after BC6HEncoderSIMD.inl, which provides F16ToF32.
+// Integer math matches BC6HDecoderCPU.cpp exactly.
+
+// endpoints: [2][2][3][LANES], subsets: [LANES], weights: [16][LANES], texels: [16][3][LANES]
+inline void DecodeBlocks(const int32_t* endpoints, const int32_t* subsets, const int32_t* weights, bool isSigned, bool toFloat, uint32_t* texels)
+{
+  I subsetEndpoints[2][2][3];
+  for (uint32_t i = 0; i < 2 * 2 * 3; ++i)
+    subsetEndpoints[i / 6][(i / 3) % 2][i % 3] = LoadI(endpoints + i * LANES);
+
+  I subsetBits = LoadI(subsets);
+  for (uint32_t i = 0; i < 16; ++i)
+  {
+    M secondSubset = ((subsetBits >> i) & 1) == SetI(1);
+    I weight = LoadI(weights + i * LANES);
+    for (uint32_t c = 0; c < 3; ++c)
+    {
+      I endpoint0 = Select(secondSubset, subsetEndpoints[1][0][c], subsetEndpoints[0][0][c]);
+      I endpoint1 = Select(secondSubset, subsetEndpoints[1][1][c], subsetEndpoints[0][1][c]);
+
+      // (e0 * (64 - w) + e1 * w + 32) >> 6
+      I x = endpoint0 + Sra((endpoint1 - endpoint0) * weight + SetI(32), 6);
+
+      // Scale by 31/32 (signed) or 31/64 (unsigned) into the half range
+      I h;
+      if (isSigned)
+      {
+        M negative = x < SetI(0);
+        I absX = Select(negative, SetI(0) - x, x);
+        h = (((absX << 5) - absX) >> 5) | Select(negative, SetI(0x8000), SetI(0));
+      }
+      else
+      {
+        h = ((x << 5) - x) >> 6;
+      }
+
+      if (toFloat)
+        h = AsI(F16ToF32(h));
+
+      StoreI(reinterpret_cast<int32_t*>(texels + (i * 3 + c) * LANES), h);
+    }
+  }
+}
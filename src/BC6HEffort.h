@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+
+// Encoder effort levels of BC6HEncoderCPU and BC6HEncoderSIMD, replacing the QUALITY, ENCODE_P2, INSET_COLOR_BBOX
+// and OPTIMIZE_ENDPOINTS switches of compress.hlsl. Every level is its own instantiation of the encoder templates,
+// so the switches below are compile time constants and the inner loops don't test them.
+//   0: P1 (mode 11) straight from the color bounding box
+//   1: + bounding box inset and least squares endpoints, compress_speed
+//   2: + P2 (modes 1 and 6) with the best fitting of the 32 patterns, compress_quality
+//   3: + bounding box inset of both P2 subsets
+//   4: + a second least squares pass for every endpoint pair
+//   5: + encodes the P2_CANDIDATES best fitting patterns instead of one and keeps the best
+namespace BC6HEffort
+{
+  const uint32_t MAX = 5;
+  // The compress.hlsl builds, Preset::Speed and Preset::Quality
+  const uint32_t SPEED = 1;
+  const uint32_t QUALITY = 2;
+
+  template<uint32_t Level>
+  struct STraits
+  {
+    static const bool INSET_P1 = Level >= 1;
+    static const bool OPTIMIZE_ENDPOINTS = Level >= 1;
+    static const bool ENCODE_P2 = Level >= 2;
+    static const bool INSET_P2 = Level >= 3;
+    static const uint32_t OPTIMIZE_PASSES = Level >= 4 ? 2 : 1;
+    static const uint32_t P2_CANDIDATES = Level >= 5 ? 4 : 1;
+  };
+}
@@ -0,0 +1,1207 @@
+#include "BC6HEncoderCPU.h"
+#include "BC6HBlockCache.h"
+#include "BC6HEffort.h"
+#include "BC6HMath.h"
+#include "ThreadPool.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+  const float HALF_MAX = 65504.0f;
+  // Largest finite half as bits, the least squares endpoints are solved on f32tof16 values.
+  // compress.hlsl clamps them to HALF_MAX, whose bits f16tof32 turns into Inf and NaN endpoints.
+  const float HALF_MAX_BITS = 31743.0f;
+  // Squared log2 error of 0 against HALF_MAX, CalcMSLE's value for NaN errors
+  const float MSLE_NAN = 256.0f;
+
+  struct float3
+  {
+    float3() : x(0.0f), y(0.0f), z(0.0f) {}
+    explicit float3(float s) : x(s), y(s), z(s) {}
+    float3(float x_, float y_, float z_) : x(x_), y(y_), z(z_) {}
+
+    float x;
+    float y;
+    float z;
+  };
+
+  struct uint4
+  {
+    uint32_t x;
+    uint32_t y;
+    uint32_t z;
+    uint32_t w;
+  };
+
+  float3 operator+(float3 a, float3 b) { return float3(a.x + b.x, a.y + b.y, a.z + b.z); }
+  float3 operator-(float3 a, float3 b) { return float3(a.x - b.x, a.y - b.y, a.z - b.z); }
+  float3 operator*(float3 a, float3 b) { return float3(a.x * b.x, a.y * b.y, a.z * b.z); }
+  float3 operator/(float3 a, float3 b) { return float3(a.x / b.x, a.y / b.y, a.z / b.z); }
+  float3 operator+(float3 a, float s) { return float3(a.x + s, a.y + s, a.z + s); }
+  float3 operator-(float3 a, float s) { return float3(a.x - s, a.y - s, a.z - s); }
+  float3 operator*(float3 a, float s) { return float3(a.x * s, a.y * s, a.z * s); }
+  float3 operator*(float s, float3 a) { return float3(s * a.x, s * a.y, s * a.z); }
+  float3 operator/(float3 a, float s) { return float3(a.x / s, a.y / s, a.z / s); }
+  float3& operator+=(float3& a, float3 b) { a = a + b; return a; }
+  float3& operator-=(float3& a, float3 b) { a = a - b; return a; }
+
+  // HLSL min/max return the non-NaN operand, see BC6HMath::Min
+  float min(float a, float b) { return BC6HMath::Min(a, b); }
+  float max(float a, float b) { return BC6HMath::Max(a, b); }
+  float3 min(float3 a, float3 b) { return float3(min(a.x, b.x), min(a.y, b.y), min(a.z, b.z)); }
+  float3 max(float3 a, float3 b) { return float3(max(a.x, b.x), max(a.y, b.y), max(a.z, b.z)); }
+  float clamp(float x, float a, float b) { return min(max(x, a), b); }
+  float3 clamp(float3 v, float a, float b) { return float3(clamp(v.x, a, b), clamp(v.y, a, b), clamp(v.z, a, b)); }
+  float saturate(float x) { return clamp(x, 0.0f, 1.0f); }
+  float3 floor(float3 v) { return float3(floorf(v.x), floorf(v.y), floorf(v.z)); }
+  float3 log2(float3 v) { return float3(BC6HMath::Log2(v.x), BC6HMath::Log2(v.y), BC6HMath::Log2(v.z)); }
+  float3 exp2(float3 v) { return float3(BC6HMath::Exp2(v.x), BC6HMath::Exp2(v.y), BC6HMath::Exp2(v.z)); }
+  float dot(float3 a, float3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+
+  // normalize() compiles to rsq + mul
+  float3 normalize(float3 v) { return v * (1.0f / sqrtf(dot(v, v))); }
+
+  // Per component a == b ? c : d
+  float3 SelectEq(float3 a, float3 b, float3 c, float3 d)
+  {
+    return float3(a.x == b.x ? c.x : d.x, a.y == b.y ? c.y : d.y, a.z == b.z ? c.z : d.z);
+  }
+
+  // D3D ftou/ftoi conversion rules: NaN goes to 0, out of range values are clamped
+  uint32_t ftou(float x)
+  {
+    if (!(x > 0.0f))
+      return 0;
+    if (x >= 4294967296.0f)
+      return 0xFFFFFFFF;
+    return static_cast<uint32_t>(x);
+  }
+
+  int32_t ftoi(float x)
+  {
+    if (x != x)
+      return 0;
+    if (x <= -2147483648.0f)
+      return INT32_MIN;
+    if (x >= 2147483648.0f)
+      return INT32_MAX;
+    return static_cast<int32_t>(x);
+  }
+
+  float f32tof16(float x)
+  {
+    return static_cast<float>(BC6HMath::F32ToF16(x));
+  }
+
+  float3 f32tof16(float3 v) { return float3(f32tof16(v.x), f32tof16(v.y), f32tof16(v.z)); }
+
+  float f16tof32(uint32_t x)
+  {
+    return BC6HMath::F16ToF32(x);
+  }
+
+  // f16tof32 takes uint, float arguments are converted with ftou first
+  float3 f16tof32(float3 v) { return float3(f16tof32(ftou(v.x)), f16tof32(ftou(v.y)), f16tof32(ftou(v.z))); }
+
+  float CalcMSLE(float3 a, float3 b)
+  {
+    float3 delta = log2((b + 1.0f) / (a + 1.0f));
+    float3 deltaSq = delta * delta;
+
+    float3 luminanceWeights = float3(0.299f, 0.587f, 0.114f);
+    deltaSq = deltaSq * luminanceWeights;
+
+    // Negative and NaN texels give NaN errors, they count as the largest error within the half range
+    // so every path compares the candidates the same way
+    float msle = deltaSq.x + deltaSq.y + deltaSq.z;
+    return msle == msle ? msle : MSLE_NAN;
+  }
+
+  uint32_t PatternFixupID(uint32_t i)
+  {
+    uint32_t ret = 15;
+    ret = ((3441033216 >> i) & 0x1) ? 2 : ret;
+    ret = ((845414400 >> i) & 0x1) ? 8 : ret;
+    return ret;
+  }
+
+  const uint32_t P2_PATTERN_NUM = 32;
+
+  // Partition masks of the P2 patterns, bit i set when texel i belongs to the second subset
+  const uint16_t P2_PATTERN_MASKS[P2_PATTERN_NUM] =
+  {
+    0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80,
+    0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+    0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE,
+    0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+  };
+
+  uint32_t Pattern(uint32_t p, uint32_t i)
+  {
+    return (P2_PATTERN_MASKS[p] >> i) & 0x1;
+  }
+
+  float3 Quantize7(float3 x)
+  {
+    return (f32tof16(x) * 128.0f) / (0x7bff + 1.0f);
+  }
+
+  float3 Quantize9(float3 x)
+  {
+    return (f32tof16(x) * 512.0f) / (0x7bff + 1.0f);
+  }
+
+  float3 Quantize10(float3 x)
+  {
+    return (f32tof16(x) * 1024.0f) / (0x7bff + 1.0f);
+  }
+
+  float3 Unquantize7(float3 x)
+  {
+    return (x * 65536.0f + 0x8000) / 128.0f;
+  }
+
+  float3 Unquantize9(float3 x)
+  {
+    return (x * 65536.0f + 0x8000) / 512.0f;
+  }
+
+  float3 Unquantize10(float3 x)
+  {
+    return (x * 65536.0f + 0x8000) / 1024.0f;
+  }
+
+  float3 FinishUnquantize(float3 endpoint0Unq, float3 endpoint1Unq, float weight)
+  {
+    float3 comp = (endpoint0Unq * (64.0f - weight) + endpoint1Unq * weight + 32.0f) * (31.0f / 4096.0f);
+    return f16tof32(comp);
+  }
+
+  template<typename T>
+  void Swap(T& a, T& b)
+  {
+    T tmp = a;
+    a = b;
+    b = tmp;
+  }
+
+  uint32_t ComputeIndex3(float texelPos, float endPoint0Pos, float endPoint1Pos)
+  {
+    float r = (texelPos - endPoint0Pos) / (endPoint1Pos - endPoint0Pos);
+    return ftou(clamp(r * 6.98182f + 0.00909f + 0.5f, 0.0f, 7.0f));
+  }
+
+  uint32_t ComputeIndex4(float texelPos, float endPoint0Pos, float endPoint1Pos)
+  {
+    float r = (texelPos - endPoint0Pos) / (endPoint1Pos - endPoint0Pos);
+    return ftou(clamp(r * 14.93333f + 0.03333f + 0.5f, 0.0f, 15.0f));
+  }
+
+  void SignExtend(float3& v1, uint32_t mask, uint32_t signFlag)
+  {
+    int32_t v[3] = { ftoi(v1.x), ftoi(v1.y), ftoi(v1.z) };
+    for (int32_t& c : v)
+      c = (c & mask) | (c < 0 ? signFlag : 0);
+    v1 = float3(static_cast<float>(v[0]), static_cast<float>(v[1]), static_cast<float>(v[2]));
+  }
+
+  // Refine endpoints by insetting bounding box in log2 RGB space
+  void InsetColorBBoxP1(const float3 texels[16], float3& blockMin, float3& blockMax)
+  {
+    float3 refinedBlockMin = blockMax;
+    float3 refinedBlockMax = blockMin;
+
+    for (uint32_t i = 0; i < 16; ++i)
+    {
+      refinedBlockMin = min(refinedBlockMin, SelectEq(texels[i], blockMin, refinedBlockMin, texels[i]));
+      refinedBlockMax = max(refinedBlockMax, SelectEq(texels[i], blockMax, refinedBlockMax, texels[i]));
+    }
+
+    float3 logRefinedBlockMax = log2(refinedBlockMax + 1.0f);
+    float3 logRefinedBlockMin = log2(refinedBlockMin + 1.0f);
+
+    float3 logBlockMax = log2(blockMax + 1.0f);
+    float3 logBlockMin = log2(blockMin + 1.0f);
+    float3 logBlockMaxExt = (logBlockMax - logBlockMin) * (1.0f / 32.0f);
+
+    logBlockMin += min(logRefinedBlockMin - logBlockMin, logBlockMaxExt);
+    logBlockMax -= min(logBlockMax - logRefinedBlockMax, logBlockMaxExt);
+
+    blockMin = exp2(logBlockMin) - 1.0f;
+    blockMax = exp2(logBlockMax) - 1.0f;
+  }
+
+  // InsetColorBBoxP1 over the texels of one subset
+  void InsetColorBBoxP2(const float3 texels[16], uint32_t pattern, uint32_t patternSelector, float3& blockMin, float3& blockMax)
+  {
+    float3 refinedBlockMin = blockMax;
+    float3 refinedBlockMax = blockMin;
+
+    for (uint32_t i = 0; i < 16; ++i)
+    {
+      uint32_t paletteID = Pattern(pattern, i);
+      if (paletteID == patternSelector)
+      {
+        refinedBlockMin = min(refinedBlockMin, SelectEq(texels[i], blockMin, refinedBlockMin, texels[i]));
+        refinedBlockMax = max(refinedBlockMax, SelectEq(texels[i], blockMax, refinedBlockMax, texels[i]));
+      }
+    }
+
+    float3 logRefinedBlockMax = log2(refinedBlockMax + 1.0f);
+    float3 logRefinedBlockMin = log2(refinedBlockMin + 1.0f);
+
+    float3 logBlockMax = log2(blockMax + 1.0f);
+    float3 logBlockMin = log2(blockMin + 1.0f);
+    float3 logBlockMaxExt = (logBlockMax - logBlockMin) * (1.0f / 32.0f);
+
+    logBlockMin += min(logRefinedBlockMin - logBlockMin, logBlockMaxExt);
+    logBlockMax -= min(logBlockMax - logRefinedBlockMax, logBlockMaxExt);
+
+    blockMin = exp2(logBlockMin) - 1.0f;
+    blockMax = exp2(logBlockMax) - 1.0f;
+  }
+
+  // Least squares optimization to find best endpoints for the selected block indices
+  void OptimizeEndpointsP1(const float3 texels[16], float3& blockMin, float3& blockMax)
+  {
+    float3 blockDir = blockMax - blockMin;
+    blockDir = blockDir / (blockDir.x + blockDir.y + blockDir.z);
+
+    float endPoint0Pos = f32tof16(dot(blockMin, blockDir));
+    float endPoint1Pos = f32tof16(dot(blockMax, blockDir));
+
+    float3 alphaTexelSum = float3(0.0f);
+    float3 betaTexelSum = float3(0.0f);
+    float alphaBetaSum = 0.0f;
+    float alphaSqSum = 0.0f;
+    float betaSqSum = 0.0f;
+
+    for (int i = 0; i < 16; i++)
+    {
+      float texelPos = f32tof16(dot(texels[i], blockDir));
+      uint32_t texelIndex = ComputeIndex4(texelPos, endPoint0Pos, endPoint1Pos);
+
+      float beta = saturate(texelIndex / 15.0f);
+      float alpha = 1.0f - beta;
+
+      float3 texelF16 = f32tof16(texels[i]);
+      alphaTexelSum += alpha * texelF16;
+      betaTexelSum += beta * texelF16;
+
+      alphaBetaSum += alpha * beta;
+
+      alphaSqSum += alpha * alpha;
+      betaSqSum += beta * beta;
+    }
+
+    float det = alphaSqSum * betaSqSum - alphaBetaSum * alphaBetaSum;
+
+    if (fabsf(det) > 0.00001f)
+    {
+      float detRcp = 1.0f / det;
+      blockMin = f16tof32(clamp(detRcp * (alphaTexelSum * betaSqSum - betaTexelSum * alphaBetaSum), 0.0f, HALF_MAX_BITS));
+      blockMax = f16tof32(clamp(detRcp * (betaTexelSum * alphaSqSum - alphaTexelSum * alphaBetaSum), 0.0f, HALF_MAX_BITS));
+    }
+  }
+
+  // Least squares optimization to find best endpoints for the selected block indices
+  void OptimizeEndpointsP2(const float3 texels[16], uint32_t pattern, uint32_t patternSelector, float3& blockMin, float3& blockMax)
+  {
+    float3 blockDir = blockMax - blockMin;
+    blockDir = blockDir / (blockDir.x + blockDir.y + blockDir.z);
+
+    float endPoint0Pos = f32tof16(dot(blockMin, blockDir));
+    float endPoint1Pos = f32tof16(dot(blockMax, blockDir));
+
+    float3 alphaTexelSum = float3(0.0f);
+    float3 betaTexelSum = float3(0.0f);
+    float alphaBetaSum = 0.0f;
+    float alphaSqSum = 0.0f;
+    float betaSqSum = 0.0f;
+
+    for (int i = 0; i < 16; i++)
+    {
+      uint32_t paletteID = Pattern(pattern, i);
+      if (paletteID == patternSelector)
+      {
+        float texelPos = f32tof16(dot(texels[i], blockDir));
+        uint32_t texelIndex = ComputeIndex3(texelPos, endPoint0Pos, endPoint1Pos);
+
+        float beta = saturate(texelIndex / 7.0f);
+        float alpha = 1.0f - beta;
+
+        float3 texelF16 = f32tof16(texels[i]);
+        alphaTexelSum += alpha * texelF16;
+        betaTexelSum += beta * texelF16;
+
+        alphaBetaSum += alpha * beta;
+
+        alphaSqSum += alpha * alpha;
+        betaSqSum += beta * beta;
+      }
+    }
+
+    float det = alphaSqSum * betaSqSum - alphaBetaSum * alphaBetaSum;
+
+    if (fabsf(det) > 0.00001f)
+    {
+      float detRcp = 1.0f / det;
+      blockMin = f16tof32(clamp(detRcp * (alphaTexelSum * betaSqSum - betaTexelSum * alphaBetaSum), 0.0f, HALF_MAX_BITS));
+      blockMax = f16tof32(clamp(detRcp * (betaTexelSum * alphaSqSum - alphaTexelSum * alphaBetaSum), 0.0f, HALF_MAX_BITS));
+    }
+  }
+
+  template<uint32_t Effort>
+  void EncodeP1(uint4& block, float& blockMSLE, const float3 texels[16])
+  {
+    typedef BC6HEffort::STraits<Effort> Traits;
+
+    // compute endpoints (min/max RGB bbox)
+    float3 blockMin = texels[0];
+    float3 blockMax = texels[0];
+    for (uint32_t i = 1; i < 16; ++i)
+    {
+      blockMin = min(blockMin, texels[i]);
+      blockMax = max(blockMax, texels[i]);
+    }
+
+    if (Traits::INSET_P1)
+      InsetColorBBoxP1(texels, blockMin, blockMax);
+    for (uint32_t pass = 0; Traits::OPTIMIZE_ENDPOINTS && pass < Traits::OPTIMIZE_PASSES; ++pass)
+      OptimizeEndpointsP1(texels, blockMin, blockMax);
+
+    float3 blockDir = blockMax - blockMin;
+    blockDir = blockDir / (blockDir.x + blockDir.y + blockDir.z);
+
+    float3 endpoint0 = Quantize10(blockMin);
+    float3 endpoint1 = Quantize10(blockMax);
+    float endPoint0Pos = f32tof16(dot(blockMin, blockDir));
+    float endPoint1Pos = f32tof16(dot(blockMax, blockDir));
+
+    // check if endpoint swap is required
+    float fixupTexelPos = f32tof16(dot(texels[0], blockDir));
+    uint32_t fixupIndex = ComputeIndex4(fixupTexelPos, endPoint0Pos, endPoint1Pos);
+    if (fixupIndex > 7)
+    {
+      Swap(endPoint0Pos, endPoint1Pos);
+      Swap(endpoint0, endpoint1);
+    }
+
+    // compute indices
+    uint32_t indices[16] = { 0 };
+    for (uint32_t i = 0; i < 16; ++i)
+    {
+      float texelPos = f32tof16(dot(texels[i], blockDir));
+      indices[i] = ComputeIndex4(texelPos, endPoint0Pos, endPoint1Pos);
+    }
+
+    // compute compression error (MSLE)
+    float3 endpoint0Unq = Unquantize10(endpoint0);
+    float3 endpoint1Unq = Unquantize10(endpoint1);
+    float msle = 0.0f;
+    for (uint32_t i = 0; i < 16; ++i)
+    {
+      float weight = floorf((indices[i] * 64.0f) / 15.0f + 0.5f);
+      float3 texelUnc = FinishUnquantize(endpoint0Unq, endpoint1Unq, weight);
+
+      msle += CalcMSLE(texels[i], texelUnc);
+    }
+
+    // encode block for mode 11
+    blockMSLE = msle;
+    block.x = 0x03;
+
+    // endpoints
+    block.x |= ftou(endpoint0.x) << 5;
+    block.x |= ftou(endpoint0.y) << 15;
+    block.x |= ftou(endpoint0.z) << 25;
+    block.y |= ftou(endpoint0.z) >> 7;
+    block.y |= ftou(endpoint1.x) << 3;
+    block.y |= ftou(endpoint1.y) << 13;
+    block.y |= ftou(endpoint1.z) << 23;
+    block.z |= ftou(endpoint1.z) >> 9;
+
+    // indices
+    block.z |= indices[0] << 1;
+    block.z |= indices[1] << 4;
+    block.z |= indices[2] << 8;
+    block.z |= indices[3] << 12;
+    block.z |= indices[4] << 16;
+    block.z |= indices[5] << 20;
+    block.z |= indices[6] << 24;
+    block.z |= indices[7] << 28;
+    block.w |= indices[8] << 0;
+    block.w |= indices[9] << 4;
+    block.w |= indices[10] << 8;
+    block.w |= indices[11] << 12;
+    block.w |= indices[12] << 16;
+    block.w |= indices[13] << 20;
+    block.w |= indices[14] << 24;
+    block.w |= indices[15] << 28;
+  }
+
+  float DistToLineSq(float3 PointOnLine, float3 LineDirection, float3 Point)
+  {
+    float3 w = Point - PointOnLine;
+    float3 x = w - dot(w, LineDirection) * LineDirection;
+    return dot(x, x);
+  }
+
+  // Evaluates how good every P2 pattern is for encoding the current block, like EvaluateP2Pattern of compress.hlsl:
+  // the squared distance of the texels from the lines through their subset bounding boxes.
+  // The bounds of every subset of every texel row are computed once per block, so the subset bounds of a pattern
+  // are four lookups by its partition mask, and only the distance pass still walks the texels.
+  void ScoreP2Patterns(const float3 texels[16], float scores[P2_PATTERN_NUM])
+  {
+    // rowMin[r][m] and rowMax[r][m] bound the texels of row r selected by the 4 bit mask m
+    float3 rowMin[4][16];
+    float3 rowMax[4][16];
+    for (uint32_t row = 0; row < 4; ++row)
+    {
+      rowMin[row][0] = float3(HALF_MAX, HALF_MAX, HALF_MAX);
+      rowMax[row][0] = float3(0.0f, 0.0f, 0.0f);
+      for (uint32_t m = 1; m < 16; ++m)
+      {
+        uint32_t lowest = m & (0u - m);
+        uint32_t i = row * 4 + (lowest == 1 ? 0 : lowest == 2 ? 1 : lowest == 4 ? 2 : 3);
+        rowMin[row][m] = min(rowMin[row][m & ~lowest], texels[i]);
+        rowMax[row][m] = max(rowMax[row][m & ~lowest], texels[i]);
+      }
+    }
+
+    for (uint32_t pattern = 0; pattern < P2_PATTERN_NUM; ++pattern)
+    {
+      uint32_t p1Mask = P2_PATTERN_MASKS[pattern];
+      uint32_t p0Mask = ~p1Mask & 0xFFFF;
+
+      float3 p0BlockMin = rowMin[0][p0Mask & 0xF];
+      float3 p0BlockMax = rowMax[0][p0Mask & 0xF];
+      float3 p1BlockMin = rowMin[0][p1Mask & 0xF];
+      float3 p1BlockMax = rowMax[0][p1Mask & 0xF];
+      for (uint32_t row = 1; row < 4; ++row)
+      {
+        p0BlockMin = min(p0BlockMin, rowMin[row][(p0Mask >> (row * 4)) & 0xF]);
+        p0BlockMax = max(p0BlockMax, rowMax[row][(p0Mask >> (row * 4)) & 0xF]);
+        p1BlockMin = min(p1BlockMin, rowMin[row][(p1Mask >> (row * 4)) & 0xF]);
+        p1BlockMax = max(p1BlockMax, rowMax[row][(p1Mask >> (row * 4)) & 0xF]);
+      }
+
+      float3 blockMin[2] = { p0BlockMin, p1BlockMin };
+      float3 blockDir[2] = { normalize(p0BlockMax - p0BlockMin), normalize(p1BlockMax - p1BlockMin) };
+
+      float sqDistanceFromLine = 0.0f;
+      for (uint32_t i = 0; i < 16; ++i)
+      {
+        uint32_t paletteID = (p1Mask >> i) & 1;
+        sqDistanceFromLine += DistToLineSq(blockMin[paletteID], blockDir[paletteID], texels[i]);
+      }
+      scores[pattern] = sqDistanceFromLine;
+    }
+  }
+
+  // The K best fitting patterns, sorted by their score. Ties keep the lower pattern, unfilled candidates
+  // (patterns scoring NaN, with a single colored subset) stay at pattern 0.
+  template<uint32_t K>
+  void FindP2Patterns(const float3 texels[16], uint32_t bestPatterns[K])
+  {
+    float scores[P2_PATTERN_NUM];
+    ScoreP2Patterns(texels, scores);
+
+    float bestScores[K];
+    for (uint32_t k = 0; k < K; ++k)
+    {
+      bestScores[k] = INFINITY;
+      bestPatterns[k] = 0;
+    }
+    bestScores[0] = scores[0];
+
+    for (uint32_t patternIndex = 1; patternIndex < P2_PATTERN_NUM; ++patternIndex)
+    {
+      float score = scores[patternIndex];
+      uint32_t pattern = patternIndex;
+      for (uint32_t k = 0; k < K; ++k)
+      {
+        if (score < bestScores[k])
+        {
+          Swap(score, bestScores[k]);
+          Swap(pattern, bestPatterns[k]);
+        }
+      }
+    }
+  }
+
+  template<uint32_t Effort>
+  void EncodeP2Pattern(uint4& block, float& blockMSLE, uint32_t pattern, const float3 texels[16])
+  {
+    typedef BC6HEffort::STraits<Effort> Traits;
+
+    float3 p0BlockMin = float3(HALF_MAX, HALF_MAX, HALF_MAX);
+    float3 p0BlockMax = float3(0.0f, 0.0f, 0.0f);
+    float3 p1BlockMin = float3(HALF_MAX, HALF_MAX, HALF_MAX);
+    float3 p1BlockMax = float3(0.0f, 0.0f, 0.0f);
+
+    for (uint32_t i = 0; i < 16; ++i)
+    {
+      uint32_t paletteID = Pattern(pattern, i);
+      if (paletteID == 0)
+      {
+        p0BlockMin = min(p0BlockMin, texels[i]);
+        p0BlockMax = max(p0BlockMax, texels[i]);
+      }
+      else
+      {
+        p1BlockMin = min(p1BlockMin, texels[i]);
+        p1BlockMax = max(p1BlockMax, texels[i]);
+      }
+    }
+
+    if (Traits::INSET_P2)
+    {
+      InsetColorBBoxP2(texels, pattern, 0, p0BlockMin, p0BlockMax);
+      InsetColorBBoxP2(texels, pattern, 1, p1BlockMin, p1BlockMax);
+    }
+
+    for (uint32_t pass = 0; Traits::OPTIMIZE_ENDPOINTS && pass < Traits::OPTIMIZE_PASSES; ++pass)
+    {
+      OptimizeEndpointsP2(texels, pattern, 0, p0BlockMin, p0BlockMax);
+      OptimizeEndpointsP2(texels, pattern, 1, p1BlockMin, p1BlockMax);
+    }
+
+    float3 p0BlockDir = p0BlockMax - p0BlockMin;
+    float3 p1BlockDir = p1BlockMax - p1BlockMin;
+    p0BlockDir = p0BlockDir / (p0BlockDir.x + p0BlockDir.y + p0BlockDir.z);
+    p1BlockDir = p1BlockDir / (p1BlockDir.x + p1BlockDir.y + p1BlockDir.z);
+
+    float p0Endpoint0Pos = f32tof16(dot(p0BlockMin, p0BlockDir));
+    float p0Endpoint1Pos = f32tof16(dot(p0BlockMax, p0BlockDir));
+    float p1Endpoint0Pos = f32tof16(dot(p1BlockMin, p1BlockDir));
+    float p1Endpoint1Pos = f32tof16(dot(p1BlockMax, p1BlockDir));
+
+    uint32_t fixupID = PatternFixupID(pattern);
+    float p0FixupTexelPos = f32tof16(dot(texels[0], p0BlockDir));
+    float p1FixupTexelPos = f32tof16(dot(texels[fixupID], p1BlockDir));
+    uint32_t p0FixupIndex = ComputeIndex3(p0FixupTexelPos, p0Endpoint0Pos, p0Endpoint1Pos);
+    uint32_t p1FixupIndex = ComputeIndex3(p1FixupTexelPos, p1Endpoint0Pos, p1Endpoint1Pos);
+    if (p0FixupIndex > 3)
+    {
+      Swap(p0Endpoint0Pos, p0Endpoint1Pos);
+      Swap(p0BlockMin, p0BlockMax);
+    }
+    if (p1FixupIndex > 3)
+    {
+      Swap(p1Endpoint0Pos, p1Endpoint1Pos);
+      Swap(p1BlockMin, p1BlockMax);
+    }
+
+    uint32_t indices[16] = { 0 };
+    for (uint32_t i = 0; i < 16; ++i)
+    {
+      float p0TexelPos = f32tof16(dot(texels[i], p0BlockDir));
+      float p1TexelPos = f32tof16(dot(texels[i], p1BlockDir));
+      uint32_t p0Index = ComputeIndex3(p0TexelPos, p0Endpoint0Pos, p0Endpoint1Pos);
+      uint32_t p1Index = ComputeIndex3(p1TexelPos, p1Endpoint0Pos, p1Endpoint1Pos);
+
+      uint32_t paletteID = Pattern(pattern, i);
+      indices[i] = paletteID == 0 ? p0Index : p1Index;
+    }
+
+    float3 endpoint760 = floor(Quantize7(p0BlockMin));
+    float3 endpoint761 = floor(Quantize7(p0BlockMax));
+    float3 endpoint762 = floor(Quantize7(p1BlockMin));
+    float3 endpoint763 = floor(Quantize7(p1BlockMax));
+
+    float3 endpoint950 = floor(Quantize9(p0BlockMin));
+    float3 endpoint951 = floor(Quantize9(p0BlockMax));
+    float3 endpoint952 = floor(Quantize9(p1BlockMin));
+    float3 endpoint953 = floor(Quantize9(p1BlockMax));
+
+    endpoint761 = endpoint761 - endpoint760;
+    endpoint762 = endpoint762 - endpoint760;
+    endpoint763 = endpoint763 - endpoint760;
+
+    endpoint951 = endpoint951 - endpoint950;
+    endpoint952 = endpoint952 - endpoint950;
+    endpoint953 = endpoint953 - endpoint950;
+
+    float maxVal76 = 0x1F;
+    endpoint761 = clamp(endpoint761, -maxVal76, maxVal76);
+    endpoint762 = clamp(endpoint762, -maxVal76, maxVal76);
+    endpoint763 = clamp(endpoint763, -maxVal76, maxVal76);
+
+    float maxVal95 = 0xF;
+    endpoint951 = clamp(endpoint951, -maxVal95, maxVal95);
+    endpoint952 = clamp(endpoint952, -maxVal95, maxVal95);
+    endpoint953 = clamp(endpoint953, -maxVal95, maxVal95);
+
+    float3 endpoint760Unq = Unquantize7(endpoint760);
+    float3 endpoint761Unq = Unquantize7(endpoint760 + endpoint761);
+    float3 endpoint762Unq = Unquantize7(endpoint760 + endpoint762);
+    float3 endpoint763Unq = Unquantize7(endpoint760 + endpoint763);
+    float3 endpoint950Unq = Unquantize9(endpoint950);
+    float3 endpoint951Unq = Unquantize9(endpoint950 + endpoint951);
+    float3 endpoint952Unq = Unquantize9(endpoint950 + endpoint952);
+    float3 endpoint953Unq = Unquantize9(endpoint950 + endpoint953);
+
+    float msle76 = 0.0f;
+    float msle95 = 0.0f;
+    for (uint32_t i = 0; i < 16; ++i)
+    {
+      uint32_t paletteID = Pattern(pattern, i);
+
+      float3 tmp760Unq = paletteID == 0 ? endpoint760Unq : endpoint762Unq;
+      float3 tmp761Unq = paletteID == 0 ? endpoint761Unq : endpoint763Unq;
+      float3 tmp950Unq = paletteID == 0 ? endpoint950Unq : endpoint952Unq;
+      float3 tmp951Unq = paletteID == 0 ? endpoint951Unq : endpoint953Unq;
+
+      float weight = floorf((indices[i] * 64.0f) / 7.0f + 0.5f);
+      float3 texelUnc76 = FinishUnquantize(tmp760Unq, tmp761Unq, weight);
+      float3 texelUnc95 = FinishUnquantize(tmp950Unq, tmp951Unq, weight);
+
+      msle76 += CalcMSLE(texels[i], texelUnc76);
+      msle95 += CalcMSLE(texels[i], texelUnc95);
+    }
+
+    SignExtend(endpoint761, 0x1F, 0x20);
+    SignExtend(endpoint762, 0x1F, 0x20);
+    SignExtend(endpoint763, 0x1F, 0x20);
+
+    SignExtend(endpoint951, 0xF, 0x10);
+    SignExtend(endpoint952, 0xF, 0x10);
+    SignExtend(endpoint953, 0xF, 0x10);
+
+    // encode block
+    float p2MSLE = min(msle76, msle95);
+    if (p2MSLE < blockMSLE)
+    {
+      blockMSLE = p2MSLE;
+      block = uint4{ 0, 0, 0, 0 };
+
+      if (p2MSLE == msle76)
+      {
+        // 7.6
+        block.x = 0x1;
+        block.x |= (ftou(endpoint762.y) & 0x20) >> 3;
+        block.x |= (ftou(endpoint763.y) & 0x10) >> 1;
+        block.x |= (ftou(endpoint763.y) & 0x20) >> 1;
+        block.x |= ftou(endpoint760.x) << 5;
+        block.x |= (ftou(endpoint763.z) & 0x01) << 12;
+        block.x |= (ftou(endpoint763.z) & 0x02) << 12;
+        block.x |= (ftou(endpoint762.z) & 0x10) << 10;
+        block.x |= ftou(endpoint760.y) << 15;
+        block.x |= (ftou(endpoint762.z) & 0x20) << 17;
+        block.x |= (ftou(endpoint763.z) & 0x04) << 21;
+        block.x |= (ftou(endpoint762.y) & 0x10) << 20;
+        block.x |= ftou(endpoint760.z) << 25;
+        block.y |= (ftou(endpoint763.z) & 0x08) >> 3;
+        block.y |= (ftou(endpoint763.z) & 0x20) >> 4;
+        block.y |= (ftou(endpoint763.z) & 0x10) >> 2;
+        block.y |= ftou(endpoint761.x) << 3;
+        block.y |= (ftou(endpoint762.y) & 0x0F) << 9;
+        block.y |= ftou(endpoint761.y) << 13;
+        block.y |= (ftou(endpoint763.y) & 0x0F) << 19;
+        block.y |= ftou(endpoint761.z) << 23;
+        block.y |= (ftou(endpoint762.z) & 0x07) << 29;
+        block.z |= (ftou(endpoint762.z) & 0x08) >> 3;
+        block.z |= ftou(endpoint762.x) << 1;
+        block.z |= ftou(endpoint763.x) << 7;
+      }
+      else
+      {
+        // 9.5
+        block.x = 0xE;
+        block.x |= ftou(endpoint950.x) << 5;
+        block.x |= (ftou(endpoint952.z) & 0x10) << 10;
+        block.x |= ftou(endpoint950.y) << 15;
+        block.x |= (ftou(endpoint952.y) & 0x10) << 20;
+        block.x |= ftou(endpoint950.z) << 25;
+        block.y |= ftou(endpoint950.z) >> 7;
+        block.y |= (ftou(endpoint953.z) & 0x10) >> 2;
+        block.y |= ftou(endpoint951.x) << 3;
+        block.y |= (ftou(endpoint953.y) & 0x10) << 4;
+        block.y |= (ftou(endpoint952.y) & 0x0F) << 9;
+        block.y |= ftou(endpoint951.y) << 13;
+        block.y |= (ftou(endpoint953.z) & 0x01) << 18;
+        block.y |= (ftou(endpoint953.y) & 0x0F) << 19;
+        block.y |= ftou(endpoint951.z) << 23;
+        block.y |= (ftou(endpoint953.z) & 0x02) << 27;
+        block.y |= ftou(endpoint952.z) << 29;
+        block.z |= (ftou(endpoint952.z) & 0x08) >> 3;
+        block.z |= ftou(endpoint952.x) << 1;
+        block.z |= (ftou(endpoint953.z) & 0x04) << 4;
+        block.z |= ftou(endpoint953.x) << 7;
+        block.z |= (ftou(endpoint953.z) & 0x08) << 9;
+      }
+
+      block.z |= pattern << 13;
+      uint32_t blockFixupID = PatternFixupID(pattern);
+      if (blockFixupID == 15)
+      {
+        block.z |= indices[0] << 18;
+        block.z |= indices[1] << 20;
+        block.z |= indices[2] << 23;
+        block.z |= indices[3] << 26;
+        block.z |= indices[4] << 29;
+        block.w |= indices[5] << 0;
+        block.w |= indices[6] << 3;
+        block.w |= indices[7] << 6;
+        block.w |= indices[8] << 9;
+        block.w |= indices[9] << 12;
+        block.w |= indices[10] << 15;
+        block.w |= indices[11] << 18;
+        block.w |= indices[12] << 21;
+        block.w |= indices[13] << 24;
+        block.w |= indices[14] << 27;
+        block.w |= indices[15] << 30;
+      }
+      else if (blockFixupID == 2)
+      {
+        block.z |= indices[0] << 18;
+        block.z |= indices[1] << 20;
+        block.z |= indices[2] << 23;
+        block.z |= indices[3] << 25;
+        block.z |= indices[4] << 28;
+        block.z |= indices[5] << 31;
+        block.w |= indices[5] >> 1;
+        block.w |= indices[6] << 2;
+        block.w |= indices[7] << 5;
+        block.w |= indices[8] << 8;
+        block.w |= indices[9] << 11;
+        block.w |= indices[10] << 14;
+        block.w |= indices[11] << 17;
+        block.w |= indices[12] << 20;
+        block.w |= indices[13] << 23;
+        block.w |= indices[14] << 26;
+        block.w |= indices[15] << 29;
+      }
+      else
+      {
+        block.z |= indices[0] << 18;
+        block.z |= indices[1] << 20;
+        block.z |= indices[2] << 23;
+        block.z |= indices[3] << 26;
+        block.z |= indices[4] << 29;
+        block.w |= indices[5] << 0;
+        block.w |= indices[6] << 3;
+        block.w |= indices[7] << 6;
+        block.w |= indices[8] << 9;
+        block.w |= indices[9] << 11;
+        block.w |= indices[10] << 14;
+        block.w |= indices[11] << 17;
+        block.w |= indices[12] << 20;
+        block.w |= indices[13] << 23;
+        block.w |= indices[14] << 26;
+        block.w |= indices[15] << 29;
+      }
+    }
+  }
+
+  // Returns true when the block skipped the P2 search
+  template<uint32_t Effort>
+  bool EncodeBlock(const float3 texels[16], float p2Threshold, uint4& block)
+  {
+    typedef BC6HEffort::STraits<Effort> Traits;
+
+    float blockMSLE = 0.0f;
+    EncodeP1<Effort>(block, blockMSLE, texels);
+
+    if (Traits::ENCODE_P2 && blockMSLE < p2Threshold * 16.0f)
+      return true;
+
+    if (Traits::ENCODE_P2)
+    {
+      // First find the patterns which fit the current block best
+      uint32_t bestPatterns[Traits::P2_CANDIDATES];
+      FindP2Patterns<Traits::P2_CANDIDATES>(texels, bestPatterns);
+
+      // Then encode them, every one replaces the block only if it has a lower error
+      for (uint32_t k = 0; k < Traits::P2_CANDIDATES; ++k)
+        EncodeP2Pattern<Effort>(block, blockMSLE, bestPatterns[k], texels);
+    }
+    return false;
+  }
+}
+
+bool BC6HEncoderCPU::EncodeBlock(const float texels[16][3], uint32_t effort, float p2Threshold, uint32_t block[4])
+{
+  float3 blockTexels[16];
+  for (uint32_t i = 0; i < 16; ++i)
+    blockTexels[i] = float3(texels[i][0], texels[i][1], texels[i][2]);
+
+  uint4 blockBits = { 0, 0, 0, 0 };
+  bool skippedP2;
+  switch (effort)
+  {
+  case 0: skippedP2 = ::EncodeBlock<0>(blockTexels, p2Threshold, blockBits); break;
+  case 1: skippedP2 = ::EncodeBlock<1>(blockTexels, p2Threshold, blockBits); break;
+  case 2: skippedP2 = ::EncodeBlock<2>(blockTexels, p2Threshold, blockBits); break;
+  case 3: skippedP2 = ::EncodeBlock<3>(blockTexels, p2Threshold, blockBits); break;
+  case 4: skippedP2 = ::EncodeBlock<4>(blockTexels, p2Threshold, blockBits); break;
+  default: skippedP2 = ::EncodeBlock<5>(blockTexels, p2Threshold, blockBits); break;
+  }
+
+  block[0] = blockBits.x;
+  block[1] = blockBits.y;
+  block[2] = blockBits.z;
+  block[3] = blockBits.w;
+  return skippedP2;
+}
+
+BC6HEncoderCPU::BlockClass BC6HEncoderCPU::EncodeSingleColorBlock(const float texels[16][3], uint32_t block[4])
+{
+  // F32ToF16 is monotonic, so only the extremes need converting. Texels are clamped to [0, HALF_MAX] with NaNs
+  // going to 0, like the shader reads them. A few half float steps stay well within 1/64 of the first texel
+  // (plus the denormal step), anything further away rejects the block early.
+  float first[3];
+  float blockMin[3];
+  float blockMax[3];
+  for (uint32_t c = 0; c < 3; ++c)
+  {
+    first[c] = texels[0][c] > 0.0f ? (texels[0][c] < HALF_MAX ? texels[0][c] : HALF_MAX) : 0.0f;
+    blockMin[c] = first[c];
+    blockMax[c] = first[c];
+  }
+
+  for (uint32_t i = 1; i < 16; ++i)
+  {
+    for (uint32_t c = 0; c < 3; ++c)
+    {
+      float x = texels[i][c] > 0.0f ? (texels[i][c] < HALF_MAX ? texels[i][c] : HALF_MAX) : 0.0f;
+      if (fabsf(x - first[c]) > first[c] * (1.0f / 64.0f) + 1.0f / (1 << 20))
+        return BlockClass::Encoded;
+
+      blockMin[c] = x < blockMin[c] ? x : blockMin[c];
+      blockMax[c] = x > blockMax[c] ? x : blockMax[c];
+    }
+  }
+
+  uint32_t halfMin[3];
+  uint32_t halfMax[3];
+  BlockClass blockClass = BlockClass::Constant;
+  for (uint32_t c = 0; c < 3; ++c)
+  {
+    halfMin[c] = BC6HMath::F32ToF16(blockMin[c]);
+    halfMax[c] = BC6HMath::F32ToF16(blockMax[c]);
+    if (halfMax[c] - halfMin[c] > NEAR_CONSTANT_SPREAD)
+      return BlockClass::Encoded;
+    if (halfMax[c] != halfMin[c])
+      blockClass = BlockClass::NearConstant;
+  }
+
+  uint32_t color[3];
+  for (uint32_t c = 0; c < 3; ++c)
+  {
+    color[c] = halfMin[c];
+    if (halfMax[c] != halfMin[c])
+    {
+      float logSum = 0.0f;
+      for (uint32_t i = 0; i < 16; ++i)
+        logSum += log2f((texels[i][c] > 0.0f ? texels[i][c] : 0.0f) + 1.0f);
+
+      uint32_t h = BC6HMath::F32ToF16(exp2f(logSum / 16.0f) - 1.0f);
+      color[c] = h < halfMin[c] ? halfMin[c] : (h > halfMax[c] ? halfMax[c] : h);
+    }
+
+    // Unquantized 16 bit endpoints decode to (x * 31) >> 6, pick the x that lands on the half exactly
+    color[c] = (color[c] * 64 + 30) / 31;
+  }
+
+  // Mode 14: 16 bit endpoint split into 10 low bits and 6 reversed high bits after the 4 bit delta, which stays 0.
+  // All indices are 0 too.
+  uint64_t low = 0x0F;
+  uint64_t high = 0;
+  for (uint32_t c = 0; c < 3; ++c)
+  {
+    low |= static_cast<uint64_t>(color[c] & 0x3FF) << (5 + c * 10);
+    for (uint32_t bit = 0; bit < 6; ++bit)
+    {
+      uint32_t pos = 39 + c * 10 + bit;
+      uint64_t value = (color[c] >> (15 - bit)) & 1;
+      if (pos < 64)
+        low |= value << pos;
+      else
+        high |= value << (pos - 64);
+    }
+  }
+
+  block[0] = static_cast<uint32_t>(low);
+  block[1] = static_cast<uint32_t>(low >> 32);
+  block[2] = static_cast<uint32_t>(high);
+  block[3] = static_cast<uint32_t>(high >> 32);
+  return blockClass;
+}
+
+uint32_t BC6HEncoderCPU::GetTexelBytes(TexelFormat format)
+{
+  switch (format)
+  {
+  case TexelFormat::RGBA32F:
+    return 16;
+  case TexelFormat::RGBA16F:
+    return 8;
+  case TexelFormat::RGB32F:
+    return 12;
+  case TexelFormat::RGB16F:
+    return 6;
+  default:
+    return 4;
+  }
+}
+
+void BC6HEncoderCPU::GatherBlock(const uint8_t* texels, TexelFormat format, uint32_t rowPitch, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY, Addressing addressing, float block[16][3])
+{
+  uint32_t texelBytes = GetTexelBytes(format);
+  for (uint32_t y = 0; y < BLOCK_SIZE; ++y)
+  {
+    uint32_t texelY = blockY * BLOCK_SIZE + y;
+    for (uint32_t x = 0; x < BLOCK_SIZE; ++x)
+    {
+      uint32_t texelX = blockX * BLOCK_SIZE + x;
+      float* texel = block[y * BLOCK_SIZE + x];
+      if (addressing == Addressing::Clamp)
+      {
+        texelX = texelX < width ? texelX : width - 1;
+        texelY = texelY < height ? texelY : height - 1;
+      }
+
+      if (texelX >= width || texelY >= height)
+      {
+        texel[0] = 0.0f;
+        texel[1] = 0.0f;
+        texel[2] = 0.0f;
+        continue;
+      }
+
+      const uint8_t* src = texels + static_cast<size_t>(texelY) * rowPitch + texelX * texelBytes;
+      if (format == TexelFormat::RGBA32F || format == TexelFormat::RGB32F)
+      {
+        memcpy(texel, src, sizeof(float) * 3);
+      }
+      else if (format == TexelFormat::RGBA16F || format == TexelFormat::RGB16F)
+      {
+        uint16_t halves[3];
+        memcpy(halves, src, sizeof(halves));
+        for (uint32_t c = 0; c < 3; ++c)
+          texel[c] = BC6HMath::F16ToF32(halves[c]);
+      }
+      else
+      {
+        // 9 bit mantissas without an implicit one, 5 bit exponent biased by 15
+        uint32_t packed;
+        memcpy(&packed, src, sizeof(packed));
+        float scale = ldexpf(1.0f, static_cast<int>(packed >> 27) - 15 - 9);
+        for (uint32_t c = 0; c < 3; ++c)
+          texel[c] = static_cast<float>((packed >> (c * 9)) & 0x1FF) * scale;
+      }
+    }
+  }
+}
+
+void BC6HEncoderCPU::CompressBlockRow(const uint8_t* texels, TexelFormat format, uint32_t rowPitch, uint32_t width, uint32_t height, uint32_t blockY, Addressing addressing, uint32_t effort, float p2Threshold, BC6HEncoderSIMD::ISA isa, uint8_t* blocks, SBlockCounts* counts, BC6HBlockCache* cache)
+{
+  uint32_t widthInBlocks = (width + BLOCK_SIZE - 1) / BLOCK_SIZE;
+  STile tile = { 0, blockY, widthInBlocks, 1 };
+  CompressTile(texels, format, rowPitch, width, height, tile, addressing, effort, p2Threshold, isa, blocks, widthInBlocks * BLOCK_BYTES, counts, cache);
+}
+
+std::vector<BC6HEncoderCPU::STile> BC6HEncoderCPU::GetTiles(uint32_t widthInBlocks, uint32_t heightInBlocks, TileOrder order)
+{
+  std::vector<STile> tiles;
+  if (order == TileOrder::RowStrip)
+  {
+    for (uint32_t blockY = 0; blockY < heightInBlocks; ++blockY)
+    {
+      for (uint32_t blockX = 0; blockX < widthInBlocks; blockX += TILE_BLOCKS)
+        tiles.push_back(STile{ blockX, blockY, std::min(TILE_BLOCKS, widthInBlocks - blockX), 1 });
+    }
+    return tiles;
+  }
+
+  // Tiles sorted by their interleaved x and y bits
+  uint32_t tileNumX = (widthInBlocks + TILE_SIZE - 1) / TILE_SIZE;
+  uint32_t tileNumY = (heightInBlocks + TILE_SIZE - 1) / TILE_SIZE;
+  auto spreadBits = [](uint64_t x)
+  {
+    x = (x | x << 16) & 0x0000FFFF0000FFFFull;
+    x = (x | x << 8) & 0x00FF00FF00FF00FFull;
+    x = (x | x << 4) & 0x0F0F0F0F0F0F0F0Full;
+    x = (x | x << 2) & 0x3333333333333333ull;
+    x = (x | x << 1) & 0x5555555555555555ull;
+    return x;
+  };
+  std::vector<uint64_t> codes;
+  codes.reserve(static_cast<size_t>(tileNumX) * tileNumY);
+  for (uint32_t tileY = 0; tileY < tileNumY; ++tileY)
+  {
+    for (uint32_t tileX = 0; tileX < tileNumX; ++tileX)
+      codes.push_back(spreadBits(tileX) | spreadBits(tileY) << 1);
+  }
+  std::sort(codes.begin(), codes.end());
+
+  auto compactBits = [](uint64_t x)
+  {
+    x &= 0x5555555555555555ull;
+    x = (x | x >> 1) & 0x3333333333333333ull;
+    x = (x | x >> 2) & 0x0F0F0F0F0F0F0F0Full;
+    x = (x | x >> 4) & 0x00FF00FF00FF00FFull;
+    x = (x | x >> 8) & 0x0000FFFF0000FFFFull;
+    x = (x | x >> 16) & 0x00000000FFFFFFFFull;
+    return static_cast<uint32_t>(x);
+  };
+  tiles.reserve(codes.size());
+  for (uint64_t code : codes)
+  {
+    uint32_t blockX = compactBits(code) * TILE_SIZE;
+    uint32_t blockY = compactBits(code >> 1) * TILE_SIZE;
+    tiles.push_back(STile{ blockX, blockY, std::min(TILE_SIZE, widthInBlocks - blockX), std::min(TILE_SIZE, heightInBlocks - blockY) });
+  }
+  return tiles;
+}
+
+void BC6HEncoderCPU::CompressTile(const uint8_t* texels, TexelFormat format, uint32_t rowPitch, uint32_t width, uint32_t height, const STile& tile, Addressing addressing, uint32_t effort, float p2Threshold, BC6HEncoderSIMD::ISA isa, uint8_t* blocks, size_t blockRowPitch, SBlockCounts* counts, BC6HBlockCache* cache)
+{
+  BC6HEncoderSIMD::EncodeBlocksFunc encodeBlocks = BC6HEncoderSIMD::GetEncodeBlocks(isa);
+  uint32_t laneNum = BC6HEncoderSIMD::GetLaneNum(isa);
+
+  // Structure of arrays for up to 16 lanes, a partial group is padded with copies of its last block.
+  // Groups carry over from one block row of the tile to the next.
+  float texelsSoA[16 * 3 * 16];
+  uint32_t groupBlocks[16 * 4];
+  uint8_t* groupDst[16];
+  uint64_t groupHashes[16];
+  uint32_t groupSize = 0;
+  SBlockCounts tileCounts = { 0, 0, 0, 0, 0 };
+  auto encodeGroup = [&]()
+  {
+    for (uint32_t lane = groupSize; lane < laneNum; ++lane)
+    {
+      for (uint32_t i = 0; i < 16 * 3; ++i)
+        texelsSoA[i * laneNum + lane] = texelsSoA[i * laneNum + groupSize - 1];
+    }
+
+    uint32_t skippedLanes = encodeBlocks(texelsSoA, effort, p2Threshold, groupBlocks);
+    for (uint32_t lane = 0; lane < groupSize; ++lane)
+    {
+      tileCounts.m_p2Skipped += (skippedLanes >> lane) & 1;
+      memcpy(groupDst[lane], groupBlocks + lane * 4, BLOCK_BYTES);
+      if (cache)
+      {
+        float blockTexels[16][3];
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+          for (uint32_t c = 0; c < 3; ++c)
+            blockTexels[i][c] = texelsSoA[(i * 3 + c) * laneNum + lane];
+        }
+        cache->Insert(groupHashes[lane], blockTexels, effort, groupBlocks + lane * 4);
+      }
+    }
+    groupSize = 0;
+  };
+
+  for (uint32_t y = 0; y < tile.m_height; ++y)
+  {
+    for (uint32_t x = 0; x < tile.m_width; ++x)
+    {
+      uint32_t blockX = tile.m_blockX + x;
+      uint32_t blockY = tile.m_blockY + y;
+      uint8_t* dst = blocks + y * blockRowPitch + x * BLOCK_BYTES;
+
+      float blockTexels[16][3];
+      GatherBlock(texels, format, rowPitch, width, height, blockX, blockY, addressing, blockTexels);
+
+      uint32_t block[4];
+      BlockClass blockClass = EncodeSingleColorBlock(blockTexels, block);
+      if (blockClass != BlockClass::Encoded)
+      {
+        ++(blockClass == BlockClass::Constant ? tileCounts.m_constant : tileCounts.m_nearConstant);
+        memcpy(dst, block, BLOCK_BYTES);
+        continue;
+      }
+
+      uint64_t hash = 0;
+      if (cache)
+      {
+        hash = BC6HBlockCache::Hash(blockTexels, effort);
+        if (cache->Find(hash, blockTexels, effort, block))
+        {
+          ++tileCounts.m_cached;
+          memcpy(dst, block, BLOCK_BYTES);
+          continue;
+        }
+      }
+
+      ++tileCounts.m_encoded;
+      if (!encodeBlocks)
+      {
+        if (EncodeBlock(blockTexels, effort, p2Threshold, block))
+          ++tileCounts.m_p2Skipped;
+        memcpy(dst, block, BLOCK_BYTES);
+        if (cache)
+          cache->Insert(hash, blockTexels, effort, block);
+        continue;
+      }
+
+      for (uint32_t i = 0; i < 16; ++i)
+      {
+        for (uint32_t c = 0; c < 3; ++c)
+          texelsSoA[(i * 3 + c) * laneNum + groupSize] = blockTexels[i][c];
+      }
+      groupHashes[groupSize] = hash;
+      groupDst[groupSize++] = dst;
+      if (groupSize == laneNum)
+        encodeGroup();
+    }
+  }
+
+  if (groupSize > 0)
+    encodeGroup();
+
+  if (counts)
+  {
+    counts->m_constant += tileCounts.m_constant;
+    counts->m_nearConstant += tileCounts.m_nearConstant;
+    counts->m_encoded += tileCounts.m_encoded;
+    counts->m_cached += tileCounts.m_cached;
+    counts->m_p2Skipped += tileCounts.m_p2Skipped;
+  }
+}
+
+void BC6HEncoderCPU::CompressImage(const uint8_t* texels, TexelFormat format, uint32_t rowPitch, uint32_t width, uint32_t height, uint32_t effort, float p2Threshold, BC6HEncoderSIMD::ISA isa, ThreadPool* pool, uint8_t* blocks, SBlockCounts* counts, BC6HBlockCache* cache, TileOrder tileOrder)
+{
+  uint32_t widthInBlocks = (width + BLOCK_SIZE - 1) / BLOCK_SIZE;
+  uint32_t heightInBlocks = (height + BLOCK_SIZE - 1) / BLOCK_SIZE;
+  size_t blockRowPitch = static_cast<size_t>(widthInBlocks) * BLOCK_BYTES;
+  std::vector<STile> tiles = GetTiles(widthInBlocks, heightInBlocks, tileOrder);
+
+  // Tiles are counted separately and summed up at the end, no atomics in the loop
+  std::vector<SBlockCounts> tileCounts(counts ? tiles.size() : 0, SBlockCounts{ 0, 0, 0, 0, 0 });
+  auto encodeTile = [&](uint32_t i)
+  {
+    const STile& tile = tiles[i];
+    uint8_t* dst = blocks + tile.m_blockY * blockRowPitch + tile.m_blockX * BLOCK_BYTES;
+    CompressTile(texels, format, rowPitch, width, height, tile, Addressing::Border, effort, p2Threshold, isa, dst, blockRowPitch, counts ? &tileCounts[i] : nullptr, cache);
+  };
+
+  uint32_t tileNum = static_cast<uint32_t>(tiles.size());
+  if (pool)
+  {
+    pool->ParallelFor(tileNum, encodeTile);
+  }
+  else
+  {
+    for (uint32_t i = 0; i < tileNum; ++i)
+      encodeTile(i);
+  }
+
+  for (const SBlockCounts& tile : tileCounts)
+  {
+    counts->m_constant += tile.m_constant;
+    counts->m_nearConstant += tile.m_nearConstant;
+    counts->m_encoded += tile.m_encoded;
+    counts->m_cached += tile.m_cached;
+    counts->m_p2Skipped += tile.m_p2Skipped;
+  }
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include "BC6HEncoderSIMD.h"
+
+class ThreadPool;
+class BC6HBlockCache;
+
+// C++ port of shaders/compress.hlsl.
+// Every function mirrors its shader counterpart operation for operation, so the CPU backend
+// writes the same blocks as the CSMain dispatch (up to the precision of the GPU div/log2/exp2),
+// except for the single color blocks the shader doesn't special case.
+namespace BC6HEncoderCPU
+{
+  const uint32_t BLOCK_SIZE = 4;
+  const uint32_t BLOCK_BYTES = 16;
+
+  // Texels are in the CSMain order: row major, 4 texels per row. effort is a BC6HEffort level,
+  // BC6HEffort::SPEED and BC6HEffort::QUALITY match the two shader builds.
+  // Efforts with P2 skip its search for blocks whose P1 encoding is already under p2Threshold, the MSLE (mean of
+  // the luminance weighted squared log2 errors of the texels) of the block. Returns true when the search was
+  // skipped. 0 never skips, so the blocks match the shader.
+  bool EncodeBlock(const float texels[16][3], uint32_t effort, float p2Threshold, uint32_t block[4]);
+
+  // Half float bits every channel of a near constant block stays within, a step of the 4 bit mode 11 indices
+  // between two adjacent 10 bit endpoints
+  const uint32_t NEAR_CONSTANT_SPREAD = 4;
+
+  enum struct BlockClass
+  {
+    // All texels are the same half float color
+    Constant,
+    // Every channel within NEAR_CONSTANT_SPREAD
+    NearConstant,
+    // Everything else, goes through EncodeBlock
+    Encoded,
+  };
+
+  struct SBlockCounts
+  {
+    uint64_t m_constant;
+    uint64_t m_nearConstant;
+    uint64_t m_encoded;
+    // Blocks which would have been encoded, copied from a BC6HBlockCache instead.
+    // The cache hit rate is m_cached / (m_cached + m_encoded).
+    uint64_t m_cached;
+    // Encoded blocks which skipped the P2 search, see EncodeBlock
+    uint64_t m_p2Skipped;
+  };
+
+  // Writes constant and near constant blocks directly, as a single 16 bit color (mode 14 with zero deltas),
+  // which reproduces constant blocks exactly. Near constant blocks get the color with the lowest MSLE,
+  // the mean in log space. Returns Encoded and leaves block alone for any other block.
+  BlockClass EncodeSingleColorBlock(const float texels[16][3], uint32_t block[4]);
+
+  // What texels outside of the image read as, same as the D3D11 sampler address modes
+  enum struct Addressing
+  {
+    // Black, what CSMain sees through its border sampler
+    Border,
+    // The nearest edge texel
+    Clamp,
+  };
+
+  // Source texel layouts the encoder reads directly, alpha is ignored
+  enum struct TexelFormat
+  {
+    RGBA32F,
+    RGBA16F,
+    RGB32F,
+    RGB16F,
+    // Shared exponent, DXGI_FORMAT_R9G9B9E5_SHAREDEXP
+    RGB9E5,
+  };
+
+  uint32_t GetTexelBytes(TexelFormat format);
+
+  // Reads the texels of a block as floats
+  void GatherBlock(const uint8_t* texels, TexelFormat format, uint32_t rowPitch, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY, Addressing addressing, float block[16][3]);
+
+  // Compresses block row blockY into widthInBlocks tightly packed blocks. Single color blocks take the
+  // EncodeSingleColorBlock fast path, so unlike EncodeBlock they don't match the shader bit for bit.
+  // counts (optional) gets the blocks of the row added to it. With a cache (optional) the blocks
+  // which need the full encoder are looked up first and the newly encoded ones added to it.
+  void CompressBlockRow(const uint8_t* texels, TexelFormat format, uint32_t rowPitch, uint32_t width, uint32_t height, uint32_t blockY, Addressing addressing, uint32_t effort, float p2Threshold, BC6HEncoderSIMD::ISA isa, uint8_t* blocks, SBlockCounts* counts = nullptr, BC6HBlockCache* cache = nullptr);
+
+  // Rectangle of blocks, the unit of work of CompressImage
+  struct STile
+  {
+    uint32_t m_blockX;
+    uint32_t m_blockY;
+    uint32_t m_width;
+    uint32_t m_height;
+  };
+
+  // Order tiles are handed out in. ThreadPool::ParallelFor starts every thread on its own contiguous run of tiles,
+  // so the order decides which part of the image a thread works on until it has to steal.
+  enum struct TileOrder
+  {
+    // TILE_BLOCKS x 1 block strips in row major order, every thread streams through a band of whole texel rows
+    RowStrip,
+    // TILE_SIZE x TILE_SIZE block squares along a Z-order curve, every thread works on a compact region
+    Morton,
+  };
+
+  // 256 blocks are 64KB of RGBA32F texels and 4KB of blocks, so a tile stays in L2 while it's encoded
+  const uint32_t TILE_BLOCKS = 256;
+  const uint32_t TILE_SIZE = 16;
+
+  // Splits a widthInBlocks x heightInBlocks surface into tiles in the given order
+  std::vector<STile> GetTiles(uint32_t widthInBlocks, uint32_t heightInBlocks, TileOrder order);
+
+  // CompressBlockRow for every block row of a tile. blocks gets the top left block of the tile,
+  // blockRowPitch is the byte offset from one block row to the next.
+  void CompressTile(const uint8_t* texels, TexelFormat format, uint32_t rowPitch, uint32_t width, uint32_t height, const STile& tile, Addressing addressing, uint32_t effort, float p2Threshold, BC6HEncoderSIMD::ISA isa, uint8_t* blocks, size_t blockRowPitch, SBlockCounts* counts = nullptr, BC6HBlockCache* cache = nullptr);
+
+  // Compresses an image into tightly packed BC6H_UF16 blocks, one GetTiles tile per task.
+  // With a SIMD isa the blocks of every tile that need the full encoder are encoded in groups of GetLaneNum(isa).
+  void CompressImage(const uint8_t* texels, TexelFormat format, uint32_t rowPitch, uint32_t width, uint32_t height, uint32_t effort, float p2Threshold, BC6HEncoderSIMD::ISA isa, ThreadPool* pool, uint8_t* blocks, SBlockCounts* counts = nullptr, BC6HBlockCache* cache = nullptr, TileOrder tileOrder = TileOrder::RowStrip);
+}
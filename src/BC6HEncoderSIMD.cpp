@@ -0,0 +1,137 @@
+#include "BC6HEncoderSIMD.h"
+#include "BC6HDecoderSIMD.h"
+#include "BC6HMetricsSIMD.h"
+
+#if BC6H_SIMD_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace
+{
+#if BC6H_SIMD_X86
+  void CPUID(uint32_t leaf, uint32_t subLeaf, uint32_t regs[4])
+  {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuidex(info, static_cast<int>(leaf), static_cast<int>(subLeaf));
+    for (uint32_t i = 0; i < 4; ++i)
+      regs[i] = static_cast<uint32_t>(info[i]);
+#else
+    __cpuid_count(leaf, subLeaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+  }
+
+  uint64_t XGETBV()
+  {
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    uint32_t eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+  }
+#endif
+}
+
+BC6HEncoderSIMD::ISA BC6HEncoderSIMD::DetectISA()
+{
+#if BC6H_SIMD_X86
+  uint32_t regs[4];
+  CPUID(0, 0, regs);
+  uint32_t maxLeaf = regs[0];
+
+  CPUID(1, 0, regs);
+  bool sse41 = (regs[2] & (1u << 19)) != 0;
+  bool osxsave = (regs[2] & (1u << 27)) != 0;
+  bool avx = (regs[2] & (1u << 28)) != 0;
+  if (!sse41)
+    return ISA::Scalar;
+
+  // AVX state has to be enabled by the OS as well
+  uint64_t xcr0 = osxsave ? XGETBV() : 0;
+  bool ymmEnabled = (xcr0 & 0x6) == 0x6;
+  bool zmmEnabled = (xcr0 & 0xE6) == 0xE6;
+  if (!avx || !ymmEnabled || maxLeaf < 7)
+    return ISA::SSE41;
+
+  CPUID(7, 0, regs);
+  bool avx2 = (regs[1] & (1u << 5)) != 0;
+  bool avx512f = (regs[1] & (1u << 16)) != 0;
+  if (avx512f && zmmEnabled)
+    return ISA::AVX512;
+  if (avx2)
+    return ISA::AVX2;
+  return ISA::SSE41;
+#else
+  return ISA::Scalar;
+#endif
+}
+
+const char* BC6HEncoderSIMD::GetISAName(ISA isa)
+{
+  switch (isa)
+  {
+  case ISA::SSE41: return "SSE4.1";
+  case ISA::AVX2: return "AVX2";
+  case ISA::AVX512: return "AVX-512";
+  default: return "Scalar";
+  }
+}
+
+uint32_t BC6HEncoderSIMD::GetLaneNum(ISA isa)
+{
+  switch (isa)
+  {
+  case ISA::SSE41: return 4;
+  case ISA::AVX2: return 8;
+  case ISA::AVX512: return 16;
+  default: return 1;
+  }
+}
+
+BC6HEncoderSIMD::EncodeBlocksFunc BC6HEncoderSIMD::GetEncodeBlocks(ISA isa)
+{
+#if BC6H_SIMD_X86
+  switch (isa)
+  {
+  case ISA::SSE41: return EncodeBlocksSSE41;
+  case ISA::AVX2: return EncodeBlocksAVX2;
+  case ISA::AVX512: return EncodeBlocksAVX512;
+  default: break;
+  }
+#endif
+  return nullptr;
+}
+
+BC6HDecoderSIMD::DecodeBlocksFunc BC6HDecoderSIMD::GetDecodeBlocks(BC6HEncoderSIMD::ISA isa)
+{
+#if BC6H_SIMD_X86
+  switch (isa)
+  {
+  case BC6HEncoderSIMD::ISA::SSE41: return DecodeBlocksSSE41;
+  case BC6HEncoderSIMD::ISA::AVX2: return DecodeBlocksAVX2;
+  case BC6HEncoderSIMD::ISA::AVX512: return DecodeBlocksAVX512;
+  default: break;
+  }
+#endif
+  return nullptr;
+}
+
+BC6HMetricsSIMD::MeasureBlocksFunc BC6HMetricsSIMD::GetMeasureBlocks(BC6HEncoderSIMD::ISA isa)
+{
+#if BC6H_SIMD_X86
+  switch (isa)
+  {
+  case BC6HEncoderSIMD::ISA::SSE41: return MeasureBlocksSSE41;
+  case BC6HEncoderSIMD::ISA::AVX2: return MeasureBlocksAVX2;
+  case BC6HEncoderSIMD::ISA::AVX512: return MeasureBlocksAVX512;
+  default: break;
+  }
+#endif
+  return nullptr;
+}
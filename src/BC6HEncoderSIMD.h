@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define BC6H_SIMD_X86 1
+#else
+#define BC6H_SIMD_X86 0
+#endif
+
+// Block parallel version of BC6HEncoderCPU, one block per SIMD lane.
+// Every ISA lives in its own translation unit built for that instruction set,
+// the widest one supported by the running CPU is picked at runtime.
+namespace BC6HEncoderSIMD
+{
+  enum struct ISA
+  {
+    Scalar,
+    SSE41,
+    AVX2,
+    AVX512,
+  };
+
+  // texels: [16][3][laneNum] structure of arrays in the CSMain texel order
+  // effort: BC6HEffort level
+  // p2Threshold: see BC6HEncoderCPU::EncodeBlock
+  // blocks: [laneNum][4]
+  // Returns a mask of the lanes which skipped the P2 search, bit i for lane i
+  typedef uint32_t (*EncodeBlocksFunc)(const float* texels, uint32_t effort, float p2Threshold, uint32_t* blocks);
+
+  ISA DetectISA();
+  const char* GetISAName(ISA isa);
+  uint32_t GetLaneNum(ISA isa);
+  // Returns nullptr for ISA::Scalar
+  EncodeBlocksFunc GetEncodeBlocks(ISA isa);
+
+#if BC6H_SIMD_X86
+  uint32_t EncodeBlocksSSE41(const float* texels, uint32_t effort, float p2Threshold, uint32_t* blocks);
+  uint32_t EncodeBlocksAVX2(const float* texels, uint32_t effort, float p2Threshold, uint32_t* blocks);
+  uint32_t EncodeBlocksAVX512(const float* texels, uint32_t effort, float p2Threshold, uint32_t* blocks);
+#endif
+}
@@ -0,0 +1,881 @@
+// Lane-wide version of the BC6HEncoderCPU port, every lane encodes one block.
+// Included by the per ISA translation units inside their own namespace, after they declare
+// LANES and the F (float), I (int32) and M (lane mask) vector types with their helpers.
+// Operations mirror BC6HEncoderCPU.cpp one to one, so both produce identical blocks. That includes NaNs:
+// Min/Max follow BC6HMath::Min/Max and F32ToF16 drops the NaN sign, see BC6HMath.h.
+
+const float HALF_MAX = 65504.0f;
+const float HALF_MAX_BITS = 31743.0f;
+const float MSLE_NAN = 256.0f;
+
+struct F3
+{
+  F x;
+  F y;
+  F z;
+};
+
+struct I4
+{
+  I x;
+  I y;
+  I z;
+  I w;
+};
+
+inline F operator+(F a, float b) { return a + Set(b); }
+inline F operator-(F a, float b) { return a - Set(b); }
+inline F operator*(F a, float b) { return a * Set(b); }
+inline F operator/(F a, float b) { return a / Set(b); }
+inline F operator-(float a, F b) { return Set(a) - b; }
+
+inline F3 MakeF3(F s) { return F3{ s, s, s }; }
+inline F3 MakeF3(float x, float y, float z) { return F3{ Set(x), Set(y), Set(z) }; }
+inline F3 operator+(F3 a, F3 b) { return F3{ a.x + b.x, a.y + b.y, a.z + b.z }; }
+inline F3 operator-(F3 a, F3 b) { return F3{ a.x - b.x, a.y - b.y, a.z - b.z }; }
+inline F3 operator*(F3 a, F3 b) { return F3{ a.x * b.x, a.y * b.y, a.z * b.z }; }
+inline F3 operator/(F3 a, F3 b) { return F3{ a.x / b.x, a.y / b.y, a.z / b.z }; }
+inline F3 operator+(F3 a, F s) { return F3{ a.x + s, a.y + s, a.z + s }; }
+inline F3 operator-(F3 a, F s) { return F3{ a.x - s, a.y - s, a.z - s }; }
+inline F3 operator*(F3 a, F s) { return F3{ a.x * s, a.y * s, a.z * s }; }
+inline F3 operator*(F s, F3 a) { return F3{ s * a.x, s * a.y, s * a.z }; }
+inline F3 operator/(F3 a, F s) { return F3{ a.x / s, a.y / s, a.z / s }; }
+inline F3 operator+(F3 a, float s) { return a + Set(s); }
+inline F3 operator-(F3 a, float s) { return a - Set(s); }
+inline F3 operator*(F3 a, float s) { return a * Set(s); }
+inline F3 operator/(F3 a, float s) { return a / Set(s); }
+
+inline I operator|(I a, uint32_t b) { return a | SetI(static_cast<int32_t>(b)); }
+inline I operator&(I a, uint32_t b) { return a & SetI(static_cast<int32_t>(b)); }
+
+inline F3 Min(F3 a, F3 b) { return F3{ Min(a.x, b.x), Min(a.y, b.y), Min(a.z, b.z) }; }
+inline F3 Max(F3 a, F3 b) { return F3{ Max(a.x, b.x), Max(a.y, b.y), Max(a.z, b.z) }; }
+inline F Clamp(F x, float a, float b) { return Min(Max(x, Set(a)), Set(b)); }
+inline F3 Clamp(F3 v, float a, float b) { return F3{ Clamp(v.x, a, b), Clamp(v.y, a, b), Clamp(v.z, a, b) }; }
+inline F Saturate(F x) { return Clamp(x, 0.0f, 1.0f); }
+inline F3 Floor(F3 v) { return F3{ Floor(v.x), Floor(v.y), Floor(v.z) }; }
+inline F Dot(F3 a, F3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+inline F3 Normalize(F3 v) { return v * (Set(1.0f) / Sqrt(Dot(v, v))); }
+
+inline F3 Select(M m, F3 a, F3 b) { return F3{ Select(m, a.x, b.x), Select(m, a.y, b.y), Select(m, a.z, b.z) }; }
+inline I4 Select(M m, I4 a, I4 b) { return I4{ Select(m, a.x, b.x), Select(m, a.y, b.y), Select(m, a.z, b.z), Select(m, a.w, b.w) }; }
+
+// Per component a == b ? c : d
+inline F3 SelectEq(F3 a, F3 b, F3 c, F3 d)
+{
+  return F3{ Select(a.x == b.x, c.x, d.x), Select(a.y == b.y, c.y, d.y), Select(a.z == b.z, c.z, d.z) };
+}
+
+// Values here are always below 2^31, so clamping NaN and negatives to 0 is enough for ftou
+inline I FtoU(F x) { return FtoI(Max(x, Set(0.0f))); }
+
+inline F F32ToF16(F x)
+{
+  const int32_t f32Infinity = 255 << 23;
+  const int32_t f16Max = (127 + 16) << 23;
+  const int32_t denormMagic = ((127 - 15) + (23 - 10) + 1) << 23;
+
+  I u = AsI(x);
+  I sign = u & 0x80000000;
+  u = u ^ sign;
+
+  I infNaN = Select(u > SetI(f32Infinity), SetI(0x7E00), SetI(0x7C00));
+  I denorm = AsI(AsF(u) + AsF(SetI(denormMagic))) - SetI(denormMagic);
+
+  I mantissaOdd = (u >> 13) & 1;
+  I normal = u - SetI((127 - 15) << 23);
+  normal = normal + SetI(0xFFF);
+  normal = normal + mantissaOdd;
+  normal = normal >> 13;
+
+  I h = Select(u < SetI(113 << 23), denorm, normal);
+  h = Select(u < SetI(f16Max), h, infNaN);
+  sign = Select(u > SetI(f32Infinity), SetI(0), sign);
+  return ItoF(h | (sign >> 16));
+}
+
+inline F3 F32ToF16(F3 v) { return F3{ F32ToF16(v.x), F32ToF16(v.y), F32ToF16(v.z) }; }
+
+inline F F16ToF32(I x)
+{
+  const F magic = AsF(SetI((254 - 15) << 23));
+  const F wasInfNaN = AsF(SetI((127 + 16) << 23));
+
+  I h = x & 0xFFFF;
+  F o = AsF((h & 0x7FFF) << 13);
+  o = o * magic;
+  o = Select(o >= wasInfNaN, AsF(AsI(o) | (255 << 23)), o);
+  return AsF(AsI(o) | ((h & 0x8000) << 16));
+}
+
+inline F3 F16ToF32(F3 v) { return F3{ F16ToF32(FtoU(v.x)), F16ToF32(FtoU(v.y)), F16ToF32(FtoU(v.z)) }; }
+
+inline F Log2(F x)
+{
+  I u = AsI(x);
+  F e = ItoF(((u >> 23) & 0xFF) - SetI(127));
+  F m = AsF((u & 0x007FFFFF) | 0x3F800000);
+  M big = m > Set(1.41421356f);
+  m = Select(big, m * 0.5f, m);
+  e = Select(big, e + 1.0f, e);
+
+  F f = m - 1.0f;
+  F z = f * f;
+  F y = Set(7.0376836292e-2f);
+  y = y * f - 1.1514610310e-1f;
+  y = y * f + 1.1676998740e-1f;
+  y = y * f - 1.2420140846e-1f;
+  y = y * f + 1.4249322787e-1f;
+  y = y * f - 1.6668057665e-1f;
+  y = y * f + 2.0000714765e-1f;
+  y = y * f - 2.4999993993e-1f;
+  y = y * f + 3.3333331174e-1f;
+  y = y * f * z;
+  y = y - Set(0.5f) * z;
+
+  F ln = f + y;
+  return ln * 1.44269504f + e;
+}
+
+inline F Exp2(F x)
+{
+  x = Min(Max(x, Set(-126.0f)), Set(127.0f));
+  F i = Floor(x + 0.5f);
+  F f = x - i;
+
+  F p = Set(1.535336188319500e-4f);
+  p = p * f + 1.339887440266574e-3f;
+  p = p * f + 9.618437357674640e-3f;
+  p = p * f + 5.550332471162809e-2f;
+  p = p * f + 2.402264791363012e-1f;
+  p = p * f + 6.931472028550421e-1f;
+  p = p * f + 1.0f;
+
+  return p * AsF((FtoI(i) + SetI(127)) << 23);
+}
+
+inline F3 Log2(F3 v) { return F3{ Log2(v.x), Log2(v.y), Log2(v.z) }; }
+inline F3 Exp2(F3 v) { return F3{ Exp2(v.x), Exp2(v.y), Exp2(v.z) }; }
+
+inline F CalcMSLE(F3 a, F3 b)
+{
+  F3 delta = Log2((b + 1.0f) / (a + 1.0f));
+  F3 deltaSq = delta * delta;
+
+  F3 luminanceWeights = MakeF3(0.299f, 0.587f, 0.114f);
+  deltaSq = deltaSq * luminanceWeights;
+
+  F msle = deltaSq.x + deltaSq.y + deltaSq.z;
+  return Select(msle == msle, msle, Set(MSLE_NAN));
+}
+
+const uint32_t P2_PATTERN_NUM = 32;
+
+// Partition masks of the P2 patterns, bit i set when texel i belongs to the second subset
+const uint16_t P2_PATTERN_MASKS[P2_PATTERN_NUM] =
+{
+  0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80,
+  0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+  0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE,
+  0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+};
+
+inline uint32_t PatternBits(uint32_t p)
+{
+  return P2_PATTERN_MASKS[p];
+}
+
+inline uint32_t PatternFixupID(uint32_t i)
+{
+  uint32_t ret = 15;
+  ret = ((3441033216 >> i) & 0x1) ? 2 : ret;
+  ret = ((845414400 >> i) & 0x1) ? 8 : ret;
+  return ret;
+}
+
+inline F3 Quantize7(F3 x) { return (F32ToF16(x) * 128.0f) / (0x7bff + 1.0f); }
+inline F3 Quantize9(F3 x) { return (F32ToF16(x) * 512.0f) / (0x7bff + 1.0f); }
+inline F3 Quantize10(F3 x) { return (F32ToF16(x) * 1024.0f) / (0x7bff + 1.0f); }
+inline F3 Unquantize7(F3 x) { return (x * 65536.0f + static_cast<float>(0x8000)) / 128.0f; }
+inline F3 Unquantize9(F3 x) { return (x * 65536.0f + static_cast<float>(0x8000)) / 512.0f; }
+inline F3 Unquantize10(F3 x) { return (x * 65536.0f + static_cast<float>(0x8000)) / 1024.0f; }
+
+inline F3 FinishUnquantize(F3 endpoint0Unq, F3 endpoint1Unq, F weight)
+{
+  F3 comp = (endpoint0Unq * (64.0f - weight) + endpoint1Unq * weight + 32.0f) * (31.0f / 4096.0f);
+  return F16ToF32(comp);
+}
+
+inline I ComputeIndex3(F texelPos, F endPoint0Pos, F endPoint1Pos)
+{
+  F r = (texelPos - endPoint0Pos) / (endPoint1Pos - endPoint0Pos);
+  return FtoU(Clamp(r * 6.98182f + 0.00909f + 0.5f, 0.0f, 7.0f));
+}
+
+inline I ComputeIndex4(F texelPos, F endPoint0Pos, F endPoint1Pos)
+{
+  F r = (texelPos - endPoint0Pos) / (endPoint1Pos - endPoint0Pos);
+  return FtoU(Clamp(r * 14.93333f + 0.03333f + 0.5f, 0.0f, 15.0f));
+}
+
+inline F SignExtend(F v1, int32_t mask, int32_t signFlag)
+{
+  I v = FtoI(v1);
+  v = (v & SetI(mask)) | Select(v < SetI(0), SetI(signFlag), SetI(0));
+  return ItoF(v);
+}
+
+inline void SignExtend(F3& v1, int32_t mask, int32_t signFlag)
+{
+  v1 = F3{ SignExtend(v1.x, mask, signFlag), SignExtend(v1.y, mask, signFlag), SignExtend(v1.z, mask, signFlag) };
+}
+
+inline M InSubset(I patternBits, uint32_t i, uint32_t patternSelector)
+{
+  return ((patternBits >> i) & 1) == SetI(static_cast<int32_t>(patternSelector));
+}
+
+// Refine endpoints by insetting bounding box in log2 RGB space
+inline void InsetColorBBoxP1(const F3 texels[16], F3& blockMin, F3& blockMax)
+{
+  F3 refinedBlockMin = blockMax;
+  F3 refinedBlockMax = blockMin;
+
+  for (uint32_t i = 0; i < 16; ++i)
+  {
+    refinedBlockMin = Min(refinedBlockMin, SelectEq(texels[i], blockMin, refinedBlockMin, texels[i]));
+    refinedBlockMax = Max(refinedBlockMax, SelectEq(texels[i], blockMax, refinedBlockMax, texels[i]));
+  }
+
+  F3 logRefinedBlockMax = Log2(refinedBlockMax + 1.0f);
+  F3 logRefinedBlockMin = Log2(refinedBlockMin + 1.0f);
+
+  F3 logBlockMax = Log2(blockMax + 1.0f);
+  F3 logBlockMin = Log2(blockMin + 1.0f);
+  F3 logBlockMaxExt = (logBlockMax - logBlockMin) * (1.0f / 32.0f);
+
+  logBlockMin = logBlockMin + Min(logRefinedBlockMin - logBlockMin, logBlockMaxExt);
+  logBlockMax = logBlockMax - Min(logBlockMax - logRefinedBlockMax, logBlockMaxExt);
+
+  blockMin = Exp2(logBlockMin) - 1.0f;
+  blockMax = Exp2(logBlockMax) - 1.0f;
+}
+
+// InsetColorBBoxP1 over the texels of one subset
+inline void InsetColorBBoxP2(const F3 texels[16], I patternBits, uint32_t patternSelector, F3& blockMin, F3& blockMax)
+{
+  F3 refinedBlockMin = blockMax;
+  F3 refinedBlockMax = blockMin;
+
+  for (uint32_t i = 0; i < 16; ++i)
+  {
+    M inSubset = InSubset(patternBits, i, patternSelector);
+    refinedBlockMin = Select(inSubset, Min(refinedBlockMin, SelectEq(texels[i], blockMin, refinedBlockMin, texels[i])), refinedBlockMin);
+    refinedBlockMax = Select(inSubset, Max(refinedBlockMax, SelectEq(texels[i], blockMax, refinedBlockMax, texels[i])), refinedBlockMax);
+  }
+
+  F3 logRefinedBlockMax = Log2(refinedBlockMax + 1.0f);
+  F3 logRefinedBlockMin = Log2(refinedBlockMin + 1.0f);
+
+  F3 logBlockMax = Log2(blockMax + 1.0f);
+  F3 logBlockMin = Log2(blockMin + 1.0f);
+  F3 logBlockMaxExt = (logBlockMax - logBlockMin) * (1.0f / 32.0f);
+
+  logBlockMin = logBlockMin + Min(logRefinedBlockMin - logBlockMin, logBlockMaxExt);
+  logBlockMax = logBlockMax - Min(logBlockMax - logRefinedBlockMax, logBlockMaxExt);
+
+  blockMin = Exp2(logBlockMin) - 1.0f;
+  blockMax = Exp2(logBlockMax) - 1.0f;
+}
+
+// Least squares optimization to find best endpoints for the selected block indices
+inline void OptimizeEndpointsP1(const F3 texels[16], F3& blockMin, F3& blockMax)
+{
+  F3 blockDir = blockMax - blockMin;
+  blockDir = blockDir / (blockDir.x + blockDir.y + blockDir.z);
+
+  F endPoint0Pos = F32ToF16(Dot(blockMin, blockDir));
+  F endPoint1Pos = F32ToF16(Dot(blockMax, blockDir));
+
+  F3 alphaTexelSum = MakeF3(Set(0.0f));
+  F3 betaTexelSum = MakeF3(Set(0.0f));
+  F alphaBetaSum = Set(0.0f);
+  F alphaSqSum = Set(0.0f);
+  F betaSqSum = Set(0.0f);
+
+  for (uint32_t i = 0; i < 16; i++)
+  {
+    F texelPos = F32ToF16(Dot(texels[i], blockDir));
+    I texelIndex = ComputeIndex4(texelPos, endPoint0Pos, endPoint1Pos);
+
+    F beta = Saturate(ItoF(texelIndex) / 15.0f);
+    F alpha = 1.0f - beta;
+
+    F3 texelF16 = F32ToF16(texels[i]);
+    alphaTexelSum = alphaTexelSum + alpha * texelF16;
+    betaTexelSum = betaTexelSum + beta * texelF16;
+
+    alphaBetaSum = alphaBetaSum + alpha * beta;
+
+    alphaSqSum = alphaSqSum + alpha * alpha;
+    betaSqSum = betaSqSum + beta * beta;
+  }
+
+  F det = alphaSqSum * betaSqSum - alphaBetaSum * alphaBetaSum;
+
+  M solvable = Abs(det) > Set(0.00001f);
+  F detRcp = Set(1.0f) / det;
+  blockMin = Select(solvable, F16ToF32(Clamp(detRcp * (alphaTexelSum * betaSqSum - betaTexelSum * alphaBetaSum), 0.0f, HALF_MAX_BITS)), blockMin);
+  blockMax = Select(solvable, F16ToF32(Clamp(detRcp * (betaTexelSum * alphaSqSum - alphaTexelSum * alphaBetaSum), 0.0f, HALF_MAX_BITS)), blockMax);
+}
+
+// Least squares optimization to find best endpoints for the selected block indices
+inline void OptimizeEndpointsP2(const F3 texels[16], I patternBits, uint32_t patternSelector, F3& blockMin, F3& blockMax)
+{
+  F3 blockDir = blockMax - blockMin;
+  blockDir = blockDir / (blockDir.x + blockDir.y + blockDir.z);
+
+  F endPoint0Pos = F32ToF16(Dot(blockMin, blockDir));
+  F endPoint1Pos = F32ToF16(Dot(blockMax, blockDir));
+
+  F3 alphaTexelSum = MakeF3(Set(0.0f));
+  F3 betaTexelSum = MakeF3(Set(0.0f));
+  F alphaBetaSum = Set(0.0f);
+  F alphaSqSum = Set(0.0f);
+  F betaSqSum = Set(0.0f);
+
+  for (uint32_t i = 0; i < 16; i++)
+  {
+    M inSubset = InSubset(patternBits, i, patternSelector);
+
+    F texelPos = F32ToF16(Dot(texels[i], blockDir));
+    I texelIndex = ComputeIndex3(texelPos, endPoint0Pos, endPoint1Pos);
+
+    F beta = Saturate(ItoF(texelIndex) / 7.0f);
+    F alpha = 1.0f - beta;
+
+    F3 texelF16 = F32ToF16(texels[i]);
+    alphaTexelSum = Select(inSubset, alphaTexelSum + alpha * texelF16, alphaTexelSum);
+    betaTexelSum = Select(inSubset, betaTexelSum + beta * texelF16, betaTexelSum);
+
+    alphaBetaSum = Select(inSubset, alphaBetaSum + alpha * beta, alphaBetaSum);
+
+    alphaSqSum = Select(inSubset, alphaSqSum + alpha * alpha, alphaSqSum);
+    betaSqSum = Select(inSubset, betaSqSum + beta * beta, betaSqSum);
+  }
+
+  F det = alphaSqSum * betaSqSum - alphaBetaSum * alphaBetaSum;
+
+  M solvable = Abs(det) > Set(0.00001f);
+  F detRcp = Set(1.0f) / det;
+  blockMin = Select(solvable, F16ToF32(Clamp(detRcp * (alphaTexelSum * betaSqSum - betaTexelSum * alphaBetaSum), 0.0f, HALF_MAX_BITS)), blockMin);
+  blockMax = Select(solvable, F16ToF32(Clamp(detRcp * (betaTexelSum * alphaSqSum - alphaTexelSum * alphaBetaSum), 0.0f, HALF_MAX_BITS)), blockMax);
+}
+
+template<uint32_t Effort>
+inline void EncodeP1(I4& block, F& blockMSLE, const F3 texels[16])
+{
+  typedef BC6HEffort::STraits<Effort> Traits;
+
+  // compute endpoints (min/max RGB bbox)
+  F3 blockMin = texels[0];
+  F3 blockMax = texels[0];
+  for (uint32_t i = 1; i < 16; ++i)
+  {
+    blockMin = Min(blockMin, texels[i]);
+    blockMax = Max(blockMax, texels[i]);
+  }
+
+  if (Traits::INSET_P1)
+    InsetColorBBoxP1(texels, blockMin, blockMax);
+  for (uint32_t pass = 0; Traits::OPTIMIZE_ENDPOINTS && pass < Traits::OPTIMIZE_PASSES; ++pass)
+    OptimizeEndpointsP1(texels, blockMin, blockMax);
+
+  F3 blockDir = blockMax - blockMin;
+  blockDir = blockDir / (blockDir.x + blockDir.y + blockDir.z);
+
+  F3 endpoint0 = Quantize10(blockMin);
+  F3 endpoint1 = Quantize10(blockMax);
+  F endPoint0Pos = F32ToF16(Dot(blockMin, blockDir));
+  F endPoint1Pos = F32ToF16(Dot(blockMax, blockDir));
+
+  // check if endpoint swap is required
+  F fixupTexelPos = F32ToF16(Dot(texels[0], blockDir));
+  I fixupIndex = ComputeIndex4(fixupTexelPos, endPoint0Pos, endPoint1Pos);
+  M swap = fixupIndex > SetI(7);
+  F tmpPos = endPoint0Pos;
+  endPoint0Pos = Select(swap, endPoint1Pos, endPoint0Pos);
+  endPoint1Pos = Select(swap, tmpPos, endPoint1Pos);
+  F3 tmpEndpoint = endpoint0;
+  endpoint0 = Select(swap, endpoint1, endpoint0);
+  endpoint1 = Select(swap, tmpEndpoint, endpoint1);
+
+  // compute indices
+  I indices[16];
+  for (uint32_t i = 0; i < 16; ++i)
+  {
+    F texelPos = F32ToF16(Dot(texels[i], blockDir));
+    indices[i] = ComputeIndex4(texelPos, endPoint0Pos, endPoint1Pos);
+  }
+
+  // compute compression error (MSLE)
+  F3 endpoint0Unq = Unquantize10(endpoint0);
+  F3 endpoint1Unq = Unquantize10(endpoint1);
+  F msle = Set(0.0f);
+  for (uint32_t i = 0; i < 16; ++i)
+  {
+    F weight = Floor((ItoF(indices[i]) * 64.0f) / 15.0f + 0.5f);
+    F3 texelUnc = FinishUnquantize(endpoint0Unq, endpoint1Unq, weight);
+
+    msle = msle + CalcMSLE(texels[i], texelUnc);
+  }
+
+  // encode block for mode 11
+  blockMSLE = msle;
+  block.x = SetI(0x03);
+
+  // endpoints
+  block.x = block.x | (FtoU(endpoint0.x) << 5);
+  block.x = block.x | (FtoU(endpoint0.y) << 15);
+  block.x = block.x | (FtoU(endpoint0.z) << 25);
+  block.y = block.y | (FtoU(endpoint0.z) >> 7);
+  block.y = block.y | (FtoU(endpoint1.x) << 3);
+  block.y = block.y | (FtoU(endpoint1.y) << 13);
+  block.y = block.y | (FtoU(endpoint1.z) << 23);
+  block.z = block.z | (FtoU(endpoint1.z) >> 9);
+
+  // indices
+  block.z = block.z | (indices[0] << 1);
+  block.z = block.z | (indices[1] << 4);
+  block.z = block.z | (indices[2] << 8);
+  block.z = block.z | (indices[3] << 12);
+  block.z = block.z | (indices[4] << 16);
+  block.z = block.z | (indices[5] << 20);
+  block.z = block.z | (indices[6] << 24);
+  block.z = block.z | (indices[7] << 28);
+  block.w = block.w | (indices[8] << 0);
+  block.w = block.w | (indices[9] << 4);
+  block.w = block.w | (indices[10] << 8);
+  block.w = block.w | (indices[11] << 12);
+  block.w = block.w | (indices[12] << 16);
+  block.w = block.w | (indices[13] << 20);
+  block.w = block.w | (indices[14] << 24);
+  block.w = block.w | (indices[15] << 28);
+}
+
+inline F DistToLineSq(F3 pointOnLine, F3 lineDirection, F3 point)
+{
+  F3 w = point - pointOnLine;
+  F3 x = w - Dot(w, lineDirection) * lineDirection;
+  return Dot(x, x);
+}
+
+// Evaluates how good every P2 pattern is for encoding the current block, see ScoreP2Patterns of BC6HEncoderCPU.
+// The pattern is the same for all lanes, so the bounds lookups and subset selection use plain scalar indices.
+inline void ScoreP2Patterns(const F3 texels[16], F scores[P2_PATTERN_NUM])
+{
+  // rowMin[r][m] and rowMax[r][m] bound the texels of row r selected by the 4 bit mask m
+  F3 rowMin[4][16];
+  F3 rowMax[4][16];
+  for (uint32_t row = 0; row < 4; ++row)
+  {
+    rowMin[row][0] = MakeF3(HALF_MAX, HALF_MAX, HALF_MAX);
+    rowMax[row][0] = MakeF3(0.0f, 0.0f, 0.0f);
+    for (uint32_t m = 1; m < 16; ++m)
+    {
+      uint32_t lowest = m & (0u - m);
+      uint32_t i = row * 4 + (lowest == 1 ? 0 : lowest == 2 ? 1 : lowest == 4 ? 2 : 3);
+      rowMin[row][m] = Min(rowMin[row][m & ~lowest], texels[i]);
+      rowMax[row][m] = Max(rowMax[row][m & ~lowest], texels[i]);
+    }
+  }
+
+  for (uint32_t pattern = 0; pattern < P2_PATTERN_NUM; ++pattern)
+  {
+    uint32_t p1Mask = P2_PATTERN_MASKS[pattern];
+    uint32_t p0Mask = ~p1Mask & 0xFFFF;
+
+    F3 p0BlockMin = rowMin[0][p0Mask & 0xF];
+    F3 p0BlockMax = rowMax[0][p0Mask & 0xF];
+    F3 p1BlockMin = rowMin[0][p1Mask & 0xF];
+    F3 p1BlockMax = rowMax[0][p1Mask & 0xF];
+    for (uint32_t row = 1; row < 4; ++row)
+    {
+      p0BlockMin = Min(p0BlockMin, rowMin[row][(p0Mask >> (row * 4)) & 0xF]);
+      p0BlockMax = Max(p0BlockMax, rowMax[row][(p0Mask >> (row * 4)) & 0xF]);
+      p1BlockMin = Min(p1BlockMin, rowMin[row][(p1Mask >> (row * 4)) & 0xF]);
+      p1BlockMax = Max(p1BlockMax, rowMax[row][(p1Mask >> (row * 4)) & 0xF]);
+    }
+
+    F3 blockMin[2] = { p0BlockMin, p1BlockMin };
+    F3 blockDir[2] = { Normalize(p0BlockMax - p0BlockMin), Normalize(p1BlockMax - p1BlockMin) };
+
+    F sqDistanceFromLine = Set(0.0f);
+    for (uint32_t i = 0; i < 16; ++i)
+    {
+      uint32_t paletteID = (p1Mask >> i) & 1;
+      sqDistanceFromLine = sqDistanceFromLine + DistToLineSq(blockMin[paletteID], blockDir[paletteID], texels[i]);
+    }
+    scores[pattern] = sqDistanceFromLine;
+  }
+}
+
+// The K best fitting patterns of every lane, sorted by their score. Ties keep the lower pattern, unfilled candidates
+// (patterns scoring NaN, with a single colored subset) stay at pattern 0.
+template<uint32_t K>
+inline void FindP2Patterns(const F3 texels[16], I bestPatterns[K])
+{
+  F scores[P2_PATTERN_NUM];
+  ScoreP2Patterns(texels, scores);
+
+  F bestScores[K];
+  for (uint32_t k = 0; k < K; ++k)
+  {
+    bestScores[k] = Set(INFINITY);
+    bestPatterns[k] = SetI(0);
+  }
+  bestScores[0] = scores[0];
+
+  for (uint32_t patternIndex = 1; patternIndex < P2_PATTERN_NUM; ++patternIndex)
+  {
+    F score = scores[patternIndex];
+    I pattern = SetI(static_cast<int32_t>(patternIndex));
+    for (uint32_t k = 0; k < K; ++k)
+    {
+      M better = score < bestScores[k];
+      F displacedScore = Select(better, bestScores[k], score);
+      I displacedPattern = Select(better, bestPatterns[k], pattern);
+      bestScores[k] = Select(better, score, bestScores[k]);
+      bestPatterns[k] = Select(better, pattern, bestPatterns[k]);
+      score = displacedScore;
+      pattern = displacedPattern;
+    }
+  }
+}
+
+// Pattern differs per lane here, patternBits holds the 16 bit subset mask of every lane
+template<uint32_t Effort>
+inline void EncodeP2Pattern(I4& block, F& blockMSLE, I pattern, I patternBits, I fixupID, const F3 texels[16])
+{
+  typedef BC6HEffort::STraits<Effort> Traits;
+
+  F3 p0BlockMin = MakeF3(HALF_MAX, HALF_MAX, HALF_MAX);
+  F3 p0BlockMax = MakeF3(0.0f, 0.0f, 0.0f);
+  F3 p1BlockMin = MakeF3(HALF_MAX, HALF_MAX, HALF_MAX);
+  F3 p1BlockMax = MakeF3(0.0f, 0.0f, 0.0f);
+
+  M inP0[16];
+  for (uint32_t i = 0; i < 16; ++i)
+  {
+    inP0[i] = InSubset(patternBits, i, 0);
+    p0BlockMin = Select(inP0[i], Min(p0BlockMin, texels[i]), p0BlockMin);
+    p0BlockMax = Select(inP0[i], Max(p0BlockMax, texels[i]), p0BlockMax);
+    p1BlockMin = Select(inP0[i], p1BlockMin, Min(p1BlockMin, texels[i]));
+    p1BlockMax = Select(inP0[i], p1BlockMax, Max(p1BlockMax, texels[i]));
+  }
+
+  if (Traits::INSET_P2)
+  {
+    InsetColorBBoxP2(texels, patternBits, 0, p0BlockMin, p0BlockMax);
+    InsetColorBBoxP2(texels, patternBits, 1, p1BlockMin, p1BlockMax);
+  }
+
+  for (uint32_t pass = 0; Traits::OPTIMIZE_ENDPOINTS && pass < Traits::OPTIMIZE_PASSES; ++pass)
+  {
+    OptimizeEndpointsP2(texels, patternBits, 0, p0BlockMin, p0BlockMax);
+    OptimizeEndpointsP2(texels, patternBits, 1, p1BlockMin, p1BlockMax);
+  }
+
+  F3 p0BlockDir = p0BlockMax - p0BlockMin;
+  F3 p1BlockDir = p1BlockMax - p1BlockMin;
+  p0BlockDir = p0BlockDir / (p0BlockDir.x + p0BlockDir.y + p0BlockDir.z);
+  p1BlockDir = p1BlockDir / (p1BlockDir.x + p1BlockDir.y + p1BlockDir.z);
+
+  F p0Endpoint0Pos = F32ToF16(Dot(p0BlockMin, p0BlockDir));
+  F p0Endpoint1Pos = F32ToF16(Dot(p0BlockMax, p0BlockDir));
+  F p1Endpoint0Pos = F32ToF16(Dot(p1BlockMin, p1BlockDir));
+  F p1Endpoint1Pos = F32ToF16(Dot(p1BlockMax, p1BlockDir));
+
+  F3 fixupTexel = Select(fixupID == SetI(2), texels[2], Select(fixupID == SetI(8), texels[8], texels[15]));
+  F p0FixupTexelPos = F32ToF16(Dot(texels[0], p0BlockDir));
+  F p1FixupTexelPos = F32ToF16(Dot(fixupTexel, p1BlockDir));
+  I p0FixupIndex = ComputeIndex3(p0FixupTexelPos, p0Endpoint0Pos, p0Endpoint1Pos);
+  I p1FixupIndex = ComputeIndex3(p1FixupTexelPos, p1Endpoint0Pos, p1Endpoint1Pos);
+
+  M p0Swap = p0FixupIndex > SetI(3);
+  F tmpPos = p0Endpoint0Pos;
+  p0Endpoint0Pos = Select(p0Swap, p0Endpoint1Pos, p0Endpoint0Pos);
+  p0Endpoint1Pos = Select(p0Swap, tmpPos, p0Endpoint1Pos);
+  F3 tmpEndpoint = p0BlockMin;
+  p0BlockMin = Select(p0Swap, p0BlockMax, p0BlockMin);
+  p0BlockMax = Select(p0Swap, tmpEndpoint, p0BlockMax);
+
+  M p1Swap = p1FixupIndex > SetI(3);
+  tmpPos = p1Endpoint0Pos;
+  p1Endpoint0Pos = Select(p1Swap, p1Endpoint1Pos, p1Endpoint0Pos);
+  p1Endpoint1Pos = Select(p1Swap, tmpPos, p1Endpoint1Pos);
+  tmpEndpoint = p1BlockMin;
+  p1BlockMin = Select(p1Swap, p1BlockMax, p1BlockMin);
+  p1BlockMax = Select(p1Swap, tmpEndpoint, p1BlockMax);
+
+  I indices[16];
+  for (uint32_t i = 0; i < 16; ++i)
+  {
+    F p0TexelPos = F32ToF16(Dot(texels[i], p0BlockDir));
+    F p1TexelPos = F32ToF16(Dot(texels[i], p1BlockDir));
+    I p0Index = ComputeIndex3(p0TexelPos, p0Endpoint0Pos, p0Endpoint1Pos);
+    I p1Index = ComputeIndex3(p1TexelPos, p1Endpoint0Pos, p1Endpoint1Pos);
+
+    indices[i] = Select(inP0[i], p0Index, p1Index);
+  }
+
+  F3 endpoint760 = Floor(Quantize7(p0BlockMin));
+  F3 endpoint761 = Floor(Quantize7(p0BlockMax));
+  F3 endpoint762 = Floor(Quantize7(p1BlockMin));
+  F3 endpoint763 = Floor(Quantize7(p1BlockMax));
+
+  F3 endpoint950 = Floor(Quantize9(p0BlockMin));
+  F3 endpoint951 = Floor(Quantize9(p0BlockMax));
+  F3 endpoint952 = Floor(Quantize9(p1BlockMin));
+  F3 endpoint953 = Floor(Quantize9(p1BlockMax));
+
+  endpoint761 = endpoint761 - endpoint760;
+  endpoint762 = endpoint762 - endpoint760;
+  endpoint763 = endpoint763 - endpoint760;
+
+  endpoint951 = endpoint951 - endpoint950;
+  endpoint952 = endpoint952 - endpoint950;
+  endpoint953 = endpoint953 - endpoint950;
+
+  float maxVal76 = 0x1F;
+  endpoint761 = Clamp(endpoint761, -maxVal76, maxVal76);
+  endpoint762 = Clamp(endpoint762, -maxVal76, maxVal76);
+  endpoint763 = Clamp(endpoint763, -maxVal76, maxVal76);
+
+  float maxVal95 = 0xF;
+  endpoint951 = Clamp(endpoint951, -maxVal95, maxVal95);
+  endpoint952 = Clamp(endpoint952, -maxVal95, maxVal95);
+  endpoint953 = Clamp(endpoint953, -maxVal95, maxVal95);
+
+  F3 endpoint760Unq = Unquantize7(endpoint760);
+  F3 endpoint761Unq = Unquantize7(endpoint760 + endpoint761);
+  F3 endpoint762Unq = Unquantize7(endpoint760 + endpoint762);
+  F3 endpoint763Unq = Unquantize7(endpoint760 + endpoint763);
+  F3 endpoint950Unq = Unquantize9(endpoint950);
+  F3 endpoint951Unq = Unquantize9(endpoint950 + endpoint951);
+  F3 endpoint952Unq = Unquantize9(endpoint950 + endpoint952);
+  F3 endpoint953Unq = Unquantize9(endpoint950 + endpoint953);
+
+  F msle76 = Set(0.0f);
+  F msle95 = Set(0.0f);
+  for (uint32_t i = 0; i < 16; ++i)
+  {
+    F3 tmp760Unq = Select(inP0[i], endpoint760Unq, endpoint762Unq);
+    F3 tmp761Unq = Select(inP0[i], endpoint761Unq, endpoint763Unq);
+    F3 tmp950Unq = Select(inP0[i], endpoint950Unq, endpoint952Unq);
+    F3 tmp951Unq = Select(inP0[i], endpoint951Unq, endpoint953Unq);
+
+    F weight = Floor((ItoF(indices[i]) * 64.0f) / 7.0f + 0.5f);
+    F3 texelUnc76 = FinishUnquantize(tmp760Unq, tmp761Unq, weight);
+    F3 texelUnc95 = FinishUnquantize(tmp950Unq, tmp951Unq, weight);
+
+    msle76 = msle76 + CalcMSLE(texels[i], texelUnc76);
+    msle95 = msle95 + CalcMSLE(texels[i], texelUnc95);
+  }
+
+  SignExtend(endpoint761, 0x1F, 0x20);
+  SignExtend(endpoint762, 0x1F, 0x20);
+  SignExtend(endpoint763, 0x1F, 0x20);
+
+  SignExtend(endpoint951, 0xF, 0x10);
+  SignExtend(endpoint952, 0xF, 0x10);
+  SignExtend(endpoint953, 0xF, 0x10);
+
+  F p2MSLE = Min(msle76, msle95);
+  M useP2 = p2MSLE < blockMSLE;
+  if (!Any(useP2))
+    return;
+
+  // 7.6
+  I4 block76 = { SetI(0x1), SetI(0), SetI(0), SetI(0) };
+  block76.x = block76.x | ((FtoU(endpoint762.y) & 0x20) >> 3);
+  block76.x = block76.x | ((FtoU(endpoint763.y) & 0x10) >> 1);
+  block76.x = block76.x | ((FtoU(endpoint763.y) & 0x20) >> 1);
+  block76.x = block76.x | (FtoU(endpoint760.x) << 5);
+  block76.x = block76.x | ((FtoU(endpoint763.z) & 0x01) << 12);
+  block76.x = block76.x | ((FtoU(endpoint763.z) & 0x02) << 12);
+  block76.x = block76.x | ((FtoU(endpoint762.z) & 0x10) << 10);
+  block76.x = block76.x | (FtoU(endpoint760.y) << 15);
+  block76.x = block76.x | ((FtoU(endpoint762.z) & 0x20) << 17);
+  block76.x = block76.x | ((FtoU(endpoint763.z) & 0x04) << 21);
+  block76.x = block76.x | ((FtoU(endpoint762.y) & 0x10) << 20);
+  block76.x = block76.x | (FtoU(endpoint760.z) << 25);
+  block76.y = block76.y | ((FtoU(endpoint763.z) & 0x08) >> 3);
+  block76.y = block76.y | ((FtoU(endpoint763.z) & 0x20) >> 4);
+  block76.y = block76.y | ((FtoU(endpoint763.z) & 0x10) >> 2);
+  block76.y = block76.y | (FtoU(endpoint761.x) << 3);
+  block76.y = block76.y | ((FtoU(endpoint762.y) & 0x0F) << 9);
+  block76.y = block76.y | (FtoU(endpoint761.y) << 13);
+  block76.y = block76.y | ((FtoU(endpoint763.y) & 0x0F) << 19);
+  block76.y = block76.y | (FtoU(endpoint761.z) << 23);
+  block76.y = block76.y | ((FtoU(endpoint762.z) & 0x07) << 29);
+  block76.z = block76.z | ((FtoU(endpoint762.z) & 0x08) >> 3);
+  block76.z = block76.z | (FtoU(endpoint762.x) << 1);
+  block76.z = block76.z | (FtoU(endpoint763.x) << 7);
+
+  // 9.5
+  I4 block95 = { SetI(0xE), SetI(0), SetI(0), SetI(0) };
+  block95.x = block95.x | (FtoU(endpoint950.x) << 5);
+  block95.x = block95.x | ((FtoU(endpoint952.z) & 0x10) << 10);
+  block95.x = block95.x | (FtoU(endpoint950.y) << 15);
+  block95.x = block95.x | ((FtoU(endpoint952.y) & 0x10) << 20);
+  block95.x = block95.x | (FtoU(endpoint950.z) << 25);
+  block95.y = block95.y | (FtoU(endpoint950.z) >> 7);
+  block95.y = block95.y | ((FtoU(endpoint953.z) & 0x10) >> 2);
+  block95.y = block95.y | (FtoU(endpoint951.x) << 3);
+  block95.y = block95.y | ((FtoU(endpoint953.y) & 0x10) << 4);
+  block95.y = block95.y | ((FtoU(endpoint952.y) & 0x0F) << 9);
+  block95.y = block95.y | (FtoU(endpoint951.y) << 13);
+  block95.y = block95.y | ((FtoU(endpoint953.z) & 0x01) << 18);
+  block95.y = block95.y | ((FtoU(endpoint953.y) & 0x0F) << 19);
+  block95.y = block95.y | (FtoU(endpoint951.z) << 23);
+  block95.y = block95.y | ((FtoU(endpoint953.z) & 0x02) << 27);
+  block95.y = block95.y | (FtoU(endpoint952.z) << 29);
+  block95.z = block95.z | ((FtoU(endpoint952.z) & 0x08) >> 3);
+  block95.z = block95.z | (FtoU(endpoint952.x) << 1);
+  block95.z = block95.z | ((FtoU(endpoint953.z) & 0x04) << 4);
+  block95.z = block95.z | (FtoU(endpoint953.x) << 7);
+  block95.z = block95.z | ((FtoU(endpoint953.z) & 0x08) << 9);
+
+  I4 p2Block = Select(p2MSLE == msle76, block76, block95);
+  p2Block.z = p2Block.z | (pattern << 13);
+
+  // Index layout depends on the fixup texel of the second subset
+  I4 indices15 = { SetI(0), SetI(0), SetI(0), SetI(0) };
+  indices15.z = indices15.z | (indices[0] << 18);
+  indices15.z = indices15.z | (indices[1] << 20);
+  indices15.z = indices15.z | (indices[2] << 23);
+  indices15.z = indices15.z | (indices[3] << 26);
+  indices15.z = indices15.z | (indices[4] << 29);
+  indices15.w = indices15.w | (indices[5] << 0);
+  indices15.w = indices15.w | (indices[6] << 3);
+  indices15.w = indices15.w | (indices[7] << 6);
+  indices15.w = indices15.w | (indices[8] << 9);
+  indices15.w = indices15.w | (indices[9] << 12);
+  indices15.w = indices15.w | (indices[10] << 15);
+  indices15.w = indices15.w | (indices[11] << 18);
+  indices15.w = indices15.w | (indices[12] << 21);
+  indices15.w = indices15.w | (indices[13] << 24);
+  indices15.w = indices15.w | (indices[14] << 27);
+  indices15.w = indices15.w | (indices[15] << 30);
+
+  I4 indices2 = { SetI(0), SetI(0), SetI(0), SetI(0) };
+  indices2.z = indices2.z | (indices[0] << 18);
+  indices2.z = indices2.z | (indices[1] << 20);
+  indices2.z = indices2.z | (indices[2] << 23);
+  indices2.z = indices2.z | (indices[3] << 25);
+  indices2.z = indices2.z | (indices[4] << 28);
+  indices2.z = indices2.z | (indices[5] << 31);
+  indices2.w = indices2.w | (indices[5] >> 1);
+  indices2.w = indices2.w | (indices[6] << 2);
+  indices2.w = indices2.w | (indices[7] << 5);
+  indices2.w = indices2.w | (indices[8] << 8);
+  indices2.w = indices2.w | (indices[9] << 11);
+  indices2.w = indices2.w | (indices[10] << 14);
+  indices2.w = indices2.w | (indices[11] << 17);
+  indices2.w = indices2.w | (indices[12] << 20);
+  indices2.w = indices2.w | (indices[13] << 23);
+  indices2.w = indices2.w | (indices[14] << 26);
+  indices2.w = indices2.w | (indices[15] << 29);
+
+  I4 indices8 = { SetI(0), SetI(0), SetI(0), SetI(0) };
+  indices8.z = indices8.z | (indices[0] << 18);
+  indices8.z = indices8.z | (indices[1] << 20);
+  indices8.z = indices8.z | (indices[2] << 23);
+  indices8.z = indices8.z | (indices[3] << 26);
+  indices8.z = indices8.z | (indices[4] << 29);
+  indices8.w = indices8.w | (indices[5] << 0);
+  indices8.w = indices8.w | (indices[6] << 3);
+  indices8.w = indices8.w | (indices[7] << 6);
+  indices8.w = indices8.w | (indices[8] << 9);
+  indices8.w = indices8.w | (indices[9] << 11);
+  indices8.w = indices8.w | (indices[10] << 14);
+  indices8.w = indices8.w | (indices[11] << 17);
+  indices8.w = indices8.w | (indices[12] << 20);
+  indices8.w = indices8.w | (indices[13] << 23);
+  indices8.w = indices8.w | (indices[14] << 26);
+  indices8.w = indices8.w | (indices[15] << 29);
+
+  I4 indexBits = Select(fixupID == SetI(15), indices15, Select(fixupID == SetI(2), indices2, indices8));
+  p2Block.z = p2Block.z | indexBits.z;
+  p2Block.w = p2Block.w | indexBits.w;
+
+  block = Select(useP2, p2Block, block);
+  blockMSLE = Select(useP2, p2MSLE, blockMSLE);
+}
+
+// texels: [16][3][LANES] structure of arrays, blocks: [LANES][4]. Returns the lanes which skipped the P2 search.
+template<uint32_t Effort>
+inline uint32_t EncodeBlocks(const float* texelsSoA, float p2Threshold, uint32_t* blocks)
+{
+  typedef BC6HEffort::STraits<Effort> Traits;
+
+  F3 texels[16];
+  for (uint32_t i = 0; i < 16; ++i)
+  {
+    texels[i].x = Load(texelsSoA + (i * 3 + 0) * LANES);
+    texels[i].y = Load(texelsSoA + (i * 3 + 1) * LANES);
+    texels[i].z = Load(texelsSoA + (i * 3 + 2) * LANES);
+  }
+
+  I4 block = { SetI(0), SetI(0), SetI(0), SetI(0) };
+  F blockMSLE = Set(0.0f);
+
+  EncodeP1<Effort>(block, blockMSLE, texels);
+
+  // Lanes under the threshold keep their P1 encoding through a zero error no P2 pattern beats,
+  // the search itself only runs while some lane still needs it
+  uint32_t skippedLanes = 0;
+  if (Traits::ENCODE_P2)
+  {
+    M skipP2 = blockMSLE < Set(p2Threshold * 16.0f);
+    skippedLanes = LaneMask(skipP2);
+    blockMSLE = Select(skipP2, Set(0.0f), blockMSLE);
+  }
+
+  if (Traits::ENCODE_P2 && skippedLanes != (1u << LANES) - 1)
+  {
+    // First find the patterns which fit the current block best
+    I bestPatterns[Traits::P2_CANDIDATES];
+    FindP2Patterns<Traits::P2_CANDIDATES>(texels, bestPatterns);
+
+    // Then encode them, every one replaces the block only if it has a lower error
+    for (uint32_t k = 0; k < Traits::P2_CANDIDATES; ++k)
+    {
+      // Per lane pattern tables
+      int32_t patterns[LANES];
+      int32_t patternBits[LANES];
+      int32_t fixupIDs[LANES];
+      StoreI(patterns, bestPatterns[k]);
+      for (uint32_t lane = 0; lane < LANES; ++lane)
+      {
+        patternBits[lane] = static_cast<int32_t>(PatternBits(patterns[lane]));
+        fixupIDs[lane] = static_cast<int32_t>(PatternFixupID(patterns[lane]));
+      }
+
+      EncodeP2Pattern<Effort>(block, blockMSLE, bestPatterns[k], LoadI(patternBits), LoadI(fixupIDs), texels);
+    }
+  }
+
+  int32_t blockBits[4][LANES];
+  StoreI(blockBits[0], block.x);
+  StoreI(blockBits[1], block.y);
+  StoreI(blockBits[2], block.z);
+  StoreI(blockBits[3], block.w);
+  for (uint32_t lane = 0; lane < LANES; ++lane)
+  {
+    for (uint32_t i = 0; i < 4; ++i)
+      blocks[lane * 4 + i] = static_cast<uint32_t>(blockBits[i][lane]);
+  }
+  return skippedLanes;
+}
@@ -0,0 +1,108 @@
+#include "BC6HEncoderSIMD.h"
+#include "BC6HDecoderSIMD.h"
+#include "BC6HMetricsSIMD.h"
+#include "BC6HEffort.h"
+
+#include <math.h>
+
+#if BC6H_SIMD_X86
+
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+
+#include <immintrin.h>
+
+namespace
+{
+  namespace AVX2
+  {
+    const uint32_t LANES = 8;
+
+    struct F { __m256 v; };
+    struct I { __m256i v; };
+    struct M { __m256 v; };
+
+    inline F Load(const float* p) { return F{ _mm256_loadu_ps(p) }; }
+    inline void Store(float* p, F a) { _mm256_storeu_ps(p, a.v); }
+    inline F Set(float s) { return F{ _mm256_set1_ps(s) }; }
+    inline F operator+(F a, F b) { return F{ _mm256_add_ps(a.v, b.v) }; }
+    inline F operator-(F a, F b) { return F{ _mm256_sub_ps(a.v, b.v) }; }
+    inline F operator*(F a, F b) { return F{ _mm256_mul_ps(a.v, b.v) }; }
+    inline F operator/(F a, F b) { return F{ _mm256_div_ps(a.v, b.v) }; }
+    // BC6HMath::Min/Max: minps/maxps return b for NaN lanes, which have to return a instead
+    inline F Min(F a, F b) { return F{ _mm256_blendv_ps(_mm256_min_ps(a.v, b.v), a.v, _mm256_cmp_ps(b.v, b.v, _CMP_UNORD_Q)) }; }
+    inline F Max(F a, F b) { return F{ _mm256_blendv_ps(_mm256_max_ps(a.v, b.v), a.v, _mm256_cmp_ps(b.v, b.v, _CMP_UNORD_Q)) }; }
+    inline F Floor(F a) { return F{ _mm256_floor_ps(a.v) }; }
+    inline F Sqrt(F a) { return F{ _mm256_sqrt_ps(a.v) }; }
+    inline F Abs(F a) { return F{ _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v) }; }
+
+    inline M operator==(F a, F b) { return M{ _mm256_cmp_ps(a.v, b.v, _CMP_EQ_OQ) }; }
+    inline M operator<(F a, F b) { return M{ _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ) }; }
+    inline M operator>(F a, F b) { return M{ _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ) }; }
+    inline M operator>=(F a, F b) { return M{ _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ) }; }
+    inline bool Any(M m) { return _mm256_movemask_ps(m.v) != 0; }
+    inline uint32_t LaneMask(M m) { return static_cast<uint32_t>(_mm256_movemask_ps(m.v)); }
+    inline F Select(M m, F a, F b) { return F{ _mm256_blendv_ps(b.v, a.v, m.v) }; }
+
+    inline I SetI(int32_t s) { return I{ _mm256_set1_epi32(s) }; }
+    inline I LoadI(const int32_t* p) { return I{ _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)) }; }
+    inline void StoreI(int32_t* p, I a) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), a.v); }
+    inline I operator+(I a, I b) { return I{ _mm256_add_epi32(a.v, b.v) }; }
+    inline I operator-(I a, I b) { return I{ _mm256_sub_epi32(a.v, b.v) }; }
+    inline I operator&(I a, I b) { return I{ _mm256_and_si256(a.v, b.v) }; }
+    inline I operator|(I a, I b) { return I{ _mm256_or_si256(a.v, b.v) }; }
+    inline I operator^(I a, I b) { return I{ _mm256_xor_si256(a.v, b.v) }; }
+    inline I operator<<(I a, uint32_t n) { return I{ _mm256_sll_epi32(a.v, _mm_cvtsi32_si128(static_cast<int>(n))) }; }
+    inline I operator>>(I a, uint32_t n) { return I{ _mm256_srl_epi32(a.v, _mm_cvtsi32_si128(static_cast<int>(n))) }; }
+    inline I operator*(I a, I b) { return I{ _mm256_mullo_epi32(a.v, b.v) }; }
+    inline I Sra(I a, uint32_t n) { return I{ _mm256_sra_epi32(a.v, _mm_cvtsi32_si128(static_cast<int>(n))) }; }
+    inline M operator==(I a, I b) { return M{ _mm256_castsi256_ps(_mm256_cmpeq_epi32(a.v, b.v)) }; }
+    inline M operator<(I a, I b) { return M{ _mm256_castsi256_ps(_mm256_cmpgt_epi32(b.v, a.v)) }; }
+    inline M operator>(I a, I b) { return M{ _mm256_castsi256_ps(_mm256_cmpgt_epi32(a.v, b.v)) }; }
+    inline I Select(M m, I a, I b) { return I{ _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(b.v), _mm256_castsi256_ps(a.v), m.v)) }; }
+
+    inline I AsI(F a) { return I{ _mm256_castps_si256(a.v) }; }
+    inline F AsF(I a) { return F{ _mm256_castsi256_ps(a.v) }; }
+    inline F ItoF(I a) { return F{ _mm256_cvtepi32_ps(a.v) }; }
+    inline I FtoI(F a) { return I{ _mm256_cvttps_epi32(a.v) }; }
+
+    #include "BC6HEncoderSIMD.inl"
+    #include "BC6HDecoderSIMD.inl"
+    #include "BC6HMetricsSIMD.inl"
+  }
+}
+
+uint32_t BC6HEncoderSIMD::EncodeBlocksAVX2(const float* texels, uint32_t effort, float p2Threshold, uint32_t* blocks)
+{
+  switch (effort)
+  {
+  case 0: return AVX2::EncodeBlocks<0>(texels, p2Threshold, blocks);
+  case 1: return AVX2::EncodeBlocks<1>(texels, p2Threshold, blocks);
+  case 2: return AVX2::EncodeBlocks<2>(texels, p2Threshold, blocks);
+  case 3: return AVX2::EncodeBlocks<3>(texels, p2Threshold, blocks);
+  case 4: return AVX2::EncodeBlocks<4>(texels, p2Threshold, blocks);
+  default: return AVX2::EncodeBlocks<5>(texels, p2Threshold, blocks);
+  }
+}
+
+void BC6HDecoderSIMD::DecodeBlocksAVX2(const int32_t* endpoints, const int32_t* subsets, const int32_t* weights, bool isSigned, bool toFloat, uint32_t* texels)
+{
+  AVX2::DecodeBlocks(endpoints, subsets, weights, isSigned, toFloat, texels);
+}
+
+void BC6HMetricsSIMD::MeasureBlocksAVX2(const float* source, const int32_t* decoded, float* errors)
+{
+  AVX2::MeasureBlocks(source, decoded, errors);
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#endif
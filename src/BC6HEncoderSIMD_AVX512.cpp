@@ -0,0 +1,111 @@
+#include "BC6HEncoderSIMD.h"
+#include "BC6HDecoderSIMD.h"
+#include "BC6HMetricsSIMD.h"
+#include "BC6HEffort.h"
+
+#include <math.h>
+
+#if BC6H_SIMD_X86
+
+// AVX-512 implies FMA, fused multiply-adds would round differently than the scalar port
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx512f"))), apply_to = function)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+#include <immintrin.h>
+
+namespace
+{
+  namespace AVX512
+  {
+    const uint32_t LANES = 16;
+
+    struct F { __m512 v; };
+    struct I { __m512i v; };
+    struct M { __mmask16 v; };
+
+    inline F Load(const float* p) { return F{ _mm512_loadu_ps(p) }; }
+    inline void Store(float* p, F a) { _mm512_storeu_ps(p, a.v); }
+    inline F Set(float s) { return F{ _mm512_set1_ps(s) }; }
+    inline F operator+(F a, F b) { return F{ _mm512_add_ps(a.v, b.v) }; }
+    inline F operator-(F a, F b) { return F{ _mm512_sub_ps(a.v, b.v) }; }
+    inline F operator*(F a, F b) { return F{ _mm512_mul_ps(a.v, b.v) }; }
+    inline F operator/(F a, F b) { return F{ _mm512_div_ps(a.v, b.v) }; }
+    // BC6HMath::Min/Max: minps/maxps return b for NaN lanes, which have to return a instead
+    inline F Min(F a, F b) { return F{ _mm512_mask_blend_ps(_mm512_cmp_ps_mask(b.v, b.v, _CMP_UNORD_Q), _mm512_min_ps(a.v, b.v), a.v) }; }
+    inline F Max(F a, F b) { return F{ _mm512_mask_blend_ps(_mm512_cmp_ps_mask(b.v, b.v, _CMP_UNORD_Q), _mm512_max_ps(a.v, b.v), a.v) }; }
+    inline F Floor(F a) { return F{ _mm512_roundscale_ps(a.v, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC) }; }
+    inline F Sqrt(F a) { return F{ _mm512_sqrt_ps(a.v) }; }
+    inline F Abs(F a) { return F{ _mm512_castsi512_ps(_mm512_and_si512(_mm512_castps_si512(a.v), _mm512_set1_epi32(0x7FFFFFFF))) }; }
+
+    inline M operator==(F a, F b) { return M{ _mm512_cmp_ps_mask(a.v, b.v, _CMP_EQ_OQ) }; }
+    inline M operator<(F a, F b) { return M{ _mm512_cmp_ps_mask(a.v, b.v, _CMP_LT_OQ) }; }
+    inline M operator>(F a, F b) { return M{ _mm512_cmp_ps_mask(a.v, b.v, _CMP_GT_OQ) }; }
+    inline M operator>=(F a, F b) { return M{ _mm512_cmp_ps_mask(a.v, b.v, _CMP_GE_OQ) }; }
+    inline bool Any(M m) { return m.v != 0; }
+    inline uint32_t LaneMask(M m) { return static_cast<uint32_t>(m.v); }
+    inline F Select(M m, F a, F b) { return F{ _mm512_mask_blend_ps(m.v, b.v, a.v) }; }
+
+    inline I SetI(int32_t s) { return I{ _mm512_set1_epi32(s) }; }
+    inline I LoadI(const int32_t* p) { return I{ _mm512_loadu_si512(p) }; }
+    inline void StoreI(int32_t* p, I a) { _mm512_storeu_si512(p, a.v); }
+    inline I operator+(I a, I b) { return I{ _mm512_add_epi32(a.v, b.v) }; }
+    inline I operator-(I a, I b) { return I{ _mm512_sub_epi32(a.v, b.v) }; }
+    inline I operator&(I a, I b) { return I{ _mm512_and_si512(a.v, b.v) }; }
+    inline I operator|(I a, I b) { return I{ _mm512_or_si512(a.v, b.v) }; }
+    inline I operator^(I a, I b) { return I{ _mm512_xor_si512(a.v, b.v) }; }
+    inline I operator<<(I a, uint32_t n) { return I{ _mm512_sll_epi32(a.v, _mm_cvtsi32_si128(static_cast<int>(n))) }; }
+    inline I operator>>(I a, uint32_t n) { return I{ _mm512_srl_epi32(a.v, _mm_cvtsi32_si128(static_cast<int>(n))) }; }
+    inline I operator*(I a, I b) { return I{ _mm512_mullo_epi32(a.v, b.v) }; }
+    inline I Sra(I a, uint32_t n) { return I{ _mm512_sra_epi32(a.v, _mm_cvtsi32_si128(static_cast<int>(n))) }; }
+    inline M operator==(I a, I b) { return M{ _mm512_cmpeq_epi32_mask(a.v, b.v) }; }
+    inline M operator<(I a, I b) { return M{ _mm512_cmplt_epi32_mask(a.v, b.v) }; }
+    inline M operator>(I a, I b) { return M{ _mm512_cmpgt_epi32_mask(a.v, b.v) }; }
+    inline I Select(M m, I a, I b) { return I{ _mm512_mask_blend_epi32(m.v, b.v, a.v) }; }
+
+    inline I AsI(F a) { return I{ _mm512_castps_si512(a.v) }; }
+    inline F AsF(I a) { return F{ _mm512_castsi512_ps(a.v) }; }
+    inline F ItoF(I a) { return F{ _mm512_cvtepi32_ps(a.v) }; }
+    inline I FtoI(F a) { return I{ _mm512_cvttps_epi32(a.v) }; }
+
+    #include "BC6HEncoderSIMD.inl"
+    #include "BC6HDecoderSIMD.inl"
+    #include "BC6HMetricsSIMD.inl"
+  }
+}
+
+uint32_t BC6HEncoderSIMD::EncodeBlocksAVX512(const float* texels, uint32_t effort, float p2Threshold, uint32_t* blocks)
+{
+  switch (effort)
+  {
+  case 0: return AVX512::EncodeBlocks<0>(texels, p2Threshold, blocks);
+  case 1: return AVX512::EncodeBlocks<1>(texels, p2Threshold, blocks);
+  case 2: return AVX512::EncodeBlocks<2>(texels, p2Threshold, blocks);
+  case 3: return AVX512::EncodeBlocks<3>(texels, p2Threshold, blocks);
+  case 4: return AVX512::EncodeBlocks<4>(texels, p2Threshold, blocks);
+  default: return AVX512::EncodeBlocks<5>(texels, p2Threshold, blocks);
+  }
+}
+
+void BC6HDecoderSIMD::DecodeBlocksAVX512(const int32_t* endpoints, const int32_t* subsets, const int32_t* weights, bool isSigned, bool toFloat, uint32_t* texels)
+{
+  AVX512::DecodeBlocks(endpoints, subsets, weights, isSigned, toFloat, texels);
+}
+
+void BC6HMetricsSIMD::MeasureBlocksAVX512(const float* source, const int32_t* decoded, float* errors)
+{
+  AVX512::MeasureBlocks(source, decoded, errors);
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#endif
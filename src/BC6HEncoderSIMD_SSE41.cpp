@@ -0,0 +1,108 @@
+#include "BC6HEncoderSIMD.h"
+#include "BC6HDecoderSIMD.h"
+#include "BC6HMetricsSIMD.h"
+#include "BC6HEffort.h"
+
+#include <math.h>
+
+#if BC6H_SIMD_X86
+
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("sse4.1"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("sse4.1")
+#endif
+
+#include <smmintrin.h>
+
+namespace
+{
+  namespace SSE41
+  {
+    const uint32_t LANES = 4;
+
+    struct F { __m128 v; };
+    struct I { __m128i v; };
+    struct M { __m128 v; };
+
+    inline F Load(const float* p) { return F{ _mm_loadu_ps(p) }; }
+    inline void Store(float* p, F a) { _mm_storeu_ps(p, a.v); }
+    inline F Set(float s) { return F{ _mm_set1_ps(s) }; }
+    inline F operator+(F a, F b) { return F{ _mm_add_ps(a.v, b.v) }; }
+    inline F operator-(F a, F b) { return F{ _mm_sub_ps(a.v, b.v) }; }
+    inline F operator*(F a, F b) { return F{ _mm_mul_ps(a.v, b.v) }; }
+    inline F operator/(F a, F b) { return F{ _mm_div_ps(a.v, b.v) }; }
+    // BC6HMath::Min/Max: minps/maxps return b for NaN lanes, which have to return a instead
+    inline F Min(F a, F b) { return F{ _mm_blendv_ps(_mm_min_ps(a.v, b.v), a.v, _mm_cmpunord_ps(b.v, b.v)) }; }
+    inline F Max(F a, F b) { return F{ _mm_blendv_ps(_mm_max_ps(a.v, b.v), a.v, _mm_cmpunord_ps(b.v, b.v)) }; }
+    inline F Floor(F a) { return F{ _mm_floor_ps(a.v) }; }
+    inline F Sqrt(F a) { return F{ _mm_sqrt_ps(a.v) }; }
+    inline F Abs(F a) { return F{ _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v) }; }
+
+    inline M operator==(F a, F b) { return M{ _mm_cmpeq_ps(a.v, b.v) }; }
+    inline M operator<(F a, F b) { return M{ _mm_cmplt_ps(a.v, b.v) }; }
+    inline M operator>(F a, F b) { return M{ _mm_cmpgt_ps(a.v, b.v) }; }
+    inline M operator>=(F a, F b) { return M{ _mm_cmpge_ps(a.v, b.v) }; }
+    inline bool Any(M m) { return _mm_movemask_ps(m.v) != 0; }
+    inline uint32_t LaneMask(M m) { return static_cast<uint32_t>(_mm_movemask_ps(m.v)); }
+    inline F Select(M m, F a, F b) { return F{ _mm_blendv_ps(b.v, a.v, m.v) }; }
+
+    inline I SetI(int32_t s) { return I{ _mm_set1_epi32(s) }; }
+    inline I LoadI(const int32_t* p) { return I{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)) }; }
+    inline void StoreI(int32_t* p, I a) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), a.v); }
+    inline I operator+(I a, I b) { return I{ _mm_add_epi32(a.v, b.v) }; }
+    inline I operator-(I a, I b) { return I{ _mm_sub_epi32(a.v, b.v) }; }
+    inline I operator&(I a, I b) { return I{ _mm_and_si128(a.v, b.v) }; }
+    inline I operator|(I a, I b) { return I{ _mm_or_si128(a.v, b.v) }; }
+    inline I operator^(I a, I b) { return I{ _mm_xor_si128(a.v, b.v) }; }
+    inline I operator<<(I a, uint32_t n) { return I{ _mm_sll_epi32(a.v, _mm_cvtsi32_si128(static_cast<int>(n))) }; }
+    inline I operator>>(I a, uint32_t n) { return I{ _mm_srl_epi32(a.v, _mm_cvtsi32_si128(static_cast<int>(n))) }; }
+    inline I operator*(I a, I b) { return I{ _mm_mullo_epi32(a.v, b.v) }; }
+    inline I Sra(I a, uint32_t n) { return I{ _mm_sra_epi32(a.v, _mm_cvtsi32_si128(static_cast<int>(n))) }; }
+    inline M operator==(I a, I b) { return M{ _mm_castsi128_ps(_mm_cmpeq_epi32(a.v, b.v)) }; }
+    inline M operator<(I a, I b) { return M{ _mm_castsi128_ps(_mm_cmplt_epi32(a.v, b.v)) }; }
+    inline M operator>(I a, I b) { return M{ _mm_castsi128_ps(_mm_cmpgt_epi32(a.v, b.v)) }; }
+    inline I Select(M m, I a, I b) { return I{ _mm_castps_si128(_mm_blendv_ps(_mm_castsi128_ps(b.v), _mm_castsi128_ps(a.v), m.v)) }; }
+
+    inline I AsI(F a) { return I{ _mm_castps_si128(a.v) }; }
+    inline F AsF(I a) { return F{ _mm_castsi128_ps(a.v) }; }
+    inline F ItoF(I a) { return F{ _mm_cvtepi32_ps(a.v) }; }
+    inline I FtoI(F a) { return I{ _mm_cvttps_epi32(a.v) }; }
+
+    #include "BC6HEncoderSIMD.inl"
+    #include "BC6HDecoderSIMD.inl"
+    #include "BC6HMetricsSIMD.inl"
+  }
+}
+
+uint32_t BC6HEncoderSIMD::EncodeBlocksSSE41(const float* texels, uint32_t effort, float p2Threshold, uint32_t* blocks)
+{
+  switch (effort)
+  {
+  case 0: return SSE41::EncodeBlocks<0>(texels, p2Threshold, blocks);
+  case 1: return SSE41::EncodeBlocks<1>(texels, p2Threshold, blocks);
+  case 2: return SSE41::EncodeBlocks<2>(texels, p2Threshold, blocks);
+  case 3: return SSE41::EncodeBlocks<3>(texels, p2Threshold, blocks);
+  case 4: return SSE41::EncodeBlocks<4>(texels, p2Threshold, blocks);
+  default: return SSE41::EncodeBlocks<5>(texels, p2Threshold, blocks);
+  }
+}
+
+void BC6HDecoderSIMD::DecodeBlocksSSE41(const int32_t* endpoints, const int32_t* subsets, const int32_t* weights, bool isSigned, bool toFloat, uint32_t* texels)
+{
+  SSE41::DecodeBlocks(endpoints, subsets, weights, isSigned, toFloat, texels);
+}
+
+void BC6HMetricsSIMD::MeasureBlocksSSE41(const float* source, const int32_t* decoded, float* errors)
+{
+  SSE41::MeasureBlocks(source, decoded, errors);
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#endif
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+// Scalar helpers shared by the CPU encoder paths.
+// The SIMD kernels in BC6HEncoderSIMD.inl repeat these operation for operation,
+// so scalar and vector encodes produce identical blocks.
+namespace BC6HMath
+{
+  inline uint32_t AsUint(float f)
+  {
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    return u;
+  }
+
+  inline float AsFloat(uint32_t u)
+  {
+    float f;
+    memcpy(&f, &u, sizeof(f));
+    return f;
+  }
+
+  // HLSL min/max return the non-NaN operand, like fminf/fmaxf. Equal operands (+0 and -0) give b, which is
+  // what minps/maxps return, so the SIMD Min/Max only have to add the NaN b case to match bit for bit.
+  inline float Min(float a, float b) { return a < b || b != b ? a : b; }
+  inline float Max(float a, float b) { return a > b || b != b ? a : b; }
+
+  // Round to nearest even, https://gist.github.com/rygorous/2156668. NaNs lose their sign, which x86 leaves
+  // to the operand order the compiler picked, so they always convert to 0x7E00.
+  inline uint32_t F32ToF16(float x)
+  {
+    const uint32_t f32Infinity = 255 << 23;
+    const uint32_t f16Max = (127 + 16) << 23;
+    const uint32_t denormMagic = ((127 - 15) + (23 - 10) + 1) << 23;
+
+    uint32_t u = AsUint(x);
+    uint32_t sign = u & 0x80000000;
+    u ^= sign;
+
+    uint32_t h;
+    if (u > f32Infinity)
+    {
+      return 0x7E00;
+    }
+    else if (u >= f16Max)
+    {
+      h = 0x7C00;
+    }
+    else if (u < (113 << 23))
+    {
+      h = AsUint(AsFloat(u) + AsFloat(denormMagic)) - denormMagic;
+    }
+    else
+    {
+      uint32_t mantissaOdd = (u >> 13) & 1;
+      u -= (127 - 15) << 23;
+      u += 0xFFF;
+      u += mantissaOdd;
+      h = u >> 13;
+    }
+
+    return h | (sign >> 16);
+  }
+
+  // https://gist.github.com/rygorous/2144712
+  inline float F16ToF32(uint32_t x)
+  {
+    const float magic = AsFloat((254 - 15) << 23);
+    const float wasInfNaN = AsFloat((127 + 16) << 23);
+
+    uint32_t h = x & 0xFFFF;
+    float o = AsFloat((h & 0x7FFF) << 13);
+    o *= magic;
+    if (o >= wasInfNaN)
+      o = AsFloat(AsUint(o) | (255 << 23));
+    return AsFloat(AsUint(o) | ((h & 0x8000) << 16));
+  }
+
+  // log2 for positive normal floats, cephes logf polynomial (~1 ulp)
+  inline float Log2(float x)
+  {
+    uint32_t u = AsUint(x);
+    int32_t e = static_cast<int32_t>((u >> 23) & 0xFF) - 127;
+    float m = AsFloat((u & 0x007FFFFF) | 0x3F800000);
+    if (m > 1.41421356f)
+    {
+      m *= 0.5f;
+      e += 1;
+    }
+
+    float f = m - 1.0f;
+    float z = f * f;
+    float y = 7.0376836292e-2f;
+    y = y * f - 1.1514610310e-1f;
+    y = y * f + 1.1676998740e-1f;
+    y = y * f - 1.2420140846e-1f;
+    y = y * f + 1.4249322787e-1f;
+    y = y * f - 1.6668057665e-1f;
+    y = y * f + 2.0000714765e-1f;
+    y = y * f - 2.4999993993e-1f;
+    y = y * f + 3.3333331174e-1f;
+    y = y * f * z;
+    y = y - 0.5f * z;
+
+    float ln = f + y;
+    return ln * 1.44269504f + static_cast<float>(e);
+  }
+
+  // exp2 for x in [-126, 127], cephes exp2f polynomial (~2 ulp)
+  inline float Exp2(float x)
+  {
+    x = Min(Max(x, -126.0f), 127.0f);
+    float i = floorf(x + 0.5f);
+    float f = x - i;
+
+    float p = 1.535336188319500e-4f;
+    p = p * f + 1.339887440266574e-3f;
+    p = p * f + 9.618437357674640e-3f;
+    p = p * f + 5.550332471162809e-2f;
+    p = p * f + 2.402264791363012e-1f;
+    p = p * f + 6.931472028550421e-1f;
+    p = p * f + 1.0f;
+
+    return p * AsFloat(static_cast<uint32_t>(static_cast<int32_t>(i) + 127) << 23);
+  }
+}
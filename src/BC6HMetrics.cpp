@@ -0,0 +1,191 @@
+#include "BC6HMetrics.h"
+#include "BC6HMetricsSIMD.h"
+#include "BC6HDecoderCPU.h"
+#include "BC6HEncoderCPU.h"
+#include "BC6HMath.h"
+#include "ThreadPool.h"
+
+#include <math.h>
+#include <vector>
+
+namespace
+{
+  const uint32_t BLOCK_SIZE = 4;
+  const uint32_t BLOCK_BYTES = 16;
+  const float HALF_MAX = 65504.0f;
+
+  // Sums are in log2, scale them to ln as in the original RMSLE definition
+  const double LN2_SQ = 0.69314718055994530942 * 0.69314718055994530942;
+
+  enum ErrorSum
+  {
+    LOG_R,
+    LOG_G,
+    LOG_B,
+    LINEAR,
+    SOURCE_MAX,
+    ERROR_SUM_NUM,
+  };
+
+  struct SRowSums
+  {
+    double m_logErrorSq[3];
+    double m_linearErrorSq;
+    float m_sourceMax;
+  };
+
+  float clamp(float x, float a, float b) { return fminf(fmaxf(x, a), b); }
+
+  // Scalar version of BC6HMetricsSIMD.inl
+  void MeasureBlock(const float source[16][3], const int32_t decoded[16][3], float errors[ERROR_SUM_NUM])
+  {
+    float logErrorSq[3] = { 0.0f, 0.0f, 0.0f };
+    float linearErrorSq = 0.0f;
+    float sourceMax = 0.0f;
+
+    for (uint32_t i = 0; i < 16; ++i)
+    {
+      for (uint32_t c = 0; c < 3; ++c)
+      {
+        float a = clamp(source[i][c], 0.0f, HALF_MAX);
+        float b = clamp(BC6HMath::F16ToF32(static_cast<uint32_t>(decoded[i][c])), 0.0f, HALF_MAX);
+
+        float logDelta = BC6HMath::Log2(a + 1.0f) - BC6HMath::Log2(b + 1.0f);
+        logErrorSq[c] = logErrorSq[c] + logDelta * logDelta;
+
+        float delta = a - b;
+        linearErrorSq = linearErrorSq + delta * delta;
+        sourceMax = fmaxf(sourceMax, a);
+      }
+    }
+
+    errors[LOG_R] = logErrorSq[0];
+    errors[LOG_G] = logErrorSq[1];
+    errors[LOG_B] = logErrorSq[2];
+    errors[LINEAR] = linearErrorSq;
+    errors[SOURCE_MAX] = sourceMax;
+  }
+
+  // Decoded texels outside of the image are zeroed, so they match the zero border of GatherBlock
+  void DecodeBlock(const uint8_t* block, bool isSigned, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY, int32_t decoded[16][3])
+  {
+    uint16_t texels[16][4];
+    BC6HDecoderCPU::DecodeBlock(block, isSigned, texels);
+    for (uint32_t i = 0; i < 16; ++i)
+    {
+      bool inside = blockX * BLOCK_SIZE + i % BLOCK_SIZE < width && blockY * BLOCK_SIZE + i / BLOCK_SIZE < height;
+      for (uint32_t c = 0; c < 3; ++c)
+        decoded[i][c] = inside ? texels[i][c] : 0;
+    }
+  }
+}
+
+void BC6HMetrics::MeasureImage(const uint8_t* texels, BC6HEncoderCPU::TexelFormat format, uint32_t rowPitch, uint32_t width, uint32_t height, const uint8_t* blocks, bool isSigned, BC6HEncoderSIMD::ISA isa, ThreadPool* pool, SResult& result, float* blockMSLE)
+{
+  uint32_t widthInBlocks = (width + BLOCK_SIZE - 1) / BLOCK_SIZE;
+  uint32_t heightInBlocks = (height + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+  BC6HMetricsSIMD::MeasureBlocksFunc measureBlocks = BC6HMetricsSIMD::GetMeasureBlocks(isa);
+  uint32_t laneNum = measureBlocks ? BC6HEncoderSIMD::GetLaneNum(isa) : 1;
+
+  // Per row partial sums, reduced in order afterwards so the result doesn't depend on scheduling
+  std::vector<SRowSums> rowSums(heightInBlocks);
+
+  auto measureRow = [&](uint32_t blockY)
+  {
+    const uint8_t* srcRow = blocks + static_cast<size_t>(blockY) * widthInBlocks * BLOCK_BYTES;
+    SRowSums& sums = rowSums[blockY];
+    sums = SRowSums();
+
+    auto addBlock = [&](uint32_t blockX, const float* errors, uint32_t stride)
+    {
+      for (uint32_t c = 0; c < 3; ++c)
+        sums.m_logErrorSq[c] += errors[c * stride];
+      sums.m_linearErrorSq += errors[LINEAR * stride];
+      sums.m_sourceMax = fmaxf(sums.m_sourceMax, errors[SOURCE_MAX * stride]);
+
+      if (blockMSLE)
+      {
+        uint32_t blockWidth = width - blockX * BLOCK_SIZE < BLOCK_SIZE ? width - blockX * BLOCK_SIZE : BLOCK_SIZE;
+        uint32_t blockHeight = height - blockY * BLOCK_SIZE < BLOCK_SIZE ? height - blockY * BLOCK_SIZE : BLOCK_SIZE;
+        double lumErrorSq = 0.299 * errors[LOG_R * stride] + 0.587 * errors[LOG_G * stride] + 0.114 * errors[LOG_B * stride];
+        blockMSLE[blockY * widthInBlocks + blockX] = static_cast<float>(lumErrorSq * LN2_SQ / (blockWidth * blockHeight));
+      }
+    };
+
+    if (!measureBlocks)
+    {
+      for (uint32_t blockX = 0; blockX < widthInBlocks; ++blockX)
+      {
+        float source[16][3];
+        int32_t decoded[16][3];
+        BC6HEncoderCPU::GatherBlock(texels, format, rowPitch, width, height, blockX, blockY, BC6HEncoderCPU::Addressing::Border, source);
+        DecodeBlock(srcRow + blockX * BLOCK_BYTES, isSigned, width, height, blockX, blockY, decoded);
+
+        float errors[ERROR_SUM_NUM];
+        MeasureBlock(source, decoded, errors);
+        addBlock(blockX, errors, 1);
+      }
+      return;
+    }
+
+    // Structure of arrays for up to 16 lanes, the last group is padded with copies of its last block
+    float sourceSoA[16 * 3 * 16];
+    int32_t decodedSoA[16 * 3 * 16];
+    float errorsSoA[ERROR_SUM_NUM * 16];
+    for (uint32_t groupX = 0; groupX < widthInBlocks; groupX += laneNum)
+    {
+      uint32_t groupSize = widthInBlocks - groupX < laneNum ? widthInBlocks - groupX : laneNum;
+      for (uint32_t lane = 0; lane < laneNum; ++lane)
+      {
+        uint32_t blockX = groupX + (lane < groupSize ? lane : groupSize - 1);
+        float source[16][3];
+        int32_t decoded[16][3];
+        BC6HEncoderCPU::GatherBlock(texels, format, rowPitch, width, height, blockX, blockY, BC6HEncoderCPU::Addressing::Border, source);
+        DecodeBlock(srcRow + blockX * BLOCK_BYTES, isSigned, width, height, blockX, blockY, decoded);
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+          for (uint32_t c = 0; c < 3; ++c)
+          {
+            sourceSoA[(i * 3 + c) * laneNum + lane] = source[i][c];
+            decodedSoA[(i * 3 + c) * laneNum + lane] = decoded[i][c];
+          }
+        }
+      }
+
+      measureBlocks(sourceSoA, decodedSoA, errorsSoA);
+      for (uint32_t lane = 0; lane < groupSize; ++lane)
+        addBlock(groupX + lane, errorsSoA + lane, laneNum);
+    }
+  };
+
+  if (pool)
+  {
+    pool->ParallelFor(heightInBlocks, measureRow);
+  }
+  else
+  {
+    for (uint32_t blockY = 0; blockY < heightInBlocks; ++blockY)
+      measureRow(blockY);
+  }
+
+  SRowSums total = SRowSums();
+  for (const SRowSums& sums : rowSums)
+  {
+    for (uint32_t c = 0; c < 3; ++c)
+      total.m_logErrorSq[c] += sums.m_logErrorSq[c];
+    total.m_linearErrorSq += sums.m_linearErrorSq;
+    total.m_sourceMax = fmaxf(total.m_sourceMax, sums.m_sourceMax);
+  }
+
+  double texelNum = static_cast<double>(width) * height;
+  double rSum = total.m_logErrorSq[0] * LN2_SQ;
+  double gSum = total.m_logErrorSq[1] * LN2_SQ;
+  double bSum = total.m_logErrorSq[2] * LN2_SQ;
+  result.m_rgbRMSLE = static_cast<float>(sqrt((rSum + gSum + bSum) / (3.0 * texelNum)));
+  result.m_lumRMSLE = static_cast<float>(sqrt((0.299 * rSum + 0.587 * gSum + 0.114 * bSum) / texelNum));
+
+  double mse = total.m_linearErrorSq / (3.0 * texelNum);
+  double peak = total.m_sourceMax;
+  result.m_psnr = mse > 0.0 ? static_cast<float>(10.0 * log10(peak * peak / mse)) : INFINITY;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdint.h>
+#include "BC6HEncoderCPU.h"
+#include "BC6HEncoderSIMD.h"
+
+class ThreadPool;
+
+// Compression error of a BC6H image against its source, in any of the encoder texel formats.
+// Blocks are decoded and compared one block row at a time, so no decoded copy of the image is made.
+namespace BC6HMetrics
+{
+  struct SResult
+  {
+    // Root mean square error of ln(x + 1), over all channels and luminance weighted (0.299, 0.587, 0.114)
+    float m_rgbRMSLE;
+    float m_lumRMSLE;
+    // Linear RGB PSNR with the brightest source channel as peak, infinite for a lossless result
+    float m_psnr;
+  };
+
+  // blockMSLE is optional, it receives the luminance weighted MSLE of every block (widthInBlocks * heightInBlocks)
+  void MeasureImage(const uint8_t* texels, BC6HEncoderCPU::TexelFormat format, uint32_t rowPitch, uint32_t width, uint32_t height, const uint8_t* blocks, bool isSigned, BC6HEncoderSIMD::ISA isa, ThreadPool* pool, SResult& result, float* blockMSLE);
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdint.h>
+#include "BC6HEncoderSIMD.h"
+
+// Lane-wide error sums of BC6HMetrics, one block per lane.
+// Built into the same per ISA translation units as the encoder kernels.
+namespace BC6HMetricsSIMD
+{
+  // source: [16][3][laneNum] floats, decoded: [16][3][laneNum] half bits
+  // errors: [5][laneNum], squared log2 differences of r, g and b, squared linear difference and the source max
+  typedef void (*MeasureBlocksFunc)(const float* source, const int32_t* decoded, float* errors);
+
+  // Returns nullptr for ISA::Scalar
+  MeasureBlocksFunc GetMeasureBlocks(BC6HEncoderSIMD::ISA isa);
+
+#if BC6H_SIMD_X86
+  void MeasureBlocksSSE41(const float* source, const int32_t* decoded, float* errors);
+  void MeasureBlocksAVX2(const float* source, const int32_t* decoded, float* errors);
+  void MeasureBlocksAVX512(const float* source, const int32_t* decoded, float* errors);
+#endif
+}
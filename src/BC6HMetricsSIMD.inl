@@ -0,0 +1,34 @@
+// Lane-wide version of the BC6HMetrics block error sums, every lane measures one block.
+// Included by the per ISA translation units after BC6HEncoderSIMD.inl, which provides Log2 and F16ToF32.
+// Operations mirror BC6HMetrics.cpp one to one, so both produce identical sums.
+
+// source: [16][3][LANES], decoded: [16][3][LANES], errors: [5][LANES]
+inline void MeasureBlocks(const float* source, const int32_t* decoded, float* errors)
+{
+  F logErrorSq[3] = { Set(0.0f), Set(0.0f), Set(0.0f) };
+  F linearErrorSq = Set(0.0f);
+  F sourceMax = Set(0.0f);
+
+  for (uint32_t i = 0; i < 16; ++i)
+  {
+    for (uint32_t c = 0; c < 3; ++c)
+    {
+      uint32_t offset = (i * 3 + c) * LANES;
+      F a = Clamp(Load(source + offset), 0.0f, HALF_MAX);
+      F b = Clamp(F16ToF32(LoadI(decoded + offset)), 0.0f, HALF_MAX);
+
+      F logDelta = Log2(a + 1.0f) - Log2(b + 1.0f);
+      logErrorSq[c] = logErrorSq[c] + logDelta * logDelta;
+
+      F delta = a - b;
+      linearErrorSq = linearErrorSq + delta * delta;
+      sourceMax = Max(sourceMax, a);
+    }
+  }
+
+  Store(errors + 0 * LANES, logErrorSq[0]);
+  Store(errors + 1 * LANES, logErrorSq[1]);
+  Store(errors + 2 * LANES, logErrorSq[2]);
+  Store(errors + 3 * LANES, linearErrorSq);
+  Store(errors + 4 * LANES, sourceMax);
+}
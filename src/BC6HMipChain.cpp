@@ -0,0 +1,112 @@
+#include "BC6HMipChain.h"
+#include "ThreadPool.h"
+
+#include <vector>
+
+namespace
+{
+  struct STaps
+  {
+    uint32_t m_index[3];
+    float m_weight[3];
+  };
+
+  // Source taps of every destination texel along one axis
+  std::vector<STaps> ComputeTaps(uint32_t srcSize)
+  {
+    uint32_t dstSize = BC6HMipChain::GetLevelSize(srcSize, 1);
+    std::vector<STaps> taps(dstSize);
+    for (uint32_t i = 0; i < dstSize; ++i)
+    {
+      STaps& t = taps[i];
+      for (uint32_t j = 0; j < 3; ++j)
+      {
+        uint32_t index = 2 * i + j;
+        t.m_index[j] = index < srcSize ? index : srcSize - 1;
+      }
+
+      if (srcSize == 1)
+      {
+        t.m_weight[0] = 1.0f;
+        t.m_weight[1] = 0.0f;
+        t.m_weight[2] = 0.0f;
+      }
+      else if (srcSize % 2 == 0)
+      {
+        t.m_weight[0] = 0.5f;
+        t.m_weight[1] = 0.5f;
+        t.m_weight[2] = 0.0f;
+      }
+      else
+      {
+        // Every destination texel covers (2 * dstSize + 1) / dstSize source texels
+        float norm = 1.0f / (2 * dstSize + 1);
+        t.m_weight[0] = (dstSize - i) * norm;
+        t.m_weight[1] = dstSize * norm;
+        t.m_weight[2] = (i + 1) * norm;
+      }
+    }
+    return taps;
+  }
+}
+
+uint32_t BC6HMipChain::GetLevelNum(uint32_t width, uint32_t height)
+{
+  uint32_t size = width > height ? width : height;
+  uint32_t levelNum = 1;
+  while (size > 1)
+  {
+    size >>= 1;
+    ++levelNum;
+  }
+  return levelNum;
+}
+
+void BC6HMipChain::Downsample(const float* src, uint32_t srcWidth, uint32_t srcHeight, ThreadPool* pool, float* dst)
+{
+  uint32_t dstWidth = GetLevelSize(srcWidth, 1);
+  uint32_t dstHeight = GetLevelSize(srcHeight, 1);
+  std::vector<STaps> tapsX = ComputeTaps(srcWidth);
+  std::vector<STaps> tapsY = ComputeTaps(srcHeight);
+
+  auto downsampleRow = [&](uint32_t y)
+  {
+    const STaps& ty = tapsY[y];
+    float* dstRow = dst + static_cast<size_t>(y) * dstWidth * 4;
+    for (uint32_t x = 0; x < dstWidth; ++x)
+    {
+      const STaps& tx = tapsX[x];
+      float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+      for (uint32_t j = 0; j < 3; ++j)
+      {
+        if (ty.m_weight[j] == 0.0f)
+          continue;
+
+        const float* srcRow = src + static_cast<size_t>(ty.m_index[j]) * srcWidth * 4;
+        for (uint32_t i = 0; i < 3; ++i)
+        {
+          float weight = ty.m_weight[j] * tx.m_weight[i];
+          if (weight == 0.0f)
+            continue;
+
+          const float* texel = srcRow + tx.m_index[i] * 4;
+          for (uint32_t c = 0; c < 4; ++c)
+            sum[c] += weight * texel[c];
+        }
+      }
+
+      for (uint32_t c = 0; c < 4; ++c)
+        dstRow[x * 4 + c] = sum[c];
+    }
+  };
+
+  if (pool)
+  {
+    pool->ParallelFor(dstHeight, downsampleRow);
+  }
+  else
+  {
+    for (uint32_t y = 0; y < dstHeight; ++y)
+      downsampleRow(y);
+  }
+}
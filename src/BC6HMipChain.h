@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stdint.h>
+
+class ThreadPool;
+
+// HDR mip chain generation for CompressMipChain.
+// Level sizes follow D3D: max(1, size >> level). Filtering is done in linear space on all four channels.
+namespace BC6HMipChain
+{
+  // Number of levels of the full chain down to 1x1
+  uint32_t GetLevelNum(uint32_t width, uint32_t height);
+
+  inline uint32_t GetLevelSize(uint32_t size, uint32_t level)
+  {
+    return size >> level > 0 ? size >> level : 1;
+  }
+
+  // Builds the next level of a tightly packed RGBA32F image, one row per task.
+  // Even sizes use a 2 tap box filter, odd sizes a 3 tap polyphase box, so the last row and column
+  // still contribute their share and the average brightness of the level is preserved.
+  void Downsample(const float* src, uint32_t srcWidth, uint32_t srcHeight, ThreadPool* pool, float* dst);
+}
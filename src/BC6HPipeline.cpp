@@ -0,0 +1,76 @@
+#include "BC6HPipeline.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+bool BC6HPipeline::Run(uint32_t itemNum, uint32_t slotNum, const SStages& stages)
+{
+  if (slotNum == 0)
+    slotNum = 1;
+
+  // Items done by each stage. Every item flag is written by one stage at a time, the counter
+  // update under the mutex hands it over to the next one.
+  std::mutex mutex;
+  std::condition_variable progressCV;
+  uint32_t preparedNum = 0;
+  uint32_t encodedNum = 0;
+  uint32_t finishedNum = 0;
+  std::vector<uint8_t> itemOK(itemNum, 1);
+
+  auto waitFor = [&](const uint32_t& doneNum, uint32_t count)
+  {
+    std::unique_lock<std::mutex> lk(mutex);
+    progressCV.wait(lk, [&] { return doneNum >= count; });
+  };
+  auto advance = [&](uint32_t& doneNum)
+  {
+    {
+      std::lock_guard<std::mutex> lk(mutex);
+      ++doneNum;
+    }
+    progressCV.notify_all();
+  };
+
+  std::thread prepareThread([&]
+  {
+    for (uint32_t i = 0; i < itemNum; ++i)
+    {
+      if (i >= slotNum)
+        waitFor(finishedNum, i - slotNum + 1);
+      if (!stages.m_prepare(i, i % slotNum))
+        itemOK[i] = 0;
+      advance(preparedNum);
+    }
+  });
+
+  std::thread finishThread([&]
+  {
+    for (uint32_t i = 0; i < itemNum; ++i)
+    {
+      waitFor(encodedNum, i + 1);
+      if (!stages.m_finish(i, i % slotNum, itemOK[i] != 0))
+        itemOK[i] = 0;
+      advance(finishedNum);
+    }
+  });
+
+  for (uint32_t i = 0; i < itemNum; ++i)
+  {
+    waitFor(preparedNum, i + 1);
+    if (itemOK[i] && !stages.m_encode(i, i % slotNum))
+      itemOK[i] = 0;
+    advance(encodedNum);
+  }
+
+  prepareThread.join();
+  finishThread.join();
+
+  for (uint8_t ok : itemOK)
+  {
+    if (!ok)
+      return false;
+  }
+  return true;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdint.h>
+#include <functional>
+
+// Backend agnostic executor for batches of images. Every item goes through three stages, each one on its own thread,
+// so the prepare stage (input conversion, upload) of item N + 1, the encode stage of item N and the finish stage
+// (readback, output) of item N - 1 overlap. Every stage takes the items in order.
+// Item i uses ring slot i % slotNum and isn't prepared before item i - slotNum is finished,
+// so the stages can keep their buffers and resources per slot.
+namespace BC6HPipeline
+{
+  struct SStages
+  {
+    std::function<bool(uint32_t item, uint32_t slot)> m_prepare;
+    // Runs on the thread calling Run, after a successful prepare
+    std::function<bool(uint32_t item, uint32_t slot)> m_encode;
+    // Runs for failed items too, ok is false when prepare or encode failed
+    std::function<bool(uint32_t item, uint32_t slot, bool ok)> m_finish;
+  };
+
+  // Returns false if any stage of any item failed
+  bool Run(uint32_t itemNum, uint32_t slotNum, const SStages& stages);
+}
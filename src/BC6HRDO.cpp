@@ -0,0 +1,254 @@
+#include "BC6HRDO.h"
+#include "BC6HDecoderCPU.h"
+#include "BC6HMath.h"
+#include "ThreadPool.h"
+
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+namespace
+{
+  const uint32_t BLOCK_SIZE = 4;
+  const uint32_t BLOCK_BYTES = 16;
+  const float HALF_MAX = 65504.0f;
+  const float LUMINANCE_WEIGHTS[3] = { 0.299f, 0.587f, 0.114f };
+
+  // Rate model: every literal byte costs a byte, a match costs MATCH_BYTES and needs MIN_MATCH bytes
+  const uint32_t MIN_MATCH = 4;
+  const uint32_t MATCH_BYTES = 3;
+
+  // EstimateLZSize
+  const uint32_t HASH_BITS = 16;
+  const size_t LZ_WINDOW = 1 << 20;
+
+  // First byte made of index bits only, from the mode in the low bits of the block.
+  // 16 (no index bytes) for the reserved modes.
+  uint32_t GetIndexByte(const uint8_t* block)
+  {
+    // Modes 1 and 2 (two subsets) have 2 mode bits, the others 5
+    if ((block[0] & 0x3) < 2)
+      return 11;
+
+    uint32_t mode = block[0] & 0x1F;
+    // 10 and 11 bit single subset modes, 5 mode bits and 60 endpoint bits then the indices from bit 65
+    if ((mode & 0x3) == 0x3)
+      return mode > 0x0F ? 16 : 9;
+    // Two subsets: 82 header, endpoint and partition bits
+    return 11;
+  }
+
+  // Log2 of the texels clamped to the encoder range, only the texels inside the image count
+  struct SSourceBlock
+  {
+    float m_log[16][3];
+    bool m_inside[16];
+    uint32_t m_insideNum;
+  };
+
+  void GatherSourceBlock(const uint8_t* texels, BC6HEncoderCPU::TexelFormat format, uint32_t rowPitch, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY, SSourceBlock& source)
+  {
+    float block[16][3];
+    BC6HEncoderCPU::GatherBlock(texels, format, rowPitch, width, height, blockX, blockY, BC6HEncoderCPU::Addressing::Border, block);
+    source.m_insideNum = 0;
+    for (uint32_t i = 0; i < 16; ++i)
+    {
+      source.m_inside[i] = blockX * BLOCK_SIZE + i % BLOCK_SIZE < width && blockY * BLOCK_SIZE + i / BLOCK_SIZE < height;
+      source.m_insideNum += source.m_inside[i] ? 1 : 0;
+      for (uint32_t c = 0; c < 3; ++c)
+        source.m_log[i][c] = BC6HMath::Log2(fminf(fmaxf(block[i][c], 0.0f), HALF_MAX) + 1.0f);
+    }
+  }
+
+  // Block MSLE of a candidate, stops as soon as the error is above limit and returns a value above it
+  float MeasureCandidate(const SSourceBlock& source, const uint8_t* block, float limit)
+  {
+    uint16_t decoded[16][4];
+    BC6HDecoderCPU::DecodeBlock(block, false, decoded);
+
+    float errorLimit = limit * source.m_insideNum;
+    float error = 0.0f;
+    for (uint32_t i = 0; i < 16; ++i)
+    {
+      if (!source.m_inside[i])
+        continue;
+
+      for (uint32_t c = 0; c < 3; ++c)
+      {
+        float delta = source.m_log[i][c] - BC6HMath::Log2(BC6HMath::F16ToF32(decoded[i][c]) + 1.0f);
+        error += LUMINANCE_WEIGHTS[c] * delta * delta;
+      }
+      if (error > errorLimit)
+        return INFINITY;
+    }
+    return error / source.m_insideNum;
+  }
+
+  // Estimated bytes of a block after the window: a match covers a whole repeated block, a common head or a common tail
+  uint32_t GetBlockRate(const uint8_t* block, const uint8_t* window, uint32_t windowNum)
+  {
+    uint32_t bestMatch = 0;
+    for (uint32_t w = 0; w < windowNum; ++w)
+    {
+      const uint8_t* other = window + w * BLOCK_BYTES;
+      uint32_t head = 0;
+      while (head < BLOCK_BYTES && block[head] == other[head])
+        ++head;
+      uint32_t tail = 0;
+      while (tail < BLOCK_BYTES && block[BLOCK_BYTES - 1 - tail] == other[BLOCK_BYTES - 1 - tail])
+        ++tail;
+      bestMatch = head > bestMatch ? head : bestMatch;
+      bestMatch = tail > bestMatch ? tail : bestMatch;
+    }
+    return bestMatch >= MIN_MATCH ? BLOCK_BYTES - bestMatch + MATCH_BYTES : BLOCK_BYTES;
+  }
+
+  // Returns true when the block was replaced
+  bool OptimizeBlock(const SSourceBlock& source, const BC6HRDO::SSettings& settings, const uint8_t* window, uint32_t windowNum, uint8_t* block)
+  {
+    if (windowNum == 0 || source.m_insideNum == 0)
+      return false;
+
+    float originalError = MeasureCandidate(source, block, INFINITY);
+    float errorLimit = originalError * settings.m_maxErrorRatio;
+    float bestCost = originalError + settings.m_lambda * GetBlockRate(block, window, windowNum);
+
+    uint32_t indexByte = GetIndexByte(block);
+    uint8_t original[BLOCK_BYTES];
+    memcpy(original, block, BLOCK_BYTES);
+    bool replaced = false;
+
+    // Nearest blocks first, they are the cheapest matches for a real coder, so they win ties
+    for (uint32_t w = windowNum; w-- > 0;)
+    {
+      const uint8_t* other = window + w * BLOCK_BYTES;
+      // Runs of repeated blocks only need to be tried once
+      if (w + 1 < windowNum && memcmp(other, other + BLOCK_BYTES, BLOCK_BYTES) == 0)
+        continue;
+
+      // The whole block
+      float rate = static_cast<float>(MATCH_BYTES);
+      float error = MeasureCandidate(source, other, fminf(errorLimit, bestCost - settings.m_lambda * rate));
+      if (error <= errorLimit && error + settings.m_lambda * rate < bestCost)
+      {
+        bestCost = error + settings.m_lambda * rate;
+        memcpy(block, other, BLOCK_BYTES);
+        replaced = true;
+      }
+
+      // The other block's indices with our mode, endpoints and partition
+      if (indexByte + MIN_MATCH > BLOCK_BYTES || GetIndexByte(other) != indexByte
+        || memcmp(original + indexByte, other + indexByte, BLOCK_BYTES - indexByte) == 0)
+        continue;
+
+      uint8_t candidate[BLOCK_BYTES];
+      memcpy(candidate, original, indexByte);
+      memcpy(candidate + indexByte, other + indexByte, BLOCK_BYTES - indexByte);
+      rate = static_cast<float>(indexByte + MATCH_BYTES);
+      error = MeasureCandidate(source, candidate, fminf(errorLimit, bestCost - settings.m_lambda * rate));
+      if (error <= errorLimit && error + settings.m_lambda * rate < bestCost)
+      {
+        bestCost = error + settings.m_lambda * rate;
+        memcpy(block, candidate, BLOCK_BYTES);
+        replaced = true;
+      }
+
+      // Our indices with the other block's mode, endpoints and partition
+      memcpy(candidate, other, indexByte);
+      memcpy(candidate + indexByte, original + indexByte, BLOCK_BYTES - indexByte);
+      rate = static_cast<float>(BLOCK_BYTES - indexByte + MATCH_BYTES);
+      error = MeasureCandidate(source, candidate, fminf(errorLimit, bestCost - settings.m_lambda * rate));
+      if (error <= errorLimit && error + settings.m_lambda * rate < bestCost)
+      {
+        bestCost = error + settings.m_lambda * rate;
+        memcpy(block, candidate, BLOCK_BYTES);
+        replaced = true;
+      }
+    }
+    return replaced;
+  }
+}
+
+void BC6HRDO::OptimizeSurface(const uint8_t* texels, BC6HEncoderCPU::TexelFormat format, uint32_t rowPitch, uint32_t width, uint32_t height,
+  const SSettings& settings, ThreadPool* pool, uint8_t* blocks, SResult& result)
+{
+  uint32_t widthInBlocks = (width + BLOCK_SIZE - 1) / BLOCK_SIZE;
+  uint32_t heightInBlocks = (height + BLOCK_SIZE - 1) / BLOCK_SIZE;
+  size_t blockRowPitch = static_cast<size_t>(widthInBlocks) * BLOCK_BYTES;
+  result.m_blockNum += static_cast<uint64_t>(widthInBlocks) * heightInBlocks;
+  result.m_lzSizeBefore += EstimateLZSize(blocks, blockRowPitch * heightInBlocks);
+
+  // Rows are counted separately and summed up at the end, no atomics in the loop
+  std::vector<uint32_t> rowChanges(heightInBlocks, 0);
+  auto optimizeRow = [&](uint32_t blockY)
+  {
+    uint8_t* row = blocks + blockY * blockRowPitch;
+    for (uint32_t blockX = 1; blockX < widthInBlocks; ++blockX)
+    {
+      SSourceBlock source;
+      GatherSourceBlock(texels, format, rowPitch, width, height, blockX, blockY, source);
+
+      uint32_t windowNum = blockX < settings.m_window ? blockX : settings.m_window;
+      if (OptimizeBlock(source, settings, row + (blockX - windowNum) * BLOCK_BYTES, windowNum, row + blockX * BLOCK_BYTES))
+        ++rowChanges[blockY];
+    }
+  };
+
+  if (pool)
+  {
+    pool->ParallelFor(heightInBlocks, optimizeRow);
+  }
+  else
+  {
+    for (uint32_t blockY = 0; blockY < heightInBlocks; ++blockY)
+      optimizeRow(blockY);
+  }
+
+  for (uint32_t changes : rowChanges)
+    result.m_changedBlocks += changes;
+  result.m_lzSizeAfter += EstimateLZSize(blocks, blockRowPitch * heightInBlocks);
+}
+
+uint64_t BC6HRDO::EstimateLZSize(const uint8_t* data, size_t size)
+{
+  // Latest position of every hashed 4 byte sequence, plus one so 0 means none
+  std::vector<size_t> table(static_cast<size_t>(1) << HASH_BITS, 0);
+  auto hash = [&](size_t pos)
+  {
+    uint32_t bytes;
+    memcpy(&bytes, data + pos, sizeof(bytes));
+    return (bytes * 2654435761u) >> (32 - HASH_BITS);
+  };
+
+  uint64_t lzSize = 0;
+  size_t pos = 0;
+  while (pos + MIN_MATCH <= size)
+  {
+    uint32_t h = hash(pos);
+    size_t candidate = table[h];
+    table[h] = pos + 1;
+
+    size_t matchLength = 0;
+    if (candidate != 0 && pos - (candidate - 1) <= LZ_WINDOW)
+    {
+      const uint8_t* match = data + candidate - 1;
+      while (pos + matchLength < size && match[matchLength] == data[pos + matchLength])
+        ++matchLength;
+    }
+
+    if (matchLength < MIN_MATCH)
+    {
+      ++lzSize;
+      ++pos;
+      continue;
+    }
+
+    lzSize += MATCH_BYTES;
+    // Positions inside the match are hashed too, so later repeats find the latest copy
+    size_t end = pos + matchLength;
+    for (++pos; pos < end && pos + MIN_MATCH <= size; ++pos)
+      table[hash(pos)] = pos + 1;
+    pos = end;
+  }
+  return lzSize + (size - pos);
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "BC6HEncoderCPU.h"
+
+class ThreadPool;
+
+// Rate distortion optimization of encoded blocks for packages compressed with an LZ codec (zstd, deflate, LZ4).
+// Index bits are close to random, so encoded blocks rarely repeat bytes of their neighbours and barely compress.
+// Every block is offered the index bytes, the mode and endpoint bytes, or all the bytes, of each block in a window
+// before it and keeps the candidate with the lowest error + lambda * estimated bytes, as long as its error stays within m_maxErrorRatio
+// of the original encoding. The window only looks back along the block row, so rows run in parallel and
+// the result doesn't depend on the thread count.
+namespace BC6HRDO
+{
+  struct SSettings
+  {
+    // Block MSLE (mean luminance weighted squared log2 error of the texels) a saved byte is worth, 0 turns RDO off.
+    // The encoders reach a block MSLE around 1e-4 on smooth HDR content, useful values are 1e-6 to 1e-4.
+    float m_lambda;
+    // Bound on the error of a block, at most m_maxErrorRatio times the MSLE of its original encoding
+    float m_maxErrorRatio;
+    // Blocks before the current one it can take bytes from, 16 bytes each
+    uint32_t m_window;
+  };
+
+  struct SResult
+  {
+    uint64_t m_blockNum;
+    uint64_t m_changedBlocks;
+    // EstimateLZSize of the blocks as encoded and after RDO
+    uint64_t m_lzSizeBefore;
+    uint64_t m_lzSizeAfter;
+  };
+
+  // blocks are tightly packed rows of (width + 3) / 4 blocks encoded from texels, optimized in place.
+  // Texels outside of the image don't count towards the error. result gets the surface added to it.
+  void OptimizeSurface(const uint8_t* texels, BC6HEncoderCPU::TexelFormat format, uint32_t rowPitch, uint32_t width, uint32_t height,
+    const SSettings& settings, ThreadPool* pool, uint8_t* blocks, SResult& result);
+
+  // Output size of a greedy LZ77 coder without entropy coding (4 byte minimum match, 1MB window, 3 bytes per match).
+  // Fast and only a guide: zstd and deflate end up smaller, but follow the same trend.
+  uint64_t EstimateLZSize(const uint8_t* data, size_t size);
+}
@@ -0,0 +1,142 @@
+#include "BC6HStats.h"
+
+#include <algorithm>
+#include <chrono>
+
+BC6HStats::SFrame::SFrame()
+{
+  for (uint32_t i = 0; i < STAGE_NUM; ++i)
+    m_times[i] = -1.0f;
+  m_blocks = BC6HEncoderCPU::SBlockCounts{ 0, 0, 0, 0, 0 };
+  m_rdo = BC6HRDO::SResult{ 0, 0, 0, 0 };
+}
+
+void BC6HStats::SFrame::Add(const SFrame& other)
+{
+  for (uint32_t i = 0; i < STAGE_NUM; ++i)
+  {
+    if (other.m_times[i] >= 0.0f)
+      m_times[i] = std::max(m_times[i], 0.0f) + other.m_times[i];
+  }
+  m_blocks.m_constant += other.m_blocks.m_constant;
+  m_blocks.m_nearConstant += other.m_blocks.m_nearConstant;
+  m_blocks.m_encoded += other.m_blocks.m_encoded;
+  m_blocks.m_cached += other.m_blocks.m_cached;
+  m_blocks.m_p2Skipped += other.m_blocks.m_p2Skipped;
+  m_rdo.m_blockNum += other.m_rdo.m_blockNum;
+  m_rdo.m_changedBlocks += other.m_rdo.m_changedBlocks;
+  m_rdo.m_lzSizeBefore += other.m_rdo.m_lzSizeBefore;
+  m_rdo.m_lzSizeAfter += other.m_rdo.m_lzSizeAfter;
+}
+
+double BC6HStats::Now()
+{
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+BC6HStats::Collector::Collector()
+{
+  Reset();
+}
+
+void BC6HStats::Collector::AddFrame(const SFrame& frame, uint64_t bytesIn, uint64_t bytesOut)
+{
+  std::lock_guard<std::mutex> lk(m_mutex);
+  for (uint32_t i = 0; i < STAGE_NUM; ++i)
+  {
+    if (frame.m_times[i] >= 0.0f)
+      AddSampleUnlocked(static_cast<Stage>(i), frame.m_times[i]);
+  }
+  ++m_compressCount;
+  m_bytesIn += bytesIn;
+  m_bytesOut += bytesOut;
+  m_blocks.m_constant += frame.m_blocks.m_constant;
+  m_blocks.m_nearConstant += frame.m_blocks.m_nearConstant;
+  m_blocks.m_encoded += frame.m_blocks.m_encoded;
+  m_blocks.m_cached += frame.m_blocks.m_cached;
+  m_blocks.m_p2Skipped += frame.m_blocks.m_p2Skipped;
+  m_rdo.m_blockNum += frame.m_rdo.m_blockNum;
+  m_rdo.m_changedBlocks += frame.m_rdo.m_changedBlocks;
+  m_rdo.m_lzSizeBefore += frame.m_rdo.m_lzSizeBefore;
+  m_rdo.m_lzSizeAfter += frame.m_rdo.m_lzSizeAfter;
+}
+
+void BC6HStats::Collector::AddSample(Stage stage, float time)
+{
+  std::lock_guard<std::mutex> lk(m_mutex);
+  AddSampleUnlocked(stage, time);
+}
+
+void BC6HStats::Collector::AddGPUSampleDropped()
+{
+  std::lock_guard<std::mutex> lk(m_mutex);
+  ++m_gpuSamplesDropped;
+}
+
+void BC6HStats::Collector::AddSampleUnlocked(Stage stage, float time)
+{
+  SWindow& window = m_windows[static_cast<uint32_t>(stage)];
+  window.m_samples[window.m_count % WINDOW_SIZE] = time;
+  window.m_last = time;
+  ++window.m_count;
+}
+
+void BC6HStats::Collector::Get(SStats& stats) const
+{
+  // Copy under the lock, sort outside of it
+  SWindow windows[STAGE_NUM];
+  {
+    std::lock_guard<std::mutex> lk(m_mutex);
+    std::copy(m_windows, m_windows + STAGE_NUM, windows);
+    stats.m_compressCount = m_compressCount;
+    stats.m_bytesIn = m_bytesIn;
+    stats.m_bytesOut = m_bytesOut;
+    stats.m_gpuSamplesDropped = m_gpuSamplesDropped;
+    stats.m_blocks = m_blocks;
+    stats.m_rdo = m_rdo;
+  }
+
+  for (uint32_t i = 0; i < STAGE_NUM; ++i)
+  {
+    SWindow& window = windows[i];
+    SStageStats& stage = stats.m_stages[i];
+    stage = SStageStats();
+    stage.m_count = window.m_count;
+    if (window.m_count == 0)
+      continue;
+
+    uint32_t sampleNum = static_cast<uint32_t>(std::min<uint64_t>(window.m_count, WINDOW_SIZE));
+    float* samples = window.m_samples;
+    std::sort(samples, samples + sampleNum);
+
+    // Nearest rank percentiles
+    auto percentile = [&](uint32_t p) { return samples[std::max(1u, (p * sampleNum + 99) / 100) - 1]; };
+
+    double sum = 0.0;
+    for (uint32_t j = 0; j < sampleNum; ++j)
+      sum += samples[j];
+
+    stage.m_last = window.m_last;
+    stage.m_mean = static_cast<float>(sum / sampleNum);
+    stage.m_p50 = percentile(50);
+    stage.m_p90 = percentile(90);
+    stage.m_p99 = percentile(99);
+    stage.m_max = samples[sampleNum - 1];
+  }
+}
+
+void BC6HStats::Collector::Reset()
+{
+  std::lock_guard<std::mutex> lk(m_mutex);
+  for (SWindow& window : m_windows)
+  {
+    window.m_count = 0;
+    window.m_last = 0.0f;
+  }
+  m_compressCount = 0;
+  m_bytesIn = 0;
+  m_bytesOut = 0;
+  m_gpuSamplesDropped = 0;
+  m_blocks = BC6HEncoderCPU::SBlockCounts{ 0, 0, 0, 0, 0 };
+  m_rdo = BC6HRDO::SResult{ 0, 0, 0, 0 };
+}
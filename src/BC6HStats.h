@@ -0,0 +1,118 @@
+#pragma once
+
+#include <stdint.h>
+#include <mutex>
+#include "BC6HEncoderCPU.h"
+#include "BC6HRDO.h"
+
+// Per stage timings and byte counters of Compress.
+// Every stage keeps a rolling window of its latest samples, percentiles are only computed by Get,
+// so recording a sample is a timer read and a short uncontended lock.
+namespace BC6HStats
+{
+  enum struct Stage
+  {
+    // Waiting for another Compress/Decompress/Measure call to release the compressor
+    LockWait,
+    // Source texture creation and upload (D3D11)
+    Upload,
+    // Block encoding, GPU timestamps of the dispatch for D3D11
+    Encode,
+    // GPU copies from the UAV target to the staging texture (D3D11 timestamps)
+    Copy,
+    // Staging texture map and copy out (D3D11)
+    Readback,
+    // Output image allocation
+    Allocation,
+    // Quality measurement when SetMeasureQuality is on
+    Measure,
+    // Rate distortion optimization pass when SetRDO is on
+    RDO,
+    // The whole Compress call, lock wait included
+    Total,
+    Count,
+  };
+
+  const uint32_t STAGE_NUM = static_cast<uint32_t>(Stage::Count);
+
+  // Milliseconds over the rolling window, all zero while m_count is 0
+  struct SStageStats
+  {
+    uint64_t m_count;
+    float m_last;
+    float m_mean;
+    float m_p50;
+    float m_p90;
+    float m_p99;
+    float m_max;
+  };
+
+  struct SStats
+  {
+    uint64_t m_compressCount;
+    uint64_t m_bytesIn;
+    uint64_t m_bytesOut;
+    // GPU timestamps overwritten before they were ready, the compressions were faster than the GPU reported back
+    uint64_t m_gpuSamplesDropped;
+    // CPU backend blocks by encoding path, the D3D11 shader runs the full encoder on every block
+    BC6HEncoderCPU::SBlockCounts m_blocks;
+    // Blocks changed by the RDO pass and the estimated LZ sizes of the passes, see SetRDO
+    BC6HRDO::SResult m_rdo;
+    SStageStats m_stages[STAGE_NUM];
+  };
+
+  // Monotonic time in milliseconds
+  double Now();
+
+  // Stage times of a single Compress call, negative for the stages it didn't go through
+  struct SFrame
+  {
+    SFrame();
+
+    // Sets the stage time to the time elapsed since startTime (from Now)
+    void Record(Stage stage, double startTime) { m_times[static_cast<uint32_t>(stage)] = static_cast<float>(Now() - startTime); }
+    void Set(Stage stage, float time) { m_times[static_cast<uint32_t>(stage)] = time; }
+    float Get(Stage stage) const { return m_times[static_cast<uint32_t>(stage)]; }
+    // Adds the stage times (those other went through), block counts and RDO results of one part of a call
+    void Add(const SFrame& other);
+
+    float m_times[STAGE_NUM];
+    BC6HEncoderCPU::SBlockCounts m_blocks;
+    BC6HRDO::SResult m_rdo;
+  };
+
+  class Collector
+  {
+  public:
+    Collector();
+
+    void AddFrame(const SFrame& frame, uint64_t bytesIn, uint64_t bytesOut);
+    // Samples that arrive later, like GPU timestamps
+    void AddSample(Stage stage, float time);
+    void AddGPUSampleDropped();
+
+    void Get(SStats& stats) const;
+    void Reset();
+
+  private:
+    static const uint32_t WINDOW_SIZE = 256;
+
+    struct SWindow
+    {
+      float m_samples[WINDOW_SIZE];
+      uint64_t m_count;
+      float m_last;
+    };
+
+    void AddSampleUnlocked(Stage stage, float time);
+
+    mutable std::mutex m_mutex;
+    SWindow m_windows[STAGE_NUM];
+    uint64_t m_compressCount;
+    uint64_t m_bytesIn;
+    uint64_t m_bytesOut;
+    uint64_t m_gpuSamplesDropped;
+    BC6HEncoderCPU::SBlockCounts m_blocks;
+    BC6HRDO::SResult m_rdo;
+  };
+}
@@ -1,48 +1,538 @@
 #include "GPURealTimeBC6H-c.h"
 #include "GPURealTimeBC6H.h"
+#include "ThreadPool.h"
+
+#include <iostream>
+
+struct GPURealTimeBC6H_Context
+{
+  GPURealTimeBC6H m_compressor;
+};
+
+struct GPURealTimeBC6H_WorkerPool
+{
+  std::shared_ptr<ThreadPool> m_threadPool;
+};
 
 namespace
 {
-  GPURealTimeBC6H gCompressor;
+  GPURealTimeBC6H_Context gDefaultContext;
+
+  uint32_t GetTexelBytes(SImage::ImageFormat format)
+  {
+    switch (format)
+    {
+    case SImage::ImageFormat::RGBA32F: return 16;
+    case SImage::ImageFormat::RGBA16F: return 8;
+    case SImage::ImageFormat::RGB32F: return 12;
+    case SImage::ImageFormat::RGB16F: return 6;
+    case SImage::ImageFormat::RGB9E5: return 4;
+    default: return 0;
+    }
+  }
+
+  // Source images of the C API. Their slice count and pitches came in with later versions, a caller that doesn't
+  // zero the struct passes garbage in them, so the rows and slices they describe have to fit in dataSize.
+  bool GetSourceImage(const GPURealTimeBC6H_Image* image, SImage::ImageFormat format, SImage& imageCpp)
+  {
+    imageCpp.m_format = format;
+    imageCpp.m_width = image->width;
+    imageCpp.m_height = image->height;
+    imageCpp.m_data = image->data;
+    imageCpp.m_dataSize = image->dataSize;
+    imageCpp.m_sliceNum = image->sliceCount != 0 ? image->sliceCount : 1;
+    imageCpp.m_slicePitch = image->slicePitch;
+    imageCpp.m_rowPitch = image->rowPitch;
+
+    // Unknown formats are left to the compressor to reject
+    uint32_t texelBytes = GetTexelBytes(format);
+    if (texelBytes == 0 || image->width == 0 || image->height == 0)
+      return true;
+
+    uint64_t rowBytes = static_cast<uint64_t>(image->width) * texelBytes;
+    uint64_t rowPitch = image->rowPitch != 0 ? image->rowPitch : rowBytes;
+    uint64_t slicePitch = image->slicePitch != 0 ? image->slicePitch : rowPitch * image->height;
+    uint64_t extent = (imageCpp.m_sliceNum - 1) * slicePitch + (image->height - 1) * rowPitch + rowBytes;
+    if (!image->data || extent > image->dataSize)
+    {
+      std::cerr << "GPURealTimeBC6H: " << image->width << "x" << image->height << "x" << imageCpp.m_sliceNum << " image with row pitch " << image->rowPitch
+        << " and slice pitch " << image->slicePitch << " doesn't fit in its " << image->dataSize << " bytes, is the GPURealTimeBC6H_Image zero initialized?" << std::endl;
+      return false;
+    }
+    return true;
+  }
 }
 
 bool GPURealTimeBC6H_Initialize(uint32_t preset)
 {
-  return gCompressor.Init(static_cast<GPURealTimeBC6H::Preset>(preset));
+  return gDefaultContext.m_compressor.Init(static_cast<GPURealTimeBC6H::Preset>(preset));
+}
+
+bool GPURealTimeBC6H_InitializeBackend(uint32_t preset, uint32_t backend)
+{
+  return gDefaultContext.m_compressor.Init(static_cast<GPURealTimeBC6H::Preset>(preset), static_cast<GPURealTimeBC6H::Backend>(backend));
+}
+
+void GPURealTimeBC6H_SetEffort(uint32_t effort)
+{
+  GPURealTimeBC6H_ContextSetEffort(&gDefaultContext, effort);
+}
+
+uint32_t GPURealTimeBC6H_GetEffort()
+{
+  return GPURealTimeBC6H_ContextGetEffort(&gDefaultContext);
+}
+
+void GPURealTimeBC6H_SetBlockCache(uint32_t entryCount)
+{
+  GPURealTimeBC6H_ContextSetBlockCache(&gDefaultContext, entryCount);
+}
+
+void GPURealTimeBC6H_ClearBlockCache()
+{
+  GPURealTimeBC6H_ContextClearBlockCache(&gDefaultContext);
+}
+
+void GPURealTimeBC6H_SetTileOrder(uint32_t tileOrder)
+{
+  GPURealTimeBC6H_ContextSetTileOrder(&gDefaultContext, tileOrder);
+}
+
+void GPURealTimeBC6H_SetP2Threshold(float threshold)
+{
+  GPURealTimeBC6H_ContextSetP2Threshold(&gDefaultContext, threshold);
+}
+
+void GPURealTimeBC6H_SetRDO(float lambda, float maxErrorRatio)
+{
+  GPURealTimeBC6H_ContextSetRDO(&gDefaultContext, lambda, maxErrorRatio);
 }
 
 bool GPURealTimeBC6H_Compress(GPURealTimeBC6H_Image* srcImage, uint32_t format, GPURealTimeBC6H_Image* dstImage)
 {
+  return GPURealTimeBC6H_ContextCompress(&gDefaultContext, srcImage, format, dstImage);
+}
+
+bool GPURealTimeBC6H_CompressInto(GPURealTimeBC6H_Image* srcImage, uint32_t format, GPURealTimeBC6H_Image* dstImage)
+{
+  return GPURealTimeBC6H_ContextCompressInto(&gDefaultContext, srcImage, format, dstImage);
+}
+
+bool GPURealTimeBC6H_CompressBatch(GPURealTimeBC6H_Image* srcImages, uint32_t format, uint32_t imageCount, uint32_t depth, GPURealTimeBC6H_BatchCallback callback, void* userData)
+{
+  return GPURealTimeBC6H_ContextCompressBatch(&gDefaultContext, srcImages, format, imageCount, depth, callback, userData);
+}
+
+bool GPURealTimeBC6H_CompressRects(GPURealTimeBC6H_Image* srcImage, uint32_t format, const GPURealTimeBC6H_Rect* rects, uint32_t rectCount, GPURealTimeBC6H_Image* dstImage)
+{
+  return GPURealTimeBC6H_ContextCompressRects(&gDefaultContext, srcImage, format, rects, rectCount, dstImage);
+}
+
+uint32_t GPURealTimeBC6H_GetCompressedSize(uint32_t width, uint32_t height, uint32_t sliceCount)
+{
+  uint64_t dataSize = GPURealTimeBC6H::GetCompressedSize(width, height, sliceCount != 0 ? sliceCount : 1);
+  return dataSize <= UINT32_MAX ? static_cast<uint32_t>(dataSize) : 0;
+}
+
+uint32_t GPURealTimeBC6H_GetMipLevelNum(uint32_t width, uint32_t height)
+{
+  return GPURealTimeBC6H::GetMipLevelNum(width, height);
+}
+
+bool GPURealTimeBC6H_CompressMipChain(GPURealTimeBC6H_Image* srcImage, uint32_t levelNum, GPURealTimeBC6H_Image* dstImage, uint32_t* levelOffsets)
+{
+  return GPURealTimeBC6H_ContextCompressMipChain(&gDefaultContext, srcImage, levelNum, dstImage, levelOffsets);
+}
+
+bool GPURealTimeBC6H_CompressToFile(GPURealTimeBC6H_Image* srcImage, uint32_t levelNum, bool cubemap, uint32_t container, const char* path)
+{
+  return GPURealTimeBC6H_ContextCompressToFile(&gDefaultContext, srcImage, levelNum, cubemap, container, path);
+}
+
+bool GPURealTimeBC6H_CompressToSink(GPURealTimeBC6H_Image* srcImage, uint32_t levelNum, bool cubemap, uint32_t container, GPURealTimeBC6H_WriteCallback write, void* userData)
+{
+  return GPURealTimeBC6H_ContextCompressToSink(&gDefaultContext, srcImage, levelNum, cubemap, container, write, userData);
+}
+
+bool GPURealTimeBC6H_BeginStream(uint32_t width, uint32_t height, GPURealTimeBC6H_BlockRowCallback callback, void* userData)
+{
+  return GPURealTimeBC6H_ContextBeginStream(&gDefaultContext, width, height, callback, userData);
+}
+
+bool GPURealTimeBC6H_CompressRows(const uint8_t* rows, uint32_t rowPitch, uint32_t rowNum)
+{
+  return GPURealTimeBC6H_ContextCompressRows(&gDefaultContext, rows, rowPitch, rowNum);
+}
+
+bool GPURealTimeBC6H_EndStream()
+{
+  return GPURealTimeBC6H_ContextEndStream(&gDefaultContext);
+}
+
+bool GPURealTimeBC6H_Decompress(GPURealTimeBC6H_Image* srcImage, uint32_t srcFormat, uint32_t dstFormat, GPURealTimeBC6H_Image* dstImage)
+{
+  return GPURealTimeBC6H_ContextDecompress(&gDefaultContext, srcImage, srcFormat, dstFormat, dstImage);
+}
+
+bool GPURealTimeBC6H_ComputeMetrics(GPURealTimeBC6H_Image* srcImage, GPURealTimeBC6H_Image* bc6hImage, uint32_t bc6hFormat, GPURealTimeBC6H_Metrics* metrics, float* blockMSLE)
+{
+  return GPURealTimeBC6H_ContextComputeMetrics(&gDefaultContext, srcImage, bc6hImage, bc6hFormat, metrics, blockMSLE);
+}
+
+void GPURealTimeBC6H_SetMeasureQuality(bool measureQuality)
+{
+  GPURealTimeBC6H_ContextSetMeasureQuality(&gDefaultContext, measureQuality);
+}
+
+void GPURealTimeBC6H_GetMetrics(GPURealTimeBC6H_Metrics* metrics)
+{
+  GPURealTimeBC6H_ContextGetMetrics(&gDefaultContext, metrics);
+}
+
+float GPURealTimeBC6H_GetGPUCompressionTime()
+{
+  return GPURealTimeBC6H_ContextGetGPUCompressionTime(&gDefaultContext);
+}
+
+void GPURealTimeBC6H_GetStats(GPURealTimeBC6H_Stats* stats)
+{
+  GPURealTimeBC6H_ContextGetStats(&gDefaultContext, stats);
+}
+
+void GPURealTimeBC6H_ResetStats()
+{
+  GPURealTimeBC6H_ContextResetStats(&gDefaultContext);
+}
+
+void GPURealTimeBC6H_FreeImage(GPURealTimeBC6H_Image* dstImage)
+{
+  SImage dstImageCpp;
+  dstImageCpp.m_data = dstImage->data;
+  gDefaultContext.m_compressor.FreeImage(&dstImageCpp);
+}
+
+void GPURealTimeBC6H_Release()
+{
+  gDefaultContext.m_compressor.Release();
+}
+
+GPURealTimeBC6H_WorkerPool* GPURealTimeBC6H_CreateWorkerPool(uint32_t threadCount, bool pinThreads)
+{
+  GPURealTimeBC6H_WorkerPool* pool = new GPURealTimeBC6H_WorkerPool();
+  pool->m_threadPool = std::make_shared<ThreadPool>(threadCount, pinThreads);
+  return pool;
+}
+
+void GPURealTimeBC6H_DestroyWorkerPool(GPURealTimeBC6H_WorkerPool* pool)
+{
+  delete pool;
+}
+
+GPURealTimeBC6H_Context* GPURealTimeBC6H_CreateContext(uint32_t preset, uint32_t backend, GPURealTimeBC6H_WorkerPool* workerPool)
+{
+  GPURealTimeBC6H_Context* context = new GPURealTimeBC6H_Context();
+  std::shared_ptr<ThreadPool> threadPool = workerPool ? workerPool->m_threadPool : nullptr;
+  if (!context->m_compressor.Init(static_cast<GPURealTimeBC6H::Preset>(preset), static_cast<GPURealTimeBC6H::Backend>(backend), threadPool))
+  {
+    delete context;
+    return nullptr;
+  }
+  return context;
+}
+
+void GPURealTimeBC6H_DestroyContext(GPURealTimeBC6H_Context* context)
+{
+  delete context;
+}
+
+void GPURealTimeBC6H_ContextSetEffort(GPURealTimeBC6H_Context* context, uint32_t effort)
+{
+  static_assert(BC6HEffort::MAX == 5 && BC6HEffort::QUALITY == 2 && BC6HEffort::SPEED == 1, "Effort levels are out of sync");
+  context->m_compressor.SetEffort(effort);
+}
+
+uint32_t GPURealTimeBC6H_ContextGetEffort(GPURealTimeBC6H_Context* context)
+{
+  return context->m_compressor.GetEffort();
+}
+
+void GPURealTimeBC6H_ContextSetBlockCache(GPURealTimeBC6H_Context* context, uint32_t entryCount)
+{
+  context->m_compressor.SetBlockCache(entryCount);
+}
+
+void GPURealTimeBC6H_ContextClearBlockCache(GPURealTimeBC6H_Context* context)
+{
+  context->m_compressor.ClearBlockCache();
+}
+
+void GPURealTimeBC6H_ContextSetTileOrder(GPURealTimeBC6H_Context* context, uint32_t tileOrder)
+{
+  static_assert(GPURealTimeBC6H_TileOrder_Morton == static_cast<uint32_t>(BC6HEncoderCPU::TileOrder::Morton), "Tile order enums are out of sync");
+  context->m_compressor.SetTileOrder(static_cast<BC6HEncoderCPU::TileOrder>(tileOrder));
+}
+
+void GPURealTimeBC6H_ContextSetP2Threshold(GPURealTimeBC6H_Context* context, float threshold)
+{
+  context->m_compressor.SetP2Threshold(threshold);
+}
+
+void GPURealTimeBC6H_ContextSetRDO(GPURealTimeBC6H_Context* context, float lambda, float maxErrorRatio)
+{
+  context->m_compressor.SetRDO(lambda, maxErrorRatio);
+}
+
+bool GPURealTimeBC6H_ContextCompress(GPURealTimeBC6H_Context* context, GPURealTimeBC6H_Image* srcImage, uint32_t format, GPURealTimeBC6H_Image* dstImage)
+{
+  static_assert(GPURealTimeBC6H_ImageFormat_RGB9E5 == static_cast<uint32_t>(SImage::ImageFormat::RGB9E5), "Image format enums are out of sync");
   SImage srcImageCpp, dstImageCpp;
-  srcImageCpp.m_format = static_cast<SImage::ImageFormat>(format);
-  srcImageCpp.m_width = srcImage->width;
-  srcImageCpp.m_height = srcImage->height;
-  srcImageCpp.m_data = srcImage->data;
-  srcImageCpp.m_dataSize = srcImage->dataSize;
+  if (!GetSourceImage(srcImage, static_cast<SImage::ImageFormat>(format), srcImageCpp))
+    return false;
 
   dstImageCpp.m_format = SImage::ImageFormat::BC6H;
  
-  /// TODO: add format to Compress parameters
-  bool result = gCompressor.Compress(&srcImageCpp, &dstImageCpp);
+  bool result = context->m_compressor.Compress(&srcImageCpp, &dstImageCpp);
   if (result)
   {
     dstImage->width = srcImageCpp.m_width;
     dstImage->height = srcImageCpp.m_height;
     dstImage->data = dstImageCpp.m_data;
-    dstImage->dataSize = srcImageCpp.m_dataSize;
+    dstImage->dataSize = dstImageCpp.m_dataSize;
+    dstImage->sliceCount = dstImageCpp.m_sliceNum;
+    dstImage->slicePitch = dstImageCpp.m_slicePitch;
   }
 
   return result;
 }
 
-void GPURealTimeBC6H_FreeImage(GPURealTimeBC6H_Image* dstImage)
+bool GPURealTimeBC6H_ContextCompressInto(GPURealTimeBC6H_Context* context, GPURealTimeBC6H_Image* srcImage, uint32_t format, GPURealTimeBC6H_Image* dstImage)
 {
-  SImage dstImageCpp;
+  SImage srcImageCpp, dstImageCpp;
+  if (!GetSourceImage(srcImage, static_cast<SImage::ImageFormat>(format), srcImageCpp))
+    return false;
+
+  dstImageCpp.m_format = SImage::ImageFormat::BC6H;
+  dstImageCpp.m_data = dstImage->data;
+  dstImageCpp.m_dataSize = dstImage->dataSize;
+
+  bool result = context->m_compressor.CompressInto(&srcImageCpp, &dstImageCpp);
+  if (result)
+  {
+    dstImage->width = srcImageCpp.m_width;
+    dstImage->height = srcImageCpp.m_height;
+    dstImage->dataSize = dstImageCpp.m_dataSize;
+    dstImage->sliceCount = dstImageCpp.m_sliceNum;
+    dstImage->slicePitch = dstImageCpp.m_slicePitch;
+  }
+
+  return result;
+}
+
+bool GPURealTimeBC6H_ContextCompressBatch(GPURealTimeBC6H_Context* context, GPURealTimeBC6H_Image* srcImages, uint32_t format, uint32_t imageCount, uint32_t depth, GPURealTimeBC6H_BatchCallback callback, void* userData)
+{
+  std::vector<SImage> srcImagesCpp(imageCount);
+  for (uint32_t i = 0; i < imageCount; ++i)
+  {
+    if (!GetSourceImage(&srcImages[i], static_cast<SImage::ImageFormat>(format), srcImagesCpp[i]))
+      return false;
+  }
+
+  auto onImage = [&](uint32_t index, const SImage* dstImageCpp, bool ok)
+  {
+    GPURealTimeBC6H_Image dstImage = {};
+    dstImage.width = srcImages[index].width;
+    dstImage.height = srcImages[index].height;
+    dstImage.data = dstImageCpp->m_data;
+    dstImage.dataSize = dstImageCpp->m_dataSize;
+    dstImage.sliceCount = dstImageCpp->m_sliceNum;
+    dstImage.slicePitch = dstImageCpp->m_slicePitch;
+    callback(index, &dstImage, ok, userData);
+  };
+  return context->m_compressor.CompressBatch(srcImagesCpp.data(), imageCount, depth, onImage);
+}
+
+bool GPURealTimeBC6H_ContextCompressRects(GPURealTimeBC6H_Context* context, GPURealTimeBC6H_Image* srcImage, uint32_t format, const GPURealTimeBC6H_Rect* rects, uint32_t rectCount, GPURealTimeBC6H_Image* dstImage)
+{
+  static_assert(sizeof(GPURealTimeBC6H_Rect) == sizeof(SRect), "Rect structs are out of sync");
+  SImage srcImageCpp, dstImageCpp;
+  if (!GetSourceImage(srcImage, static_cast<SImage::ImageFormat>(format), srcImageCpp))
+    return false;
+
+  // The C images keep their size in texels
+  dstImageCpp.m_format = SImage::ImageFormat::BC6H;
+  dstImageCpp.m_width = (dstImage->width + 3) / 4;
+  dstImageCpp.m_height = (dstImage->height + 3) / 4;
   dstImageCpp.m_data = dstImage->data;
-  gCompressor.FreeImage(&dstImageCpp);
+  dstImageCpp.m_dataSize = dstImage->dataSize;
+
+  return context->m_compressor.CompressRects(&srcImageCpp, reinterpret_cast<const SRect*>(rects), rectCount, &dstImageCpp);
 }
 
-void GPURealTimeBC6H_Release()
+bool GPURealTimeBC6H_ContextCompressMipChain(GPURealTimeBC6H_Context* context, GPURealTimeBC6H_Image* srcImage, uint32_t levelNum, GPURealTimeBC6H_Image* dstImage, uint32_t* levelOffsets)
+{
+  SImage srcImageCpp, dstImageCpp;
+  if (!GetSourceImage(srcImage, SImage::ImageFormat::RGBA32F, srcImageCpp))
+    return false;
+
+  bool result = context->m_compressor.CompressMipChain(&srcImageCpp, levelNum, &dstImageCpp, levelOffsets);
+  if (result)
+  {
+    dstImage->width = srcImageCpp.m_width;
+    dstImage->height = srcImageCpp.m_height;
+    dstImage->data = dstImageCpp.m_data;
+    dstImage->dataSize = dstImageCpp.m_dataSize;
+    dstImage->sliceCount = 1;
+    dstImage->slicePitch = dstImageCpp.m_dataSize;
+  }
+
+  return result;
+}
+
+bool GPURealTimeBC6H_ContextCompressToFile(GPURealTimeBC6H_Context* context, GPURealTimeBC6H_Image* srcImage, uint32_t levelNum, bool cubemap, uint32_t container, const char* path)
+{
+  static_assert(GPURealTimeBC6H_Container_KTX2 == static_cast<uint32_t>(BC6HContainer::Format::KTX2), "Container enums are out of sync");
+
+  SImage srcImageCpp;
+  if (!GetSourceImage(srcImage, SImage::ImageFormat::RGBA32F, srcImageCpp))
+    return false;
+
+  return context->m_compressor.CompressToFile(&srcImageCpp, levelNum, cubemap, static_cast<BC6HContainer::Format>(container), path);
+}
+
+bool GPURealTimeBC6H_ContextCompressToSink(GPURealTimeBC6H_Context* context, GPURealTimeBC6H_Image* srcImage, uint32_t levelNum, bool cubemap, uint32_t container, GPURealTimeBC6H_WriteCallback write, void* userData)
+{
+  if (!write)
+    return false;
+
+  SImage srcImageCpp;
+  if (!GetSourceImage(srcImage, SImage::ImageFormat::RGBA32F, srcImageCpp))
+    return false;
+
+  auto sink = [write, userData](uint64_t offset, const uint8_t* data, size_t size)
+  {
+    return write(offset, data, size, userData);
+  };
+  return context->m_compressor.CompressToSink(&srcImageCpp, levelNum, cubemap, static_cast<BC6HContainer::Format>(container), sink);
+}
+
+bool GPURealTimeBC6H_ContextBeginStream(GPURealTimeBC6H_Context* context, uint32_t width, uint32_t height, GPURealTimeBC6H_BlockRowCallback callback, void* userData)
+{
+  if (!callback)
+    return false;
+
+  auto blockRowCallback = [callback, userData](uint32_t firstBlockRow, uint32_t blockRowNum, const uint8_t* blocks, uint32_t dataSize)
+  {
+    callback(firstBlockRow, blockRowNum, blocks, dataSize, userData);
+  };
+  return context->m_compressor.BeginStream(width, height, blockRowCallback);
+}
+
+bool GPURealTimeBC6H_ContextCompressRows(GPURealTimeBC6H_Context* context, const uint8_t* rows, uint32_t rowPitch, uint32_t rowNum)
+{
+  return context->m_compressor.CompressRows(rows, rowPitch, rowNum);
+}
+
+bool GPURealTimeBC6H_ContextEndStream(GPURealTimeBC6H_Context* context)
+{
+  return context->m_compressor.EndStream();
+}
+
+bool GPURealTimeBC6H_ContextDecompress(GPURealTimeBC6H_Context* context, GPURealTimeBC6H_Image* srcImage, uint32_t srcFormat, uint32_t dstFormat, GPURealTimeBC6H_Image* dstImage)
+{
+  // The C images keep their size in texels
+  SImage srcImageCpp, dstImageCpp;
+  srcImageCpp.m_format = static_cast<SImage::ImageFormat>(srcFormat);
+  srcImageCpp.m_width = (srcImage->width + 3) / 4;
+  srcImageCpp.m_height = (srcImage->height + 3) / 4;
+  srcImageCpp.m_data = srcImage->data;
+  srcImageCpp.m_dataSize = srcImage->dataSize;
+
+  bool result = context->m_compressor.Decompress(&srcImageCpp, static_cast<SImage::ImageFormat>(dstFormat), &dstImageCpp, srcImage->width, srcImage->height);
+  if (result)
+  {
+    dstImage->width = dstImageCpp.m_width;
+    dstImage->height = dstImageCpp.m_height;
+    dstImage->data = dstImageCpp.m_data;
+    dstImage->dataSize = dstImageCpp.m_dataSize;
+    dstImage->sliceCount = 1;
+    dstImage->slicePitch = dstImageCpp.m_dataSize;
+  }
+
+  return result;
+}
+
+bool GPURealTimeBC6H_ContextComputeMetrics(GPURealTimeBC6H_Context* context, GPURealTimeBC6H_Image* srcImage, GPURealTimeBC6H_Image* bc6hImage, uint32_t bc6hFormat, GPURealTimeBC6H_Metrics* metrics, float* blockMSLE)
+{
+  SImage srcImageCpp, bc6hImageCpp;
+  if (!GetSourceImage(srcImage, SImage::ImageFormat::RGBA32F, srcImageCpp))
+    return false;
+
+  bc6hImageCpp.m_format = static_cast<SImage::ImageFormat>(bc6hFormat);
+  bc6hImageCpp.m_width = bc6hImage->width;
+  bc6hImageCpp.m_height = bc6hImage->height;
+  bc6hImageCpp.m_data = bc6hImage->data;
+  bc6hImageCpp.m_dataSize = bc6hImage->dataSize;
+
+  BC6HMetrics::SResult result;
+  if (!context->m_compressor.Measure(&srcImageCpp, &bc6hImageCpp, result, blockMSLE))
+    return false;
+
+  metrics->rgbRMSLE = result.m_rgbRMSLE;
+  metrics->lumRMSLE = result.m_lumRMSLE;
+  metrics->psnr = result.m_psnr;
+  return true;
+}
+
+void GPURealTimeBC6H_ContextSetMeasureQuality(GPURealTimeBC6H_Context* context, bool measureQuality)
+{
+  context->m_compressor.SetMeasureQuality(measureQuality);
+}
+
+void GPURealTimeBC6H_ContextGetMetrics(GPURealTimeBC6H_Context* context, GPURealTimeBC6H_Metrics* metrics)
+{
+  const BC6HMetrics::SResult& result = context->m_compressor.GetMetrics();
+  metrics->rgbRMSLE = result.m_rgbRMSLE;
+  metrics->lumRMSLE = result.m_lumRMSLE;
+  metrics->psnr = result.m_psnr;
+}
+
+float GPURealTimeBC6H_ContextGetGPUCompressionTime(GPURealTimeBC6H_Context* context)
+{
+  return context->m_compressor.GetGPUCompressionTime();
+}
+
+void GPURealTimeBC6H_ContextGetStats(GPURealTimeBC6H_Context* context, GPURealTimeBC6H_Stats* stats)
 {
-  gCompressor.Release();
-}
\ No newline at end of file
+  static_assert(GPURealTimeBC6H_Stage_Count == BC6HStats::STAGE_NUM, "Stage enums are out of sync");
+
+  BC6HStats::SStats statsCpp;
+  context->m_compressor.GetStats(statsCpp);
+  stats->compressCount = statsCpp.m_compressCount;
+  stats->bytesIn = statsCpp.m_bytesIn;
+  stats->bytesOut = statsCpp.m_bytesOut;
+  stats->gpuSamplesDropped = statsCpp.m_gpuSamplesDropped;
+  stats->constantBlocks = statsCpp.m_blocks.m_constant;
+  stats->nearConstantBlocks = statsCpp.m_blocks.m_nearConstant;
+  stats->encodedBlocks = statsCpp.m_blocks.m_encoded;
+  stats->cachedBlocks = statsCpp.m_blocks.m_cached;
+  stats->p2SkippedBlocks = statsCpp.m_blocks.m_p2Skipped;
+  stats->rdoChangedBlocks = statsCpp.m_rdo.m_changedBlocks;
+  stats->rdoLZSizeBefore = statsCpp.m_rdo.m_lzSizeBefore;
+  stats->rdoLZSizeAfter = statsCpp.m_rdo.m_lzSizeAfter;
+  for (uint32_t i = 0; i < BC6HStats::STAGE_NUM; ++i)
+  {
+    const BC6HStats::SStageStats& stage = statsCpp.m_stages[i];
+    stats->stages[i].count = stage.m_count;
+    stats->stages[i].last = stage.m_last;
+    stats->stages[i].mean = stage.m_mean;
+    stats->stages[i].p50 = stage.m_p50;
+    stats->stages[i].p90 = stage.m_p90;
+    stats->stages[i].p99 = stage.m_p99;
+    stats->stages[i].max = stage.m_max;
+  }
+}
+
+void GPURealTimeBC6H_ContextResetStats(GPURealTimeBC6H_Context* context)
+{
+  context->m_compressor.ResetStats();
+}
@@ -1,11 +1,22 @@
 #include "GPURealTimeBC6H.h"
+#include "BC6HEncoderCPU.h"
+#include "BC6HDecoderCPU.h"
+#include "BC6HMipChain.h"
+#include "BC6HPipeline.h"
+#include "MappedFile.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <thread>
 
+#if HAVE_D3D11
 namespace Shaders
 {
   #include "shaders/compress_quality.inc"
   #include "shaders/compress_speed.inc"
 }
+#endif
 
 #define SAFE_RELEASE(x) { if (x) { safeRelease(reinterpret_cast<void**>(&x), #x); } }
 #define CHECK_HR(message) if (hr < 0) \
@@ -31,38 +42,69 @@ namespace
     uint32_t m_padding;
   };
 
-  // https://gist.github.com/rygorous/2144712
-  static float HalfToFloat(uint16_t h)
+  uint32_t DivideAndRoundUp(uint32_t x, uint32_t divisor)
+  {
+    return (x + divisor - 1) / divisor;
+  }
+
+  struct BufferBC6H
+  {
+    uint32_t color[4];
+  };
+
+  // Uncompressed formats the encoder reads directly
+  bool GetTexelFormat(SImage::ImageFormat format, BC6HEncoderCPU::TexelFormat& texelFormat)
   {
-    union FP32
+    switch (format)
     {
-      uint32_t    u;
-      float       f;
-      struct
-      {
-        unsigned Mantissa : 23;
-        unsigned Exponent : 8;
-        unsigned Sign : 1;
-      };
-    };
+    case SImage::ImageFormat::RGBA32F:
+      texelFormat = BC6HEncoderCPU::TexelFormat::RGBA32F;
+      return true;
+    case SImage::ImageFormat::RGBA16F:
+      texelFormat = BC6HEncoderCPU::TexelFormat::RGBA16F;
+      return true;
+    case SImage::ImageFormat::RGB32F:
+      texelFormat = BC6HEncoderCPU::TexelFormat::RGB32F;
+      return true;
+    case SImage::ImageFormat::RGB16F:
+      texelFormat = BC6HEncoderCPU::TexelFormat::RGB16F;
+      return true;
+    case SImage::ImageFormat::RGB9E5:
+      texelFormat = BC6HEncoderCPU::TexelFormat::RGB9E5;
+      return true;
+    default:
+      return false;
+    }
+  }
 
-    static const FP32 magic = { (254 - 15) << 23 };
-    static const FP32 was_infnan = { (127 + 16) << 23 };
+  // SImage::m_dataSize is 32 bit
+  bool CheckDataSize(uint64_t dataSize)
+  {
+    if (dataSize > UINT32_MAX)
+    {
+      std::cerr << "GPURealTimeBC6H: output of " << dataSize << " bytes doesn't fit in 4 GB" << std::endl;
+      return false;
+    }
+    return true;
+  }
 
-    FP32 o;
-    o.u = (h & 0x7fff) << 13;     // exponent/mantissa bits
-    o.f *= magic.f;                 // exponent adjust
-    if (o.f >= was_infnan.f)        // make sure Inf/NaN survive
-      o.u |= 255 << 23;
-    o.u |= (h & 0x8000) << 16;    // sign bit
-    return o.f;
+  uint32_t GetRowPitch(const SImage* image, BC6HEncoderCPU::TexelFormat texelFormat)
+  {
+    return image->m_rowPitch != 0 ? image->m_rowPitch : image->m_width * BC6HEncoderCPU::GetTexelBytes(texelFormat);
   }
 
-  uint32_t DivideAndRoundUp(uint32_t x, uint32_t divisor)
+  bool CheckRowPitch(const SImage* image, BC6HEncoderCPU::TexelFormat texelFormat)
   {
-    return (x + divisor - 1) / divisor;
+    uint32_t rowPitch = GetRowPitch(image, texelFormat);
+    if (rowPitch < image->m_width * BC6HEncoderCPU::GetTexelBytes(texelFormat))
+    {
+      std::cerr << "GPURealTimeBC6H: row pitch " << rowPitch << " is smaller than a row of " << image->m_width << " texels" << std::endl;
+      return false;
+    }
+    return true;
   }
 
+#if HAVE_D3D11
   uint32_t roundUp(uint32_t numToRound, uint32_t multiple)
   {
     if (multiple == 0)
@@ -75,10 +117,45 @@ namespace
     return numToRound + multiple - remainder;
   }
 
-  struct BufferBC6H
+  // Fills initialData for an immutable source texture and returns its format. There are no gatherable 3 channel
+  // DXGI formats, RGB32F and RGB16F are expanded to four channels with the alpha set to 1.
+  DXGI_FORMAT PrepareUpload(const uint8_t* texels, BC6HEncoderCPU::TexelFormat format, uint32_t rowPitch, uint32_t width, uint32_t height,
+    std::vector<uint8_t>& expanded, D3D11_SUBRESOURCE_DATA& initialData)
   {
-    UINT color[4];
-  };
+    initialData.pSysMem = texels;
+    initialData.SysMemPitch = rowPitch;
+    initialData.SysMemSlicePitch = 0;
+
+    switch (format)
+    {
+    case BC6HEncoderCPU::TexelFormat::RGBA32F:
+      return DXGI_FORMAT_R32G32B32A32_FLOAT;
+    case BC6HEncoderCPU::TexelFormat::RGBA16F:
+      return DXGI_FORMAT_R16G16B16A16_FLOAT;
+    case BC6HEncoderCPU::TexelFormat::RGB9E5:
+      return DXGI_FORMAT_R9G9B9E5_SHAREDEXP;
+    default:
+      break;
+    }
+
+    uint32_t channelBytes = format == BC6HEncoderCPU::TexelFormat::RGB32F ? 4 : 2;
+    uint32_t one = format == BC6HEncoderCPU::TexelFormat::RGB32F ? 0x3F800000 : 0x3C00;
+    expanded.resize(static_cast<size_t>(width) * height * channelBytes * 4);
+    for (uint32_t y = 0; y < height; ++y)
+    {
+      const uint8_t* src = texels + static_cast<size_t>(y) * rowPitch;
+      uint8_t* dst = expanded.data() + static_cast<size_t>(y) * width * channelBytes * 4;
+      for (uint32_t x = 0; x < width; ++x, src += channelBytes * 3, dst += channelBytes * 4)
+      {
+        memcpy(dst, src, channelBytes * 3);
+        memcpy(dst + channelBytes * 3, &one, channelBytes);
+      }
+    }
+
+    initialData.pSysMem = expanded.data();
+    initialData.SysMemPitch = width * channelBytes * 4;
+    return format == BC6HEncoderCPU::TexelFormat::RGB32F ? DXGI_FORMAT_R32G32B32A32_FLOAT : DXGI_FORMAT_R16G16B16A16_FLOAT;
+  }
 
   void safeRelease(void** ptr, const char* name)
   {
@@ -91,9 +168,11 @@ namespace
       *ptr = nullptr; 
     }
   }
+#endif
 }
 
 GPURealTimeBC6H::GPURealTimeBC6H()
+  : m_isa(BC6HEncoderSIMD::DetectISA())
 {
 }
 
@@ -102,8 +181,20 @@ GPURealTimeBC6H::~GPURealTimeBC6H()
 	Release();
 }
 
-bool GPURealTimeBC6H::Init(Preset preset)
+bool GPURealTimeBC6H::Init(Preset preset, Backend backend, const std::shared_ptr<ThreadPool>& threadPool)
 {
+  m_effort = preset == Preset::Quality ? BC6HEffort::QUALITY : BC6HEffort::SPEED;
+  m_backend = backend;
+  m_threadPool = threadPool;
+
+  if (m_backend == Backend::CPU)
+  {
+    if (!m_threadPool)
+      m_threadPool = std::make_shared<ThreadPool>();
+    return true;
+  }
+
+#if HAVE_D3D11
 	D3D_FEATURE_LEVEL featureLevels[] = { D3D_FEATURE_LEVEL_11_0 };
 	D3D_FEATURE_LEVEL retFeatureLevel;
 
@@ -117,8 +208,6 @@ bool GPURealTimeBC6H::Init(Preset preset)
 	_ASSERT(SUCCEEDED(hr));
 	CHECK_HR("D3D11CreateDevice failed");
 
-  m_preset = preset;
-
 	if (!CreateShaders())
 		return false;
 	CreateQueries();
@@ -145,6 +234,14 @@ bool GPURealTimeBC6H::Init(Preset preset)
 	_ASSERT(SUCCEEDED(hr));
 	CHECK_HR("m_device->CreateSamplerState failed");
 
+	// CompressMipChain repeats the edge texels of levels that don't fill their last blocks
+	samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
+	samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_CLAMP;
+	samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
+	hr = m_device->CreateSamplerState(&samplerDesc, &m_clampSampler);
+	_ASSERT(SUCCEEDED(hr));
+	CHECK_HR("m_device->CreateSamplerState(m_clampSampler) failed");
+
 	D3D11_BUFFER_DESC bd;
 	ZeroMemory(&bd, sizeof(bd));
 	bd.Usage = D3D11_USAGE_DEFAULT;
@@ -162,36 +259,15 @@ bool GPURealTimeBC6H::Init(Preset preset)
 	CHECK_HR("m_device->CreateBuffer(m_ib) failed");
 
 	return true;
+#else
+  std::cerr << "GPURealTimeBC6H: D3D11 backend is not available on this platform" << std::endl;
+  return false;
+#endif
 }
 
+#if HAVE_D3D11
 bool GPURealTimeBC6H::CreateTargets()
 {
-	{
-		D3D11_TEXTURE2D_DESC desc;
-		ZeroMemory(&desc, sizeof(desc));
-		desc.Format = DXGI_FORMAT_BC6H_UF16;
-		desc.Usage = D3D11_USAGE_DEFAULT;
-		desc.Width = m_imageWidth;
-		desc.Height = m_imageHeight;
-		desc.MipLevels = 1;
-		desc.ArraySize = 1;
-		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-		desc.SampleDesc.Count = 1;
-		desc.SampleDesc.Quality = 0;
-		HRESULT hr = m_device->CreateTexture2D(&desc, nullptr, &m_compressedTextureRes);
-		_ASSERT(SUCCEEDED(hr));
-		CHECK_HR("m_device->CreateTexture2D(m_compressedTextureRes) failed");
-
-		D3D11_SHADER_RESOURCE_VIEW_DESC resViewDesc;
-		resViewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-		resViewDesc.Format = desc.Format;
-		resViewDesc.Texture2D.MostDetailedMip = 0;
-		resViewDesc.Texture2D.MipLevels = desc.MipLevels;
-		hr = m_device->CreateShaderResourceView(m_compressedTextureRes, &resViewDesc, &m_compressedTextureView);
-		_ASSERT(SUCCEEDED(hr));
-		CHECK_HR("m_device->CreateShaderResourceView(m_compressedTextureView) failed");
-	}
-
 	{
 		D3D11_TEXTURE2D_DESC texDesc;
 		texDesc.Width = DivideAndRoundUp(m_imageWidth, BC_BLOCK_SIZE);
@@ -207,30 +283,12 @@ bool GPURealTimeBC6H::CreateTargets()
 		texDesc.MiscFlags = 0;
 		HRESULT hr = m_device->CreateTexture2D(&texDesc, nullptr, &m_compressTargetRes);
 		_ASSERT(SUCCEEDED(hr));
-		CHECK_HR("m_device->CreateShaderResourceView(m_compressedTextureView) failed");
+		CHECK_HR("m_device->CreateTexture2D(m_compressTargetRes) failed");
 
 		hr = m_device->CreateUnorderedAccessView(m_compressTargetRes, nullptr, &m_compressTargetUAV);
 		_ASSERT(SUCCEEDED(hr));
 		CHECK_HR("m_device->CreateUnorderedAccessView(m_compressTargetUAV) failed");
 
-#if HAVE_QUALITY_MEASUREMENT
-		texDesc.Width = m_imageWidth;
-		texDesc.Height = m_imageHeight;
-		texDesc.MipLevels = 1;
-		texDesc.ArraySize = 1;
-		texDesc.Format = DXGI_FORMAT_R16G16B16A16_FLOAT;
-		texDesc.SampleDesc.Count = 1;
-		texDesc.SampleDesc.Quality = 0;
-		texDesc.Usage = D3D11_USAGE_DEFAULT;
-		texDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
-		texDesc.CPUAccessFlags = 0;
-		texDesc.MiscFlags = 0;
-		hr = m_device->CreateTexture2D(&texDesc, nullptr, &m_tmpTargetRes);
-		_ASSERT(SUCCEEDED(hr));
-
-		hr = m_device->CreateRenderTargetView(m_tmpTargetRes, nullptr, &m_tmpTargetView);
-		_ASSERT(SUCCEEDED(hr));
-#endif
 
 		texDesc.Width = DivideAndRoundUp(m_imageWidth, BC_BLOCK_SIZE);
 		texDesc.Height = DivideAndRoundUp(m_imageHeight, BC_BLOCK_SIZE);
@@ -252,14 +310,8 @@ bool GPURealTimeBC6H::CreateTargets()
 
 void GPURealTimeBC6H::DestroyTargets()
 {
-	SAFE_RELEASE(m_compressedTextureView);
-	SAFE_RELEASE(m_compressedTextureRes);
 	SAFE_RELEASE(m_compressTargetUAV);
 	SAFE_RELEASE(m_compressTargetRes);
-#if HAVE_QUALITY_MEASUREMENT
-	SAFE_RELEASE(m_tmpTargetView);
-	SAFE_RELEASE(m_tmpTargetRes);
-#endif
 	SAFE_RELEASE(m_tmpStagingRes);
 }
 
@@ -280,6 +332,50 @@ void GPURealTimeBC6H::CreateQueries()
 		_ASSERT(SUCCEEDED(hr));
 		hr = m_device->CreateQuery(&queryDesc, &m_timeEndQueries[i]);
 		_ASSERT(SUCCEEDED(hr));
+		hr = m_device->CreateQuery(&queryDesc, &m_timeCopyQueries[i]);
+		_ASSERT(SUCCEEDED(hr));
+	}
+}
+
+void GPURealTimeBC6H::DestroyQueries()
+{
+	for (unsigned i = 0; i < MAX_QUERY_FRAME_NUM; ++i)
+	{
+		SAFE_RELEASE(m_disjointQueries[i]);
+		SAFE_RELEASE(m_timeBeginQueries[i]);
+		SAFE_RELEASE(m_timeEndQueries[i]);
+		SAFE_RELEASE(m_timeCopyQueries[i]);
+		m_queryPending[i] = false;
+	}
+}
+
+void GPURealTimeBC6H::ResolveQueries()
+{
+	for (unsigned i = 0; i < MAX_QUERY_FRAME_NUM; ++i)
+	{
+		if (!m_queryPending[i])
+			continue;
+
+		// Never flush or spin here, a query that isn't ready stays pending
+		D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjointData;
+		uint64_t timeBegin;
+		uint64_t timeEnd;
+		uint64_t timeCopy;
+		if (m_ctx->GetData(m_disjointQueries[i], &disjointData, sizeof(disjointData), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK ||
+			m_ctx->GetData(m_timeBeginQueries[i], &timeBegin, sizeof(timeBegin), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK ||
+			m_ctx->GetData(m_timeEndQueries[i], &timeEnd, sizeof(timeEnd), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK ||
+			m_ctx->GetData(m_timeCopyQueries[i], &timeCopy, sizeof(timeCopy), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+		{
+			continue;
+		}
+
+		m_queryPending[i] = false;
+		if (disjointData.Disjoint)
+			continue;
+
+		double msPerTick = 1000.0 / disjointData.Frequency;
+		m_stats.AddSample(BC6HStats::Stage::Encode, static_cast<float>((timeEnd - timeBegin) * msPerTick));
+		m_stats.AddSample(BC6HStats::Stage::Copy, static_cast<float>((timeCopy - timeEnd) * msPerTick));
 	}
 }
 
@@ -303,23 +399,33 @@ bool GPURealTimeBC6H::CreateConstantBuffer()
 	return true;
 }
 
+void GPURealTimeBC6H::UpdateConstantBuffer(uint32_t width, uint32_t height)
+{
+  SShaderCB shaderCB;
+  shaderCB.m_textureSizeInBlocks[0] = DivideAndRoundUp(width, BC_BLOCK_SIZE);
+  shaderCB.m_textureSizeInBlocks[1] = DivideAndRoundUp(height, BC_BLOCK_SIZE);
+  shaderCB.m_imageSizeRcp.x = 1.0f / width;
+  shaderCB.m_imageSizeRcp.y = 1.0f / height;
+  shaderCB.m_texelBias = m_texelBias;
+  shaderCB.m_texelScale = m_texelScale;
+  shaderCB.m_exposure = static_cast<float>(exp(m_imageExposure));
+  shaderCB.m_blitMode = m_blitMode;
+
+  D3D11_MAPPED_SUBRESOURCE mappedRes;
+  m_ctx->Map(m_constantBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedRes);
+  memcpy(mappedRes.pData, &shaderCB, sizeof(shaderCB));
+  m_ctx->Unmap(m_constantBuffer, 0);
+}
+
 bool GPURealTimeBC6H::CreateImage(const SImage* img)
 {
-  DXGI_FORMAT textureFormat;
-  switch (img->m_format)
-  {
-  case SImage::ImageFormat::RGBA32F:
-    /// TODO: support RGBA32 input
-    textureFormat = DXGI_FORMAT_R32G32B32A32_FLOAT;
-    break;
-  default:
+  BC6HEncoderCPU::TexelFormat texelFormat;
+  if (!GetTexelFormat(img->m_format, texelFormat))
     return false;
-  }
 
+  std::vector<uint8_t> expanded;
 	D3D11_SUBRESOURCE_DATA initialData;
-	initialData.pSysMem = img->m_data;
-	initialData.SysMemPitch = img->m_width * sizeof(float) * 4;
-	initialData.SysMemSlicePitch = 0;
+  DXGI_FORMAT textureFormat = PrepareUpload(img->m_data, texelFormat, GetRowPitch(img, texelFormat), img->m_width, img->m_height, expanded, initialData);
 
 	D3D11_TEXTURE2D_DESC desc;
 	ZeroMemory(&desc, sizeof(desc));
@@ -365,19 +471,17 @@ bool GPURealTimeBC6H::CreateShaders()
 #endif
 
   /// TODO: use new shader compiler
-	HRESULT hr;
-  if (m_preset == Preset::Quality)
-  {
-    hr = m_device->CreateComputeShader(Shaders::Compress_Quality, sizeof(Shaders::Compress_Quality), nullptr, &m_compressCS);
-  }
-  else
-  {
-    hr = m_device->CreateComputeShader(Shaders::Compress_Speed, sizeof(Shaders::Compress_Speed), nullptr, &m_compressCS);
-  }
+	HRESULT hr = m_device->CreateComputeShader(Shaders::Compress_Quality, sizeof(Shaders::Compress_Quality), nullptr, &m_compressQualityCS);
+	if (hr < 0)
+	{
+		std::cerr << "m_device->CreateComputeShader(Compress_Quality) failed" << std::endl;
+		return false;
+	}
 
+	hr = m_device->CreateComputeShader(Shaders::Compress_Speed, sizeof(Shaders::Compress_Speed), nullptr, &m_compressSpeedCS);
 	if (hr < 0)
 	{
-		std::cerr << "m_device->CreateComputeShader failed, preset: " << (int)m_preset << std::endl;
+		std::cerr << "m_device->CreateComputeShader(Compress_Speed) failed" << std::endl;
 		return false;
 	}
 
@@ -388,24 +492,380 @@ void GPURealTimeBC6H::DestroyShaders()
 {
 	SAFE_RELEASE(m_blitVS);
 	SAFE_RELEASE(m_blitPS);
-  SAFE_RELEASE(m_compressCS);
+  SAFE_RELEASE(m_compressQualityCS);
+  SAFE_RELEASE(m_compressSpeedCS);
 }
 
+#endif
+
 void GPURealTimeBC6H::Release()
 {
+  m_threadPool.reset();
+  m_blockCache.reset();
+
+#if HAVE_D3D11
 	DestroyTargets();
 	DestroyShaders();
+	DestroyQueries();
+	SAFE_RELEASE(m_clampSampler);
 	SAFE_RELEASE(m_ctx);
 	SAFE_RELEASE(m_device);
+#endif
+}
+
+bool GPURealTimeBC6H::CompressCPU(const SImage* srcImage, SImage* dstImage, BC6HStats::SFrame& frame)
+{
+  if (!m_threadPool)
+  {
+    std::cerr << "GPURealTimeBC6H: CPU backend is not initialized" << std::endl;
+    return false;
+  }
+
+  m_imageWidth = srcImage->m_width;
+  m_imageHeight = srcImage->m_height;
+
+  BC6HEncoderCPU::TexelFormat texelFormat = BC6HEncoderCPU::TexelFormat::RGBA32F;
+  GetTexelFormat(srcImage->m_format, texelFormat);
+
+  double encodeStart = BC6HStats::Now();
+  BC6HEncoderCPU::CompressImage(srcImage->m_data, texelFormat, GetRowPitch(srcImage, texelFormat), m_imageWidth, m_imageHeight, m_effort, m_p2Threshold, m_isa, m_threadPool.get(), dstImage->m_data, &frame.m_blocks, m_blockCache.get(), m_tileOrder);
+  frame.Record(BC6HStats::Stage::Encode, encodeStart);
+
+  ++m_frameID;
+  return true;
+}
+
+uint64_t GPURealTimeBC6H::GetCompressedSize(uint32_t width, uint32_t height, uint32_t sliceNum)
+{
+  return static_cast<uint64_t>(DivideAndRoundUp(width, BC_BLOCK_SIZE)) * DivideAndRoundUp(height, BC_BLOCK_SIZE) * sizeof(BufferBC6H) * sliceNum;
 }
 
 bool GPURealTimeBC6H::Compress(const SImage* srcImage, SImage* dstImage)
 {
+  double startTime = BC6HStats::Now();
+
 	// All the compression is essentially single-threaded due to the DX11 nature
 	std::lock_guard<std::mutex> lk(m_compressMutex);
 
-  bool sizeChanged = srcImage->m_width != m_imageWidth || dstImage->m_width != m_imageHeight;
+  BC6HStats::SFrame frame;
+  frame.Record(BC6HStats::Stage::LockWait, startTime);
+  return CompressUnlocked(srcImage, dstImage, true, startTime, frame);
+}
+
+bool GPURealTimeBC6H::CompressInto(const SImage* srcImage, SImage* dstImage)
+{
+  double startTime = BC6HStats::Now();
+  std::lock_guard<std::mutex> lk(m_compressMutex);
+
+  BC6HStats::SFrame frame;
+  frame.Record(BC6HStats::Stage::LockWait, startTime);
+  return CompressUnlocked(srcImage, dstImage, false, startTime, frame);
+}
+
+bool GPURealTimeBC6H::CompressUnlocked(const SImage* srcImage, SImage* dstImage, bool allocate, double startTime, BC6HStats::SFrame& frame)
+{
+  uint32_t sliceNum = srcImage->m_sliceNum;
+  BC6HEncoderCPU::TexelFormat texelFormat;
+  if (!GetTexelFormat(srcImage->m_format, texelFormat) || sliceNum == 0)
+    return false;
+
+  if (!CheckRowPitch(srcImage, texelFormat))
+    return false;
+
+  uint64_t dataSize = GetCompressedSize(srcImage->m_width, srcImage->m_height, sliceNum);
+  if (!CheckDataSize(dataSize))
+    return false;
+
+  if (allocate)
+  {
+    double allocationStart = BC6HStats::Now();
+    dstImage->m_data = static_cast<uint8_t*>(malloc(static_cast<size_t>(dataSize)));
+    if (!dstImage->m_data)
+      return false;
+    frame.Record(BC6HStats::Stage::Allocation, allocationStart);
+  }
+  else if (!dstImage->m_data || dstImage->m_dataSize < dataSize)
+  {
+    std::cerr << "GPURealTimeBC6H: output buffer of " << dstImage->m_dataSize << " bytes is too small, " << dataSize << " needed" << std::endl;
+    return false;
+  }
+
+  dstImage->m_width = DivideAndRoundUp(srcImage->m_width, BC_BLOCK_SIZE);
+  dstImage->m_height = DivideAndRoundUp(srcImage->m_height, BC_BLOCK_SIZE);
+  dstImage->m_format = SImage::ImageFormat::BC6H;
+  dstImage->m_dataSize = static_cast<unsigned>(dataSize);
+  dstImage->m_sliceNum = sliceNum;
+  dstImage->m_slicePitch = static_cast<unsigned>(dataSize / sliceNum);
+
+  bool result;
+  if (sliceNum > 1)
+  {
+    result = CompressSlices(srcImage, dstImage, frame);
+  }
+  else
+  {
+    result = m_backend == Backend::CPU ? CompressCPU(srcImage, dstImage, frame) : CompressD3D11(srcImage, dstImage, frame);
+    if (result)
+      OptimizeSurfaces(std::vector<SSurface>{ SSurface{ srcImage->m_width, srcImage->m_height, srcImage->m_data, texelFormat, GetRowPitch(srcImage, texelFormat), 0 } }, dstImage, frame);
+  }
+  if (!result)
+  {
+    if (allocate)
+      FreeImage(dstImage);
+    return false;
+  }
+
+  // BC6HMetrics works on a single surface, texture arrays aren't measured
+  if (m_measureQuality && sliceNum == 1)
+  {
+    double measureStart = BC6HStats::Now();
+    MeasureUnlocked(srcImage, dstImage, m_metrics, nullptr);
+    frame.Record(BC6HStats::Stage::Measure, measureStart);
+  }
+
+  frame.Record(BC6HStats::Stage::Total, startTime);
+  uint64_t bytesIn = static_cast<uint64_t>(srcImage->m_width) * srcImage->m_height * BC6HEncoderCPU::GetTexelBytes(texelFormat) * sliceNum;
+  m_stats.AddFrame(frame, bytesIn, dstImage->m_dataSize);
+  return true;
+}
+
+bool GPURealTimeBC6H::CompressBatch(const SImage* srcImages, uint32_t imageNum, uint32_t depth, const BatchCallback& callback)
+{
+  std::lock_guard<std::mutex> lk(m_compressMutex);
+
+  struct SSlot
+  {
+    std::vector<uint8_t> m_blocks;
+    SImage m_dstImage;
+    BC6HStats::SFrame m_frame;
+    double m_startTime = 0.0;
+    // Single slice D3D11 images go through the three stages, anything else is compressed whole by the encode stage
+    bool m_pipelined = false;
+#if HAVE_D3D11
+    ID3D11Texture2D* m_sourceRes = nullptr;
+    ID3D11ShaderResourceView* m_sourceView = nullptr;
+    ID3D11Texture2D* m_stagingRes = nullptr;
+#endif
+  };
+  std::vector<SSlot> slots(depth > 0 ? depth : 1);
+  // The immediate context is shared by the encode and the finish stage
+  std::mutex ctxMutex;
+
+  BC6HPipeline::SStages stages;
+  stages.m_prepare = [&](uint32_t i, uint32_t slotIndex)
+  {
+    const SImage* srcImage = &srcImages[i];
+    SSlot& slot = slots[slotIndex];
+    slot.m_startTime = BC6HStats::Now();
+    slot.m_frame = BC6HStats::SFrame();
+    slot.m_dstImage = SImage();
+
+    BC6HEncoderCPU::TexelFormat texelFormat;
+    if (!GetTexelFormat(srcImage->m_format, texelFormat) || srcImage->m_sliceNum == 0 || !CheckRowPitch(srcImage, texelFormat))
+      return false;
+
+    double allocationStart = BC6HStats::Now();
+    uint64_t dataSize = GetCompressedSize(srcImage->m_width, srcImage->m_height, srcImage->m_sliceNum);
+    if (!CheckDataSize(dataSize))
+      return false;
+    if (slot.m_blocks.size() < dataSize)
+      slot.m_blocks.resize(static_cast<size_t>(dataSize));
+    slot.m_frame.Record(BC6HStats::Stage::Allocation, allocationStart);
+
+    slot.m_dstImage.m_format = SImage::ImageFormat::BC6H;
+    slot.m_dstImage.m_width = DivideAndRoundUp(srcImage->m_width, BC_BLOCK_SIZE);
+    slot.m_dstImage.m_height = DivideAndRoundUp(srcImage->m_height, BC_BLOCK_SIZE);
+    slot.m_dstImage.m_data = slot.m_blocks.data();
+    slot.m_dstImage.m_dataSize = static_cast<unsigned>(dataSize);
+    slot.m_dstImage.m_slicePitch = static_cast<unsigned>(dataSize);
+    slot.m_pipelined = m_backend == Backend::D3D11 && srcImage->m_sliceNum == 1;
+    if (!slot.m_pipelined)
+      return true;
+
+#if HAVE_D3D11
+    // Texture creation only needs the device, which is free threaded
+    double uploadStart = BC6HStats::Now();
+    std::vector<uint8_t> expanded;
+    D3D11_SUBRESOURCE_DATA initialData;
+    DXGI_FORMAT format = PrepareUpload(srcImage->m_data, texelFormat, GetRowPitch(srcImage, texelFormat), srcImage->m_width, srcImage->m_height, expanded, initialData);
+
+    D3D11_TEXTURE2D_DESC desc;
+    ZeroMemory(&desc, sizeof(desc));
+    desc.Format = format;
+    desc.Width = srcImage->m_width;
+    desc.Height = srcImage->m_height;
+    desc.MipLevels = 1;
+    desc.ArraySize = 1;
+    desc.Usage = D3D11_USAGE_IMMUTABLE;
+    desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+    desc.SampleDesc.Count = 1;
+    desc.SampleDesc.Quality = 0;
+    HRESULT hr = m_device->CreateTexture2D(&desc, &initialData, &slot.m_sourceRes);
+    _ASSERT(SUCCEEDED(hr));
+    CHECK_HR("m_device->CreateTexture2D(slot.m_sourceRes) failed");
+
+    hr = m_device->CreateShaderResourceView(slot.m_sourceRes, nullptr, &slot.m_sourceView);
+    _ASSERT(SUCCEEDED(hr));
+    CHECK_HR("m_device->CreateShaderResourceView(slot.m_sourceView) failed");
+
+    D3D11_TEXTURE2D_DESC stagingDesc;
+    ZeroMemory(&stagingDesc, sizeof(stagingDesc));
+    stagingDesc.Width = slot.m_dstImage.m_width;
+    stagingDesc.Height = slot.m_dstImage.m_height;
+    stagingDesc.MipLevels = 1;
+    stagingDesc.ArraySize = 1;
+    stagingDesc.Format = DXGI_FORMAT_R32G32B32A32_UINT;
+    stagingDesc.SampleDesc.Count = 1;
+    stagingDesc.Usage = D3D11_USAGE_STAGING;
+    stagingDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+    hr = m_device->CreateTexture2D(&stagingDesc, nullptr, &slot.m_stagingRes);
+    _ASSERT(SUCCEEDED(hr));
+    CHECK_HR("m_device->CreateTexture2D(slot.m_stagingRes) failed");
+    slot.m_frame.Record(BC6HStats::Stage::Upload, uploadStart);
+    return true;
+#else
+    return false;
+#endif
+  };
+
+  stages.m_encode = [&](uint32_t i, uint32_t slotIndex)
+  {
+    const SImage* srcImage = &srcImages[i];
+    SSlot& slot = slots[slotIndex];
+    std::lock_guard<std::mutex> ctxLock(ctxMutex);
+    if (!slot.m_pipelined)
+      return CompressUnlocked(srcImage, &slot.m_dstImage, false, slot.m_startTime, slot.m_frame);
+
+#if HAVE_D3D11
+    // Stage::Encode gets the GPU timestamps of the dispatch like CompressD3D11, not the CPU time to submit it
+    ResolveQueries();
+    if (srcImage->m_width != m_imageWidth || srcImage->m_height != m_imageHeight)
+    {
+      m_imageWidth = srcImage->m_width;
+      m_imageHeight = srcImage->m_height;
+      DestroyTargets();
+      if (!CreateTargets())
+        return false;
+    }
+
+    ID3D11ComputeShader* compressCS = GetCompressCS();
+    if (!compressCS)
+    {
+      std::cerr << "compressCS == nullptr" << std::endl;
+      return false;
+    }
+
+    m_ctx->ClearState();
+    UpdateConstantBuffer(m_imageWidth, m_imageHeight);
+    m_ctx->CSSetShader(compressCS, nullptr, 0);
+    m_ctx->CSSetUnorderedAccessViews(0, 1, &m_compressTargetUAV, nullptr);
+    m_ctx->CSSetShaderResources(0, 1, &slot.m_sourceView);
+    m_ctx->CSSetSamplers(0, 1, &m_pointSampler);
+    m_ctx->CSSetConstantBuffers(0, 1, &m_constantBuffer);
+
+    uint32_t querySlot = m_frameID % MAX_QUERY_FRAME_NUM;
+    if (m_queryPending[querySlot])
+      m_stats.AddGPUSampleDropped();
+    m_ctx->Begin(m_disjointQueries[querySlot]);
+    m_ctx->End(m_timeBeginQueries[querySlot]);
+
+    uint32_t threadsX = 8;
+    uint32_t threadsY = 8;
+    m_ctx->Dispatch(DivideAndRoundUp(m_imageWidth, BC_BLOCK_SIZE * threadsX), DivideAndRoundUp(m_imageHeight, BC_BLOCK_SIZE * threadsY), 1);
+    m_ctx->End(m_timeEndQueries[querySlot]);
+
+    // The next image reuses the target, the GPU runs the copy before its dispatch.
+    // Flushed right away, the finish stage polls the staging texture without holding the context.
+    m_ctx->CopyResource(slot.m_stagingRes, m_compressTargetRes);
+    m_ctx->End(m_timeCopyQueries[querySlot]);
+    m_ctx->End(m_disjointQueries[querySlot]);
+    m_queryPending[querySlot] = true;
+    m_ctx->Flush();
+    ++m_frameID;
+    return true;
+#else
+    return false;
+#endif
+  };
+
+  stages.m_finish = [&](uint32_t i, uint32_t slotIndex, bool ok)
+  {
+    const SImage* srcImage = &srcImages[i];
+    SSlot& slot = slots[slotIndex];
+#if HAVE_D3D11
+    if (ok && slot.m_pipelined)
+    {
+      double readbackStart = BC6HStats::Now();
+      D3D11_MAPPED_SUBRESOURCE mappedTexRes;
+      HRESULT hr;
+      for (;;)
+      {
+        {
+          std::lock_guard<std::mutex> ctxLock(ctxMutex);
+          hr = m_ctx->Map(slot.m_stagingRes, 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &mappedTexRes);
+        }
+        if (hr != DXGI_ERROR_WAS_STILL_DRAWING)
+          break;
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+      }
+
+      if (SUCCEEDED(hr))
+      {
+        uint32_t rowBytes = slot.m_dstImage.m_width * sizeof(BufferBC6H);
+        for (uint32_t blockY = 0; blockY < slot.m_dstImage.m_height; ++blockY)
+          memcpy(slot.m_dstImage.m_data + static_cast<size_t>(blockY) * rowBytes, static_cast<const uint8_t*>(mappedTexRes.pData) + static_cast<size_t>(blockY) * mappedTexRes.RowPitch, rowBytes);
+
+        std::lock_guard<std::mutex> ctxLock(ctxMutex);
+        m_ctx->Unmap(slot.m_stagingRes, 0);
+      }
+      else
+      {
+        std::cerr << "GPURealTimeBC6H: m_ctx->Map(slot.m_stagingRes) failed" << std::endl;
+        ok = false;
+      }
+      slot.m_frame.Record(BC6HStats::Stage::Readback, readbackStart);
+    }
+
+    SAFE_RELEASE(slot.m_stagingRes);
+    SAFE_RELEASE(slot.m_sourceView);
+    SAFE_RELEASE(slot.m_sourceRes);
+#endif
+
+    // CompressUnlocked already optimized, measured and counted the other images
+    if (ok && slot.m_pipelined)
+    {
+      BC6HEncoderCPU::TexelFormat texelFormat = BC6HEncoderCPU::TexelFormat::RGBA32F;
+      GetTexelFormat(srcImage->m_format, texelFormat);
+      OptimizeSurfaces(std::vector<SSurface>{ SSurface{ srcImage->m_width, srcImage->m_height, srcImage->m_data, texelFormat, GetRowPitch(srcImage, texelFormat), 0 } }, &slot.m_dstImage, slot.m_frame);
+
+      if (m_measureQuality)
+      {
+        double measureStart = BC6HStats::Now();
+        MeasureUnlocked(srcImage, &slot.m_dstImage, m_metrics, nullptr);
+        slot.m_frame.Record(BC6HStats::Stage::Measure, measureStart);
+      }
+
+      slot.m_frame.Record(BC6HStats::Stage::Total, slot.m_startTime);
+      uint64_t bytesIn = static_cast<uint64_t>(srcImage->m_width) * srcImage->m_height * BC6HEncoderCPU::GetTexelBytes(texelFormat);
+      m_stats.AddFrame(slot.m_frame, bytesIn, slot.m_dstImage.m_dataSize);
+    }
+
+    callback(i, &slot.m_dstImage, ok);
+    return ok;
+  };
+
+  // The stages run on their own threads and can all reach GetThreadPool, start the workers here
+  // rather than racing on the lazy creation
+  GetThreadPool();
+  return BC6HPipeline::Run(imageNum, static_cast<uint32_t>(slots.size()), stages);
+}
+
+#if HAVE_D3D11
+bool GPURealTimeBC6H::CompressD3D11(const SImage* srcImage, SImage* dstImage, BC6HStats::SFrame& frame)
+{
+  bool sizeChanged = srcImage->m_width != m_imageWidth || srcImage->m_height != m_imageHeight;
 
+  double uploadStart = BC6HStats::Now();
   if (!CreateImage(srcImage))
     return false;
 
@@ -415,35 +875,27 @@ bool GPURealTimeBC6H::Compress(const SImage* srcImage, SImage* dstImage)
 		if (!CreateTargets())
 			return false;
   }
+  frame.Record(BC6HStats::Stage::Upload, uploadStart);
 
 	m_ctx->ClearState();
 
 	m_ctx->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
 	m_ctx->IASetIndexBuffer(m_ib, DXGI_FORMAT_R16_UINT, 0);
 
-  {
-    SShaderCB shaderCB;
-    shaderCB.m_textureSizeInBlocks[0] = DivideAndRoundUp(m_imageWidth, BC_BLOCK_SIZE);
-    shaderCB.m_textureSizeInBlocks[1] = DivideAndRoundUp(m_imageHeight, BC_BLOCK_SIZE);
-    shaderCB.m_imageSizeRcp.x = 1.0f / m_imageWidth;
-    shaderCB.m_imageSizeRcp.y = 1.0f / m_imageHeight;
-    shaderCB.m_texelBias = m_texelBias;
-    shaderCB.m_texelScale = m_texelScale;
-    shaderCB.m_exposure = static_cast<float>(exp(m_imageExposure));
-    shaderCB.m_blitMode = m_blitMode;
+  UpdateConstantBuffer(m_imageWidth, m_imageHeight);
 
-    D3D11_MAPPED_SUBRESOURCE mappedRes;
-    m_ctx->Map(m_constantBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedRes);
-    memcpy(mappedRes.pData, &shaderCB, sizeof(shaderCB));
-    m_ctx->Unmap(m_constantBuffer, 0);
-  }
+  // The slot is reused every MAX_QUERY_FRAME_NUM frames, a result that still isn't ready by then is lost
+  uint32_t querySlot = m_frameID % MAX_QUERY_FRAME_NUM;
+  if (m_queryPending[querySlot])
+    m_stats.AddGPUSampleDropped();
 
-	m_ctx->Begin(m_disjointQueries[m_frameID % MAX_QUERY_FRAME_NUM]);
-	m_ctx->End(m_timeBeginQueries[m_frameID % MAX_QUERY_FRAME_NUM]);
+	m_ctx->Begin(m_disjointQueries[querySlot]);
+	m_ctx->End(m_timeBeginQueries[querySlot]);
 
-	if (m_compressCS)
+	ID3D11ComputeShader* compressCS = GetCompressCS();
+	if (compressCS)
 	{
-		m_ctx->CSSetShader(m_compressCS, nullptr, 0);
+		m_ctx->CSSetShader(compressCS, nullptr, 0);
 		m_ctx->CSSetUnorderedAccessViews(0, 1, &m_compressTargetUAV, nullptr);
 		m_ctx->CSSetShaderResources(0, 1, &m_sourceTextureView);
 		m_ctx->CSSetSamplers(0, 1, &m_pointSampler);
@@ -455,219 +907,1045 @@ bool GPURealTimeBC6H::Compress(const SImage* srcImage, SImage* dstImage)
 	}
   else
   {
-		std::cerr << "m_compressCS == nullptr" << std::endl;
+		std::cerr << "compressCS == nullptr" << std::endl;
     return false;
   }
 
-	m_ctx->End(m_timeEndQueries[m_frameID % MAX_QUERY_FRAME_NUM]);
-	m_ctx->End(m_disjointQueries[m_frameID % MAX_QUERY_FRAME_NUM]);
+	m_ctx->End(m_timeEndQueries[querySlot]);
 
-	/// TODO: get away with just 1 copy
-	m_ctx->CopyResource(m_compressedTextureRes, m_compressTargetRes);
-	m_ctx->CopyResource(m_tmpStagingRes, m_compressedTextureRes);
+	m_ctx->CopyResource(m_tmpStagingRes, m_compressTargetRes);
 
-  // Read the compressed texture
+	m_ctx->End(m_timeCopyQueries[querySlot]);
+	m_ctx->End(m_disjointQueries[querySlot]);
+	m_queryPending[querySlot] = true;
+
+  // Read the compressed texture, row by row as the staging rows can be padded
   {
+    double readbackStart = BC6HStats::Now();
     D3D11_MAPPED_SUBRESOURCE mappedTexRes;
-    m_ctx->Map(m_tmpStagingRes, 0, D3D11_MAP_READ, 0, &mappedTexRes);
-    if (mappedTexRes.pData)
-    {
-      // https://github.com/walbourn/directx-sdk-samples/blob/main/BC6HBC7EncoderCS/utils.cpp
-      dstImage->m_width = DivideAndRoundUp(m_imageWidth, BC_BLOCK_SIZE);
-      dstImage->m_height = DivideAndRoundUp(m_imageHeight, BC_BLOCK_SIZE);
-      dstImage->m_format = SImage::ImageFormat::BC6H;
-      dstImage->m_dataSize = dstImage->m_width * dstImage->m_height * sizeof(BufferBC6H);
-      dstImage->m_data = static_cast<uint8_t*>(malloc(dstImage->m_dataSize));
-			if (mappedTexRes.RowPitch == dstImage->m_width * sizeof(BufferBC6H)) 
-			{
-				memcpy(dstImage->m_data, mappedTexRes.pData, dstImage->m_dataSize);
-			}
-			else 
-			{
-				memset(dstImage->m_data, 255, dstImage->m_dataSize);
-				std::cerr << "mappedTexRes.RowPitch:" << mappedTexRes.RowPitch << "; dstImage->m_width * sizeof(BufferBC6H):" << dstImage->m_width * sizeof(BufferBC6H) << std::endl;
-				return false;
-			}
-
-#if 0
-			// Debug
-			int nonZero = 0;
-			for (int i = 0; i < dstImage->m_dataSize; ++i)
-			{
-				if (dstImage->m_data[i] != 0)
-					nonZero += 1;
-			}
-			//std::cerr << "Nonzero bc6 block values:" << nonZero << std::endl;
-			if (nonZero == 0)
-				std::cerr << "All bc6 block values are zero" << std::endl;
-#endif
+    HRESULT hr = m_ctx->Map(m_tmpStagingRes, 0, D3D11_MAP_READ, 0, &mappedTexRes);
+    CHECK_HR("m_ctx->Map(m_tmpStagingRes) failed");
 
-      m_ctx->Unmap(m_tmpStagingRes, 0);
+    // https://github.com/walbourn/directx-sdk-samples/blob/main/BC6HBC7EncoderCS/utils.cpp
+    uint32_t rowBytes = dstImage->m_width * sizeof(BufferBC6H);
+    if (mappedTexRes.RowPitch == rowBytes)
+    {
+      memcpy(dstImage->m_data, mappedTexRes.pData, dstImage->m_dataSize);
     }
     else
     {
-			std::cerr << "mappedTexRes.pData == nullptr" << std::endl;
-      return false;
+      for (uint32_t blockY = 0; blockY < dstImage->m_height; ++blockY)
+        memcpy(dstImage->m_data + blockY * rowBytes, static_cast<const uint8_t*>(mappedTexRes.pData) + blockY * mappedTexRes.RowPitch, rowBytes);
     }
-  }
 
-#if HAVE_QUALITY_MEASUREMENT
-	if (m_updateRMSE)
-	{
-		UpdateRMSE();
-		m_updateRMSE = false;
-	}
-#endif
+    m_ctx->Unmap(m_tmpStagingRes, 0);
+    frame.Record(BC6HStats::Stage::Readback, readbackStart);
+  }
 
 	++m_frameID;
 
-	D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjointData;
-	uint64_t timeStart;
-	uint64_t timeEnd;
-
-	if (m_frameID > m_frameID % MAX_QUERY_FRAME_NUM)
-	{
-		while (m_ctx->GetData(m_disjointQueries[m_frameID % MAX_QUERY_FRAME_NUM], &disjointData, sizeof(disjointData), 0) != S_OK)
-		{
-			int e = 0;
-		}
-
-		while (m_ctx->GetData(m_timeBeginQueries[m_frameID % MAX_QUERY_FRAME_NUM], &timeStart, sizeof(timeStart), 0) != S_OK)
-		{
-			int e = 0;
-		}
-
-		while (m_ctx->GetData(m_timeEndQueries[m_frameID % MAX_QUERY_FRAME_NUM], &timeEnd, sizeof(timeEnd), 0) != S_OK)
-		{
-			int e = 0;
-		}
-
-		if (!disjointData.Disjoint)
-		{
-			uint64_t delta = (timeEnd - timeStart) * 1000;
-			m_timeAcc += delta / (float)disjointData.Frequency;
-			++m_timeAccSampleNum;
-		}
-
-		if (m_timeAccSampleNum > 100)
-		{
-			m_compressionTime = m_timeAcc / m_timeAccSampleNum;
-			m_timeAcc = 0.0f;
-			m_timeAccSampleNum = 0;
-		}
-	}
+  // The staging map has usually waited for the timestamps as well, whatever isn't ready is picked up later
+	ResolveQueries();
 
   DestroyImage();
 
   return true;
 }
-
-void GPURealTimeBC6H::FreeImage(SImage* dstImage)
+#else
+bool GPURealTimeBC6H::CompressD3D11(const SImage*, SImage*, BC6HStats::SFrame&)
 {
-  free(dstImage->m_data);
-  dstImage->m_data = nullptr;
+  return false;
 }
+#endif
 
-#if HAVE_QUALITY_MEASUREMENT
-void GPURealTimeBC6H::CopyTexture(Vec3* image, ID3D11ShaderResourceView* srcView)
+bool GPURealTimeBC6H::CompressSlices(const SImage* srcImage, SImage* dstImage, BC6HStats::SFrame& frame)
 {
-	if (m_blitVS && m_blitPS)
-	{
-		m_ctx->OMSetRenderTargets(1, &m_tmpTargetView, nullptr);
-		D3D11_VIEWPORT vp;
-		vp.Width = (float)m_imageWidth;
-		vp.Height = (float)m_imageHeight;
-		vp.MinDepth = 0.0f;
-		vp.MaxDepth = 1.0f;
-		vp.TopLeftX = 0;
-		vp.TopLeftY = 0;
-		m_ctx->RSSetViewports(1, &vp);
-
-		m_ctx->VSSetShader(m_blitVS, nullptr, 0);
-		m_ctx->PSSetShader(m_blitPS, nullptr, 0);
-		m_ctx->PSSetShaderResources(0, 1, &srcView);
-		m_ctx->PSSetShaderResources(1, 1, &srcView);
-		m_ctx->PSSetSamplers(0, 1, &m_pointSampler);
-
-		m_ctx->DrawIndexed(4, 0, 0);
-		m_ctx->CopyResource(m_tmpStagingRes, m_tmpTargetRes);
-
-		D3D11_MAPPED_SUBRESOURCE mappedRes;
-		m_ctx->Map(m_tmpStagingRes, 0, D3D11_MAP_READ, 0, &mappedRes);
-		if (mappedRes.pData)
-		{
-			for (unsigned y = 0; y < m_imageHeight; ++y)
-			{
-				for (unsigned x = 0; x < m_imageWidth; ++x)
-				{
-					uint16_t tmp[4];
-					memcpy(&tmp, (uint8_t*)mappedRes.pData + mappedRes.RowPitch * y + x * sizeof(tmp), sizeof(tmp));
-
-					image[x + y * m_imageWidth].x = HalfToFloat(tmp[0]);
-					image[x + y * m_imageWidth].y = HalfToFloat(tmp[1]);
-					image[x + y * m_imageWidth].z = HalfToFloat(tmp[2]);
-				}
-			}
-
-			m_ctx->Unmap(m_tmpStagingRes, 0);
-		}
-	}
+  BC6HEncoderCPU::TexelFormat texelFormat = BC6HEncoderCPU::TexelFormat::RGBA32F;
+  GetTexelFormat(srcImage->m_format, texelFormat);
+
+  uint32_t sliceNum = srcImage->m_sliceNum;
+  uint32_t rowPitch = GetRowPitch(srcImage, texelFormat);
+  size_t sliceBytes = static_cast<size_t>(rowPitch) * srcImage->m_height;
+  size_t slicePitch = srcImage->m_slicePitch != 0 ? srcImage->m_slicePitch : sliceBytes;
+  if (slicePitch < sliceBytes)
+  {
+    std::cerr << "GPURealTimeBC6H: slice pitch " << slicePitch << " is smaller than a " << srcImage->m_width << "x" << srcImage->m_height << " slice" << std::endl;
+    return false;
+  }
+
+  std::vector<SSurface> slices(sliceNum);
+  for (uint32_t slice = 0; slice < sliceNum; ++slice)
+  {
+    slices[slice].m_width = srcImage->m_width;
+    slices[slice].m_height = srcImage->m_height;
+    slices[slice].m_texels = srcImage->m_data + slice * slicePitch;
+    slices[slice].m_format = texelFormat;
+    slices[slice].m_rowPitch = rowPitch;
+    slices[slice].m_offset = slice * dstImage->m_slicePitch;
+  }
+
+  return CompressSurfaces(slices, BC6HEncoderCPU::Addressing::Border, dstImage, frame);
 }
 
-void GPURealTimeBC6H::UpdateRMSE()
-{
-	SShaderCB shaderCB;
-	shaderCB.m_imageSizeRcp.x = 1.0f / m_imageWidth;
-	shaderCB.m_imageSizeRcp.y = 1.0f / m_imageHeight;
-	shaderCB.m_texelBias = Vec2(0.0f, 0.0f);
-	shaderCB.m_texelScale = 1.0f;
-	shaderCB.m_exposure = 1.0f;
-	shaderCB.m_blitMode = 0;
-
-	D3D11_MAPPED_SUBRESOURCE mappedRes;
-	m_ctx->Map(m_constantBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedRes);
-	memcpy(mappedRes.pData, &shaderCB, sizeof(shaderCB));
-	m_ctx->Unmap(m_constantBuffer, 0);
-	m_ctx->PSSetConstantBuffers(0, 1, &m_constantBuffer);
-
-	Vec3* imageA = new Vec3[m_imageWidth * m_imageHeight];
-	Vec3* imageB = new Vec3[m_imageWidth * m_imageHeight];
-
-	CopyTexture(imageA, m_sourceTextureView);
-	CopyTexture(imageB, m_compressedTextureView);
-	
-	// Compute RGB and Luminance RMSE errors in log space
-	double rSum = 0.0;
-	double gSum = 0.0;
-	double bSum = 0.0;
-	for (unsigned y = 0; y < m_imageHeight; ++y)
-	{
-		for (unsigned x = 0; x < m_imageWidth; ++x)
-		{
-			double x0 = imageA[x + y * m_imageWidth].x;
-			double y0 = imageA[x + y * m_imageWidth].y;
-			double z0 = imageA[x + y * m_imageWidth].z;
-			double x1 = imageB[x + y * m_imageWidth].x;
-			double y1 = imageB[x + y * m_imageWidth].y;
-			double z1 = imageB[x + y * m_imageWidth].z;
-
-			double dx = log(x1 + 1.0) - log(x0 + 1.0);
-			double dy = log(y1 + 1.0) - log(y0 + 1.0);
-			double dz = log(z1 + 1.0) - log(z0 + 1.0);
-			rSum += dx * dx;
-			gSum += dy * dy;
-			bSum += dy * dy;
-		}
-	}
-	m_rgbRMSLE = (float)sqrt((rSum + gSum + bSum) / (3.0 * m_imageWidth * m_imageHeight));
-	m_lumRMSLE = (float)sqrt((0.299 * rSum + 0.587 * gSum + 0.114 * bSum) / (1.0 * m_imageWidth * m_imageHeight));
+bool GPURealTimeBC6H::CompressRects(const SImage* srcImage, const SRect* rects, uint32_t rectNum, SImage* dstImage)
+{
+  double startTime = BC6HStats::Now();
+  std::lock_guard<std::mutex> lk(m_compressMutex);
+
+  BC6HStats::SFrame frame;
+  frame.Record(BC6HStats::Stage::LockWait, startTime);
+
+  BC6HEncoderCPU::TexelFormat texelFormat;
+  if (!GetTexelFormat(srcImage->m_format, texelFormat) || srcImage->m_sliceNum != 1)
+    return false;
+
+  uint32_t width = srcImage->m_width;
+  uint32_t height = srcImage->m_height;
+  uint32_t texelBytes = BC6HEncoderCPU::GetTexelBytes(texelFormat);
+  uint32_t rowPitch = GetRowPitch(srcImage, texelFormat);
+  if (rowPitch < width * texelBytes)
+  {
+    std::cerr << "GPURealTimeBC6H: row pitch " << rowPitch << " is smaller than a row of " << width << " texels" << std::endl;
+    return false;
+  }
+
+  uint32_t widthInBlocks = DivideAndRoundUp(width, BC_BLOCK_SIZE);
+  uint32_t heightInBlocks = DivideAndRoundUp(height, BC_BLOCK_SIZE);
+  if (dstImage->m_format != SImage::ImageFormat::BC6H || !dstImage->m_data || dstImage->m_width != widthInBlocks || dstImage->m_height != heightInBlocks
+    || dstImage->m_dataSize < GetCompressedSize(width, height))
+  {
+    std::cerr << "GPURealTimeBC6H: dstImage isn't the BC6H image of a " << width << "x" << height << " source" << std::endl;
+    return false;
+  }
 
-	delete imageA;
-	delete imageB;
+  std::vector<uint8_t> dirty(static_cast<size_t>(widthInBlocks) * heightInBlocks, 0);
+  for (uint32_t i = 0; i < rectNum; ++i)
+  {
+    const SRect& rect = rects[i];
+    if (rect.m_x >= width || rect.m_y >= height || rect.m_width == 0 || rect.m_height == 0)
+      continue;
 
-	char rmseString[256];
-	rmseString[0] = 0;
-	sprintf_s(rmseString, "rgbRMSLE:%.4f lumRMSLE:%.4f Mode:%s\n", m_rgbRMSLE, m_lumRMSLE, m_preset == Preset::Quality ? "Quality" : "Fast");
-	OutputDebugStringA(rmseString);
+    uint32_t endX = rect.m_width < width - rect.m_x ? rect.m_x + rect.m_width : width;
+    uint32_t endY = rect.m_height < height - rect.m_y ? rect.m_y + rect.m_height : height;
+    for (uint32_t blockY = rect.m_y / BC_BLOCK_SIZE; blockY < DivideAndRoundUp(endY, BC_BLOCK_SIZE); ++blockY)
+    {
+      uint8_t* dirtyRow = dirty.data() + static_cast<size_t>(blockY) * widthInBlocks;
+      memset(dirtyRow + rect.m_x / BC_BLOCK_SIZE, 1, DivideAndRoundUp(endX, BC_BLOCK_SIZE) - rect.m_x / BC_BLOCK_SIZE);
+    }
+  }
+
+  // Split the dirty blocks into disjoint block rectangles: a run of dirty blocks in a row grows down
+  // while the rows below have the whole run dirty too
+  struct SBlockRect
+  {
+    uint32_t m_x;
+    uint32_t m_y;
+    uint32_t m_width;
+    uint32_t m_height;
+  };
+  std::vector<SBlockRect> blockRects;
+  std::vector<SSurface> surfaces;
+  size_t blocksSize = 0;
+  for (uint32_t blockY = 0; blockY < heightInBlocks; ++blockY)
+  {
+    for (uint32_t blockX = 0; blockX < widthInBlocks;)
+    {
+      uint8_t* dirtyRow = dirty.data() + static_cast<size_t>(blockY) * widthInBlocks;
+      if (!dirtyRow[blockX])
+      {
+        ++blockX;
+        continue;
+      }
+
+      uint32_t endX = blockX;
+      while (endX < widthInBlocks && dirtyRow[endX])
+        ++endX;
+
+      uint32_t endY = blockY + 1;
+      for (; endY < heightInBlocks; ++endY)
+      {
+        const uint8_t* nextRow = dirty.data() + static_cast<size_t>(endY) * widthInBlocks;
+        if (std::find(nextRow + blockX, nextRow + endX, 0) != nextRow + endX)
+          break;
+      }
+
+      for (uint32_t y = blockY; y < endY; ++y)
+        memset(dirty.data() + static_cast<size_t>(y) * widthInBlocks + blockX, 0, endX - blockX);
+
+      SBlockRect blockRect = { blockX, blockY, endX - blockX, endY - blockY };
+      blockRects.push_back(blockRect);
+
+      SSurface surface;
+      surface.m_width = std::min(endX * BC_BLOCK_SIZE, width) - blockX * BC_BLOCK_SIZE;
+      surface.m_height = std::min(endY * BC_BLOCK_SIZE, height) - blockY * BC_BLOCK_SIZE;
+      surface.m_texels = srcImage->m_data + static_cast<size_t>(blockY) * BC_BLOCK_SIZE * rowPitch + blockX * BC_BLOCK_SIZE * texelBytes;
+      surface.m_format = texelFormat;
+      surface.m_rowPitch = rowPitch;
+      surface.m_offset = blocksSize;
+      surfaces.push_back(surface);
+      blocksSize += static_cast<size_t>(blockRect.m_width) * blockRect.m_height * sizeof(BufferBC6H);
+
+      blockX = endX;
+    }
+  }
+
+  if (!surfaces.empty())
+  {
+    // The rectangles are encoded tightly packed and then copied into their place
+    std::vector<uint8_t> blocks(blocksSize);
+    SImage blocksImage = {};
+    blocksImage.m_format = SImage::ImageFormat::BC6H;
+    blocksImage.m_data = blocks.data();
+    blocksImage.m_dataSize = static_cast<unsigned>(blocksSize);
+    bool result = CompressSurfaces(surfaces, BC6HEncoderCPU::Addressing::Border, &blocksImage, frame);
+    if (!result)
+      return false;
+
+    for (size_t i = 0; i < blockRects.size(); ++i)
+    {
+      const SBlockRect& blockRect = blockRects[i];
+      size_t rowBytes = blockRect.m_width * sizeof(BufferBC6H);
+      for (uint32_t y = 0; y < blockRect.m_height; ++y)
+      {
+        uint8_t* dst = dstImage->m_data + (static_cast<size_t>(blockRect.m_y + y) * widthInBlocks + blockRect.m_x) * sizeof(BufferBC6H);
+        memcpy(dst, blocks.data() + surfaces[i].m_offset + y * rowBytes, rowBytes);
+      }
+    }
+  }
+
+  frame.Record(BC6HStats::Stage::Total, startTime);
+  m_stats.AddFrame(frame, blocksSize / sizeof(BufferBC6H) * BC_BLOCK_SIZE * BC_BLOCK_SIZE * texelBytes, blocksSize);
+  return true;
+}
+
+uint32_t GPURealTimeBC6H::GetMipLevelNum(uint32_t width, uint32_t height)
+{
+  return BC6HMipChain::GetLevelNum(width, height);
+}
+
+bool GPURealTimeBC6H::CompressMipChain(const SImage* srcImage, uint32_t levelNum, SImage* dstImage, uint32_t* levelOffsets)
+{
+  double startTime = BC6HStats::Now();
+  std::lock_guard<std::mutex> lk(m_compressMutex);
+
+  BC6HStats::SFrame frame;
+  frame.Record(BC6HStats::Stage::LockWait, startTime);
+
+  if (srcImage->m_format != SImage::ImageFormat::RGBA32F || srcImage->m_width == 0 || srcImage->m_height == 0)
+    return false;
+
+  uint32_t fullLevelNum = BC6HMipChain::GetLevelNum(srcImage->m_width, srcImage->m_height);
+  if (levelNum == 0 || levelNum > fullLevelNum)
+    levelNum = fullLevelNum;
+
+  // Levels 1+ are built into one buffer, level 0 is the source image itself
+  double uploadStart = BC6HStats::Now();
+  std::vector<SSurface> levels(levelNum);
+  size_t mipTexelNum = 0;
+  uint64_t blockNum = 0;
+  for (uint32_t level = 0; level < levelNum; ++level)
+  {
+    SSurface& mip = levels[level];
+    mip.m_width = BC6HMipChain::GetLevelSize(srcImage->m_width, level);
+    mip.m_height = BC6HMipChain::GetLevelSize(srcImage->m_height, level);
+    mip.m_format = BC6HEncoderCPU::TexelFormat::RGBA32F;
+    mip.m_rowPitch = mip.m_width * sizeof(float) * 4;
+    mip.m_offset = static_cast<size_t>(blockNum * sizeof(BufferBC6H));
+    blockNum += static_cast<uint64_t>(DivideAndRoundUp(mip.m_width, BC_BLOCK_SIZE)) * DivideAndRoundUp(mip.m_height, BC_BLOCK_SIZE);
+    if (level > 0)
+      mipTexelNum += static_cast<size_t>(mip.m_width) * mip.m_height * 4;
+  }
+  uint64_t dataSize = blockNum * sizeof(BufferBC6H);
+  if (!CheckDataSize(dataSize))
+    return false;
+
+  std::vector<float> mipTexels(mipTexelNum);
+  levels[0].m_texels = srcImage->m_data;
+  float* nextTexels = mipTexels.data();
+  for (uint32_t level = 1; level < levelNum; ++level)
+  {
+    const SSurface& parent = levels[level - 1];
+    BC6HMipChain::Downsample(reinterpret_cast<const float*>(parent.m_texels), parent.m_width, parent.m_height, GetThreadPool(), nextTexels);
+    levels[level].m_texels = reinterpret_cast<const uint8_t*>(nextTexels);
+    nextTexels += static_cast<size_t>(levels[level].m_width) * levels[level].m_height * 4;
+  }
+  frame.Record(BC6HStats::Stage::Upload, uploadStart);
+
+  double allocationStart = BC6HStats::Now();
+  dstImage->m_width = DivideAndRoundUp(srcImage->m_width, BC_BLOCK_SIZE);
+  dstImage->m_height = DivideAndRoundUp(srcImage->m_height, BC_BLOCK_SIZE);
+  dstImage->m_format = SImage::ImageFormat::BC6H;
+  dstImage->m_dataSize = static_cast<unsigned>(dataSize);
+  dstImage->m_sliceNum = 1;
+  dstImage->m_slicePitch = dstImage->m_dataSize;
+  dstImage->m_data = static_cast<uint8_t*>(malloc(dstImage->m_dataSize));
+  if (!dstImage->m_data)
+    return false;
+  frame.Record(BC6HStats::Stage::Allocation, allocationStart);
+
+  bool result;
+  if (m_backend == Backend::D3D11)
+  {
+    result = CompressMipChainD3D11(levels, dstImage, frame);
+    if (result)
+      OptimizeSurfaces(levels, dstImage, frame);
+  }
+  else
+  {
+    result = CompressSurfaces(levels, BC6HEncoderCPU::Addressing::Clamp, dstImage, frame);
+  }
+  if (!result)
+  {
+    FreeImage(dstImage);
+    return false;
+  }
+
+  for (uint32_t level = 0; level < levelNum; ++level)
+    levelOffsets[level] = static_cast<uint32_t>(levels[level].m_offset);
+
+  frame.Record(BC6HStats::Stage::Total, startTime);
+  uint64_t bytesIn = static_cast<uint64_t>(srcImage->m_width) * srcImage->m_height * sizeof(float) * 4;
+  m_stats.AddFrame(frame, bytesIn, dstImage->m_dataSize);
+  return true;
+}
+
+bool GPURealTimeBC6H::GetContainerLayout(const SImage* srcImage, uint32_t levelNum, bool cubemap, BC6HContainer::SLayout& layout)
+{
+  if (srcImage->m_format != SImage::ImageFormat::RGBA32F || srcImage->m_width == 0 || srcImage->m_height == 0 || srcImage->m_sliceNum == 0)
+    return false;
+
+  if (cubemap && (srcImage->m_sliceNum % 6 != 0 || srcImage->m_width != srcImage->m_height))
+  {
+    std::cerr << "GPURealTimeBC6H: a cubemap needs square faces and 6 slices per cube, got " << srcImage->m_sliceNum << " slices of "
+      << srcImage->m_width << "x" << srcImage->m_height << std::endl;
+    return false;
+  }
+
+  uint32_t fullLevelNum = BC6HMipChain::GetLevelNum(srcImage->m_width, srcImage->m_height);
+  layout.m_width = srcImage->m_width;
+  layout.m_height = srcImage->m_height;
+  layout.m_levelNum = levelNum == 0 || levelNum > fullLevelNum ? fullLevelNum : levelNum;
+  layout.m_sliceNum = srcImage->m_sliceNum;
+  layout.m_cubemap = cubemap;
+  return true;
+}
+
+bool GPURealTimeBC6H::GetContainerSurfaces(const SImage* srcImage, const BC6HContainer::SLayout& layout, BC6HContainer::Format format,
+  std::vector<float>& mipTexels, std::vector<SSurface>& surfaces, BC6HStats::SFrame& frame)
+{
+  size_t sliceBytes = static_cast<size_t>(srcImage->m_width) * srcImage->m_height * sizeof(float) * 4;
+  size_t slicePitch = srcImage->m_slicePitch != 0 ? srcImage->m_slicePitch : sliceBytes;
+  if (slicePitch < sliceBytes)
+    return false;
+
+  // Mips of every slice are built into one buffer, level 0 is the source slice itself
+  double uploadStart = BC6HStats::Now();
+  size_t sliceMipTexelNum = 0;
+  for (uint32_t level = 1; level < layout.m_levelNum; ++level)
+    sliceMipTexelNum += static_cast<size_t>(BC6HMipChain::GetLevelSize(layout.m_width, level)) * BC6HMipChain::GetLevelSize(layout.m_height, level) * 4;
+  mipTexels.resize(sliceMipTexelNum * layout.m_sliceNum);
+
+  surfaces.resize(static_cast<size_t>(layout.m_sliceNum) * layout.m_levelNum);
+  for (uint32_t slice = 0; slice < layout.m_sliceNum; ++slice)
+  {
+    float* nextTexels = mipTexels.data() + slice * sliceMipTexelNum;
+    for (uint32_t level = 0; level < layout.m_levelNum; ++level)
+    {
+      SSurface& surface = surfaces[slice * layout.m_levelNum + level];
+      surface.m_width = BC6HMipChain::GetLevelSize(layout.m_width, level);
+      surface.m_height = BC6HMipChain::GetLevelSize(layout.m_height, level);
+      surface.m_format = BC6HEncoderCPU::TexelFormat::RGBA32F;
+      surface.m_rowPitch = surface.m_width * sizeof(float) * 4;
+      surface.m_offset = static_cast<size_t>(BC6HContainer::GetSurfaceOffset(format, layout, level, slice));
+      if (level == 0)
+      {
+        surface.m_texels = srcImage->m_data + slice * slicePitch;
+      }
+      else
+      {
+        const SSurface& parent = surfaces[slice * layout.m_levelNum + level - 1];
+        BC6HMipChain::Downsample(reinterpret_cast<const float*>(parent.m_texels), parent.m_width, parent.m_height, GetThreadPool(), nextTexels);
+        surface.m_texels = reinterpret_cast<const uint8_t*>(nextTexels);
+        nextTexels += static_cast<size_t>(surface.m_width) * surface.m_height * 4;
+      }
+    }
+  }
+  frame.Record(BC6HStats::Stage::Upload, uploadStart);
+  return true;
+}
+
+BC6HEncoderCPU::Addressing GPURealTimeBC6H::GetContainerAddressing(const BC6HContainer::SLayout& layout)
+{
+  // Same edge handling as CompressMipChain with mips and as Compress without
+  return layout.m_levelNum > 1 ? BC6HEncoderCPU::Addressing::Clamp : BC6HEncoderCPU::Addressing::Border;
+}
+
+bool GPURealTimeBC6H::CompressContainer(const SImage* srcImage, const BC6HContainer::SLayout& layout, BC6HContainer::Format format, uint8_t* file, BC6HStats::SFrame& frame)
+{
+  uint64_t fileSize = BC6HContainer::GetFileSize(format, layout);
+  if (!CheckDataSize(fileSize))
+    return false;
+
+  std::vector<float> mipTexels;
+  std::vector<SSurface> surfaces;
+  if (!GetContainerSurfaces(srcImage, layout, format, mipTexels, surfaces, frame))
+    return false;
+
+  BC6HContainer::WriteHeader(format, layout, file);
+
+  // The blocks go straight to their place in the file, after the header
+  SImage fileImage;
+  fileImage.m_format = SImage::ImageFormat::BC6H;
+  fileImage.m_width = DivideAndRoundUp(layout.m_width, BC_BLOCK_SIZE);
+  fileImage.m_height = DivideAndRoundUp(layout.m_height, BC_BLOCK_SIZE);
+  fileImage.m_data = file;
+  fileImage.m_dataSize = static_cast<unsigned>(fileSize);
+  return CompressSurfaces(surfaces, GetContainerAddressing(layout), &fileImage, frame);
+}
+
+bool GPURealTimeBC6H::CompressToFile(const SImage* srcImage, uint32_t levelNum, bool cubemap, BC6HContainer::Format format, const char* path)
+{
+  double startTime = BC6HStats::Now();
+  std::lock_guard<std::mutex> lk(m_compressMutex);
+
+  BC6HStats::SFrame frame;
+  frame.Record(BC6HStats::Stage::LockWait, startTime);
+
+  BC6HContainer::SLayout layout;
+  if (!GetContainerLayout(srcImage, levelNum, cubemap, layout))
+    return false;
+
+  double allocationStart = BC6HStats::Now();
+  uint64_t fileSize = BC6HContainer::GetFileSize(format, layout);
+  MappedFile file;
+  if (!CheckDataSize(fileSize) || !file.Create(path, fileSize))
+    return false;
+  frame.Record(BC6HStats::Stage::Allocation, allocationStart);
+
+  bool result = CompressContainer(srcImage, layout, format, file.GetData(), frame);
+  result = file.Close() && result;
+  if (!result)
+  {
+    std::cerr << "GPURealTimeBC6H: failed to write " << path << std::endl;
+    remove(path);
+    return false;
+  }
+
+  frame.Record(BC6HStats::Stage::Total, startTime);
+  uint64_t bytesIn = static_cast<uint64_t>(srcImage->m_width) * srcImage->m_height * sizeof(float) * 4 * layout.m_sliceNum;
+  m_stats.AddFrame(frame, bytesIn, fileSize);
+  return true;
+}
+
+bool GPURealTimeBC6H::CompressToSink(const SImage* srcImage, uint32_t levelNum, bool cubemap, BC6HContainer::Format format, const ContainerSink& sink)
+{
+  double startTime = BC6HStats::Now();
+  std::lock_guard<std::mutex> lk(m_compressMutex);
+
+  BC6HStats::SFrame frame;
+  frame.Record(BC6HStats::Stage::LockWait, startTime);
+
+  BC6HContainer::SLayout layout;
+  if (!GetContainerLayout(srcImage, levelNum, cubemap, layout))
+    return false;
+
+  std::vector<float> mipTexels;
+  std::vector<SSurface> surfaces;
+  if (!GetContainerSurfaces(srcImage, layout, format, mipTexels, surfaces, frame))
+    return false;
+
+  // One surface is encoded at a time into a buffer that fits the largest one, level 0
+  double allocationStart = BC6HStats::Now();
+  std::vector<uint8_t> header(static_cast<size_t>(BC6HContainer::GetHeaderSize(format, layout)));
+  std::vector<uint8_t> blocks(static_cast<size_t>(BC6HContainer::GetSurfaceSize(layout, 0)));
+  frame.Record(BC6HStats::Stage::Allocation, allocationStart);
+
+  BC6HContainer::WriteHeader(format, layout, header.data());
+  if (!sink(0, header.data(), header.size()))
+    return false;
+
+  SImage blockImage;
+  blockImage.m_format = SImage::ImageFormat::BC6H;
+  blockImage.m_data = blocks.data();
+  blockImage.m_dataSize = static_cast<unsigned>(blocks.size());
+
+  // Surfaces in file order: KTX2 has the smallest level first with all of its slices, DDS every slice with its whole chain
+  bool ktx2 = format == BC6HContainer::Format::KTX2;
+  uint32_t surfaceNum = layout.m_levelNum * layout.m_sliceNum;
+  for (uint32_t i = 0; i < surfaceNum; ++i)
+  {
+    uint32_t level = ktx2 ? layout.m_levelNum - 1 - i / layout.m_sliceNum : i % layout.m_levelNum;
+    uint32_t slice = ktx2 ? i % layout.m_sliceNum : i / layout.m_levelNum;
+    std::vector<SSurface> surface(1, surfaces[slice * layout.m_levelNum + level]);
+    surface[0].m_offset = 0;
+    blockImage.m_width = DivideAndRoundUp(surface[0].m_width, BC_BLOCK_SIZE);
+    blockImage.m_height = DivideAndRoundUp(surface[0].m_height, BC_BLOCK_SIZE);
+
+    BC6HStats::SFrame surfaceFrame;
+    if (!CompressSurfaces(surface, GetContainerAddressing(layout), &blockImage, surfaceFrame))
+      return false;
+    frame.Add(surfaceFrame);
+
+    uint64_t offset = BC6HContainer::GetSurfaceOffset(format, layout, level, slice);
+    if (!sink(offset, blocks.data(), static_cast<size_t>(BC6HContainer::GetSurfaceSize(layout, level))))
+      return false;
+  }
+
+  frame.Record(BC6HStats::Stage::Total, startTime);
+  uint64_t bytesIn = static_cast<uint64_t>(srcImage->m_width) * srcImage->m_height * sizeof(float) * 4 * layout.m_sliceNum;
+  m_stats.AddFrame(frame, bytesIn, BC6HContainer::GetFileSize(format, layout));
+  return true;
+}
+
+bool GPURealTimeBC6H::BeginStream(uint32_t width, uint32_t height, const BlockRowCallback& blockRowCallback, SImage::ImageFormat rowFormat)
+{
+  std::lock_guard<std::mutex> lk(m_compressMutex);
+
+  if (width == 0 || height == 0 || !blockRowCallback || !GetTexelFormat(rowFormat, m_streamFormat))
+    return false;
+
+  m_streamCallback = blockRowCallback;
+  m_streamWidth = width;
+  m_streamHeight = height;
+  m_streamRow = 0;
+  return true;
+}
+
+bool GPURealTimeBC6H::CompressRows(const uint8_t* rows, uint32_t rowPitch, uint32_t rowNum)
+{
+  double startTime = BC6HStats::Now();
+  std::lock_guard<std::mutex> lk(m_compressMutex);
+
+  BC6HStats::SFrame frame;
+  frame.Record(BC6HStats::Stage::LockWait, startTime);
+
+  if (!m_streamCallback)
+  {
+    std::cerr << "GPURealTimeBC6H: CompressRows called without BeginStream" << std::endl;
+    return false;
+  }
+
+  // Blocks can't straddle two strips, so every strip but the last one has to end on a block row
+  bool lastStrip = m_streamRow + rowNum == m_streamHeight;
+  if (rowNum == 0 || rowNum > m_streamHeight - m_streamRow || (rowNum % BC_BLOCK_SIZE != 0 && !lastStrip))
+  {
+    std::cerr << "GPURealTimeBC6H: can't compress " << rowNum << " rows at row " << m_streamRow << " of " << m_streamHeight << ", strips need a multiple of 4 rows" << std::endl;
+    return false;
+  }
+
+  uint32_t texelBytes = BC6HEncoderCPU::GetTexelBytes(m_streamFormat);
+  if (rowPitch < m_streamWidth * texelBytes)
+    return false;
+
+  std::vector<SSurface> strip(1);
+  strip[0].m_width = m_streamWidth;
+  strip[0].m_height = rowNum;
+  strip[0].m_texels = rows;
+  strip[0].m_format = m_streamFormat;
+  strip[0].m_rowPitch = rowPitch;
+  strip[0].m_offset = 0;
+
+  // The block buffer grows to the largest strip once and is reused for the rest of the stream
+  double allocationStart = BC6HStats::Now();
+  SImage blocks;
+  blocks.m_format = SImage::ImageFormat::BC6H;
+  blocks.m_width = DivideAndRoundUp(m_streamWidth, BC_BLOCK_SIZE);
+  blocks.m_height = DivideAndRoundUp(rowNum, BC_BLOCK_SIZE);
+  blocks.m_dataSize = blocks.m_width * blocks.m_height * sizeof(BufferBC6H);
+  if (m_streamBlocks.size() < blocks.m_dataSize)
+    m_streamBlocks.resize(blocks.m_dataSize);
+  blocks.m_data = m_streamBlocks.data();
+  frame.Record(BC6HStats::Stage::Allocation, allocationStart);
+
+  bool result = CompressSurfaces(strip, BC6HEncoderCPU::Addressing::Border, &blocks, frame);
+  if (!result)
+    return false;
+
+  m_streamCallback(m_streamRow / BC_BLOCK_SIZE, blocks.m_height, blocks.m_data, blocks.m_dataSize);
+  m_streamRow += rowNum;
+
+  frame.Record(BC6HStats::Stage::Total, startTime);
+  uint64_t bytesIn = static_cast<uint64_t>(m_streamWidth) * rowNum * texelBytes;
+  m_stats.AddFrame(frame, bytesIn, blocks.m_dataSize);
+  return true;
+}
+
+bool GPURealTimeBC6H::EndStream()
+{
+  std::lock_guard<std::mutex> lk(m_compressMutex);
+
+  if (!m_streamCallback)
+    return false;
+
+  bool complete = m_streamRow == m_streamHeight;
+  if (!complete)
+    std::cerr << "GPURealTimeBC6H: stream ended after " << m_streamRow << " of " << m_streamHeight << " rows" << std::endl;
+
+  m_streamCallback = nullptr;
+  m_streamBlocks = std::vector<uint8_t>();
+  return complete;
+}
+
+bool GPURealTimeBC6H::CompressSurfaces(const std::vector<SSurface>& surfaces, BC6HEncoderCPU::Addressing addressing, SImage* dstImage, BC6HStats::SFrame& frame)
+{
+  bool result = m_backend == Backend::CPU ? CompressSurfacesCPU(surfaces, addressing, dstImage, frame) : CompressSurfacesD3D11(surfaces, addressing, dstImage, frame);
+
+  if (result)
+    OptimizeSurfaces(surfaces, dstImage, frame);
+  return result;
+}
+
+void GPURealTimeBC6H::OptimizeSurfaces(const std::vector<SSurface>& surfaces, SImage* dstImage, BC6HStats::SFrame& frame)
+{
+  if (m_rdoSettings.m_lambda <= 0.0f)
+    return;
+
+  // The GPU backends have read the blocks back by now, so every backend goes through the same CPU pass
+  double rdoStart = BC6HStats::Now();
+  for (const SSurface& surface : surfaces)
+  {
+    BC6HRDO::OptimizeSurface(surface.m_texels, surface.m_format, surface.m_rowPitch, surface.m_width, surface.m_height,
+      m_rdoSettings, GetThreadPool(), dstImage->m_data + surface.m_offset, frame.m_rdo);
+  }
+  frame.Record(BC6HStats::Stage::RDO, rdoStart);
+}
+
+bool GPURealTimeBC6H::CompressSurfacesCPU(const std::vector<SSurface>& surfaces, BC6HEncoderCPU::Addressing addressing, SImage* dstImage, BC6HStats::SFrame& frame)
+{
+  // The tiles of all the surfaces go into one ParallelFor, so small surfaces don't leave the workers idle
+  struct SSurfaceTile
+  {
+    const SSurface* m_surface;
+    BC6HEncoderCPU::STile m_tile;
+  };
+  std::vector<SSurfaceTile> tiles;
+  for (const SSurface& surface : surfaces)
+  {
+    for (const BC6HEncoderCPU::STile& tile : BC6HEncoderCPU::GetTiles(DivideAndRoundUp(surface.m_width, BC_BLOCK_SIZE), DivideAndRoundUp(surface.m_height, BC_BLOCK_SIZE), m_tileOrder))
+      tiles.push_back(SSurfaceTile{ &surface, tile });
+  }
+
+  std::vector<BC6HEncoderCPU::SBlockCounts> tileCounts(tiles.size(), BC6HEncoderCPU::SBlockCounts{ 0, 0, 0, 0, 0 });
+  auto encodeTile = [&](uint32_t i)
+  {
+    const SSurface& surface = *tiles[i].m_surface;
+    const BC6HEncoderCPU::STile& tile = tiles[i].m_tile;
+    size_t blockRowPitch = DivideAndRoundUp(surface.m_width, BC_BLOCK_SIZE) * sizeof(BufferBC6H);
+    uint8_t* dst = dstImage->m_data + surface.m_offset + tile.m_blockY * blockRowPitch + tile.m_blockX * sizeof(BufferBC6H);
+    BC6HEncoderCPU::CompressTile(surface.m_texels, surface.m_format, surface.m_rowPitch, surface.m_width, surface.m_height, tile,
+      addressing, m_effort, m_p2Threshold, m_isa, dst, blockRowPitch, &tileCounts[i], m_blockCache.get());
+  };
+
+  double encodeStart = BC6HStats::Now();
+  GetThreadPool()->ParallelFor(static_cast<uint32_t>(tiles.size()), encodeTile);
+  frame.Record(BC6HStats::Stage::Encode, encodeStart);
+
+  for (const BC6HEncoderCPU::SBlockCounts& counts : tileCounts)
+  {
+    frame.m_blocks.m_constant += counts.m_constant;
+    frame.m_blocks.m_nearConstant += counts.m_nearConstant;
+    frame.m_blocks.m_encoded += counts.m_encoded;
+    frame.m_blocks.m_cached += counts.m_cached;
+    frame.m_blocks.m_p2Skipped += counts.m_p2Skipped;
+  }
+
+  ++m_frameID;
+  return true;
+}
+
+#if HAVE_D3D11
+bool GPURealTimeBC6H::CompressSurfacesD3D11(const std::vector<SSurface>& surfaces, BC6HEncoderCPU::Addressing addressing, SImage* dstImage, BC6HStats::SFrame& frame)
+{
+  // CSMain reads a Texture2D, so every surface gets its own texture rather than a view into an array
+  double uploadStart = BC6HStats::Now();
+  uint32_t surfaceNum = static_cast<uint32_t>(surfaces.size());
+  std::vector<ID3D11Texture2D*> surfaceResources(surfaceNum, nullptr);
+  std::vector<ID3D11ShaderResourceView*> surfaceViews(surfaceNum, nullptr);
+  std::vector<uint8_t> expanded;
+  HRESULT hr = S_OK;
+  for (uint32_t i = 0; i < surfaceNum && SUCCEEDED(hr); ++i)
+  {
+    const SSurface& surface = surfaces[i];
+    D3D11_SUBRESOURCE_DATA initialData;
+    DXGI_FORMAT format = PrepareUpload(surface.m_texels, surface.m_format, surface.m_rowPitch, surface.m_width, surface.m_height, expanded, initialData);
+
+    D3D11_TEXTURE2D_DESC desc;
+    ZeroMemory(&desc, sizeof(desc));
+    desc.Format = format;
+    desc.Width = surface.m_width;
+    desc.Height = surface.m_height;
+    desc.MipLevels = 1;
+    desc.ArraySize = 1;
+    desc.Usage = D3D11_USAGE_IMMUTABLE;
+    desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+    desc.SampleDesc.Count = 1;
+    desc.SampleDesc.Quality = 0;
+    hr = m_device->CreateTexture2D(&desc, &initialData, &surfaceResources[i]);
+    _ASSERT(SUCCEEDED(hr));
+    if (SUCCEEDED(hr))
+    {
+      hr = m_device->CreateShaderResourceView(surfaceResources[i], nullptr, &surfaceViews[i]);
+      _ASSERT(SUCCEEDED(hr));
+    }
+  }
+  frame.Record(BC6HStats::Stage::Upload, uploadStart);
+
+  ID3D11SamplerState* sampler = addressing == BC6HEncoderCPU::Addressing::Clamp ? m_clampSampler : m_pointSampler;
+  if (SUCCEEDED(hr) && !DispatchSurfacesD3D11(surfaces, surfaceViews, sampler, dstImage, frame))
+    hr = E_FAIL;
+
+  for (uint32_t i = 0; i < surfaceNum; ++i)
+  {
+    SAFE_RELEASE(surfaceViews[i]);
+    SAFE_RELEASE(surfaceResources[i]);
+  }
+
+  CHECK_HR("surface compression failed");
+  return true;
+}
+#else
+bool GPURealTimeBC6H::CompressSurfacesD3D11(const std::vector<SSurface>&, BC6HEncoderCPU::Addressing, SImage*, BC6HStats::SFrame&)
+{
+  return false;
+}
+#endif
+
+#if HAVE_D3D11
+bool GPURealTimeBC6H::CompressMipChainD3D11(const std::vector<SSurface>& levels, SImage* dstImage, BC6HStats::SFrame& frame)
+{
+  uint32_t levelNum = static_cast<uint32_t>(levels.size());
+
+  double uploadStart = BC6HStats::Now();
+
+  // The whole chain in one texture, each level gets its own view
+  std::vector<D3D11_SUBRESOURCE_DATA> initialData(levelNum);
+  for (uint32_t level = 0; level < levelNum; ++level)
+  {
+    initialData[level].pSysMem = levels[level].m_texels;
+    initialData[level].SysMemPitch = levels[level].m_rowPitch;
+    initialData[level].SysMemSlicePitch = 0;
+  }
+
+  D3D11_TEXTURE2D_DESC desc;
+  ZeroMemory(&desc, sizeof(desc));
+  desc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+  desc.Width = levels[0].m_width;
+  desc.Height = levels[0].m_height;
+  desc.MipLevels = levelNum;
+  desc.ArraySize = 1;
+  desc.Usage = D3D11_USAGE_IMMUTABLE;
+  desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+  desc.SampleDesc.Count = 1;
+  desc.SampleDesc.Quality = 0;
+  ID3D11Texture2D* sourceRes = nullptr;
+  HRESULT hr = m_device->CreateTexture2D(&desc, initialData.data(), &sourceRes);
+  _ASSERT(SUCCEEDED(hr));
+  CHECK_HR("m_device->CreateTexture2D(sourceRes) failed");
+
+  std::vector<ID3D11ShaderResourceView*> levelViews(levelNum, nullptr);
+  for (uint32_t level = 0; level < levelNum && SUCCEEDED(hr); ++level)
+  {
+    D3D11_SHADER_RESOURCE_VIEW_DESC resViewDesc;
+    resViewDesc.Format = desc.Format;
+    resViewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+    resViewDesc.Texture2D.MostDetailedMip = level;
+    resViewDesc.Texture2D.MipLevels = 1;
+    hr = m_device->CreateShaderResourceView(sourceRes, &resViewDesc, &levelViews[level]);
+    _ASSERT(SUCCEEDED(hr));
+  }
+  frame.Record(BC6HStats::Stage::Upload, uploadStart);
+
+  if (SUCCEEDED(hr) && !DispatchSurfacesD3D11(levels, levelViews, m_clampSampler, dstImage, frame))
+    hr = E_FAIL;
+
+  for (ID3D11ShaderResourceView*& view : levelViews)
+    SAFE_RELEASE(view);
+  SAFE_RELEASE(sourceRes);
+
+  CHECK_HR("mip chain compression failed");
+  return true;
+}
+#else
+bool GPURealTimeBC6H::CompressMipChainD3D11(const std::vector<SSurface>&, SImage*, BC6HStats::SFrame&)
+{
+  return false;
+}
+#endif
+
+#if HAVE_D3D11
+bool GPURealTimeBC6H::DispatchSurfacesD3D11(const std::vector<SSurface>& surfaces, const std::vector<ID3D11ShaderResourceView*>& views, ID3D11SamplerState* sampler, SImage* dstImage, BC6HStats::SFrame& frame)
+{
+  ID3D11ComputeShader* compressCS = GetCompressCS();
+  if (!compressCS)
+  {
+    std::cerr << "compressCS == nullptr" << std::endl;
+    return false;
+  }
+
+  // Every surface is encoded into the same target, sized for the largest one, then copied under
+  // the previous ones into a staging texture, so a whole batch is read back with one Map.
+  // Batches taller than the texture size limit are split.
+  uint32_t maxWidth = 0;
+  uint32_t maxHeight = 0;
+  for (const SSurface& surface : surfaces)
+  {
+    maxWidth = surface.m_width > maxWidth ? surface.m_width : maxWidth;
+    maxHeight = surface.m_height > maxHeight ? surface.m_height : maxHeight;
+  }
+
+  if (maxWidth != m_imageWidth || maxHeight != m_imageHeight)
+  {
+    m_imageWidth = maxWidth;
+    m_imageHeight = maxHeight;
+    DestroyTargets();
+    if (!CreateTargets())
+      return false;
+  }
+
+  double readbackTime = 0.0;
+  size_t batchEnd = 0;
+  for (size_t batchBegin = 0; batchBegin < surfaces.size(); batchBegin = batchEnd)
+  {
+    uint32_t stagingHeight = 0;
+    for (batchEnd = batchBegin; batchEnd < surfaces.size(); ++batchEnd)
+    {
+      uint32_t heightInBlocks = DivideAndRoundUp(surfaces[batchEnd].m_height, BC_BLOCK_SIZE);
+      if (batchEnd > batchBegin && stagingHeight + heightInBlocks > D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION)
+        break;
+      stagingHeight += heightInBlocks;
+    }
+
+    D3D11_TEXTURE2D_DESC texDesc;
+    ZeroMemory(&texDesc, sizeof(texDesc));
+    texDesc.Width = DivideAndRoundUp(maxWidth, BC_BLOCK_SIZE);
+    texDesc.Height = stagingHeight;
+    texDesc.MipLevels = 1;
+    texDesc.ArraySize = 1;
+    texDesc.Format = DXGI_FORMAT_R32G32B32A32_UINT;
+    texDesc.SampleDesc.Count = 1;
+    texDesc.Usage = D3D11_USAGE_STAGING;
+    texDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+    ID3D11Texture2D* stagingRes = nullptr;
+    HRESULT hr = m_device->CreateTexture2D(&texDesc, nullptr, &stagingRes);
+    _ASSERT(SUCCEEDED(hr));
+    CHECK_HR("m_device->CreateTexture2D(stagingRes) failed");
+
+    m_ctx->ClearState();
+    m_ctx->CSSetShader(compressCS, nullptr, 0);
+    m_ctx->CSSetUnorderedAccessViews(0, 1, &m_compressTargetUAV, nullptr);
+    m_ctx->CSSetSamplers(0, 1, &sampler);
+    m_ctx->CSSetConstantBuffers(0, 1, &m_constantBuffer);
+
+    uint32_t stagingY = 0;
+    for (size_t i = batchBegin; i < batchEnd; ++i)
+    {
+      uint32_t widthInBlocks = DivideAndRoundUp(surfaces[i].m_width, BC_BLOCK_SIZE);
+      uint32_t heightInBlocks = DivideAndRoundUp(surfaces[i].m_height, BC_BLOCK_SIZE);
+      UpdateConstantBuffer(surfaces[i].m_width, surfaces[i].m_height);
+      m_ctx->CSSetShaderResources(0, 1, &views[i]);
+
+      uint32_t threadsX = 8;
+      uint32_t threadsY = 8;
+      m_ctx->Dispatch(DivideAndRoundUp(widthInBlocks, threadsX), DivideAndRoundUp(heightInBlocks, threadsY), 1);
+
+      D3D11_BOX box = { 0, 0, 0, widthInBlocks, heightInBlocks, 1 };
+      m_ctx->CopySubresourceRegion(stagingRes, 0, 0, stagingY, 0, m_compressTargetRes, 0, &box);
+      stagingY += heightInBlocks;
+    }
+
+    double readbackStart = BC6HStats::Now();
+    D3D11_MAPPED_SUBRESOURCE mappedTexRes;
+    hr = m_ctx->Map(stagingRes, 0, D3D11_MAP_READ, 0, &mappedTexRes);
+    if (SUCCEEDED(hr))
+    {
+      stagingY = 0;
+      for (size_t i = batchBegin; i < batchEnd; ++i)
+      {
+        const SSurface& surface = surfaces[i];
+        uint32_t rowBytes = DivideAndRoundUp(surface.m_width, BC_BLOCK_SIZE) * sizeof(BufferBC6H);
+        uint32_t heightInBlocks = DivideAndRoundUp(surface.m_height, BC_BLOCK_SIZE);
+        for (uint32_t blockY = 0; blockY < heightInBlocks; ++blockY, ++stagingY)
+        {
+          const uint8_t* src = static_cast<const uint8_t*>(mappedTexRes.pData) + static_cast<size_t>(stagingY) * mappedTexRes.RowPitch;
+          memcpy(dstImage->m_data + surface.m_offset + static_cast<size_t>(blockY) * rowBytes, src, rowBytes);
+        }
+      }
+      m_ctx->Unmap(stagingRes, 0);
+    }
+    readbackTime += BC6HStats::Now() - readbackStart;
+
+    SAFE_RELEASE(stagingRes);
+    CHECK_HR("m_ctx->Map(stagingRes) failed");
+  }
+  frame.Set(BC6HStats::Stage::Readback, static_cast<float>(readbackTime));
+
+  ++m_frameID;
+  return true;
+}
+#endif
+
+bool GPURealTimeBC6H::Decompress(const SImage* srcImage, SImage::ImageFormat format, SImage* dstImage, uint32_t width, uint32_t height)
+{
+  if (srcImage->m_format != SImage::ImageFormat::BC6H && srcImage->m_format != SImage::ImageFormat::BC6H_SF16)
+    return false;
+  if (format != SImage::ImageFormat::RGBA16F && format != SImage::ImageFormat::RGBA32F)
+    return false;
+
+  // srcImage is in blocks like a Compress result, width and height crop the last block row and column
+  uint32_t widthInBlocks = srcImage->m_width;
+  uint32_t heightInBlocks = srcImage->m_height;
+  if (width == 0 && height == 0)
+  {
+    width = widthInBlocks * BC_BLOCK_SIZE;
+    height = heightInBlocks * BC_BLOCK_SIZE;
+  }
+  if (width == 0 || height == 0 || DivideAndRoundUp(width, BC_BLOCK_SIZE) != widthInBlocks || DivideAndRoundUp(height, BC_BLOCK_SIZE) != heightInBlocks)
+  {
+    std::cerr << "GPURealTimeBC6H: can't decode " << width << "x" << height << " texels from " << widthInBlocks << "x" << heightInBlocks << " blocks" << std::endl;
+    return false;
+  }
+  if (srcImage->m_dataSize < static_cast<uint64_t>(widthInBlocks) * heightInBlocks * sizeof(BufferBC6H))
+  {
+    std::cerr << "GPURealTimeBC6H: BC6H data is too small for " << widthInBlocks << "x" << heightInBlocks << " blocks" << std::endl;
+    return false;
+  }
+
+  uint32_t texelBytes = format == SImage::ImageFormat::RGBA16F ? sizeof(uint16_t) * 4 : sizeof(float) * 4;
+  uint64_t dataSize = static_cast<uint64_t>(width) * height * texelBytes;
+  if (dataSize > UINT32_MAX)
+  {
+    std::cerr << "GPURealTimeBC6H: decoded " << width << "x" << height << " image doesn't fit in 4 GB" << std::endl;
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lk(m_compressMutex);
+
+  dstImage->m_width = width;
+  dstImage->m_height = height;
+  dstImage->m_format = format;
+  dstImage->m_dataSize = static_cast<unsigned>(dataSize);
+  dstImage->m_rowPitch = 0;
+  dstImage->m_sliceNum = 1;
+  dstImage->m_slicePitch = 0;
+  dstImage->m_data = static_cast<uint8_t*>(malloc(dstImage->m_dataSize));
+  if (!dstImage->m_data)
+    return false;
+
+  BC6HDecoderCPU::OutputFormat outputFormat = format == SImage::ImageFormat::RGBA16F ? BC6HDecoderCPU::OutputFormat::RGBA16F : BC6HDecoderCPU::OutputFormat::RGBA32F;
+  BC6HDecoderCPU::DecompressImage(srcImage->m_data, width, height, srcImage->m_format == SImage::ImageFormat::BC6H_SF16, outputFormat, width * texelBytes, m_isa, GetThreadPool(), dstImage->m_data);
+  return true;
+}
+
+void GPURealTimeBC6H::FreeImage(SImage* dstImage)
+{
+  free(dstImage->m_data);
+  dstImage->m_data = nullptr;
+}
+
+float GPURealTimeBC6H::GetGPUCompressionTime() const
+{
+  if (m_backend != Backend::D3D11)
+    return 0.0f;
+
+  BC6HStats::SStats stats;
+  m_stats.Get(stats);
+  return stats.m_stages[static_cast<uint32_t>(BC6HStats::Stage::Encode)].m_mean;
+}
+
+void GPURealTimeBC6H::GetStats(BC6HStats::SStats& stats) const
+{
+  m_stats.Get(stats);
+}
+
+void GPURealTimeBC6H::ResetStats()
+{
+  m_stats.Reset();
+}
+
+void GPURealTimeBC6H::SetEffort(uint32_t effort)
+{
+  std::lock_guard<std::mutex> lk(m_compressMutex);
+  m_effort = effort < BC6HEffort::MAX ? effort : BC6HEffort::MAX;
+}
+
+void GPURealTimeBC6H::SetP2Threshold(float threshold)
+{
+  std::lock_guard<std::mutex> lk(m_compressMutex);
+  threshold = threshold > 0.0f ? threshold : 0.0f;
+  // Cached blocks were encoded with the old threshold
+  if (threshold != m_p2Threshold && m_blockCache)
+    m_blockCache->Clear();
+  m_p2Threshold = threshold;
+}
+
+void GPURealTimeBC6H::SetRDO(float lambda, float maxErrorRatio, uint32_t window)
+{
+  std::lock_guard<std::mutex> lk(m_compressMutex);
+  m_rdoSettings.m_lambda = lambda > 0.0f ? lambda : 0.0f;
+  // Below 1 the original encoding itself would be out of bounds
+  m_rdoSettings.m_maxErrorRatio = maxErrorRatio > 1.0f ? maxErrorRatio : 1.0f;
+  m_rdoSettings.m_window = window;
+}
+
+void GPURealTimeBC6H::SetBlockCache(uint32_t entryNum)
+{
+  std::lock_guard<std::mutex> lk(m_compressMutex);
+  m_blockCache.reset(entryNum > 0 ? new BC6HBlockCache(entryNum) : nullptr);
+}
+
+void GPURealTimeBC6H::ClearBlockCache()
+{
+  std::lock_guard<std::mutex> lk(m_compressMutex);
+  if (m_blockCache)
+    m_blockCache->Clear();
+}
+
+void GPURealTimeBC6H::SetTileOrder(BC6HEncoderCPU::TileOrder tileOrder)
+{
+  std::lock_guard<std::mutex> lk(m_compressMutex);
+  m_tileOrder = tileOrder;
+}
+
+void GPURealTimeBC6H::SetISA(BC6HEncoderSIMD::ISA isa)
+{
+  std::lock_guard<std::mutex> lk(m_compressMutex);
+  m_isa = isa < BC6HEncoderSIMD::DetectISA() ? isa : BC6HEncoderSIMD::DetectISA();
+}
+
+ThreadPool* GPURealTimeBC6H::GetThreadPool()
+{
+  // The D3D11 backend doesn't need the workers for compression, spin them up on first use.
+  // Not thread safe, callers running several threads have to call it before they start them.
+  if (!m_threadPool)
+    m_threadPool = std::make_shared<ThreadPool>();
+  return m_threadPool.get();
+}
+
+bool GPURealTimeBC6H::Measure(const SImage* srcImage, const SImage* compressedImage, BC6HMetrics::SResult& metrics, float* blockMSLE)
+{
+  std::lock_guard<std::mutex> lk(m_compressMutex);
+  return MeasureUnlocked(srcImage, compressedImage, metrics, blockMSLE);
+}
+
+bool GPURealTimeBC6H::MeasureUnlocked(const SImage* srcImage, const SImage* compressedImage, BC6HMetrics::SResult& metrics, float* blockMSLE)
+{
+  BC6HEncoderCPU::TexelFormat texelFormat;
+  if (!GetTexelFormat(srcImage->m_format, texelFormat))
+    return false;
+  if (compressedImage->m_format != SImage::ImageFormat::BC6H && compressedImage->m_format != SImage::ImageFormat::BC6H_SF16)
+    return false;
+  if (srcImage->m_width == 0 || srcImage->m_height == 0)
+    return false;
+
+  uint32_t widthInBlocks = DivideAndRoundUp(srcImage->m_width, BC_BLOCK_SIZE);
+  uint32_t heightInBlocks = DivideAndRoundUp(srcImage->m_height, BC_BLOCK_SIZE);
+  if (!compressedImage->m_data || compressedImage->m_dataSize < static_cast<uint64_t>(widthInBlocks) * heightInBlocks * sizeof(BufferBC6H))
+  {
+    std::cerr << "GPURealTimeBC6H: BC6H data is too small for " << srcImage->m_width << "x" << srcImage->m_height << std::endl;
+    return false;
+  }
+
+  bool isSigned = compressedImage->m_format == SImage::ImageFormat::BC6H_SF16;
+  BC6HMetrics::MeasureImage(srcImage->m_data, texelFormat, GetRowPitch(srcImage, texelFormat), srcImage->m_width, srcImage->m_height, compressedImage->m_data, isSigned, m_isa, GetThreadPool(), metrics, blockMSLE);
+  return true;
 }
-#endif
\ No newline at end of file
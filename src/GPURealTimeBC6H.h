@@ -1,21 +1,40 @@
 #pragma once
 
+// The D3D11 backend is only available on Windows, the CPU backend builds everywhere
+#if defined(_WIN32)
+#define HAVE_D3D11 1
+#else
+#define HAVE_D3D11 0
+#endif
+
+#if HAVE_D3D11
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
+#include <tchar.h>
+#include <d3d11.h>
+#include <d3dcompiler.h>
+#endif
+
 #include <stdlib.h>
 #include <malloc.h>
 #include <memory.h>
-#include <tchar.h>
 #include <vector>
 #include <string>
+#include <functional>
 #include <mutex>
+#include <memory>
 #include <stdint.h>
 
-#include <d3d11.h>
-#include <d3dcompiler.h>
+#include "BC6HEncoderSIMD.h"
+#include "BC6HEncoderCPU.h"
+#include "BC6HEffort.h"
+#include "BC6HBlockCache.h"
+#include "BC6HContainer.h"
+#include "BC6HMetrics.h"
+#include "BC6HStats.h"
+#include "BC6HRDO.h"
 
-// Note: that is incomplete, needs some work
-#define HAVE_QUALITY_MEASUREMENT 0
+class ThreadPool;
 
 struct Vec2
 {
@@ -35,19 +54,18 @@ struct Vec2
   float y;
 };
 
-struct Vec3
-{
-  float x;
-  float y;
-  float z;
-};
-
 struct SImage
 {
   enum struct ImageFormat
   {
     RGBA32F,
     BC6H,
+    RGBA16F,
+    BC6H_SF16,
+    RGB32F,
+    RGB16F,
+    // DXGI_FORMAT_R9G9B9E5_SHAREDEXP
+    RGB9E5,
   };
 
   ImageFormat m_format;
@@ -55,6 +73,22 @@ struct SImage
   unsigned m_height;
   uint8_t* m_data;
   unsigned m_dataSize;
+  // Bytes between the rows of an uncompressed image, 0 means tightly packed. With m_data pointing into
+  // a larger image, it makes the image a sub-rectangle of it.
+  unsigned m_rowPitch = 0;
+  // Texture arrays and cubemaps (6 slices: +X, -X, +Y, -Y, +Z, -Z) keep their slices m_slicePitch bytes apart,
+  // 0 means tightly packed
+  unsigned m_sliceNum = 1;
+  unsigned m_slicePitch = 0;
+};
+
+// Texel rectangle
+struct SRect
+{
+  unsigned m_x;
+  unsigned m_y;
+  unsigned m_width;
+  unsigned m_height;
 };
 
 uint32_t const MAX_QUERY_FRAME_NUM = 5;
@@ -76,76 +110,239 @@ public:
     Speed,
   };
 
-  bool Init(Preset preset);
+  enum struct Backend
+  {
+    D3D11,
+    // Multithreaded C++ port of compress.hlsl, doesn't need a GPU. Writes single color blocks directly.
+    CPU,
+  };
+
+  // The preset sets the effort, BC6HEffort::QUALITY or BC6HEffort::SPEED.
+  // Every compressor owns its device, targets and scratch buffers and locks only itself, so separate compressors
+  // run in parallel. They can share threadPool, otherwise each one starts its own workers.
+  bool Init(Preset preset, Backend backend = Backend::D3D11, const std::shared_ptr<ThreadPool>& threadPool = nullptr);
+  // Encoder effort from 0 (fastest) to BC6HEffort::MAX, see BC6HEffort.h. The CPU backend has a specialized encoder
+  // for every level, D3D11 runs the compress_quality shader from BC6HEffort::QUALITY up and compress_speed below it.
+  void SetEffort(uint32_t effort);
+  uint32_t GetEffort() const { return m_effort; }
+  // CPU backend: blocks whose P1 (single subset) encoding has an MSLE under threshold skip the P2 search,
+  // trading a little quality on smooth content for close to effort 1 speed. See BC6HEncoderCPU::EncodeBlock for
+  // the error measure, 0 turns it off (the default). Changing it clears the block cache.
+  // GetStats reports the skipped blocks as m_blocks.m_p2Skipped.
+  void SetP2Threshold(float threshold);
+  float GetP2Threshold() const { return m_p2Threshold; }
+  // Rate distortion optimization for output that gets packed with an LZ codec (zstd, deflate, LZ4), every backend.
+  // After encoding, blocks take over bytes of their neighbours where that costs less than lambda block MSLE per saved
+  // byte and stays within maxErrorRatio of their own error, see BC6HRDO.h. lambda 0 turns it off (the default).
+  // GetStats reports the changed blocks and estimated LZ sizes as m_rdo, the pass time as Stage::RDO.
+  void SetRDO(float lambda, float maxErrorRatio = 2.0f, uint32_t window = 16);
+  const BC6HRDO::SSettings& GetRDO() const { return m_rdoSettings; }
+  // CPU backend block deduplication: blocks with the same texels as an already encoded one reuse its bits.
+  // The cache holds entryNum blocks (about 220 bytes each), is shared by the worker threads and kept across
+  // Compress calls until ClearBlockCache, so a batch of textures sharing tiles benefits too. 0 turns it off (the default).
+  // GetStats reports the hits as m_blocks.m_cached.
+  void SetBlockCache(uint32_t entryNum);
+  void ClearBlockCache();
+  // CPU backend work order, see BC6HEncoderCPU::TileOrder. The thread count and affinity come from the ThreadPool passed to Init.
+  void SetTileOrder(BC6HEncoderCPU::TileOrder tileOrder);
+  BC6HEncoderCPU::TileOrder GetTileOrder() const { return m_tileOrder; }
+  // CPU backend instruction set, defaults to the widest one the CPU supports (and can't go above it).
+  // Every ISA writes the same blocks, only the speed differs.
+  void SetISA(BC6HEncoderSIMD::ISA isa);
+  BC6HEncoderSIMD::ISA GetISA() const { return m_isa; }
   void Release();
+  // Texture arrays and cubemaps (m_sliceNum > 1) are compressed in one submission, dstImage gets the slices
+  // back to back m_slicePitch bytes apart. Quality measurement skips them.
+  // The source can be any uncompressed format with its own m_rowPitch, read as is without a conversion pass.
   bool Compress(const SImage* srcImage, SImage* dstImage);
+  // Compress into a caller owned buffer, dstImage->m_data with m_dataSize bytes (GetCompressedSize at least).
+  // Nothing is allocated, the rest of dstImage is filled in like Compress does.
+  bool CompressInto(const SImage* srcImage, SImage* dstImage);
+  // Compresses imageNum images with up to depth of them in flight (see BC6HPipeline.h). On D3D11 the upload of
+  // image N + 1, the dispatch of image N and the readback of image N - 1 overlap, the CPU backend encodes image N
+  // while the callback gets image N - 1. The callback runs on a pipeline thread, once per image and in order,
+  // with ok == false for the failed ones. dstImage is only valid during the call and the callback must not call
+  // back into the compressor. Returns false if any image failed.
+  typedef std::function<void(uint32_t index, const SImage* dstImage, bool ok)> BatchCallback;
+  bool CompressBatch(const SImage* srcImages, uint32_t imageNum, uint32_t depth, const BatchCallback& callback);
+  // Incremental recompression: dstImage is a previous Compress result of an image with srcImage's size, only the blocks
+  // the dirty rectangles (texels, clipped to the image) touch are encoded again and patched into it in place.
+  // Blocks covered by several rectangles are encoded once, the D3D11 backend uploads just the dirty blocks' texels,
+  // so the cost follows the dirty area and not the image size. Single slice images only, quality isn't measured.
+  bool CompressRects(const SImage* srcImage, const SRect* rects, uint32_t rectNum, SImage* dstImage);
+  // Output bytes of Compress and CompressInto, which fail when it's over the 32 bit m_dataSize
+  static uint64_t GetCompressedSize(uint32_t width, uint32_t height, uint32_t sliceNum = 1);
+  // Builds the mip chain of an RGBA32F image (box filter in linear space) and compresses levelNum levels of it
+  // in one go, levelNum == 0 means the full chain down to 1x1. dstImage gets all the levels back to back,
+  // levelOffsets (GetMipLevelNum entries at most) the byte offset of each one. Texels past the edge of a level
+  // repeat the edge, so levels smaller than a block don't fit their endpoints to black.
+  bool CompressMipChain(const SImage* srcImage, uint32_t levelNum, SImage* dstImage, uint32_t* levelOffsets);
+  static uint32_t GetMipLevelNum(uint32_t width, uint32_t height);
+
+  // Writes srcImage, all of its slices with levelNum mips each (1 for none, 0 for the full chain), as a complete DDS
+  // (DX10 header, BC6H_UF16) or KTX2 file of up to 4 GB. The blocks are encoded straight into the mapped output file.
+  // A cubemap takes 6 slices per cube (+X, -X, +Y, -Y, +Z, -Z) with square faces.
+  bool CompressToFile(const SImage* srcImage, uint32_t levelNum, bool cubemap, BC6HContainer::Format format, const char* path);
+  // Same file passed to the sink front to back, the header first and then one write per surface. Each surface is
+  // encoded on its own into a buffer of the level 0 size and handed over as soon as it is done, so the file is never
+  // held whole. Returning false from the sink stops the compression before the next surface.
+  typedef std::function<bool(uint64_t offset, const uint8_t* data, size_t size)> ContainerSink;
+  bool CompressToSink(const SImage* srcImage, uint32_t levelNum, bool cubemap, BC6HContainer::Format format, const ContainerSink& sink);
+
+  // Streaming compression for images too large to keep in memory. After BeginStream, CompressRows takes the rows
+  // (rowFormat, any uncompressed format) top to bottom in strips of 4 * N rows (only the last strip can be shorter)
+  // and hands the strip's BC6H block rows to the callback before returning, so both buffers can be reused right away.
+  // Peak memory is one strip of blocks, the output is the same as Compress of the whole image. One stream at a time
+  // per compressor, the callback must not call back into it.
+  typedef std::function<void(uint32_t firstBlockRow, uint32_t blockRowNum, const uint8_t* blocks, uint32_t dataSize)> BlockRowCallback;
+  bool BeginStream(uint32_t width, uint32_t height, const BlockRowCallback& blockRowCallback, SImage::ImageFormat rowFormat = SImage::ImageFormat::RGBA32F);
+  bool CompressRows(const uint8_t* rows, uint32_t rowPitch, uint32_t rowNum);
+  // Fails if the stream didn't get all the rows
+  bool EndStream();
+  // Decodes a BC6H or BC6H_SF16 image to RGBA16F or RGBA32F on the CPU, works with any backend.
+  // BC6H images have m_width/m_height in blocks everywhere, as Compress returns them. The result is width x height
+  // texels, which have to round up to the source blocks, 0 x 0 (the default) decodes all of them.
+  bool Decompress(const SImage* srcImage, SImage::ImageFormat format, SImage* dstImage, uint32_t width = 0, uint32_t height = 0);
   void FreeImage(SImage* dstImage);
 
+  // Error of a compressed image against its RGBA32F source, blockMSLE (optional) gets one value per block
+  bool Measure(const SImage* srcImage, const SImage* compressedImage, BC6HMetrics::SResult& metrics, float* blockMSLE = nullptr);
+  // Measures every Compress result, GetMetrics returns the latest one
+  void SetMeasureQuality(bool measureQuality) { m_measureQuality = measureQuality; }
+  const BC6HMetrics::SResult& GetMetrics() const { return m_metrics; }
+  // Mean compute dispatch time in ms over the recent D3D11 compressions, 0 for the CPU backend
+  float GetGPUCompressionTime() const;
+
+  // Per stage timings, byte and block counts of Compress, safe to call while another thread compresses
+  void GetStats(BC6HStats::SStats& stats) const;
+  void ResetStats();
+
+#if HAVE_D3D11
   ID3D11Device* GetDevice() { return m_device; }
   ID3D11DeviceContext* GetCtx() { return m_ctx; }
+#endif
 
 private:
+  Backend m_backend = Backend::D3D11;
+
+  // CPU backend
+  std::shared_ptr<ThreadPool> m_threadPool;
+  BC6HEncoderSIMD::ISA m_isa = BC6HEncoderSIMD::ISA::Scalar;
+  std::unique_ptr<BC6HBlockCache> m_blockCache;
+
+#if HAVE_D3D11
   ID3D11Device* m_device = nullptr;
   ID3D11DeviceContext* m_ctx = nullptr;
   ID3D11RenderTargetView* m_backBufferView = nullptr;
   ID3D11SamplerState* m_pointSampler = nullptr;
+  ID3D11SamplerState* m_clampSampler = nullptr;
   ID3D11Buffer* m_constantBuffer = nullptr;
 
-  ID3D11Query* m_disjointQueries[MAX_QUERY_FRAME_NUM];
-  ID3D11Query* m_timeBeginQueries[MAX_QUERY_FRAME_NUM];
-  ID3D11Query* m_timeEndQueries[MAX_QUERY_FRAME_NUM];
-  float m_timeAcc = 0.0f;
-  unsigned m_timeAccSampleNum = 0;
-  float m_compressionTime = 0.0f;
+  ID3D11Query* m_disjointQueries[MAX_QUERY_FRAME_NUM] = {};
+  ID3D11Query* m_timeBeginQueries[MAX_QUERY_FRAME_NUM] = {};
+  ID3D11Query* m_timeEndQueries[MAX_QUERY_FRAME_NUM] = {};
+  ID3D11Query* m_timeCopyQueries[MAX_QUERY_FRAME_NUM] = {};
+  bool m_queryPending[MAX_QUERY_FRAME_NUM] = {};
 
   // Shaders
   ID3D11VertexShader* m_blitVS = nullptr;
   ID3D11PixelShader* m_blitPS = nullptr;
-  ID3D11ComputeShader* m_compressCS = nullptr;
+  ID3D11ComputeShader* m_compressQualityCS = nullptr;
+  ID3D11ComputeShader* m_compressSpeedCS = nullptr;
 
   // Resources
   ID3D11Buffer* m_ib = nullptr;
   ID3D11Texture2D* m_sourceTextureRes = nullptr;
   ID3D11ShaderResourceView* m_sourceTextureView = nullptr;
-  ID3D11Texture2D* m_compressedTextureRes = nullptr;
-  ID3D11ShaderResourceView* m_compressedTextureView = nullptr;
   ID3D11Texture2D* m_compressTargetRes = nullptr;
   ID3D11UnorderedAccessView* m_compressTargetUAV = nullptr;
-#if HAVE_QUALITY_MEASUREMENT
-  ID3D11Texture2D* m_tmpTargetRes = nullptr;
-  ID3D11RenderTargetView* m_tmpTargetView = nullptr;
-#endif
 	ID3D11Texture2D* m_tmpStagingRes = nullptr;
 
   HWND m_windowHandle = 0;
+#endif
   Vec2 m_texelBias = Vec2(0.0f, 0.0f);
   float m_texelScale = 1.0f;
   float m_imageZoom = 0.0f;
   float m_imageExposure = 0.0f;
   bool m_dragEnabled = false;
   Vec2 m_dragStart = Vec2(0.0f, 0.0f);
-  bool m_updateRMSE = true;
   uint32_t m_imageWidth = 0;
   uint32_t m_imageHeight = 0;
   uint64_t m_frameID = 0;
-  Preset m_preset;
+  uint32_t m_effort = BC6HEffort::QUALITY;
+  float m_p2Threshold = 0.0f;
+  BC6HRDO::SSettings m_rdoSettings = { 0.0f, 2.0f, 16 };
+  BC6HEncoderCPU::TileOrder m_tileOrder = BC6HEncoderCPU::TileOrder::RowStrip;
 
 	std::mutex m_compressMutex;
 
   uint32_t m_blitMode = 1;
 
+  BC6HStats::Collector m_stats;
+
+  // Streaming compression
+  BlockRowCallback m_streamCallback;
+  uint32_t m_streamWidth = 0;
+  uint32_t m_streamHeight = 0;
+  uint32_t m_streamRow = 0;
+  BC6HEncoderCPU::TexelFormat m_streamFormat = BC6HEncoderCPU::TexelFormat::RGBA32F;
+  std::vector<uint8_t> m_streamBlocks;
+
   // Compression error
-  float m_rgbRMSLE = 0.0f;
-  float m_lumRMSLE = 0.0f;
+  bool m_measureQuality = false;
+  BC6HMetrics::SResult m_metrics = {};
+
+  ThreadPool* GetThreadPool();
+  bool MeasureUnlocked(const SImage* srcImage, const SImage* compressedImage, BC6HMetrics::SResult& metrics, float* blockMSLE);
+  // allocate == false writes into the dstImage buffer
+  bool CompressUnlocked(const SImage* srcImage, SImage* dstImage, bool allocate, double startTime, BC6HStats::SFrame& frame);
+  // Encode into the dstImage buffer, already sized by CompressUnlocked
+  bool CompressCPU(const SImage* srcImage, SImage* dstImage, BC6HStats::SFrame& frame);
+  bool CompressD3D11(const SImage* srcImage, SImage* dstImage, BC6HStats::SFrame& frame);
 
+  // One 2D surface of a batch (mip level, array slice or stream strip)
+  struct SSurface
+  {
+    uint32_t m_width;
+    uint32_t m_height;
+    const uint8_t* m_texels;
+    BC6HEncoderCPU::TexelFormat m_format;
+    uint32_t m_rowPitch;
+    // Of the surface blocks in the output
+    size_t m_offset;
+  };
+
+  bool CompressSlices(const SImage* srcImage, SImage* dstImage, BC6HStats::SFrame& frame);
+  // Encodes the surfaces with the current backend
+  bool CompressSurfaces(const std::vector<SSurface>& surfaces, BC6HEncoderCPU::Addressing addressing, SImage* dstImage, BC6HStats::SFrame& frame);
+  bool CompressSurfacesCPU(const std::vector<SSurface>& surfaces, BC6HEncoderCPU::Addressing addressing, SImage* dstImage, BC6HStats::SFrame& frame);
+  bool CompressSurfacesD3D11(const std::vector<SSurface>& surfaces, BC6HEncoderCPU::Addressing addressing, SImage* dstImage, BC6HStats::SFrame& frame);
+  bool GetContainerLayout(const SImage* srcImage, uint32_t levelNum, bool cubemap, BC6HContainer::SLayout& layout);
+  // Every surface of the container with its file offset, mipTexels gets the mip levels below the source slices
+  bool GetContainerSurfaces(const SImage* srcImage, const BC6HContainer::SLayout& layout, BC6HContainer::Format format,
+    std::vector<float>& mipTexels, std::vector<SSurface>& surfaces, BC6HStats::SFrame& frame);
+  static BC6HEncoderCPU::Addressing GetContainerAddressing(const BC6HContainer::SLayout& layout);
+  // Writes the header and encodes every surface into file, which has BC6HContainer::GetFileSize bytes
+  bool CompressContainer(const SImage* srcImage, const BC6HContainer::SLayout& layout, BC6HContainer::Format format, uint8_t* file, BC6HStats::SFrame& frame);
+  bool CompressMipChainD3D11(const std::vector<SSurface>& levels, SImage* dstImage, BC6HStats::SFrame& frame);
+  // RDO pass over encoded surfaces, nothing to do while m_rdoSettings.m_lambda is 0
+  void OptimizeSurfaces(const std::vector<SSurface>& surfaces, SImage* dstImage, BC6HStats::SFrame& frame);
+
+#if HAVE_D3D11
   bool CreateImage(const SImage* img);
   void DestroyImage();
 	bool CreateShaders();
   void DestroyShaders();
+  // Shader build of the current effort
+  ID3D11ComputeShader* GetCompressCS() const { return m_effort >= BC6HEffort::QUALITY ? m_compressQualityCS : m_compressSpeedCS; }
   bool CreateTargets();
   void DestroyTargets();
   void CreateQueries();
+  void DestroyQueries();
+  void ResolveQueries();
   bool CreateConstantBuffer();
-  void UpdateRMSE();
-  void CopyTexture(Vec3* image, ID3D11ShaderResourceView* srcView);
+  void UpdateConstantBuffer(uint32_t width, uint32_t height);
+  // Encodes every surface with its view and reads the whole batch back with one Map
+  bool DispatchSurfacesD3D11(const std::vector<SSurface>& surfaces, const std::vector<ID3D11ShaderResourceView*>& views, ID3D11SamplerState* sampler, SImage* dstImage, BC6HStats::SFrame& frame);
+#endif
 };
\ No newline at end of file
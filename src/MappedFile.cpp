@@ -0,0 +1,141 @@
+#include "MappedFile.h"
+
+#include <iostream>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+  Close();
+}
+
+bool MappedFile::Create(const char* path, uint64_t size)
+{
+  Close();
+  if (size == 0)
+    return false;
+
+#ifdef _WIN32
+  HANDLE file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE)
+  {
+    std::cerr << "GPURealTimeBC6H: can't create " << path << std::endl;
+    return false;
+  }
+  m_file = file;
+
+  m_mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, static_cast<DWORD>(size >> 32), static_cast<DWORD>(size), nullptr);
+  if (m_mapping)
+    m_data = static_cast<uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_WRITE, 0, 0, static_cast<SIZE_T>(size)));
+#else
+  m_file = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (m_file < 0)
+  {
+    std::cerr << "GPURealTimeBC6H: can't create " << path << std::endl;
+    return false;
+  }
+
+  if (ftruncate(m_file, static_cast<off_t>(size)) == 0)
+  {
+    void* data = mmap(nullptr, static_cast<size_t>(size), PROT_READ | PROT_WRITE, MAP_SHARED, m_file, 0);
+    m_data = data != MAP_FAILED ? static_cast<uint8_t*>(data) : nullptr;
+  }
+#endif
+
+  if (!m_data)
+  {
+    std::cerr << "GPURealTimeBC6H: can't map " << size << " bytes of " << path << std::endl;
+    Close();
+    return false;
+  }
+
+  m_size = size;
+  m_writable = true;
+  return true;
+}
+
+bool MappedFile::Open(const char* path)
+{
+  Close();
+
+  uint64_t size = 0;
+#ifdef _WIN32
+  HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (file == INVALID_HANDLE_VALUE)
+  {
+    std::cerr << "GPURealTimeBC6H: can't open " << path << std::endl;
+    return false;
+  }
+  m_file = file;
+
+  LARGE_INTEGER fileSize;
+  if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0)
+  {
+    size = static_cast<uint64_t>(fileSize.QuadPart);
+    m_mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (m_mapping)
+      m_data = static_cast<uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+  }
+#else
+  m_file = open(path, O_RDONLY);
+  if (m_file < 0)
+  {
+    std::cerr << "GPURealTimeBC6H: can't open " << path << std::endl;
+    return false;
+  }
+
+  struct stat info;
+  if (fstat(m_file, &info) == 0 && info.st_size > 0)
+  {
+    size = static_cast<uint64_t>(info.st_size);
+    void* data = mmap(nullptr, static_cast<size_t>(size), PROT_READ, MAP_PRIVATE, m_file, 0);
+    m_data = data != MAP_FAILED ? static_cast<uint8_t*>(data) : nullptr;
+    // Readers go front to back, so the kernel can read ahead aggressively
+    if (m_data)
+      madvise(m_data, static_cast<size_t>(size), MADV_SEQUENTIAL);
+  }
+#endif
+
+  if (!m_data)
+  {
+    std::cerr << "GPURealTimeBC6H: can't map " << path << std::endl;
+    Close();
+    return false;
+  }
+
+  m_size = size;
+  m_writable = false;
+  return true;
+}
+
+bool MappedFile::Close()
+{
+  bool result = true;
+#ifdef _WIN32
+  if (m_data)
+    result = (!m_writable || FlushViewOfFile(m_data, 0) != 0) && UnmapViewOfFile(m_data) != 0;
+  if (m_mapping)
+    CloseHandle(m_mapping);
+  if (m_file)
+    CloseHandle(m_file);
+  m_mapping = nullptr;
+  m_file = nullptr;
+#else
+  if (m_data)
+    result = munmap(m_data, static_cast<size_t>(m_size)) == 0;
+  if (m_file >= 0)
+    result = close(m_file) == 0 && result;
+  m_file = -1;
+#endif
+  m_data = nullptr;
+  m_size = 0;
+  m_writable = false;
+  return result;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+
+// File mapped into memory. Create sizes the file up front, so the data can be written in any order straight
+// into the page cache without a staging copy. Open maps an existing file read only, its pages are read in
+// on first access instead of copied into a buffer.
+class MappedFile
+{
+public:
+  MappedFile() = default;
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  // Creates (or truncates) the file and maps all of its size bytes
+  bool Create(const char* path, uint64_t size);
+  // Maps all of an existing, non empty file for reading, the data must not be written to
+  bool Open(const char* path);
+  // Unmaps and closes the file, fails if the data couldn't be flushed
+  bool Close();
+
+  uint8_t* GetData() const { return m_data; }
+  uint64_t GetSize() const { return m_size; }
+
+private:
+#ifdef _WIN32
+  void* m_file = nullptr;
+  void* m_mapping = nullptr;
+#else
+  int m_file = -1;
+#endif
+  uint8_t* m_data = nullptr;
+  uint64_t m_size = 0;
+  bool m_writable = false;
+};
@@ -0,0 +1,202 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace
+{
+  uint64_t PackRange(uint32_t begin, uint32_t end)
+  {
+    return begin | static_cast<uint64_t>(end) << 32;
+  }
+
+  void PinThread(std::thread& thread, uint32_t processor)
+  {
+#ifdef _WIN32
+    if (processor < sizeof(DWORD_PTR) * 8)
+      SetThreadAffinityMask(thread.native_handle(), static_cast<DWORD_PTR>(1) << processor);
+#elif defined(__linux__)
+    if (processor < CPU_SETSIZE)
+    {
+      cpu_set_t cpus;
+      CPU_ZERO(&cpus);
+      CPU_SET(processor, &cpus);
+      pthread_setaffinity_np(thread.native_handle(), sizeof(cpus), &cpus);
+    }
+#else
+    (void)thread;
+    (void)processor;
+#endif
+  }
+}
+
+ThreadPool::ThreadPool(uint32_t threadNum, bool pinThreads)
+{
+  if (threadNum == 0)
+    threadNum = std::thread::hardware_concurrency();
+  if (threadNum == 0)
+    threadNum = 1;
+
+  // The caller of ParallelFor is the last worker
+  for (uint32_t i = 0; i + 1 < threadNum; ++i)
+  {
+    m_workers.emplace_back(&ThreadPool::WorkerMain, this, i);
+    if (pinThreads)
+      PinThread(m_workers.back(), i);
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lk(m_mutex);
+    m_quit = true;
+  }
+  m_jobCV.notify_all();
+
+  for (std::thread& worker : m_workers)
+    worker.join();
+}
+
+void ThreadPool::ParallelFor(uint32_t count, const std::function<void(uint32_t)>& func)
+{
+  if (count == 0)
+    return;
+
+  if (m_workers.empty() || count == 1)
+  {
+    for (uint32_t i = 0; i < count; ++i)
+      func(i);
+    return;
+  }
+
+  SJob job;
+  job.m_func = &func;
+  job.m_rangeNum = GetThreadNum();
+  job.m_ranges.reset(new SRange[job.m_rangeNum]);
+  for (uint32_t i = 0; i < job.m_rangeNum; ++i)
+  {
+    uint32_t begin = static_cast<uint32_t>(static_cast<uint64_t>(count) * i / job.m_rangeNum);
+    uint32_t end = static_cast<uint32_t>(static_cast<uint64_t>(count) * (i + 1) / job.m_rangeNum);
+    job.m_ranges[i].m_items.store(PackRange(begin, end));
+  }
+  job.m_helperNum = 0;
+  {
+    std::lock_guard<std::mutex> lk(m_mutex);
+    m_jobs.push_back(&job);
+  }
+  m_jobCV.notify_all();
+
+  RunItems(job, 0);
+
+  // Once the job is out of the list no other worker joins it, then wait for the ones still running its items.
+  // func and the job must outlive all their calls.
+  std::unique_lock<std::mutex> lk(m_mutex);
+  m_jobs.erase(std::find(m_jobs.begin(), m_jobs.end(), &job));
+  m_doneCV.wait(lk, [&] { return job.m_helperNum == 0; });
+}
+
+ThreadPool::SJob* ThreadPool::FindJob()
+{
+  for (SJob* job : m_jobs)
+  {
+    for (uint32_t i = 0; i < job->m_rangeNum; ++i)
+    {
+      uint64_t items = job->m_ranges[i].m_items.load();
+      if (static_cast<uint32_t>(items) < static_cast<uint32_t>(items >> 32))
+        return job;
+    }
+  }
+  return nullptr;
+}
+
+void ThreadPool::WorkerMain(uint32_t workerIndex)
+{
+  for (;;)
+  {
+    SJob* job = nullptr;
+    {
+      std::unique_lock<std::mutex> lk(m_mutex);
+      m_jobCV.wait(lk, [&] { return m_quit || (job = FindJob()) != nullptr; });
+      if (m_quit)
+        return;
+      ++job->m_helperNum;
+    }
+
+    RunItems(*job, workerIndex + 1);
+
+    {
+      std::lock_guard<std::mutex> lk(m_mutex);
+      --job->m_helperNum;
+    }
+    m_doneCV.notify_all();
+  }
+}
+
+void ThreadPool::RunItems(SJob& job, uint32_t rangeIndex)
+{
+  SRange& range = job.m_ranges[rangeIndex];
+  do
+  {
+    uint32_t item;
+    while (PopItem(range, item))
+      (*job.m_func)(item);
+  } while (StealItems(job, rangeIndex));
+}
+
+bool ThreadPool::PopItem(SRange& range, uint32_t& item)
+{
+  uint64_t items = range.m_items.load();
+  for (;;)
+  {
+    uint32_t begin = static_cast<uint32_t>(items);
+    uint32_t end = static_cast<uint32_t>(items >> 32);
+    if (begin >= end)
+      return false;
+    if (range.m_items.compare_exchange_weak(items, PackRange(begin + 1, end)))
+    {
+      item = begin;
+      return true;
+    }
+  }
+}
+
+bool ThreadPool::StealItems(SJob& job, uint32_t rangeIndex)
+{
+  for (;;)
+  {
+    uint32_t victim = rangeIndex;
+    uint32_t victimSize = 0;
+    uint64_t victimItems = 0;
+    for (uint32_t i = 0; i < job.m_rangeNum; ++i)
+    {
+      uint64_t items = job.m_ranges[i].m_items.load();
+      uint32_t begin = static_cast<uint32_t>(items);
+      uint32_t end = static_cast<uint32_t>(items >> 32);
+      if (i != rangeIndex && end > begin && end - begin > victimSize)
+      {
+        victim = i;
+        victimSize = end - begin;
+        victimItems = items;
+      }
+    }
+    if (victimSize == 0)
+      return false;
+
+    // Our own range is empty, so no other thread touches it until the store below
+    uint32_t begin = static_cast<uint32_t>(victimItems);
+    uint32_t end = static_cast<uint32_t>(victimItems >> 32);
+    uint32_t middle = end - (victimSize + 1) / 2;
+    if (job.m_ranges[victim].m_items.compare_exchange_strong(victimItems, PackRange(begin, middle)))
+    {
+      job.m_ranges[rangeIndex].m_items.store(PackRange(middle, end));
+      return true;
+    }
+  }
+}
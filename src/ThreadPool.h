@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent worker threads used by the CPU backend, can be shared by several compressors.
+// Any number of threads can run a ParallelFor at the same time: every caller works on its own items
+// and the workers help out the oldest call which still has items left.
+// The items of a ParallelFor are split into one contiguous range per thread. Every thread walks its own
+// range front to back and, once it runs dry, steals the back half of the largest range left, so uneven
+// item costs even out without all the threads fighting over one shared counter.
+class ThreadPool
+{
+public:
+  // threadNum == 0 means one thread per hardware core. With pinThreads worker i only runs on logical
+  // processor i, the thread calling ParallelFor is left alone.
+  explicit ThreadPool(uint32_t threadNum = 0, bool pinThreads = false);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  uint32_t GetThreadNum() const { return static_cast<uint32_t>(m_workers.size()) + 1; }
+
+  // Calls func(i) for every i in [0, count). The calling thread takes part in the work
+  // and the call returns once all the items are processed. Thread t starts with the t-th
+  // GetThreadNum() part of [0, count), the caller with the first one.
+  void ParallelFor(uint32_t count, const std::function<void(uint32_t)>& func);
+
+private:
+  // Items [begin, end) left to a thread, packed as begin | end << 32 so a steal is a single compare exchange.
+  // Padded to a cache line, the owner updates it for every item.
+  struct SRange
+  {
+    std::atomic<uint64_t> m_items;
+    uint8_t m_padding[64 - sizeof(uint64_t)];
+  };
+
+  struct SJob
+  {
+    const std::function<void(uint32_t)>* m_func;
+    // One per thread, the caller runs ranges[0] and worker i ranges[i + 1]
+    std::unique_ptr<SRange[]> m_ranges;
+    uint32_t m_rangeNum;
+    // Workers running items of the job, guarded by m_mutex
+    uint32_t m_helperNum;
+  };
+
+  void WorkerMain(uint32_t workerIndex);
+  // Oldest job with items left, m_mutex has to be locked
+  SJob* FindJob();
+  static void RunItems(SJob& job, uint32_t rangeIndex);
+  static bool PopItem(SRange& range, uint32_t& item);
+  // Moves the back half of the largest range other than ranges[rangeIndex] into it, false when all are empty
+  static bool StealItems(SJob& job, uint32_t rangeIndex);
+
+  std::vector<std::thread> m_workers;
+
+  std::mutex m_mutex;
+  std::condition_variable m_jobCV;
+  std::condition_variable m_doneCV;
+
+  // Running ParallelFor calls
+  std::vector<SJob*> m_jobs;
+  bool m_quit = false;
+};
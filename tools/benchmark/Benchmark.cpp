@@ -0,0 +1,707 @@
+// Compression benchmark on deterministic synthetic HDR images.
+//
+// Every (backend, preset, image, size) combination is compressed warmup + iterations times. The report has
+// throughput, latency percentiles and the quality of the last result, one result per line, so two JSON
+// reports can be diffed directly or checked against each other with --baseline. Unless --verify is 0, every
+// combination is also checked against Decompress and the streaming API after it's timed.
+
+#include "GPURealTimeBC6H.h"
+#include "BC6HMath.h"
+#include "ThreadPool.h"
+#include "SyntheticImages.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+  const uint32_t BLOCK_SIZE = 4;
+
+  struct SOptions
+  {
+    std::vector<uint32_t> m_sizes = { 256, 1024, 4096 };
+    std::vector<SyntheticImages::Pattern> m_patterns;
+    std::vector<GPURealTimeBC6H::Backend> m_backends = { GPURealTimeBC6H::Backend::CPU, GPURealTimeBC6H::Backend::D3D11 };
+    std::vector<GPURealTimeBC6H::Preset> m_presets = { GPURealTimeBC6H::Preset::Quality, GPURealTimeBC6H::Preset::Speed };
+    // Replaces the presets when set
+    std::vector<uint32_t> m_efforts;
+    BC6HEncoderSIMD::ISA m_isa = BC6HEncoderSIMD::DetectISA();
+    uint32_t m_iterations = 10;
+    uint32_t m_warmup = 2;
+    uint32_t m_seed = 1;
+    std::string m_output;
+    std::string m_baseline;
+    float m_tolerance = 0.05f;
+    // Block cache entries of the CPU backend, 0 for none
+    uint32_t m_blockCache = 0;
+    // CPU backend P2 search threshold, 0 for none
+    float m_p2Threshold = 0.0f;
+    // RDO lambda, 0 for none
+    float m_rdoLambda = 0.0f;
+    // CPU backend worker threads, 0 for one per hardware core
+    uint32_t m_threads = 0;
+    bool m_pinThreads = false;
+    BC6HEncoderCPU::TileOrder m_tileOrder = BC6HEncoderCPU::TileOrder::RowStrip;
+    // Images per CompressBatch call, 0 times single Compress calls
+    uint32_t m_batch = 0;
+    // Round trip and streaming checks of every combination
+    bool m_verify = true;
+  };
+
+  struct SResult
+  {
+    std::string m_name;
+    const char* m_backend;
+    const char* m_isa;
+    const char* m_preset;
+    const char* m_image;
+    uint32_t m_width;
+    uint32_t m_height;
+    double m_blocksPerSecond;
+    double m_mbPerSecond;
+    double m_latencyMin;
+    double m_latencyP50;
+    double m_latencyP90;
+    double m_latencyP99;
+    double m_latencyMax;
+    float m_gpuTime;
+    // Shares of the blocks the CPU backend wrote as a single color
+    double m_constantBlocks;
+    double m_nearConstantBlocks;
+    // Share of the blocks taken from the block cache
+    double m_cachedBlocks;
+    // Share of the encoded blocks which skipped the P2 search
+    double m_p2SkippedBlocks;
+    // Share of the blocks the RDO pass changed, estimated LZ bytes of an image before and after it
+    double m_rdoChangedBlocks;
+    double m_lzSizeBefore;
+    double m_lzSizeAfter;
+    BC6HMetrics::SResult m_metrics;
+  };
+
+  const char* GetBackendName(GPURealTimeBC6H::Backend backend)
+  {
+    return backend == GPURealTimeBC6H::Backend::CPU ? "cpu" : "d3d11";
+  }
+
+  const char* GetPresetName(GPURealTimeBC6H::Preset preset)
+  {
+    return preset == GPURealTimeBC6H::Preset::Quality ? "quality" : "speed";
+  }
+
+  std::vector<std::string> Split(const char* list)
+  {
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ','))
+    {
+      if (!item.empty())
+        items.push_back(item);
+    }
+    return items;
+  }
+
+  void PrintUsage()
+  {
+    printf(
+      "Usage: GPURealTimeBC6HBenchmark [options]\n"
+      "  --sizes 256,1024,4096         square image sizes, up to 16384\n"
+      "  --images gradient,sky,...     gradient, sky, specular, noise, flat, tiles (default: all)\n"
+      "  --backends cpu,d3d11          backends to time (default: both)\n"
+      "  --presets quality,speed       presets to time (default: both)\n"
+      "  --efforts 0,1,...,5           effort levels to time instead of the presets\n"
+      "  --block-cache N               CPU backend block cache entries, emptied before every compression (default: 0, off)\n"
+      "  --p2-threshold X              CPU backend MSLE under which blocks skip the P2 search (default: 0, off)\n"
+      "  --rdo-lambda X                RDO block MSLE per saved byte (default: 0, off)\n"
+      "  --isa scalar|sse41|avx2|avx512  CPU backend instruction set (default: widest supported)\n"
+      "  --threads N                   CPU backend threads (default: 0, one per hardware core)\n"
+      "  --pin-threads 0|1             bind every CPU backend worker to its own logical processor (default: 0)\n"
+      "  --tile-order row|morton       CPU backend work order (default: row)\n"
+      "  --batch N                     time CompressBatch calls of N copies of the image, latency per image (default: 0, off)\n"
+      "  --verify 0|1                  check the Decompress round trip and streaming against Compress (default: 1)\n"
+      "  --iterations N                timed compressions per result (default: 10)\n"
+      "  --warmup N                    untimed compressions before timing (default: 2)\n"
+      "  --seed N                      synthetic image seed (default: 1)\n"
+      "  --output report.json          write the JSON report\n"
+      "  --baseline baseline.json      compare against a previous report, exit code 1 on a regression\n"
+      "  --tolerance 0.05              allowed relative throughput loss against the baseline\n");
+  }
+
+  bool ParseOptions(int argc, char** argv, SOptions& options)
+  {
+    for (uint32_t i = 0; i < static_cast<uint32_t>(SyntheticImages::Pattern::Count); ++i)
+      options.m_patterns.push_back(static_cast<SyntheticImages::Pattern>(i));
+
+    for (int i = 1; i < argc; ++i)
+    {
+      const char* arg = argv[i];
+      if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0)
+      {
+        PrintUsage();
+        return false;
+      }
+
+      if (i + 1 >= argc)
+      {
+        fprintf(stderr, "Missing value for %s\n", arg);
+        return false;
+      }
+      const char* value = argv[++i];
+
+      if (strcmp(arg, "--sizes") == 0)
+      {
+        options.m_sizes.clear();
+        for (const std::string& item : Split(value))
+        {
+          uint32_t size = static_cast<uint32_t>(strtoul(item.c_str(), nullptr, 10));
+          if (size == 0 || size > 16384)
+          {
+            fprintf(stderr, "Invalid size %s\n", item.c_str());
+            return false;
+          }
+          options.m_sizes.push_back(size);
+        }
+      }
+      else if (strcmp(arg, "--images") == 0)
+      {
+        options.m_patterns.clear();
+        for (const std::string& item : Split(value))
+        {
+          SyntheticImages::Pattern pattern = SyntheticImages::FindPattern(item.c_str());
+          if (pattern == SyntheticImages::Pattern::Count)
+          {
+            fprintf(stderr, "Unknown image %s\n", item.c_str());
+            return false;
+          }
+          options.m_patterns.push_back(pattern);
+        }
+      }
+      else if (strcmp(arg, "--backends") == 0)
+      {
+        options.m_backends.clear();
+        for (const std::string& item : Split(value))
+        {
+          if (item == "cpu")
+            options.m_backends.push_back(GPURealTimeBC6H::Backend::CPU);
+          else if (item == "d3d11")
+            options.m_backends.push_back(GPURealTimeBC6H::Backend::D3D11);
+          else
+          {
+            fprintf(stderr, "Unknown backend %s\n", item.c_str());
+            return false;
+          }
+        }
+      }
+      else if (strcmp(arg, "--presets") == 0)
+      {
+        options.m_presets.clear();
+        for (const std::string& item : Split(value))
+        {
+          if (item == "quality")
+            options.m_presets.push_back(GPURealTimeBC6H::Preset::Quality);
+          else if (item == "speed")
+            options.m_presets.push_back(GPURealTimeBC6H::Preset::Speed);
+          else
+          {
+            fprintf(stderr, "Unknown preset %s\n", item.c_str());
+            return false;
+          }
+        }
+      }
+      else if (strcmp(arg, "--efforts") == 0)
+      {
+        options.m_efforts.clear();
+        for (const std::string& item : Split(value))
+        {
+          uint32_t effort = static_cast<uint32_t>(strtoul(item.c_str(), nullptr, 10));
+          if (effort > BC6HEffort::MAX)
+          {
+            fprintf(stderr, "Effort %s is above %u\n", item.c_str(), BC6HEffort::MAX);
+            return false;
+          }
+          options.m_efforts.push_back(effort);
+        }
+      }
+      else if (strcmp(arg, "--isa") == 0)
+      {
+        const char* names[] = { "scalar", "sse41", "avx2", "avx512" };
+        uint32_t isa = 0;
+        while (isa < 4 && strcmp(value, names[isa]) != 0)
+          ++isa;
+        if (isa == 4)
+        {
+          fprintf(stderr, "Unknown ISA %s\n", value);
+          return false;
+        }
+        options.m_isa = static_cast<BC6HEncoderSIMD::ISA>(isa);
+      }
+      else if (strcmp(arg, "--tile-order") == 0)
+      {
+        if (strcmp(value, "row") == 0)
+          options.m_tileOrder = BC6HEncoderCPU::TileOrder::RowStrip;
+        else if (strcmp(value, "morton") == 0)
+          options.m_tileOrder = BC6HEncoderCPU::TileOrder::Morton;
+        else
+        {
+          fprintf(stderr, "Unknown tile order %s\n", value);
+          return false;
+        }
+      }
+      else if (strcmp(arg, "--batch") == 0)
+        options.m_batch = static_cast<uint32_t>(strtoul(value, nullptr, 10));
+      else if (strcmp(arg, "--threads") == 0)
+        options.m_threads = static_cast<uint32_t>(strtoul(value, nullptr, 10));
+      else if (strcmp(arg, "--pin-threads") == 0)
+        options.m_pinThreads = strtoul(value, nullptr, 10) != 0;
+      else if (strcmp(arg, "--verify") == 0)
+        options.m_verify = strtoul(value, nullptr, 10) != 0;
+      else if (strcmp(arg, "--iterations") == 0)
+        options.m_iterations = std::max(1u, static_cast<uint32_t>(strtoul(value, nullptr, 10)));
+      else if (strcmp(arg, "--block-cache") == 0)
+        options.m_blockCache = static_cast<uint32_t>(strtoul(value, nullptr, 10));
+      else if (strcmp(arg, "--p2-threshold") == 0)
+        options.m_p2Threshold = static_cast<float>(atof(value));
+      else if (strcmp(arg, "--rdo-lambda") == 0)
+        options.m_rdoLambda = static_cast<float>(atof(value));
+      else if (strcmp(arg, "--warmup") == 0)
+        options.m_warmup = static_cast<uint32_t>(strtoul(value, nullptr, 10));
+      else if (strcmp(arg, "--seed") == 0)
+        options.m_seed = static_cast<uint32_t>(strtoul(value, nullptr, 10));
+      else if (strcmp(arg, "--output") == 0)
+        options.m_output = value;
+      else if (strcmp(arg, "--baseline") == 0)
+        options.m_baseline = value;
+      else if (strcmp(arg, "--tolerance") == 0)
+        options.m_tolerance = static_cast<float>(atof(value));
+      else
+      {
+        fprintf(stderr, "Unknown option %s\n", arg);
+        PrintUsage();
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Nearest rank percentile of sorted samples
+  double Percentile(const std::vector<double>& sorted, double percentile)
+  {
+    size_t rank = static_cast<size_t>(ceil(percentile / 100.0 * sorted.size()));
+    return sorted[rank > 0 ? rank - 1 : 0];
+  }
+
+  // Batch depth of --batch, an image being uploaded, one encoded and one read back
+  const uint32_t BATCH_DEPTH = 3;
+
+  bool Run(GPURealTimeBC6H& compressor, const SOptions& options, const SImage& image, SResult& result)
+  {
+    std::vector<double> latencies;
+    std::vector<SImage> batch(options.m_batch, image);
+    for (uint32_t i = 0; i < options.m_warmup + options.m_iterations; ++i)
+    {
+      // Only the repeats within the image hit the cache, not the blocks of the previous iteration
+      compressor.ClearBlockCache();
+
+      if (!batch.empty())
+      {
+        auto start = std::chrono::steady_clock::now();
+        bool batchOK = compressor.CompressBatch(batch.data(), options.m_batch, BATCH_DEPTH, [](uint32_t, const SImage*, bool) {});
+        auto end = std::chrono::steady_clock::now();
+        if (!batchOK)
+          return false;
+        if (i >= options.m_warmup)
+          latencies.push_back(std::chrono::duration<double, std::milli>(end - start).count() / options.m_batch);
+        // The last iteration also compresses once more below for the quality
+        if (i + 1 < options.m_warmup + options.m_iterations)
+          continue;
+      }
+
+      SImage compressed = {};
+      auto start = std::chrono::steady_clock::now();
+      bool compressedOK = compressor.Compress(&image, &compressed);
+      auto end = std::chrono::steady_clock::now();
+      if (!compressedOK)
+        return false;
+
+      if (i >= options.m_warmup && batch.empty())
+        latencies.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+
+      // Quality of the last result, the compressed data doesn't change between iterations
+      if (i + 1 == options.m_warmup + options.m_iterations)
+      {
+        compressor.Measure(&image, &compressed, result.m_metrics);
+      }
+      compressor.FreeImage(&compressed);
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    double total = 0.0;
+    for (double latency : latencies)
+      total += latency;
+    double mean = total / latencies.size();
+
+    double blockNum = static_cast<double>((image.m_width + BLOCK_SIZE - 1) / BLOCK_SIZE) * ((image.m_height + BLOCK_SIZE - 1) / BLOCK_SIZE);
+    double sourceMB = static_cast<double>(image.m_width) * image.m_height * sizeof(float) * 4 / (1024.0 * 1024.0);
+    result.m_blocksPerSecond = blockNum / (mean / 1000.0);
+    result.m_mbPerSecond = sourceMB / (mean / 1000.0);
+    result.m_latencyMin = latencies.front();
+    result.m_latencyP50 = Percentile(latencies, 50.0);
+    result.m_latencyP90 = Percentile(latencies, 90.0);
+    result.m_latencyP99 = Percentile(latencies, 99.0);
+    result.m_latencyMax = latencies.back();
+    result.m_gpuTime = compressor.GetGPUCompressionTime();
+
+    BC6HStats::SStats stats;
+    compressor.GetStats(stats);
+    uint64_t countedNum = stats.m_blocks.m_constant + stats.m_blocks.m_nearConstant + stats.m_blocks.m_encoded + stats.m_blocks.m_cached;
+    if (countedNum > 0)
+    {
+      result.m_constantBlocks = static_cast<double>(stats.m_blocks.m_constant) / countedNum;
+      result.m_nearConstantBlocks = static_cast<double>(stats.m_blocks.m_nearConstant) / countedNum;
+      result.m_cachedBlocks = static_cast<double>(stats.m_blocks.m_cached) / countedNum;
+    }
+    if (stats.m_blocks.m_encoded > 0)
+      result.m_p2SkippedBlocks = static_cast<double>(stats.m_blocks.m_p2Skipped) / stats.m_blocks.m_encoded;
+    if (stats.m_rdo.m_blockNum > 0)
+    {
+      result.m_rdoChangedBlocks = static_cast<double>(stats.m_rdo.m_changedBlocks) / stats.m_rdo.m_blockNum;
+      result.m_lzSizeBefore = static_cast<double>(stats.m_rdo.m_lzSizeBefore) / stats.m_compressCount;
+      result.m_lzSizeAfter = static_cast<double>(stats.m_rdo.m_lzSizeAfter) / stats.m_compressCount;
+    }
+    return true;
+  }
+
+  // Rows per CompressRows call of the streaming check, several strips for all but the smallest images
+  const uint32_t STREAM_ROWS = 64;
+
+  // Decompress has to give back the error Measure reports, which decodes on its own, and streaming the image in
+  // strips has to write the same blocks as Compress of the whole image
+  bool Verify(GPURealTimeBC6H& compressor, const SImage& image, const char* name)
+  {
+    compressor.ClearBlockCache();
+    SImage compressed = {};
+    if (!compressor.Compress(&image, &compressed))
+      return false;
+    BC6HMetrics::SResult metrics;
+    compressor.Measure(&image, &compressed, metrics);
+
+    // RGBA16F, so a 16k image still fits in the 32 bit m_dataSize
+    SImage decoded = {};
+    if (!compressor.Decompress(&compressed, SImage::ImageFormat::RGBA16F, &decoded, image.m_width, image.m_height))
+    {
+      fprintf(stderr, "%s: Decompress failed\n", name);
+      compressor.FreeImage(&compressed);
+      return false;
+    }
+
+    bool ok = decoded.m_width == image.m_width && decoded.m_height == image.m_height &&
+      decoded.m_dataSize == static_cast<uint64_t>(image.m_width) * image.m_height * sizeof(uint16_t) * 4;
+    if (!ok)
+      fprintf(stderr, "%s: Decompress returned %ux%u texels in %u bytes\n", name, decoded.m_width, decoded.m_height, decoded.m_dataSize);
+
+    if (ok)
+    {
+      // Same clamp and RGB RMSLE as BC6HMetrics, which uses a faster log2, hence the tolerance
+      const float halfMax = 65504.0f;
+      const float* source = reinterpret_cast<const float*>(image.m_data);
+      const uint16_t* texels = reinterpret_cast<const uint16_t*>(decoded.m_data);
+      size_t texelNum = static_cast<size_t>(image.m_width) * image.m_height;
+      double logErrorSq = 0.0;
+      for (size_t i = 0; i < texelNum; ++i)
+      {
+        for (uint32_t c = 0; c < 3; ++c)
+        {
+          float a = std::min(std::max(source[i * 4 + c], 0.0f), halfMax);
+          float b = std::min(std::max(BC6HMath::F16ToF32(texels[i * 4 + c]), 0.0f), halfMax);
+          double logDelta = log1p(a) - log1p(b);
+          logErrorSq += logDelta * logDelta;
+        }
+      }
+      double rmsle = sqrt(logErrorSq / (3.0 * texelNum));
+      if (fabs(rmsle - metrics.m_rgbRMSLE) > 0.01 * metrics.m_rgbRMSLE + 1e-5)
+      {
+        fprintf(stderr, "%s: decoded RMSLE %f, Measure reported %f\n", name, rmsle, metrics.m_rgbRMSLE);
+        ok = false;
+      }
+    }
+    compressor.FreeImage(&decoded);
+
+    if (ok)
+    {
+      compressor.ClearBlockCache();
+      size_t blockRowBytes = static_cast<size_t>(compressed.m_width) * 16;
+      std::vector<uint8_t> streamed(compressed.m_dataSize);
+      bool overrun = false;
+      auto blockRowCallback = [&](uint32_t firstBlockRow, uint32_t, const uint8_t* blocks, uint32_t dataSize)
+      {
+        size_t offset = firstBlockRow * blockRowBytes;
+        if (offset + dataSize > streamed.size())
+        {
+          overrun = true;
+          return;
+        }
+        memcpy(streamed.data() + offset, blocks, dataSize);
+      };
+
+      size_t rowPitch = static_cast<size_t>(image.m_width) * sizeof(float) * 4;
+      bool streamOK = compressor.BeginStream(image.m_width, image.m_height, blockRowCallback);
+      for (uint32_t row = 0; streamOK && row < image.m_height; row += STREAM_ROWS)
+        streamOK = compressor.CompressRows(image.m_data + row * rowPitch, static_cast<uint32_t>(rowPitch), std::min(STREAM_ROWS, image.m_height - row));
+      streamOK = compressor.EndStream() && streamOK;
+
+      if (!streamOK || overrun)
+      {
+        fprintf(stderr, "%s: streaming compression failed\n", name);
+        ok = false;
+      }
+      else if (memcmp(streamed.data(), compressed.m_data, streamed.size()) != 0)
+      {
+        size_t offset = std::mismatch(streamed.begin(), streamed.end(), compressed.m_data).first - streamed.begin();
+        fprintf(stderr, "%s: streamed block %zu differs from Compress\n", name, offset / 16);
+        ok = false;
+      }
+    }
+
+    compressor.FreeImage(&compressed);
+    return ok;
+  }
+
+  // JSON has no infinity, a lossless PSNR is written as null.
+  // Timings are noisy anyway, quality metrics get all the digits of a float so they diff exactly.
+  std::string FormatFloat(double value, int digits = 6)
+  {
+    if (!std::isfinite(value))
+      return "null";
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "%.*g", digits, value);
+    return buffer;
+  }
+
+  void WriteReport(FILE* file, const SOptions& options, uint32_t threadNum, const std::vector<SResult>& results)
+  {
+    fprintf(file, "{\n");
+    fprintf(file, "  \"version\": 1,\n");
+    fprintf(file, "  \"seed\": %u,\n", options.m_seed);
+    fprintf(file, "  \"iterations\": %u,\n", options.m_iterations);
+    fprintf(file, "  \"threads\": %u,\n", threadNum);
+    fprintf(file, "  \"pin_threads\": %s,\n", options.m_pinThreads ? "true" : "false");
+    fprintf(file, "  \"batch\": %u,\n", options.m_batch);
+    fprintf(file, "  \"tile_order\": \"%s\",\n", options.m_tileOrder == BC6HEncoderCPU::TileOrder::Morton ? "morton" : "row");
+    fprintf(file, "  \"p2_threshold\": %s,\n", FormatFloat(options.m_p2Threshold).c_str());
+    fprintf(file, "  \"rdo_lambda\": %s,\n", FormatFloat(options.m_rdoLambda).c_str());
+    fprintf(file, "  \"results\": [\n");
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+      const SResult& r = results[i];
+      fprintf(file,
+        "    { \"name\": \"%s\", \"backend\": \"%s\", \"isa\": \"%s\", \"preset\": \"%s\", \"image\": \"%s\", \"width\": %u, \"height\": %u, "
+        "\"blocks_per_s\": %s, \"mb_per_s\": %s, "
+        "\"latency_ms\": { \"min\": %s, \"p50\": %s, \"p90\": %s, \"p99\": %s, \"max\": %s }, \"gpu_ms\": %s, "
+        "\"constant_blocks\": %s, \"near_constant_blocks\": %s, \"cached_blocks\": %s, \"p2_skipped_blocks\": %s, "
+        "\"rdo_changed_blocks\": %s, \"lz_size_before\": %s, \"lz_size_after\": %s, "
+        "\"rgb_rmsle\": %s, \"lum_rmsle\": %s, \"psnr\": %s }%s\n",
+        r.m_name.c_str(), r.m_backend, r.m_isa, r.m_preset, r.m_image, r.m_width, r.m_height,
+        FormatFloat(r.m_blocksPerSecond).c_str(), FormatFloat(r.m_mbPerSecond).c_str(),
+        FormatFloat(r.m_latencyMin).c_str(), FormatFloat(r.m_latencyP50).c_str(), FormatFloat(r.m_latencyP90).c_str(),
+        FormatFloat(r.m_latencyP99).c_str(), FormatFloat(r.m_latencyMax).c_str(), FormatFloat(r.m_gpuTime).c_str(),
+        FormatFloat(r.m_constantBlocks).c_str(), FormatFloat(r.m_nearConstantBlocks).c_str(), FormatFloat(r.m_cachedBlocks).c_str(), FormatFloat(r.m_p2SkippedBlocks).c_str(),
+        FormatFloat(r.m_rdoChangedBlocks).c_str(), FormatFloat(r.m_lzSizeBefore, 9).c_str(), FormatFloat(r.m_lzSizeAfter, 9).c_str(),
+        FormatFloat(r.m_metrics.m_rgbRMSLE, 9).c_str(), FormatFloat(r.m_metrics.m_lumRMSLE, 9).c_str(), FormatFloat(r.m_metrics.m_psnr, 9).c_str(),
+        i + 1 < results.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n");
+    fprintf(file, "}\n");
+  }
+
+  // Reads a number field from a result line written by WriteReport
+  bool FindNumber(const std::string& line, const char* key, double& value)
+  {
+    std::string pattern = std::string("\"") + key + "\": ";
+    size_t pos = line.find(pattern);
+    if (pos == std::string::npos)
+      return false;
+    const char* begin = line.c_str() + pos + pattern.size();
+    char* end = nullptr;
+    value = strtod(begin, &end);
+    return end != begin;
+  }
+
+  // Matches results by name against a report written by WriteReport, returns the number of regressions
+  int CompareWithBaseline(const SOptions& options, const std::vector<SResult>& results)
+  {
+    std::ifstream file(options.m_baseline);
+    if (!file)
+    {
+      fprintf(stderr, "Can't open baseline %s\n", options.m_baseline.c_str());
+      return 1;
+    }
+
+    std::vector<std::string> lines;
+    std::string line;
+    while (std::getline(file, line))
+      lines.push_back(line);
+
+    int regressionNum = 0;
+    printf("\n%-40s %14s %14s %8s %12s\n", "name", "blocks/s", "baseline", "change", "rmsle delta");
+    for (const SResult& r : results)
+    {
+      std::string key = "\"name\": \"" + r.m_name + "\"";
+      auto it = std::find_if(lines.begin(), lines.end(), [&](const std::string& l) { return l.find(key) != std::string::npos; });
+      double baseBlocksPerSecond = 0.0;
+      double baseRMSLE = 0.0;
+      if (it == lines.end() || !FindNumber(*it, "blocks_per_s", baseBlocksPerSecond) || !FindNumber(*it, "rgb_rmsle", baseRMSLE))
+      {
+        printf("%-40s %14.0f %14s\n", r.m_name.c_str(), r.m_blocksPerSecond, "missing");
+        continue;
+      }
+
+      double change = r.m_blocksPerSecond / baseBlocksPerSecond - 1.0;
+      // Compared as floats, the report has just enough digits to round trip them
+      double rmsleDelta = r.m_metrics.m_rgbRMSLE - static_cast<float>(baseRMSLE);
+      // The images are deterministic, so any RMSLE increase is a real quality change
+      bool slower = change < -options.m_tolerance;
+      bool worse = rmsleDelta > 0.0;
+      regressionNum += slower || worse ? 1 : 0;
+      printf("%-40s %14.0f %14.0f %+7.1f%% %+12.6f%s\n", r.m_name.c_str(), r.m_blocksPerSecond, baseBlocksPerSecond, change * 100.0, rmsleDelta,
+        slower ? "  SLOWER" : (worse ? "  WORSE" : ""));
+    }
+    return regressionNum;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  SOptions options;
+  if (!ParseOptions(argc, argv, options))
+    return 1;
+
+  // Drop the backends that aren't available here (D3D11 outside of Windows or without a device)
+  auto unavailable = [](GPURealTimeBC6H::Backend backend)
+  {
+    GPURealTimeBC6H compressor;
+    bool ok = compressor.Init(GPURealTimeBC6H::Preset::Speed, backend);
+    compressor.Release();
+    if (!ok)
+      fprintf(stderr, "Skipping the %s backend, it failed to initialize\n", GetBackendName(backend));
+    return !ok;
+  };
+  options.m_backends.erase(std::remove_if(options.m_backends.begin(), options.m_backends.end(), unavailable), options.m_backends.end());
+
+  // Compressor settings to time, named like the presets or effortN
+  struct SSetting
+  {
+    GPURealTimeBC6H::Preset m_preset;
+    uint32_t m_effort;
+    std::string m_name;
+  };
+  std::vector<SSetting> settings;
+  for (GPURealTimeBC6H::Preset preset : options.m_presets)
+  {
+    uint32_t effort = preset == GPURealTimeBC6H::Preset::Quality ? BC6HEffort::QUALITY : BC6HEffort::SPEED;
+    settings.push_back(SSetting{ preset, effort, GetPresetName(preset) });
+  }
+  if (!options.m_efforts.empty())
+  {
+    settings.clear();
+    for (uint32_t effort : options.m_efforts)
+      settings.push_back(SSetting{ GPURealTimeBC6H::Preset::Quality, effort, "effort" + std::to_string(effort) });
+  }
+
+  ThreadPool generatorPool;
+  // Shared by all the CPU backend compressors, so the workers are started (and pinned) once
+  std::shared_ptr<ThreadPool> encoderPool = std::make_shared<ThreadPool>(options.m_threads, options.m_pinThreads);
+  std::vector<SResult> results;
+
+  printf("%-40s %14s %10s %10s %10s %10s %10s\n", "name", "blocks/s", "MB/s", "p50 ms", "p99 ms", "rmsle", "psnr");
+  for (uint32_t size : options.m_sizes)
+  {
+    size_t byteNum = static_cast<size_t>(size) * size * sizeof(float) * 4;
+    std::unique_ptr<float[]> texels(new (std::nothrow) float[byteNum / sizeof(float)]);
+    if (!texels)
+    {
+      fprintf(stderr, "Can't allocate a %ux%u image\n", size, size);
+      return 1;
+    }
+
+    for (SyntheticImages::Pattern pattern : options.m_patterns)
+    {
+      SyntheticImages::Generate(pattern, size, size, options.m_seed, &generatorPool, texels.get());
+
+      SImage image;
+      image.m_format = SImage::ImageFormat::RGBA32F;
+      image.m_width = size;
+      image.m_height = size;
+      image.m_data = reinterpret_cast<uint8_t*>(texels.get());
+      // m_dataSize is 32 bit and a 16k image is exactly 4GB, the encoders only read width x height texels
+      image.m_dataSize = static_cast<unsigned>(std::min<size_t>(byteNum, 0xFFFFFFFFu));
+
+      for (GPURealTimeBC6H::Backend backend : options.m_backends)
+      {
+        for (const SSetting& setting : settings)
+        {
+          GPURealTimeBC6H compressor;
+          if (!compressor.Init(setting.m_preset, backend, encoderPool))
+          {
+            fprintf(stderr, "Can't initialize the %s backend\n", GetBackendName(backend));
+            return 1;
+          }
+          compressor.SetISA(options.m_isa);
+          compressor.SetEffort(setting.m_effort);
+          compressor.SetBlockCache(options.m_blockCache);
+          compressor.SetP2Threshold(options.m_p2Threshold);
+          compressor.SetRDO(options.m_rdoLambda);
+          compressor.SetTileOrder(options.m_tileOrder);
+
+          SResult result = {};
+          result.m_backend = GetBackendName(backend);
+          result.m_isa = backend == GPURealTimeBC6H::Backend::CPU ? BC6HEncoderSIMD::GetISAName(compressor.GetISA()) : "gpu";
+          result.m_preset = setting.m_name.c_str();
+          result.m_image = SyntheticImages::GetPatternName(pattern);
+          result.m_width = size;
+          result.m_height = size;
+          result.m_name = std::string(result.m_backend) + "/" + result.m_preset + "/" + result.m_image + "/" + std::to_string(size);
+
+          bool ok = Run(compressor, options, image, result);
+          if (ok && options.m_verify)
+            ok = Verify(compressor, image, result.m_name.c_str());
+          compressor.Release();
+          if (!ok)
+          {
+            fprintf(stderr, "%s failed\n", result.m_name.c_str());
+            return 1;
+          }
+
+          printf("%-40s %14.0f %10.1f %10.3f %10.3f %10.6f %10.2f\n", result.m_name.c_str(), result.m_blocksPerSecond, result.m_mbPerSecond,
+            result.m_latencyP50, result.m_latencyP99, result.m_metrics.m_rgbRMSLE, result.m_metrics.m_psnr);
+          results.push_back(result);
+        }
+      }
+    }
+  }
+
+  if (!options.m_output.empty())
+  {
+    FILE* file = fopen(options.m_output.c_str(), "w");
+    if (!file)
+    {
+      fprintf(stderr, "Can't write %s\n", options.m_output.c_str());
+      return 1;
+    }
+    WriteReport(file, options, encoderPool->GetThreadNum(), results);
+    fclose(file);
+  }
+
+  if (!options.m_baseline.empty() && CompareWithBaseline(options, results) > 0)
+    return 1;
+  return 0;
+}
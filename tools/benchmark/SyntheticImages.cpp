@@ -0,0 +1,238 @@
+#include "SyntheticImages.h"
+#include "BC6HMath.h"
+#include "ThreadPool.h"
+
+#include <string.h>
+
+namespace
+{
+  const char* PATTERN_NAMES[] = { "gradient", "sky", "specular", "noise", "flat", "tiles" };
+
+  struct SColor
+  {
+    float r;
+    float g;
+    float b;
+  };
+
+  // https://nullprogram.com/blog/2018/07/31/ (lowbias32)
+  uint32_t Hash(uint32_t x)
+  {
+    x ^= x >> 16;
+    x *= 0x7FEB352Du;
+    x ^= x >> 15;
+    x *= 0x846CA68Bu;
+    x ^= x >> 16;
+    return x;
+  }
+
+  uint32_t Hash(uint32_t x, uint32_t y, uint32_t seed)
+  {
+    return Hash(x ^ Hash(y ^ Hash(seed)));
+  }
+
+  // Uniform in [0, 1)
+  float Random(uint32_t x, uint32_t y, uint32_t seed)
+  {
+    return static_cast<float>(Hash(x, y, seed) >> 8) * (1.0f / 16777216.0f);
+  }
+
+  float Lerp(float a, float b, float t) { return a + (b - a) * t; }
+  float Saturate(float x) { return x < 0.0f ? 0.0f : (x > 1.0f ? 1.0f : x); }
+  float SmoothStep(float x) { return x * x * (3.0f - 2.0f * x); }
+
+  SColor Lerp(SColor a, SColor b, float t)
+  {
+    return SColor{ Lerp(a.r, b.r, t), Lerp(a.g, b.g, t), Lerp(a.b, b.b, t) };
+  }
+
+  // Bilinearly filtered lattice noise in [0, 1)
+  float ValueNoise(float x, float y, uint32_t seed)
+  {
+    float x0 = static_cast<float>(static_cast<int32_t>(x));
+    float y0 = static_cast<float>(static_cast<int32_t>(y));
+    uint32_t ix = static_cast<uint32_t>(static_cast<int32_t>(x0));
+    uint32_t iy = static_cast<uint32_t>(static_cast<int32_t>(y0));
+    float fx = SmoothStep(x - x0);
+    float fy = SmoothStep(y - y0);
+
+    float top = Lerp(Random(ix, iy, seed), Random(ix + 1, iy, seed), fx);
+    float bottom = Lerp(Random(ix, iy + 1, seed), Random(ix + 1, iy + 1, seed), fx);
+    return Lerp(top, bottom, fy);
+  }
+
+  // Four octaves of value noise, roughly in [0, 1)
+  float FBM(float x, float y, uint32_t seed)
+  {
+    float sum = 0.0f;
+    float amplitude = 0.5f;
+    for (uint32_t octave = 0; octave < 4; ++octave)
+    {
+      sum += amplitude * ValueNoise(x, y, seed + octave);
+      x *= 2.0f;
+      y *= 2.0f;
+      amplitude *= 0.5f;
+    }
+    return sum / 0.9375f;
+  }
+
+  SColor Gradient(float u, float v)
+  {
+    SColor color;
+    color.r = BC6HMath::Exp2(Lerp(-8.0f, 8.0f, u));
+    color.g = BC6HMath::Exp2(Lerp(-8.0f, 8.0f, v));
+    color.b = BC6HMath::Exp2(Lerp(8.0f, -8.0f, 0.5f * (u + v)));
+    return color;
+  }
+
+  SColor Sky(float u, float v, uint32_t seed)
+  {
+    const float HORIZON = 0.7f;
+    if (v > HORIZON)
+    {
+      float ground = 0.02f + 0.06f * FBM(u * 64.0f, v * 64.0f, seed + 16);
+      return SColor{ ground * 1.2f, ground, ground * 0.8f };
+    }
+
+    // 0 at the horizon, 1 at the zenith
+    float height = 1.0f - v / HORIZON;
+    SColor horizon = { 6.0f, 5.0f, 4.0f };
+    SColor zenith = { 0.3f, 0.8f, 2.5f };
+    SColor color = Lerp(horizon, zenith, SmoothStep(height));
+
+    float cloud = Saturate((FBM(u * 8.0f, v * 16.0f, seed) - 0.45f) * 4.0f);
+    color = Lerp(color, SColor{ 8.0f, 8.0f, 8.5f }, cloud * 0.8f);
+
+    // Sun glow and a disk far above the half float range, it has to clamp cleanly
+    float dx = u - 0.7f;
+    float dy = v - 0.2f;
+    float distanceSq = dx * dx + dy * dy;
+    float glow = 40.0f / (1.0f + distanceSq * 4000.0f);
+    color.r += glow;
+    color.g += glow * 0.9f;
+    color.b += glow * 0.7f;
+    if (distanceSq < 0.0003f)
+      color = SColor{ 100000.0f, 95000.0f, 90000.0f };
+    return color;
+  }
+
+  SColor Specular(float u, float v, uint32_t seed)
+  {
+    const uint32_t HIGHLIGHT_NUM = 64;
+
+    float base = 0.05f + 0.25f * FBM(u * 32.0f, v * 32.0f, seed);
+    SColor color = { base, base * 0.9f, base * 0.8f };
+    for (uint32_t i = 0; i < HIGHLIGHT_NUM; ++i)
+    {
+      float x = Random(i, 0, seed + 1);
+      float y = Random(i, 1, seed + 1);
+      float radius = 0.002f + 0.02f * Random(i, 2, seed + 1);
+      float peak = BC6HMath::Exp2(Lerp(6.0f, 15.8f, Random(i, 3, seed + 1)));
+
+      float dx = (u - x) / radius;
+      float dy = (v - y) / radius;
+      float falloff = 1.0f / (1.0f + dx * dx + dy * dy);
+      float intensity = peak * falloff * falloff;
+      color.r += intensity;
+      color.g += intensity * Lerp(0.7f, 1.0f, Random(i, 4, seed + 1));
+      color.b += intensity * Lerp(0.5f, 1.0f, Random(i, 5, seed + 1));
+    }
+    return color;
+  }
+
+  SColor Noise(uint32_t x, uint32_t y, uint32_t seed)
+  {
+    SColor color;
+    color.r = BC6HMath::Exp2(Random(x, y, seed) * 20.0f - 10.0f);
+    color.g = BC6HMath::Exp2(Random(x, y, seed + 1) * 20.0f - 10.0f);
+    color.b = BC6HMath::Exp2(Random(x, y, seed + 2) * 20.0f - 10.0f);
+    return color;
+  }
+
+  SColor Flat(float u, float v, uint32_t seed)
+  {
+    const uint32_t CELL_NUM = 8;
+    uint32_t cellX = static_cast<uint32_t>(u * CELL_NUM);
+    uint32_t cellY = static_cast<uint32_t>(v * CELL_NUM);
+    if (Random(cellX, cellY, seed) < 0.15f)
+      return SColor{ 0.0f, 0.0f, 0.0f };
+
+    SColor color;
+    color.r = BC6HMath::Exp2(Random(cellX, cellY, seed + 1) * 12.0f - 6.0f);
+    color.g = BC6HMath::Exp2(Random(cellX, cellY, seed + 2) * 12.0f - 6.0f);
+    color.b = BC6HMath::Exp2(Random(cellX, cellY, seed + 3) * 12.0f - 6.0f);
+    return color;
+  }
+
+  SColor Tiles(uint32_t x, uint32_t y, uint32_t seed)
+  {
+    const uint32_t TILE_SIZE = 16;
+    const uint32_t VARIANT_NUM = 4;
+    uint32_t variant = Hash(x / TILE_SIZE, y / TILE_SIZE, seed) % VARIANT_NUM;
+    float tileU = static_cast<float>(x % TILE_SIZE) / TILE_SIZE;
+    float tileV = static_cast<float>(y % TILE_SIZE) / TILE_SIZE;
+
+    float detail = FBM(tileU * 4.0f, tileV * 4.0f, seed + variant);
+    float intensity = BC6HMath::Exp2(Lerp(-2.0f, 4.0f, detail));
+    SColor color;
+    color.r = intensity * Lerp(0.5f, 1.0f, Random(variant, 0, seed + 1));
+    color.g = intensity * Lerp(0.5f, 1.0f, Random(variant, 1, seed + 1));
+    color.b = intensity * Lerp(0.5f, 1.0f, Random(variant, 2, seed + 1));
+    return color;
+  }
+}
+
+const char* SyntheticImages::GetPatternName(Pattern pattern)
+{
+  return pattern < Pattern::Count ? PATTERN_NAMES[static_cast<uint32_t>(pattern)] : "unknown";
+}
+
+SyntheticImages::Pattern SyntheticImages::FindPattern(const char* name)
+{
+  for (uint32_t i = 0; i < static_cast<uint32_t>(Pattern::Count); ++i)
+  {
+    if (strcmp(name, PATTERN_NAMES[i]) == 0)
+      return static_cast<Pattern>(i);
+  }
+  return Pattern::Count;
+}
+
+void SyntheticImages::Generate(Pattern pattern, uint32_t width, uint32_t height, uint32_t seed, ThreadPool* pool, float* rgba)
+{
+  auto generateRow = [&](uint32_t y)
+  {
+    float* row = rgba + static_cast<size_t>(y) * width * 4;
+    float v = (y + 0.5f) / height;
+    for (uint32_t x = 0; x < width; ++x)
+    {
+      float u = (x + 0.5f) / width;
+
+      SColor color = {};
+      switch (pattern)
+      {
+      case Pattern::Gradient: color = Gradient(u, v); break;
+      case Pattern::Sky: color = Sky(u, v, seed); break;
+      case Pattern::Specular: color = Specular(u, v, seed); break;
+      case Pattern::Noise: color = Noise(x, y, seed); break;
+      case Pattern::Flat: color = Flat(u, v, seed); break;
+      case Pattern::Tiles: color = Tiles(x, y, seed); break;
+      default: break;
+      }
+
+      row[x * 4 + 0] = color.r;
+      row[x * 4 + 1] = color.g;
+      row[x * 4 + 2] = color.b;
+      row[x * 4 + 3] = 1.0f;
+    }
+  };
+
+  if (pool)
+  {
+    pool->ParallelFor(height, generateRow);
+  }
+  else
+  {
+    for (uint32_t y = 0; y < height; ++y)
+      generateRow(y);
+  }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdint.h>
+
+class ThreadPool;
+
+// Deterministic HDR test images for the benchmark.
+// Texels only depend on the pattern, the seed and the normalized texel position, so every size shows
+// the same scene. They are built from integer hashes and BC6HMath polynomials instead of libm calls,
+// so the images (and the RMSLE in the reports) don't change with the C runtime or the thread count.
+namespace SyntheticImages
+{
+  enum struct Pattern
+  {
+    // Log ramps from 2^-8 to 2^8
+    Gradient,
+    // Sky dome with clouds, a sun disk above the half float range and a dark ground
+    Sky,
+    // Dark noisy base with small highlights up to 60000
+    Specular,
+    // Independent per texel and channel values over 20 stops, the worst case for the encoder
+    Noise,
+    // Constant cells, some of them black
+    Flat,
+    // Atlas of 16x16 texel tiles picked from a few variants, the same blocks repeat all over the image
+    Tiles,
+    Count,
+  };
+
+  const char* GetPatternName(Pattern pattern);
+  // Returns Pattern::Count for an unknown name
+  Pattern FindPattern(const char* name);
+
+  // Fills a tightly packed width x height RGBA32F image, alpha is 1. One row per task when a pool is given.
+  void Generate(Pattern pattern, uint32_t width, uint32_t height, uint32_t seed, ThreadPool* pool, float* rgba);
+}
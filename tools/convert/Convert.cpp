@@ -0,0 +1,560 @@
+// Batch converter from .hdr, .pfm and .raw float images to BC6H DDS or KTX2 files.
+//
+// Inputs are files, directories (searched recursively) and manifests. Several files are converted at once,
+// each by its own compressor on a shared encoder thread pool, so reading and decoding one file overlaps the
+// encoding of the others. Outputs whose input content and settings hash matches the cache are skipped.
+// Inputs and single level outputs are memory mapped and converted a strip of rows at a time.
+
+#include "GPURealTimeBC6H.h"
+#include "ThreadPool.h"
+#include "MappedFile.h"
+#include "BC6HMipChain.h"
+#include "FileSystem.h"
+#include "HashCache.h"
+#include "ImageFile.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+  // Bump when the output of the same input and settings changes, so every cached file is built again
+  const uint32_t CACHE_VERSION = 1;
+  const uint32_t BLOCK_SIZE = 4;
+  const uint32_t BLOCK_BYTES = 16;
+  // Rows decoded and encoded at a time, a multiple of the block size
+  const uint32_t STRIP_ROWS = 32;
+
+  struct SOptions
+  {
+    std::vector<std::string> m_inputs;
+    std::vector<std::string> m_manifests;
+    // Outputs go next to their inputs when empty
+    std::string m_outputDir;
+    // Size and channels of .raw inputs
+    ImageFile::SRawLayout m_rawLayout = { 0, 0, 3 };
+    BC6HContainer::Format m_format = BC6HContainer::Format::DDS;
+    // 0 for the full mip chain
+    uint32_t m_levelNum = 0;
+    GPURealTimeBC6H::Backend m_backend = GPURealTimeBC6H::Backend::CPU;
+    uint32_t m_effort = BC6HEffort::QUALITY;
+    float m_p2Threshold = 0.0f;
+    float m_rdoLambda = 0.0f;
+    // Files converted at the same time
+    uint32_t m_jobs = 2;
+    // Encoder threads, 0 for one per hardware core
+    uint32_t m_threads = 0;
+    // Defaults to .bc6h-cache in the output directory, or the current one
+    std::string m_cache;
+    bool m_force = false;
+  };
+
+  struct SJob
+  {
+    std::string m_input;
+    std::string m_output;
+  };
+
+  enum struct Status
+  {
+    Converted,
+    UpToDate,
+    Failed,
+  };
+
+  struct SResult
+  {
+    Status m_status;
+    uint32_t m_width;
+    uint32_t m_height;
+    uint64_t m_inputBytes;
+    // Milliseconds spent reading and hashing, decoding and compressing into the output file
+    double m_readTime;
+    double m_decodeTime;
+    double m_compressTime;
+  };
+
+  double Now()
+  {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  void PrintUsage()
+  {
+    printf(
+      "Usage: GPURealTimeBC6HConvert [options] inputs...\n"
+      "Inputs are .hdr, .pfm or .raw files and directories, which are searched recursively.\n"
+      "  --manifest list.txt           convert the files listed in list.txt, one \"input [output]\" per line, # comments,\n"
+      "                                paths relative to the manifest\n"
+      "  --output-dir dir              write the outputs here, keeping the layout below input directories (default: next to the inputs)\n"
+      "  --raw WxHxC                   layout of .raw files: native endian floats, C = 1, 3 or 4 channels\n"
+      "  --format dds|ktx2             output container (default: dds)\n"
+      "  --mips N                      mip levels, 0 for the full chain (default: 0). Single level outputs are\n"
+      "                                streamed from input to output without holding the whole image\n"
+      "  --backend cpu|d3d11           (default: cpu)\n"
+      "  --effort 0..5                 encoder effort (default: %u)\n"
+      "  --p2-threshold X              CPU backend MSLE under which blocks skip the P2 search (default: 0, off)\n"
+      "  --rdo-lambda X                RDO block MSLE per saved byte for LZ compressed packages (default: 0, off)\n"
+      "  --jobs N                      files converted at the same time (default: 2)\n"
+      "  --threads N                   encoder threads shared by the jobs (default: 0, one per hardware core)\n"
+      "  --cache file                  content hash cache (default: .bc6h-cache in the output directory)\n"
+      "  --force 0|1                   convert up to date files too (default: 0)\n",
+      BC6HEffort::QUALITY);
+  }
+
+  bool ParseOptions(int argc, char** argv, SOptions& options)
+  {
+    for (int i = 1; i < argc; ++i)
+    {
+      const char* arg = argv[i];
+      if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0)
+      {
+        PrintUsage();
+        return false;
+      }
+
+      if (strncmp(arg, "--", 2) != 0)
+      {
+        options.m_inputs.push_back(arg);
+        continue;
+      }
+
+      if (i + 1 >= argc)
+      {
+        fprintf(stderr, "Missing value for %s\n", arg);
+        return false;
+      }
+      const char* value = argv[++i];
+
+      if (strcmp(arg, "--manifest") == 0)
+        options.m_manifests.push_back(value);
+      else if (strcmp(arg, "--output-dir") == 0)
+        options.m_outputDir = value;
+      else if (strcmp(arg, "--format") == 0)
+      {
+        if (strcmp(value, "dds") == 0)
+          options.m_format = BC6HContainer::Format::DDS;
+        else if (strcmp(value, "ktx2") == 0)
+          options.m_format = BC6HContainer::Format::KTX2;
+        else
+        {
+          fprintf(stderr, "Unknown format %s\n", value);
+          return false;
+        }
+      }
+      else if (strcmp(arg, "--raw") == 0)
+      {
+        ImageFile::SRawLayout& raw = options.m_rawLayout;
+        if (sscanf(value, "%ux%ux%u", &raw.m_width, &raw.m_height, &raw.m_channelNum) != 3)
+        {
+          fprintf(stderr, "Invalid raw layout %s, expected WxHxC\n", value);
+          return false;
+        }
+      }
+      else if (strcmp(arg, "--mips") == 0)
+        options.m_levelNum = static_cast<uint32_t>(strtoul(value, nullptr, 10));
+      else if (strcmp(arg, "--backend") == 0)
+      {
+        if (strcmp(value, "cpu") == 0)
+          options.m_backend = GPURealTimeBC6H::Backend::CPU;
+        else if (strcmp(value, "d3d11") == 0)
+          options.m_backend = GPURealTimeBC6H::Backend::D3D11;
+        else
+        {
+          fprintf(stderr, "Unknown backend %s\n", value);
+          return false;
+        }
+      }
+      else if (strcmp(arg, "--effort") == 0)
+      {
+        options.m_effort = static_cast<uint32_t>(strtoul(value, nullptr, 10));
+        if (options.m_effort > BC6HEffort::MAX)
+        {
+          fprintf(stderr, "Effort %s is above %u\n", value, BC6HEffort::MAX);
+          return false;
+        }
+      }
+      else if (strcmp(arg, "--p2-threshold") == 0)
+        options.m_p2Threshold = static_cast<float>(atof(value));
+      else if (strcmp(arg, "--rdo-lambda") == 0)
+        options.m_rdoLambda = static_cast<float>(atof(value));
+      else if (strcmp(arg, "--jobs") == 0)
+        options.m_jobs = std::max(1u, static_cast<uint32_t>(strtoul(value, nullptr, 10)));
+      else if (strcmp(arg, "--threads") == 0)
+        options.m_threads = static_cast<uint32_t>(strtoul(value, nullptr, 10));
+      else if (strcmp(arg, "--cache") == 0)
+        options.m_cache = value;
+      else if (strcmp(arg, "--force") == 0)
+        options.m_force = strtoul(value, nullptr, 10) != 0;
+      else
+      {
+        fprintf(stderr, "Unknown option %s\n", arg);
+        PrintUsage();
+        return false;
+      }
+    }
+
+    if (options.m_inputs.empty() && options.m_manifests.empty())
+    {
+      PrintUsage();
+      return false;
+    }
+    return true;
+  }
+
+  // relativePath is the input below the directory it was found in, or its file name
+  std::string GetOutputPath(const SOptions& options, const std::string& input, const std::string& relativePath)
+  {
+    const char* extension = options.m_format == BC6HContainer::Format::DDS ? ".dds" : ".ktx2";
+    if (options.m_outputDir.empty())
+      return FileSystem::ReplaceExtension(input, extension);
+    return FileSystem::ReplaceExtension(FileSystem::Join(options.m_outputDir, relativePath), extension);
+  }
+
+  std::string GetFileName(const std::string& path)
+  {
+    size_t separator = path.find_last_of("/\\");
+    return separator == std::string::npos ? path : path.substr(separator + 1);
+  }
+
+  bool ReadManifest(const SOptions& options, const std::string& manifest, std::vector<SJob>& jobs)
+  {
+    std::ifstream file(manifest);
+    if (!file)
+    {
+      fprintf(stderr, "Can't open manifest %s\n", manifest.c_str());
+      return false;
+    }
+
+    std::string manifestDir = FileSystem::GetDirectory(manifest);
+    std::string line;
+    uint32_t lineNumber = 0;
+    while (std::getline(file, line))
+    {
+      ++lineNumber;
+      size_t comment = line.find('#');
+      if (comment != std::string::npos)
+        line.resize(comment);
+
+      std::istringstream fields(line);
+      std::string input;
+      std::string output;
+      if (!(fields >> input))
+        continue;
+      fields >> output;
+
+      SJob job;
+      job.m_input = FileSystem::Join(manifestDir, input);
+      if (!ImageFile::IsSupported(job.m_input.c_str()))
+      {
+        fprintf(stderr, "%s:%u: unsupported file type %s\n", manifest.c_str(), lineNumber, input.c_str());
+        return false;
+      }
+      job.m_output = output.empty() ? GetOutputPath(options, job.m_input, input) : FileSystem::Join(manifestDir, output);
+      jobs.push_back(job);
+    }
+    return true;
+  }
+
+  bool CollectJobs(const SOptions& options, std::vector<SJob>& jobs)
+  {
+    for (const std::string& input : options.m_inputs)
+    {
+      if (FileSystem::IsDirectory(input))
+      {
+        std::vector<std::string> files;
+        if (!FileSystem::ListFiles(input, files))
+        {
+          fprintf(stderr, "Can't list %s\n", input.c_str());
+          return false;
+        }
+
+        // ListFiles returns the directory without trailing separators, '/' and the path below it
+        std::string root = input;
+        while (root.size() > 1 && (root.back() == '/' || root.back() == '\\'))
+          root.pop_back();
+        size_t prefixSize = root.size() + 1;
+
+        for (const std::string& file : files)
+        {
+          if (ImageFile::IsSupported(file.c_str()))
+            jobs.push_back(SJob{ file, GetOutputPath(options, file, file.substr(prefixSize)) });
+        }
+      }
+      else if (ImageFile::IsSupported(input.c_str()))
+      {
+        jobs.push_back(SJob{ input, GetOutputPath(options, input, GetFileName(input)) });
+      }
+      else
+      {
+        fprintf(stderr, "%s is neither a directory nor a .hdr, .pfm or .raw file\n", input.c_str());
+        return false;
+      }
+    }
+
+    for (const std::string& manifest : options.m_manifests)
+    {
+      if (!ReadManifest(options, manifest, jobs))
+        return false;
+    }
+
+    // Two jobs writing the same file would race, and the cache would only remember one of them
+    std::set<std::string> outputs;
+    for (const SJob& job : jobs)
+    {
+      if (!outputs.insert(job.m_output).second)
+      {
+        fprintf(stderr, "%s is the output of more than one input\n", job.m_output.c_str());
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Seed of the input hashes: the same input converted with other settings gives another output
+  uint64_t HashSettings(const SOptions& options)
+  {
+    char settings[256];
+    snprintf(settings, sizeof(settings), "v%u format %u mips %u backend %u effort %u p2 %.9g rdo %.9g raw %ux%ux%u", CACHE_VERSION,
+      static_cast<uint32_t>(options.m_format), options.m_levelNum, static_cast<uint32_t>(options.m_backend), options.m_effort,
+      options.m_p2Threshold, options.m_rdoLambda, options.m_rawLayout.m_width, options.m_rawLayout.m_height, options.m_rawLayout.m_channelNum);
+    return HashCache::Hash(reinterpret_cast<const uint8_t*>(settings), strlen(settings));
+  }
+
+  // Single level outputs: the rows go from the mapped input through the encoder into the mapped output a strip
+  // at a time, the whole image is never in memory
+  bool StreamToFile(GPURealTimeBC6H& compressor, const SOptions& options, ImageFile::Reader& reader, const std::string& output, SResult& result)
+  {
+    BC6HContainer::SLayout layout = { reader.GetWidth(), reader.GetHeight(), 1, 1, false };
+    MappedFile file;
+    if (!file.Create(output.c_str(), BC6HContainer::GetFileSize(options.m_format, layout)))
+      return false;
+    BC6HContainer::WriteHeader(options.m_format, layout, file.GetData());
+
+    uint8_t* blocks = file.GetData() + BC6HContainer::GetSurfaceOffset(options.m_format, layout, 0, 0);
+    size_t blockRowBytes = static_cast<size_t>(reader.GetWidth() + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_BYTES;
+    auto blockRowCallback = [&](uint32_t firstBlockRow, uint32_t, const uint8_t* stripBlocks, uint32_t dataSize)
+    {
+      memcpy(blocks + firstBlockRow * blockRowBytes, stripBlocks, dataSize);
+    };
+    SImage::ImageFormat rowFormat = reader.GetChannelNum() == 4 ? SImage::ImageFormat::RGBA32F : SImage::ImageFormat::RGB32F;
+    bool ok = compressor.BeginStream(reader.GetWidth(), reader.GetHeight(), blockRowCallback, rowFormat);
+
+    std::vector<uint8_t> strip(static_cast<size_t>(STRIP_ROWS) * reader.GetRowPitch());
+    for (uint32_t row = 0; ok && row < reader.GetHeight(); row += STRIP_ROWS)
+    {
+      uint32_t rowNum = std::min(STRIP_ROWS, reader.GetHeight() - row);
+      double decodeStart = Now();
+      const uint8_t* rows = reader.ReadRows(rowNum, strip.data());
+      double compressStart = Now();
+      result.m_decodeTime += compressStart - decodeStart;
+      ok = rows && compressor.CompressRows(rows, reader.GetRowPitch(), rowNum);
+      result.m_compressTime += Now() - compressStart;
+    }
+    ok = compressor.EndStream() && ok;
+
+    double closeStart = Now();
+    ok = file.Close() && ok;
+    result.m_compressTime += Now() - closeStart;
+    if (!ok)
+      remove(output.c_str());
+    return ok;
+  }
+
+  // Mip chains are built from the whole level 0, the strips fill an RGBA32F image for CompressToFile
+  bool CompressChainToFile(GPURealTimeBC6H& compressor, const SOptions& options, ImageFile::Reader& reader, const std::string& output, SResult& result)
+  {
+    double decodeStart = Now();
+    uint32_t width = reader.GetWidth();
+    uint32_t channelNum = reader.GetChannelNum();
+    // SImage::m_dataSize is 32 bit, larger images can only be converted without mips
+    uint64_t texelBytes = static_cast<uint64_t>(width) * reader.GetHeight() * 4 * sizeof(float);
+    if (texelBytes > 0xFFFFFFFFu)
+    {
+      fprintf(stderr, "%s: the RGBA32F level 0 of %ux%u is over 4 GB, mip chains can't be built for it\n", output.c_str(), width, reader.GetHeight());
+      return false;
+    }
+    std::vector<float> texels(static_cast<size_t>(width) * reader.GetHeight() * 4);
+    std::vector<uint8_t> strip(static_cast<size_t>(STRIP_ROWS) * reader.GetRowPitch());
+    for (uint32_t row = 0; row < reader.GetHeight(); row += STRIP_ROWS)
+    {
+      uint32_t rowNum = std::min(STRIP_ROWS, reader.GetHeight() - row);
+      const uint8_t* rows = reader.ReadRows(rowNum, strip.data());
+      if (!rows)
+        return false;
+
+      for (uint32_t y = 0; y < rowNum; ++y)
+      {
+        const uint8_t* src = rows + static_cast<size_t>(y) * reader.GetRowPitch();
+        float* dst = texels.data() + static_cast<size_t>(row + y) * width * 4;
+        for (uint32_t x = 0; x < width; ++x)
+        {
+          memcpy(dst + x * 4, src + x * channelNum * sizeof(float), sizeof(float) * 3);
+          dst[x * 4 + 3] = 1.0f;
+        }
+      }
+    }
+    result.m_decodeTime = Now() - decodeStart;
+
+    double compressStart = Now();
+    SImage image;
+    image.m_format = SImage::ImageFormat::RGBA32F;
+    image.m_width = width;
+    image.m_height = reader.GetHeight();
+    image.m_data = reinterpret_cast<uint8_t*>(texels.data());
+    image.m_dataSize = static_cast<unsigned>(texelBytes);
+    bool ok = compressor.CompressToFile(&image, options.m_levelNum, false, options.m_format, output.c_str());
+    result.m_compressTime = Now() - compressStart;
+    return ok;
+  }
+
+  bool ConvertFile(GPURealTimeBC6H& compressor, const SOptions& options, uint64_t settingsHash, HashCache& cache, const SJob& job, SResult& result)
+  {
+    // The hash pages the file in, decoding reads it again from the page cache
+    double readStart = Now();
+    ImageFile::Reader reader;
+    if (!reader.Open(job.m_input.c_str(), options.m_rawLayout))
+      return false;
+    result.m_inputBytes = reader.GetFileSize();
+    uint64_t hash = HashCache::Hash(reader.GetFileData(), static_cast<size_t>(reader.GetFileSize()), settingsHash);
+    result.m_width = reader.GetWidth();
+    result.m_height = reader.GetHeight();
+    result.m_readTime = Now() - readStart;
+
+    if (!options.m_force && cache.IsUpToDate(job.m_output, hash))
+    {
+      result.m_status = Status::UpToDate;
+      return true;
+    }
+
+    if (!FileSystem::CreateDirectories(FileSystem::GetDirectory(job.m_output)))
+    {
+      fprintf(stderr, "Can't create the directory of %s\n", job.m_output.c_str());
+      return false;
+    }
+
+    // A failed conversion leaves no output behind, its stale cache entry goes too
+    cache.Remove(job.m_output);
+    bool singleLevel = options.m_levelNum == 1 || BC6HMipChain::GetLevelNum(result.m_width, result.m_height) == 1;
+    bool ok = singleLevel ? StreamToFile(compressor, options, reader, job.m_output, result) : CompressChainToFile(compressor, options, reader, job.m_output, result);
+    if (!ok)
+      return false;
+
+    cache.Set(job.m_output, hash);
+    result.m_status = Status::Converted;
+    return true;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  SOptions options;
+  if (!ParseOptions(argc, argv, options))
+    return 1;
+
+  std::vector<SJob> jobs;
+  if (!CollectJobs(options, jobs))
+    return 1;
+
+  HashCache cache;
+  std::string cachePath = !options.m_cache.empty() ? options.m_cache : FileSystem::Join(options.m_outputDir, ".bc6h-cache");
+  if (!cache.Load(cachePath))
+  {
+    fprintf(stderr, "Can't read the cache %s\n", cachePath.c_str());
+    return 1;
+  }
+  uint64_t settingsHash = HashSettings(options);
+
+  // One compressor per job, all encoding on the same workers
+  std::shared_ptr<ThreadPool> encoderPool = std::make_shared<ThreadPool>(options.m_threads);
+  uint32_t workerNum = std::min<uint32_t>(options.m_jobs, static_cast<uint32_t>(jobs.size()));
+  std::vector<std::unique_ptr<GPURealTimeBC6H>> compressors(workerNum);
+  for (std::unique_ptr<GPURealTimeBC6H>& compressor : compressors)
+  {
+    compressor.reset(new GPURealTimeBC6H());
+    if (!compressor->Init(GPURealTimeBC6H::Preset::Quality, options.m_backend, encoderPool))
+    {
+      fprintf(stderr, "Can't initialize the compressor\n");
+      return 1;
+    }
+    compressor->SetEffort(options.m_effort);
+    compressor->SetP2Threshold(options.m_p2Threshold);
+    compressor->SetRDO(options.m_rdoLambda);
+  }
+
+  std::vector<SResult> results(jobs.size(), SResult{ Status::Failed, 0, 0, 0, 0.0, 0.0, 0.0 });
+  std::atomic<uint32_t> nextJob(0);
+  std::atomic<uint32_t> doneNum(0);
+  std::mutex printMutex;
+  auto worker = [&](uint32_t workerIndex)
+  {
+    for (uint32_t i = nextJob++; i < jobs.size(); i = nextJob++)
+    {
+      SResult& result = results[i];
+      if (!ConvertFile(*compressors[workerIndex], options, settingsHash, cache, jobs[i], result))
+        result.m_status = Status::Failed;
+
+      std::lock_guard<std::mutex> lk(printMutex);
+      uint32_t done = ++doneNum;
+      if (result.m_status == Status::Converted)
+      {
+        double megaTexels = static_cast<double>(result.m_width) * result.m_height / 1e6;
+        printf("[%u/%zu] %s %ux%u read %.1f ms, decode %.1f ms, compress %.1f ms, %.1f MTexels/s\n", done, jobs.size(), jobs[i].m_output.c_str(),
+          result.m_width, result.m_height, result.m_readTime, result.m_decodeTime, result.m_compressTime, megaTexels / (result.m_compressTime / 1000.0));
+      }
+      else
+      {
+        printf("[%u/%zu] %s %s\n", done, jobs.size(), jobs[i].m_output.c_str(), result.m_status == Status::UpToDate ? "up to date" : "FAILED");
+      }
+      fflush(stdout);
+    }
+  };
+
+  double startTime = Now();
+  std::vector<std::thread> threads;
+  for (uint32_t i = 1; i < workerNum; ++i)
+    threads.emplace_back(worker, i);
+  if (workerNum > 0)
+    worker(0);
+  for (std::thread& thread : threads)
+    thread.join();
+  double totalTime = Now() - startTime;
+
+  for (std::unique_ptr<GPURealTimeBC6H>& compressor : compressors)
+    compressor->Release();
+
+  bool cacheSaved = cache.Save();
+  if (!cacheSaved)
+    fprintf(stderr, "Can't write the cache %s\n", cachePath.c_str());
+
+  uint32_t counts[3] = {};
+  uint64_t texelNum = 0;
+  uint64_t inputBytes = 0;
+  for (const SResult& result : results)
+  {
+    ++counts[static_cast<uint32_t>(result.m_status)];
+    if (result.m_status == Status::Converted)
+    {
+      texelNum += static_cast<uint64_t>(result.m_width) * result.m_height;
+      inputBytes += result.m_inputBytes;
+    }
+  }
+
+  double seconds = std::max(totalTime, 1e-3) / 1000.0;
+  printf("%u converted, %u up to date, %u failed in %.2f s: %.1f MTexels/s, %.1f MB/s of input files\n",
+    counts[static_cast<uint32_t>(Status::Converted)], counts[static_cast<uint32_t>(Status::UpToDate)], counts[static_cast<uint32_t>(Status::Failed)],
+    seconds, texelNum / 1e6 / seconds, inputBytes / (1024.0 * 1024.0) / seconds);
+  return counts[static_cast<uint32_t>(Status::Failed)] == 0 && cacheSaved ? 0 : 1;
+}
@@ -0,0 +1,171 @@
+#include "FileSystem.h"
+
+#include <stdio.h>
+#include <algorithm>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <errno.h>
+#include <sys/stat.h>
+#endif
+
+namespace
+{
+  bool IsSeparator(char c)
+  {
+    return c == '/' || c == '\\';
+  }
+
+  bool ListFilesRecursive(const std::string& dir, std::vector<std::string>& files)
+  {
+#ifdef _WIN32
+    WIN32_FIND_DATAA entry;
+    HANDLE find = FindFirstFileA((dir + "/*").c_str(), &entry);
+    if (find == INVALID_HANDLE_VALUE)
+      return false;
+
+    bool result = true;
+    do
+    {
+      std::string name = entry.cFileName;
+      if (name == "." || name == "..")
+        continue;
+      std::string path = dir + "/" + name;
+      if (entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+        result = ListFilesRecursive(path, files) && result;
+      else
+        files.push_back(path);
+    } while (FindNextFileA(find, &entry));
+    FindClose(find);
+    return result;
+#else
+    DIR* handle = opendir(dir.c_str());
+    if (!handle)
+      return false;
+
+    bool result = true;
+    while (const dirent* entry = readdir(handle))
+    {
+      std::string name = entry->d_name;
+      if (name == "." || name == "..")
+        continue;
+      // d_type is DT_UNKNOWN on some file systems, stat decides then
+      std::string path = dir + "/" + name;
+      if (FileSystem::IsDirectory(path))
+        result = ListFilesRecursive(path, files) && result;
+      else
+        files.push_back(path);
+    }
+    closedir(handle);
+    return result;
+#endif
+  }
+}
+
+bool FileSystem::IsDirectory(const std::string& path)
+{
+#ifdef _WIN32
+  DWORD attributes = GetFileAttributesA(path.c_str());
+  return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY);
+#else
+  struct stat info;
+  return stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+#endif
+}
+
+bool FileSystem::FileExists(const std::string& path)
+{
+#ifdef _WIN32
+  DWORD attributes = GetFileAttributesA(path.c_str());
+  return attributes != INVALID_FILE_ATTRIBUTES && !(attributes & FILE_ATTRIBUTE_DIRECTORY);
+#else
+  struct stat info;
+  return stat(path.c_str(), &info) == 0 && S_ISREG(info.st_mode);
+#endif
+}
+
+bool FileSystem::ListFiles(const std::string& dir, std::vector<std::string>& files)
+{
+  std::string root = dir;
+  while (root.size() > 1 && IsSeparator(root.back()))
+    root.pop_back();
+
+  size_t firstFile = files.size();
+  bool result = ListFilesRecursive(root, files);
+  std::sort(files.begin() + firstFile, files.end());
+  return result;
+}
+
+bool FileSystem::CreateDirectories(const std::string& dir)
+{
+  if (dir.empty() || IsDirectory(dir))
+    return true;
+
+  std::string parent = GetDirectory(dir);
+  if (!parent.empty() && parent != dir && !CreateDirectories(parent))
+    return false;
+
+  // Another converter thread can create it first
+#ifdef _WIN32
+  return CreateDirectoryA(dir.c_str(), nullptr) || GetLastError() == ERROR_ALREADY_EXISTS;
+#else
+  return mkdir(dir.c_str(), 0755) == 0 || errno == EEXIST;
+#endif
+}
+
+bool FileSystem::ReadFile(const std::string& path, std::vector<uint8_t>& data)
+{
+  FILE* file = fopen(path.c_str(), "rb");
+  if (!file)
+    return false;
+
+  bool result = fseek(file, 0, SEEK_END) == 0;
+  long size = result ? ftell(file) : -1;
+  result = size >= 0 && fseek(file, 0, SEEK_SET) == 0;
+  if (result)
+  {
+    data.resize(static_cast<size_t>(size));
+    result = fread(data.data(), 1, data.size(), file) == data.size();
+  }
+  fclose(file);
+  return result;
+}
+
+std::string FileSystem::GetDirectory(const std::string& path)
+{
+  size_t end = path.size();
+  while (end > 0 && !IsSeparator(path[end - 1]))
+    --end;
+  // Keep the root of an absolute path
+  while (end > 1 && IsSeparator(path[end - 1]))
+    --end;
+  return path.substr(0, end);
+}
+
+std::string FileSystem::GetExtension(const std::string& path)
+{
+  size_t dot = path.find_last_of('.');
+  size_t separator = path.find_last_of("/\\");
+  if (dot == std::string::npos || (separator != std::string::npos && dot < separator))
+    return std::string();
+
+  std::string extension = path.substr(dot);
+  std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c; });
+  return extension;
+}
+
+std::string FileSystem::ReplaceExtension(const std::string& path, const char* extension)
+{
+  return path.substr(0, path.size() - GetExtension(path).size()) + extension;
+}
+
+std::string FileSystem::Join(const std::string& dir, const std::string& path)
+{
+  bool absolute = !path.empty() && (IsSeparator(path[0]) || (path.size() > 1 && path[1] == ':'));
+  if (dir.empty() || absolute)
+    return path;
+  return IsSeparator(dir.back()) ? dir + path : dir + "/" + path;
+}
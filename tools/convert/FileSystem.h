@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// The few file system calls the converter needs, on top of Win32 or POSIX. Paths are UTF-8 with '/' or '\\'
+// separators, returned paths use '/'.
+namespace FileSystem
+{
+  bool IsDirectory(const std::string& path);
+  bool FileExists(const std::string& path);
+  // Files under dir and its subdirectories, sorted, so the order doesn't depend on the file system
+  bool ListFiles(const std::string& dir, std::vector<std::string>& files);
+  // Creates dir and all of its missing parents
+  bool CreateDirectories(const std::string& dir);
+  bool ReadFile(const std::string& path, std::vector<uint8_t>& data);
+
+  // "a/b" for "a/b/c.hdr", empty for "c.hdr"
+  std::string GetDirectory(const std::string& path);
+  // ".hdr" for "a/b/c.hdr" (lowercase), empty without an extension
+  std::string GetExtension(const std::string& path);
+  std::string ReplaceExtension(const std::string& path, const char* extension);
+  // dir + '/' + path, or path alone when it is absolute or dir is empty
+  std::string Join(const std::string& dir, const std::string& path);
+}
@@ -0,0 +1,103 @@
+#include "HashCache.h"
+#include "FileSystem.h"
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <string.h>
+#include <fstream>
+
+namespace
+{
+  const uint64_t PRIME = 0x9E3779B97F4A7C15ull;
+
+  // splitmix64 finalizer
+  uint64_t Mix(uint64_t h)
+  {
+    h ^= h >> 30;
+    h *= 0xBF58476D1CE4E5B9ull;
+    h ^= h >> 27;
+    h *= 0x94D049BB133111EBull;
+    return h ^ (h >> 31);
+  }
+}
+
+uint64_t HashCache::Hash(const uint8_t* data, size_t size, uint64_t seed)
+{
+  // Four independent lanes of 8 byte words keep the multiplies from serializing, about the speed of a file read
+  uint64_t lanes[4] = { seed, seed + PRIME, seed - PRIME, ~seed };
+  size_t pos = 0;
+  for (; pos + 32 <= size; pos += 32)
+  {
+    for (uint32_t lane = 0; lane < 4; ++lane)
+    {
+      uint64_t word;
+      memcpy(&word, data + pos + lane * 8, sizeof(word));
+      lanes[lane] = (lanes[lane] ^ word) * PRIME;
+      lanes[lane] ^= lanes[lane] >> 29;
+    }
+  }
+
+  uint64_t h = Mix(lanes[0]) ^ Mix(lanes[1] + 1) ^ Mix(lanes[2] + 2) ^ Mix(lanes[3] + 3);
+  for (; pos < size; ++pos)
+    h = (h ^ data[pos]) * PRIME;
+  return Mix(h ^ size);
+}
+
+bool HashCache::Load(const std::string& path)
+{
+  std::lock_guard<std::mutex> lk(m_mutex);
+  m_path = path;
+  m_entries.clear();
+
+  std::ifstream file(path);
+  if (!file)
+    return !FileSystem::FileExists(path);
+
+  std::string line;
+  while (std::getline(file, line))
+  {
+    // 16 hex digits, a space and the output path
+    uint64_t hash = 0;
+    if (line.size() > 17 && line[16] == ' ' && sscanf(line.c_str(), "%16" SCNx64, &hash) == 1)
+      m_entries[line.substr(17)] = hash;
+  }
+  return true;
+}
+
+bool HashCache::Save() const
+{
+  std::lock_guard<std::mutex> lk(m_mutex);
+  std::string tempPath = m_path + ".tmp";
+  FILE* file = fopen(tempPath.c_str(), "w");
+  if (!file)
+    return false;
+
+  for (const auto& entry : m_entries)
+    fprintf(file, "%016" PRIx64 " %s\n", entry.second, entry.first.c_str());
+  bool result = fclose(file) == 0;
+
+  // rename doesn't replace an existing file on Windows
+#ifdef _WIN32
+  remove(m_path.c_str());
+#endif
+  return result && rename(tempPath.c_str(), m_path.c_str()) == 0;
+}
+
+bool HashCache::IsUpToDate(const std::string& output, uint64_t hash) const
+{
+  std::lock_guard<std::mutex> lk(m_mutex);
+  auto it = m_entries.find(output);
+  return it != m_entries.end() && it->second == hash && FileSystem::FileExists(output);
+}
+
+void HashCache::Set(const std::string& output, uint64_t hash)
+{
+  std::lock_guard<std::mutex> lk(m_mutex);
+  m_entries[output] = hash;
+}
+
+void HashCache::Remove(const std::string& output)
+{
+  std::lock_guard<std::mutex> lk(m_mutex);
+  m_entries.erase(output);
+}
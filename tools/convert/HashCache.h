@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <map>
+#include <mutex>
+#include <string>
+
+// Content hashes of the inputs (and settings) each output was last built from, so unchanged files are skipped
+// no matter what their timestamps say. Kept as a text file of "<hash> <output path>" lines.
+// Lookups and updates can come from several converter threads.
+class HashCache
+{
+public:
+  // 64 bit hash of data, seed chains several buffers
+  static uint64_t Hash(const uint8_t* data, size_t size, uint64_t seed = 0);
+
+  // A missing file is an empty cache
+  bool Load(const std::string& path);
+  // Written to a temporary file first and renamed over the old one, so an interrupted run keeps the old cache
+  bool Save() const;
+
+  // The output exists and was built from an input with this hash
+  bool IsUpToDate(const std::string& output, uint64_t hash) const;
+  void Set(const std::string& output, uint64_t hash);
+  void Remove(const std::string& output);
+
+private:
+  mutable std::mutex m_mutex;
+  std::string m_path;
+  std::map<std::string, uint64_t> m_entries;
+};
@@ -0,0 +1,352 @@
+#include "ImageFile.h"
+#include "FileSystem.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <utility>
+
+namespace
+{
+  // Largest side accepted, the encoder takes 32 bit byte counts anyway
+  const uint32_t MAX_SIZE = 1 << 16;
+
+  // Reads the next '\n' terminated line, false at the end of data
+  bool ReadLine(const uint8_t* data, size_t size, size_t& pos, std::string& line)
+  {
+    if (pos >= size)
+      return false;
+    const uint8_t* end = static_cast<const uint8_t*>(memchr(data + pos, '\n', size - pos));
+    size_t lineEnd = end ? static_cast<size_t>(end - data) : size;
+    line.assign(reinterpret_cast<const char*>(data + pos), lineEnd - pos);
+    pos = end ? lineEnd + 1 : size;
+    return true;
+  }
+
+  // Radiance RGBE with the reference decoder's rounding: (mantissa + 0.5) * 2^(exponent - 136)
+  void RGBEToRGB(const uint8_t* rgbe, float* rgb)
+  {
+    float scale = rgbe[3] != 0 ? ldexpf(1.0f, static_cast<int>(rgbe[3]) - (128 + 8)) : 0.0f;
+    for (uint32_t c = 0; c < 3; ++c)
+      rgb[c] = rgbe[3] != 0 ? (rgbe[c] + 0.5f) * scale : 0.0f;
+  }
+
+  float ReadFloat(const uint8_t* src, bool swap)
+  {
+    uint8_t bytes[4];
+    memcpy(bytes, src, sizeof(bytes));
+    if (swap)
+    {
+      std::swap(bytes[0], bytes[3]);
+      std::swap(bytes[1], bytes[2]);
+    }
+    float value;
+    memcpy(&value, bytes, sizeof(value));
+    return value;
+  }
+
+  // One scanline of width RGBE texels into scanline, returns false on truncated or corrupt data
+  bool ReadRGBEScanline(const uint8_t* data, size_t size, size_t& pos, uint32_t width, uint8_t* scanline)
+  {
+    // New RLE: 2, 2, width (big endian), then every channel run length encoded separately
+    bool rle = width >= 8 && width < 0x8000 && pos + 4 <= size && data[pos] == 2 && data[pos + 1] == 2 && (data[pos + 2] & 0x80) == 0;
+    if (rle)
+    {
+      if ((static_cast<uint32_t>(data[pos + 2]) << 8 | data[pos + 3]) != width)
+        return false;
+      pos += 4;
+
+      for (uint32_t c = 0; c < 4; ++c)
+      {
+        uint32_t x = 0;
+        while (x < width)
+        {
+          if (pos >= size)
+            return false;
+          uint32_t count = data[pos++];
+          if (count > 128)
+          {
+            // Run of one value
+            count -= 128;
+            if (count > width - x || pos >= size)
+              return false;
+            uint8_t value = data[pos++];
+            for (; count > 0; --count, ++x)
+              scanline[x * 4 + c] = value;
+          }
+          else
+          {
+            // count literal values
+            if (count == 0 || count > width - x || pos + count > size)
+              return false;
+            for (; count > 0; --count, ++x)
+              scanline[x * 4 + c] = data[pos++];
+          }
+        }
+      }
+      return true;
+    }
+
+    // Flat texels, with the old RLE where 1, 1, 1, n repeats the previous texel n << shift times
+    uint32_t x = 0;
+    uint32_t shift = 0;
+    while (x < width)
+    {
+      if (pos + 4 > size)
+        return false;
+      const uint8_t* texel = data + pos;
+      pos += 4;
+      if (texel[0] == 1 && texel[1] == 1 && texel[2] == 1)
+      {
+        uint32_t count = static_cast<uint32_t>(texel[3]) << shift;
+        if (x == 0 || count > width - x)
+          return false;
+        for (; count > 0; --count, ++x)
+          memcpy(scanline + x * 4, scanline + (x - 1) * 4, 4);
+        shift += 8;
+      }
+      else
+      {
+        memcpy(scanline + x * 4, texel, 4);
+        ++x;
+        shift = 0;
+      }
+    }
+    return true;
+  }
+}
+
+bool ImageFile::IsSupported(const char* path)
+{
+  std::string extension = FileSystem::GetExtension(path);
+  return extension == ".hdr" || extension == ".pfm" || extension == ".raw";
+}
+
+bool ImageFile::Reader::Open(const char* path, const SRawLayout& raw)
+{
+  Close();
+
+  std::string extension = FileSystem::GetExtension(path);
+  if (extension != ".hdr" && extension != ".pfm" && extension != ".raw")
+  {
+    fprintf(stderr, "%s: unsupported file type\n", path);
+    return false;
+  }
+
+  if (!m_file.Open(path))
+    return false;
+
+  bool result;
+  if (extension == ".hdr")
+    result = OpenHDR(path);
+  else if (extension == ".pfm")
+    result = OpenPFM(path);
+  else
+    result = OpenRaw(path, raw);
+
+  if (result && (m_width == 0 || m_height == 0 || m_width > MAX_SIZE || m_height > MAX_SIZE))
+  {
+    fprintf(stderr, "%s: invalid size %ux%u\n", path, m_width, m_height);
+    result = false;
+  }
+  if (!result)
+    Close();
+  return result;
+}
+
+void ImageFile::Reader::Close()
+{
+  m_file.Close();
+  m_width = 0;
+  m_height = 0;
+  m_row = 0;
+  m_scanlinePos = 0;
+  m_scanlineOffsets = std::vector<size_t>();
+  m_scanline = std::vector<uint8_t>();
+}
+
+bool ImageFile::Reader::OpenHDR(const char* path)
+{
+  m_format = Format::HDR;
+  const uint8_t* data = m_file.GetData();
+  size_t size = static_cast<size_t>(m_file.GetSize());
+  size_t pos = 0;
+  std::string line;
+  if (!ReadLine(data, size, pos, line) || (line.compare(0, 10, "#?RADIANCE") != 0 && line.compare(0, 6, "#?RGBE") != 0))
+  {
+    fprintf(stderr, "%s: not a Radiance file\n", path);
+    return false;
+  }
+
+  // Header variables up to an empty line
+  while (ReadLine(data, size, pos, line) && !line.empty())
+  {
+    if (line.compare(0, 7, "FORMAT=") == 0 && line != "FORMAT=32-bit_rle_rgbe")
+    {
+      fprintf(stderr, "%s: unsupported %s\n", path, line.c_str());
+      return false;
+    }
+  }
+
+  // Only the usual orientations: rows top to bottom (-Y) or bottom to top (+Y), texels left to right
+  char yAxis[3] = {};
+  char xAxis[3] = {};
+  if (!ReadLine(data, size, pos, line) || sscanf(line.c_str(), "%2s %u %2s %u", yAxis, &m_height, xAxis, &m_width) != 4
+    || (strcmp(yAxis, "-Y") != 0 && strcmp(yAxis, "+Y") != 0) || strcmp(xAxis, "+X") != 0)
+  {
+    fprintf(stderr, "%s: unsupported resolution line \"%s\"\n", path, line.c_str());
+    return false;
+  }
+  // Open rejects the size
+  if (m_width == 0 || m_height == 0 || m_width > MAX_SIZE || m_height > MAX_SIZE)
+    return true;
+
+  m_scanline.resize(static_cast<size_t>(m_width) * 4);
+  m_scanlinePos = pos;
+
+  // RLE scanlines have no fixed size, a bottom to top file is walked once to find where each one starts
+  if (yAxis[0] == '+')
+  {
+    m_scanlineOffsets.resize(m_height);
+    for (uint32_t y = 0; y < m_height; ++y)
+    {
+      m_scanlineOffsets[y] = pos;
+      if (!ReadRGBEScanline(data, size, pos, m_width, m_scanline.data()))
+      {
+        fprintf(stderr, "%s: corrupt scanline %u\n", path, y);
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool ImageFile::Reader::OpenPFM(const char* path)
+{
+  m_format = Format::PFM;
+  const uint8_t* data = m_file.GetData();
+  size_t size = static_cast<size_t>(m_file.GetSize());
+
+  // "PF" (RGB) or "Pf" (gray), then width, height and scale separated by whitespace, then one whitespace
+  // character and the rows bottom to top. A negative scale means little endian floats.
+  size_t pos = 0;
+  std::string tokens[4];
+  for (std::string& token : tokens)
+  {
+    while (pos < size && isspace(data[pos]))
+      ++pos;
+    while (pos < size && !isspace(data[pos]))
+      token += static_cast<char>(data[pos++]);
+  }
+  ++pos;
+
+  m_channelNum = tokens[0] == "PF" ? 3 : (tokens[0] == "Pf" ? 1 : 0);
+  m_width = static_cast<uint32_t>(strtoul(tokens[1].c_str(), nullptr, 10));
+  m_height = static_cast<uint32_t>(strtoul(tokens[2].c_str(), nullptr, 10));
+  float scale = static_cast<float>(atof(tokens[3].c_str()));
+  if (m_channelNum == 0 || scale == 0.0f)
+  {
+    fprintf(stderr, "%s: not a PFM file\n", path);
+    return false;
+  }
+
+  uint64_t texelBytes = static_cast<uint64_t>(m_width) * m_height * m_channelNum * sizeof(float);
+  if (pos > size || size - pos < texelBytes)
+  {
+    fprintf(stderr, "%s: truncated, %ux%u needs %llu bytes of texels\n", path, m_width, m_height, static_cast<unsigned long long>(texelBytes));
+    return false;
+  }
+
+  uint32_t one = 1;
+  bool nativeLittleEndian = *reinterpret_cast<const uint8_t*>(&one) == 1;
+  m_swap = (scale < 0.0f) != nativeLittleEndian;
+  m_texelOffset = pos;
+  return true;
+}
+
+bool ImageFile::Reader::OpenRaw(const char* path, const SRawLayout& raw)
+{
+  m_format = Format::Raw;
+  m_width = raw.m_width;
+  m_height = raw.m_height;
+  m_channelNum = raw.m_channelNum;
+  m_swap = false;
+  m_texelOffset = 0;
+  if (m_channelNum != 1 && m_channelNum != 3 && m_channelNum != 4)
+  {
+    fprintf(stderr, "%s: raw files need 1, 3 or 4 channels, not %u\n", path, m_channelNum);
+    return false;
+  }
+
+  uint64_t texelBytes = static_cast<uint64_t>(m_width) * m_height * m_channelNum * sizeof(float);
+  if (m_file.GetSize() != texelBytes)
+  {
+    fprintf(stderr, "%s: %llu bytes, %ux%u with %u channels is %llu\n", path, static_cast<unsigned long long>(m_file.GetSize()),
+      m_width, m_height, m_channelNum, static_cast<unsigned long long>(texelBytes));
+    return false;
+  }
+  return true;
+}
+
+bool ImageFile::Reader::ReadHDRRow(uint32_t y, float* rgb)
+{
+  const uint8_t* data = m_file.GetData();
+  size_t size = static_cast<size_t>(m_file.GetSize());
+  size_t pos = m_scanlineOffsets.empty() ? m_scanlinePos : m_scanlineOffsets[m_height - 1 - y];
+  if (!ReadRGBEScanline(data, size, pos, m_width, m_scanline.data()))
+    return false;
+  m_scanlinePos = pos;
+
+  for (uint32_t x = 0; x < m_width; ++x)
+    RGBEToRGB(m_scanline.data() + x * 4, rgb + x * 3);
+  return true;
+}
+
+const uint8_t* ImageFile::Reader::ReadRows(uint32_t rowNum, uint8_t* buffer)
+{
+  if (rowNum > m_height - m_row)
+    return nullptr;
+
+  const uint8_t* data = m_file.GetData();
+  size_t fileRowBytes = static_cast<size_t>(m_width) * m_channelNum * sizeof(float);
+  uint32_t firstRow = m_row;
+  m_row += rowNum;
+
+  // RGB and RGBA raw files are already what the encoder reads
+  if (m_format == Format::Raw && m_channelNum != 1)
+    return data + m_texelOffset + firstRow * fileRowBytes;
+
+  for (uint32_t i = 0; i < rowNum; ++i)
+  {
+    uint32_t y = firstRow + i;
+    float* rgb = reinterpret_cast<float*>(buffer + static_cast<size_t>(i) * GetRowPitch());
+    if (m_format == Format::HDR)
+    {
+      if (!ReadHDRRow(y, rgb))
+      {
+        fprintf(stderr, "Corrupt scanline %u\n", y);
+        return nullptr;
+      }
+      continue;
+    }
+
+    // PFM rows are stored bottom to top, raw rows top to bottom
+    uint32_t fileRow = m_format == Format::PFM ? m_height - 1 - y : y;
+    const uint8_t* src = data + m_texelOffset + fileRow * fileRowBytes;
+    if (m_channelNum == 3 && !m_swap)
+    {
+      memcpy(rgb, src, fileRowBytes);
+      continue;
+    }
+
+    for (uint32_t x = 0; x < m_width; ++x)
+    {
+      for (uint32_t c = 0; c < 3; ++c)
+        rgb[x * 3 + c] = ReadFloat(src + (x * m_channelNum + (m_channelNum == 3 ? c : 0)) * sizeof(float), m_swap);
+    }
+  }
+  return buffer;
+}
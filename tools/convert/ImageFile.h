@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include "MappedFile.h"
+
+// HDR source images for the converter: Radiance RGBE (.hdr, flat or RLE scanlines), PFM (.pfm, RGB or gray)
+// and headerless float files (.raw) with their layout given by the caller.
+// The file is mapped, not read, and decoded a strip of rows at a time, so converting an image never holds
+// more than the file's page cache and one strip of texels.
+namespace ImageFile
+{
+  // From the file extension
+  bool IsSupported(const char* path);
+
+  // Layout of a .raw file: native endian 32 bit floats, rows top to bottom, tightly packed
+  struct SRawLayout
+  {
+    uint32_t m_width;
+    uint32_t m_height;
+    // 1 (gray), 3 (RGB) or 4 (RGBA, alpha is ignored)
+    uint32_t m_channelNum;
+  };
+
+  class Reader
+  {
+  public:
+    // raw is only used for .raw files
+    bool Open(const char* path, const SRawLayout& raw);
+    void Close();
+
+    uint32_t GetWidth() const { return m_width; }
+    uint32_t GetHeight() const { return m_height; }
+    // The mapped file, for hashing
+    const uint8_t* GetFileData() const { return m_file.GetData(); }
+    uint64_t GetFileSize() const { return m_file.GetSize(); }
+
+    // Texels of ReadRows, 3 floats (RGB) or 4 for RGBA .raw files, which are passed through as they are
+    uint32_t GetChannelNum() const { return m_format == Format::Raw && m_channelNum == 4 ? 4 : 3; }
+    uint32_t GetRowPitch() const { return m_width * GetChannelNum() * sizeof(float); }
+
+    // Decodes the next rowNum rows, top to bottom, into buffer (rowNum * GetRowPitch() bytes). Returns buffer,
+    // or the rows inside the mapped file when they need no decoding, null on corrupt data.
+    const uint8_t* ReadRows(uint32_t rowNum, uint8_t* buffer);
+
+  private:
+    enum struct Format
+    {
+      HDR,
+      PFM,
+      Raw,
+    };
+
+    bool OpenHDR(const char* path);
+    bool OpenPFM(const char* path);
+    bool OpenRaw(const char* path, const SRawLayout& raw);
+    bool ReadHDRRow(uint32_t y, float* rgb);
+
+    MappedFile m_file;
+    Format m_format = Format::HDR;
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    // Rows returned so far
+    uint32_t m_row = 0;
+
+    // .hdr: next scanline in file order, or the offset of every scanline of a bottom to top file
+    size_t m_scanlinePos = 0;
+    std::vector<size_t> m_scanlineOffsets;
+    std::vector<uint8_t> m_scanline;
+
+    // .pfm and .raw: first texel, channels in the file and whether the floats need a byte swap
+    size_t m_texelOffset = 0;
+    uint32_t m_channelNum = 3;
+    bool m_swap = false;
+  };
+}
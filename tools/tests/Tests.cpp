@@ -0,0 +1,621 @@
+// Correctness checks of the CPU encoder, decoder and compressor paths, no GPU needed.
+//
+// Every test prints ok or FAILED with the first mismatch it found, the exit code is 1 when any of them failed.
+// Test names can be passed to run only those.
+
+#include "GPURealTimeBC6H.h"
+#include "BC6HEncoderCPU.h"
+#include "BC6HEncoderSIMD.h"
+#include "BC6HDecoderCPU.h"
+#include "BC6HEffort.h"
+#include "BC6HBlockCache.h"
+#include "BC6HMath.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+  const uint32_t BLOCK_FLOATS = 16 * 3;
+
+  // Texels the encoders have to agree on, not just the ones a sampled image produces
+  enum struct BlockKind
+  {
+    // Positive HDR texels, every block in its own range between 2^-20 and 2^20
+    HDR,
+    // HDR with a fifth of the texels negated
+    Negative,
+    // Negative with a few NaN and infinite texels
+    NonFinite,
+    Count,
+  };
+
+  const char* GetBlockKindName(BlockKind kind)
+  {
+    switch (kind)
+    {
+    case BlockKind::HDR: return "hdr";
+    case BlockKind::Negative: return "negative";
+    default: return "non-finite";
+    }
+  }
+
+  // blockNum blocks of [16][3] texels
+  std::vector<float> GenerateBlocks(BlockKind kind, uint32_t blockNum, uint32_t seed)
+  {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<float> texels(static_cast<size_t>(blockNum) * BLOCK_FLOATS);
+    for (uint32_t block = 0; block < blockNum; ++block)
+    {
+      float scale = exp2f(unit(rng) * 40.0f - 20.0f);
+      for (uint32_t i = 0; i < BLOCK_FLOATS; ++i)
+      {
+        float texel = unit(rng) * scale;
+        if (kind != BlockKind::HDR && unit(rng) < 0.2f)
+          texel = -texel;
+        if (kind == BlockKind::NonFinite && unit(rng) < 0.02f)
+          texel = unit(rng) < 0.5f ? NAN : INFINITY;
+        texels[block * BLOCK_FLOATS + i] = texel;
+      }
+    }
+    return texels;
+  }
+
+  void PrintBlock(const char* name, const uint32_t block[4])
+  {
+    fprintf(stderr, "    %-8s %08x %08x %08x %08x\n", name, block[0], block[1], block[2], block[3]);
+  }
+
+  // BC6HEncoderSIMD has to write the blocks of BC6HEncoderCPU::EncodeBlock bit for bit, on every ISA
+  // the CPU can run, at every effort, with and without the P2 threshold
+  bool TestEncoderISAs()
+  {
+    const uint32_t BLOCK_NUM = 8192;
+    const float P2_THRESHOLDS[] = { 0.0f, 0.001f };
+    BC6HEncoderSIMD::ISA widestISA = BC6HEncoderSIMD::DetectISA();
+
+    for (uint32_t kindIndex = 0; kindIndex < static_cast<uint32_t>(BlockKind::Count); ++kindIndex)
+    {
+      BlockKind kind = static_cast<BlockKind>(kindIndex);
+      std::vector<float> texels = GenerateBlocks(kind, BLOCK_NUM, kindIndex + 1);
+
+      for (uint32_t effort = 0; effort <= BC6HEffort::MAX; ++effort)
+      {
+        for (float p2Threshold : P2_THRESHOLDS)
+        {
+          std::vector<uint32_t> blocks(BLOCK_NUM * 4);
+          std::vector<bool> skipped(BLOCK_NUM);
+          for (uint32_t block = 0; block < BLOCK_NUM; ++block)
+            skipped[block] = BC6HEncoderCPU::EncodeBlock(reinterpret_cast<const float(*)[3]>(&texels[block * BLOCK_FLOATS]), effort, p2Threshold, &blocks[block * 4]);
+
+          for (uint32_t isaIndex = static_cast<uint32_t>(BC6HEncoderSIMD::ISA::SSE41); isaIndex <= static_cast<uint32_t>(widestISA); ++isaIndex)
+          {
+            BC6HEncoderSIMD::ISA isa = static_cast<BC6HEncoderSIMD::ISA>(isaIndex);
+            BC6HEncoderSIMD::EncodeBlocksFunc encodeBlocks = BC6HEncoderSIMD::GetEncodeBlocks(isa);
+            uint32_t laneNum = BC6HEncoderSIMD::GetLaneNum(isa);
+
+            // Structure of arrays, [16][3][laneNum]
+            std::vector<float> laneTexels(BLOCK_FLOATS * laneNum);
+            std::vector<uint32_t> laneBlocks(laneNum * 4);
+            for (uint32_t firstBlock = 0; firstBlock < BLOCK_NUM; firstBlock += laneNum)
+            {
+              for (uint32_t lane = 0; lane < laneNum; ++lane)
+              {
+                for (uint32_t i = 0; i < BLOCK_FLOATS; ++i)
+                  laneTexels[i * laneNum + lane] = texels[(firstBlock + lane) * BLOCK_FLOATS + i];
+              }
+              uint32_t skippedMask = encodeBlocks(laneTexels.data(), effort, p2Threshold, laneBlocks.data());
+
+              for (uint32_t lane = 0; lane < laneNum; ++lane)
+              {
+                uint32_t block = firstBlock + lane;
+                bool laneSkipped = ((skippedMask >> lane) & 1) != 0;
+                if (memcmp(&laneBlocks[lane * 4], &blocks[block * 4], 16) == 0 && laneSkipped == skipped[block])
+                  continue;
+
+                fprintf(stderr, "  %s block %u, effort %u, p2 threshold %g: %s differs from scalar\n", GetBlockKindName(kind), block, effort,
+                  p2Threshold, BC6HEncoderSIMD::GetISAName(isa));
+                PrintBlock("scalar", &blocks[block * 4]);
+                PrintBlock(BC6HEncoderSIMD::GetISAName(isa), &laneBlocks[lane * 4]);
+                return false;
+              }
+            }
+          }
+        }
+      }
+    }
+    return true;
+  }
+
+  bool CompareBlocks(const char* what, const std::vector<uint8_t>& blocks, const std::vector<uint8_t>& expected)
+  {
+    for (size_t i = 0; i < expected.size(); i += BC6HEncoderCPU::BLOCK_BYTES)
+    {
+      if (memcmp(&blocks[i], &expected[i], BC6HEncoderCPU::BLOCK_BYTES) == 0)
+        continue;
+
+      fprintf(stderr, "  %s: block %zu differs\n", what, i / BC6HEncoderCPU::BLOCK_BYTES);
+      PrintBlock("expected", reinterpret_cast<const uint32_t*>(&expected[i]));
+      PrintBlock("got", reinterpret_cast<const uint32_t*>(&blocks[i]));
+      return false;
+    }
+    return true;
+  }
+
+  // The block cache key has no ISA, so CompressImage has to write the same image whichever ISA filled
+  // the cache: one cache is kept while the ISA goes from scalar to the widest one, and every pass has to
+  // match the uncached scalar image
+  bool TestBlockCacheISAs()
+  {
+    // 64x64 blocks picked from 256 distinct ones, so most of them are cache hits
+    const uint32_t WIDTH_IN_BLOCKS = 64;
+    const uint32_t DISTINCT_BLOCK_NUM = 256;
+    const uint32_t width = WIDTH_IN_BLOCKS * BC6HEncoderCPU::BLOCK_SIZE;
+    const uint32_t rowPitch = width * 4 * sizeof(float);
+    std::vector<float> distinctBlocks = GenerateBlocks(BlockKind::NonFinite, DISTINCT_BLOCK_NUM, 4);
+
+    std::mt19937 rng(5);
+    std::vector<float> texels(static_cast<size_t>(width) * width * 4);
+    for (uint32_t blockY = 0; blockY < WIDTH_IN_BLOCKS; ++blockY)
+    {
+      for (uint32_t blockX = 0; blockX < WIDTH_IN_BLOCKS; ++blockX)
+      {
+        const float* block = &distinctBlocks[(rng() % DISTINCT_BLOCK_NUM) * BLOCK_FLOATS];
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+          float* texel = &texels[((blockY * 4 + i / 4) * width + blockX * 4 + i % 4) * 4];
+          memcpy(texel, &block[i * 3], 3 * sizeof(float));
+          texel[3] = 1.0f;
+        }
+      }
+    }
+
+    const uint8_t* src = reinterpret_cast<const uint8_t*>(texels.data());
+    size_t blockBytes = static_cast<size_t>(WIDTH_IN_BLOCKS) * WIDTH_IN_BLOCKS * BC6HEncoderCPU::BLOCK_BYTES;
+    BC6HEncoderSIMD::ISA widestISA = BC6HEncoderSIMD::DetectISA();
+    BC6HBlockCache cache(DISTINCT_BLOCK_NUM * 4);
+    for (uint32_t effort = 0; effort <= BC6HEffort::MAX; ++effort)
+    {
+      std::vector<uint8_t> expected(blockBytes);
+      BC6HEncoderCPU::CompressImage(src, BC6HEncoderCPU::TexelFormat::RGBA32F, rowPitch, width, width, effort, 0.0f, BC6HEncoderSIMD::ISA::Scalar, nullptr, expected.data());
+
+      cache.Clear();
+      for (uint32_t isaIndex = 0; isaIndex <= static_cast<uint32_t>(widestISA); ++isaIndex)
+      {
+        BC6HEncoderSIMD::ISA isa = static_cast<BC6HEncoderSIMD::ISA>(isaIndex);
+        std::vector<uint8_t> blocks(blockBytes);
+        BC6HEncoderCPU::SBlockCounts counts = { 0, 0, 0, 0, 0 };
+        BC6HEncoderCPU::CompressImage(src, BC6HEncoderCPU::TexelFormat::RGBA32F, rowPitch, width, width, effort, 0.0f, isa, nullptr, blocks.data(), &counts, &cache);
+
+        char what[64];
+        snprintf(what, sizeof(what), "effort %u, %s after %s", effort, BC6HEncoderSIMD::GetISAName(isa), isaIndex == 0 ? "an empty cache" : "the other ISAs");
+        if (!CompareBlocks(what, blocks, expected))
+          return false;
+        if (isaIndex > 0 && counts.m_cached == 0)
+        {
+          fprintf(stderr, "  %s: no cache hits\n", what);
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  // BC6H header layouts as the format spec lists them, after the mode bits. r0..r3 are the red endpoints of
+  // the first and second subset (deltas from r0 in transformed modes), d the partition. x[a:b] stores bit b first
+  // and bit a last, so [9:0] is LSB first and [10:15] is reversed.
+  struct SModeLayout
+  {
+    uint32_t m_mode;
+    uint32_t m_modeBits;
+    bool m_transformed;
+    uint32_t m_endpointBits;
+    uint32_t m_deltaBits[3];
+    const char* m_header;
+  };
+
+  const SModeLayout MODE_LAYOUTS[14] =
+  {
+    { 0x00, 2, true, 10, { 5, 5, 5 }, "g2[4] b2[4] b3[4] r0[9:0] g0[9:0] b0[9:0] r1[4:0] g3[4] g2[3:0] g1[4:0] b3[0] g3[3:0] b1[4:0] b3[1] b2[3:0] r2[4:0] b3[2] r3[4:0] b3[3] d[4:0]" },
+    { 0x01, 2, true, 7, { 6, 6, 6 }, "g2[5] g3[4] g3[5] r0[6:0] b3[0] b3[1] b2[4] g0[6:0] b2[5] b3[2] g2[4] b0[6:0] b3[3] b3[5] b3[4] r1[5:0] g2[3:0] g1[5:0] g3[3:0] b1[5:0] b2[3:0] r2[5:0] r3[5:0] d[4:0]" },
+    { 0x02, 5, true, 11, { 5, 4, 4 }, "r0[9:0] g0[9:0] b0[9:0] r1[4:0] r0[10] g2[3:0] g1[3:0] g0[10] b3[0] g3[3:0] b1[3:0] b0[10] b3[1] b2[3:0] r2[4:0] b3[2] r3[4:0] b3[3] d[4:0]" },
+    { 0x06, 5, true, 11, { 4, 5, 4 }, "r0[9:0] g0[9:0] b0[9:0] r1[3:0] r0[10] g3[4] g2[3:0] g1[4:0] g0[10] g3[3:0] b1[3:0] b0[10] b3[1] b2[3:0] r2[3:0] b3[0] b3[2] r3[3:0] g2[4] b3[3] d[4:0]" },
+    { 0x0A, 5, true, 11, { 4, 4, 5 }, "r0[9:0] g0[9:0] b0[9:0] r1[3:0] r0[10] b2[4] g2[3:0] g1[3:0] g0[10] b3[0] g3[3:0] b1[4:0] b0[10] b2[3:0] r2[3:0] b3[1] b3[2] r3[3:0] b3[4] b3[3] d[4:0]" },
+    { 0x0E, 5, true, 9, { 5, 5, 5 }, "r0[8:0] b2[4] g0[8:0] g2[4] b0[8:0] b3[4] r1[4:0] g3[4] g2[3:0] g1[4:0] b3[0] g3[3:0] b1[4:0] b3[1] b2[3:0] r2[4:0] b3[2] r3[4:0] b3[3] d[4:0]" },
+    { 0x12, 5, true, 8, { 6, 5, 5 }, "r0[7:0] g3[4] b2[4] g0[7:0] b3[2] g2[4] b0[7:0] b3[3] b3[4] r1[5:0] g2[3:0] g1[4:0] b3[0] g3[3:0] b1[4:0] b3[1] b2[3:0] r2[5:0] r3[5:0] d[4:0]" },
+    { 0x16, 5, true, 8, { 5, 6, 5 }, "r0[7:0] b3[0] b2[4] g0[7:0] g2[5] g2[4] b0[7:0] g3[5] b3[4] r1[4:0] g3[4] g2[3:0] g1[5:0] g3[3:0] b1[4:0] b3[1] b2[3:0] r2[4:0] b3[2] r3[4:0] b3[3] d[4:0]" },
+    { 0x1A, 5, true, 8, { 5, 5, 6 }, "r0[7:0] b3[1] b2[4] g0[7:0] b2[5] g2[4] b0[7:0] b3[5] b3[4] r1[4:0] g3[4] g2[3:0] g1[4:0] b3[0] g3[3:0] b1[5:0] b2[3:0] r2[4:0] b3[2] r3[4:0] b3[3] d[4:0]" },
+    { 0x1E, 5, false, 6, { 6, 6, 6 }, "r0[5:0] g3[4] b3[0] b3[1] b2[4] g0[5:0] g2[5] b2[5] b3[2] g2[4] b0[5:0] g3[5] b3[3] b3[5] b3[4] r1[5:0] g2[3:0] g1[5:0] g3[3:0] b1[5:0] b2[3:0] r2[5:0] r3[5:0] d[4:0]" },
+    { 0x03, 5, false, 10, { 10, 10, 10 }, "r0[9:0] g0[9:0] b0[9:0] r1[9:0] g1[9:0] b1[9:0]" },
+    { 0x07, 5, true, 11, { 9, 9, 9 }, "r0[9:0] g0[9:0] b0[9:0] r1[8:0] r0[10] g1[8:0] g0[10] b1[8:0] b0[10]" },
+    { 0x0B, 5, true, 12, { 8, 8, 8 }, "r0[9:0] g0[9:0] b0[9:0] r1[7:0] r0[10:11] g1[7:0] g0[10:11] b1[7:0] b0[10:11]" },
+    { 0x0F, 5, true, 16, { 4, 4, 4 }, "r0[9:0] g0[9:0] b0[9:0] r1[3:0] r0[10:15] g1[3:0] g0[10:15] b1[3:0] b0[10:15]" },
+  };
+
+  // The 32 two subset partitions, subset of texels 0..15
+  const char* const PARTITIONS[32] =
+  {
+    "0011001100110011", "0001000100010001", "0111011101110111", "0001001100110111",
+    "0000000100010011", "0011011101111111", "0001001101111111", "0000000100110111",
+    "0000000000010011", "0011011111111111", "0000000101111111", "0000000000010111",
+    "0001011111111111", "0000000011111111", "0000111111111111", "0000000000001111",
+    "0000100011101111", "0111000100000000", "0000000010001110", "0111001100010000",
+    "0011000100000000", "0000100011001110", "0000000010001100", "0111001100110001",
+    "0011000100010000", "0000100010001100", "0110011001100110", "0011011001101100",
+    "0001011111101000", "0000111111110000", "0111000110001110", "0011100110011100",
+  };
+
+  const uint32_t ANCHORS[32] =
+  {
+    15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+    15, 2, 8, 2, 2, 8, 8, 15, 2, 8, 2, 2, 8, 8, 2, 2,
+  };
+
+  class BitWriter
+  {
+  public:
+    void Write(uint32_t value, uint32_t bitNum)
+    {
+      for (uint32_t i = 0; i < bitNum; ++i, ++m_pos)
+        m_block[m_pos / 8] |= static_cast<uint8_t>(((value >> i) & 1) << (m_pos % 8));
+    }
+
+    uint32_t GetPos() const { return m_pos; }
+    const uint8_t* GetBlock() const { return m_block; }
+
+  private:
+    uint8_t m_block[16] = {};
+    uint32_t m_pos = 0;
+  };
+
+  int32_t SignExtend(uint32_t x, uint32_t bitNum)
+  {
+    int32_t shift = 32 - static_cast<int32_t>(bitNum);
+    return static_cast<int32_t>(x << shift) >> shift;
+  }
+
+  // unquantize and finish_unquantize of the spec, written out the long way
+  int32_t UnquantizeReference(int32_t x, uint32_t bitNum, bool isSigned)
+  {
+    if (!isSigned)
+    {
+      if (bitNum >= 15 || x == 0)
+        return x;
+      if (x == (1 << bitNum) - 1)
+        return 0xFFFF;
+      return ((x << 16) + 0x8000) >> bitNum;
+    }
+
+    if (bitNum >= 16 || x == 0)
+      return x;
+    int32_t magnitude = x < 0 ? -x : x;
+    int32_t unq = magnitude >= (1 << (bitNum - 1)) - 1 ? 0x7FFF : ((magnitude << 15) + 0x4000) >> (bitNum - 1);
+    return x < 0 ? -unq : unq;
+  }
+
+  uint16_t FinishUnquantizeReference(int32_t x, bool isSigned)
+  {
+    if (!isSigned)
+      return static_cast<uint16_t>((x * 31) >> 6);
+    return x < 0 ? static_cast<uint16_t>(0x8000 | ((-x * 31) >> 5)) : static_cast<uint16_t>((x * 31) >> 5);
+  }
+
+  // Packs a block of layout from random fields and returns the texels the spec decodes it to
+  bool PackRandomBlock(const SModeLayout& layout, bool isSigned, std::mt19937& rng, uint8_t block[16], uint16_t texels[16][3])
+  {
+    // Modes ending in 11 have a single subset
+    bool partitioned = (layout.m_mode & 3) != 3;
+
+    // Stored bits of [endpoint][channel] and the partition
+    uint32_t fields[4][3];
+    for (uint32_t e = 0; e < 4; ++e)
+    {
+      for (uint32_t c = 0; c < 3; ++c)
+      {
+        uint32_t bitNum = e > 0 && layout.m_transformed ? layout.m_deltaBits[c] : layout.m_endpointBits;
+        fields[e][c] = rng() & ((1u << bitNum) - 1);
+      }
+    }
+    uint32_t partition = partitioned ? rng() % 32 : 0;
+
+    BitWriter writer;
+    writer.Write(layout.m_mode, layout.m_modeBits);
+    for (const char* token = layout.m_header; *token;)
+    {
+      char channel = token[0];
+      uint32_t* field = channel == 'd' ? &partition : &fields[token[1] - '0'][channel == 'r' ? 0 : channel == 'g' ? 1 : 2];
+      const char* bits = strchr(token, '[') + 1;
+      char* end;
+      long first = strtol(bits, &end, 10);
+      long last = *end == ':' ? strtol(end + 1, &end, 10) : first;
+      for (long bit = last; ; bit += first > last ? 1 : -1)
+      {
+        writer.Write(*field >> bit, 1);
+        if (bit == first)
+          break;
+      }
+      token = strchr(token, ']') + 1;
+      while (*token == ' ')
+        ++token;
+    }
+
+    if (writer.GetPos() != (partitioned ? 82u : 65u))
+    {
+      fprintf(stderr, "  mode 0x%02x: header of %u bits\n", layout.m_mode, writer.GetPos());
+      return false;
+    }
+
+    uint32_t indexBits = partitioned ? 3 : 4;
+    uint32_t anchor = partitioned ? ANCHORS[partition] : 0;
+    uint32_t indices[16];
+    for (uint32_t i = 0; i < 16; ++i)
+    {
+      uint32_t bitNum = i == 0 || (partitioned && i == anchor) ? indexBits - 1 : indexBits;
+      indices[i] = rng() & ((1u << bitNum) - 1);
+      writer.Write(indices[i], bitNum);
+    }
+    memcpy(block, writer.GetBlock(), 16);
+
+    int32_t endpoints[4][3];
+    for (uint32_t c = 0; c < 3; ++c)
+    {
+      uint32_t mask = (1u << layout.m_endpointBits) - 1;
+      for (uint32_t e = 0; e < 4; ++e)
+      {
+        uint32_t value = fields[e][c];
+        if (e > 0 && layout.m_transformed)
+          value = static_cast<uint32_t>(static_cast<int32_t>(fields[0][c]) + SignExtend(fields[e][c], layout.m_deltaBits[c])) & mask;
+        int32_t endpoint = isSigned ? SignExtend(value, layout.m_endpointBits) : static_cast<int32_t>(value);
+        endpoints[e][c] = UnquantizeReference(endpoint, layout.m_endpointBits, isSigned);
+      }
+    }
+
+    const int32_t WEIGHTS3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+    const int32_t WEIGHTS4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+    for (uint32_t i = 0; i < 16; ++i)
+    {
+      uint32_t subset = partitioned ? static_cast<uint32_t>(PARTITIONS[partition][i] - '0') : 0;
+      int32_t weight = partitioned ? WEIGHTS3[indices[i]] : WEIGHTS4[indices[i]];
+      for (uint32_t c = 0; c < 3; ++c)
+      {
+        int32_t x = ((64 - weight) * endpoints[subset * 2][c] + weight * endpoints[subset * 2 + 1][c] + 32) >> 6;
+        texels[i][c] = FinishUnquantizeReference(x, isSigned);
+      }
+    }
+    return true;
+  }
+
+  // Blocks of all 14 modes with random endpoints, partitions and indices, packed from the spec layouts above.
+  // BC6HDecoderCPU::DecodeBlock and DecompressImage on every ISA have to return the texels of the spec's decoder.
+  bool TestDecoderModes()
+  {
+    const uint32_t BLOCKS_PER_MODE = 1024;
+    BC6HEncoderSIMD::ISA widestISA = BC6HEncoderSIMD::DetectISA();
+    std::mt19937 rng(6);
+
+    for (bool isSigned : { false, true })
+    {
+      const char* format = isSigned ? "BC6H_SF16" : "BC6H_UF16";
+      for (const SModeLayout& layout : MODE_LAYOUTS)
+      {
+        std::vector<uint8_t> blocks(BLOCKS_PER_MODE * 16);
+        std::vector<uint16_t> expected(BLOCKS_PER_MODE * 16 * 3);
+        for (uint32_t block = 0; block < BLOCKS_PER_MODE; ++block)
+        {
+          uint16_t (*texels)[3] = reinterpret_cast<uint16_t(*)[3]>(&expected[block * 16 * 3]);
+          if (!PackRandomBlock(layout, isSigned, rng, &blocks[block * 16], texels))
+            return false;
+
+          uint16_t decoded[16][4];
+          BC6HDecoderCPU::DecodeBlock(&blocks[block * 16], isSigned, decoded);
+          for (uint32_t i = 0; i < 16 * 3; ++i)
+          {
+            if (decoded[i / 3][i % 3] == texels[i / 3][i % 3])
+              continue;
+            fprintf(stderr, "  %s mode 0x%02x, block %u texel %u channel %u: decoded %04x, expected %04x\n", format, layout.m_mode, block,
+              i / 3, i % 3, decoded[i / 3][i % 3], texels[i / 3][i % 3]);
+            return false;
+          }
+        }
+
+        // One block row, so every lane width sees every block
+        for (uint32_t isaIndex = 0; isaIndex <= static_cast<uint32_t>(widestISA); ++isaIndex)
+        {
+          BC6HEncoderSIMD::ISA isa = static_cast<BC6HEncoderSIMD::ISA>(isaIndex);
+          std::vector<uint16_t> image(BLOCKS_PER_MODE * 16 * 4);
+          BC6HDecoderCPU::DecompressImage(blocks.data(), BLOCKS_PER_MODE * 4, 4, isSigned, BC6HDecoderCPU::OutputFormat::RGBA16F,
+            BLOCKS_PER_MODE * 4 * 4 * sizeof(uint16_t), isa, nullptr, reinterpret_cast<uint8_t*>(image.data()));
+          for (uint32_t block = 0; block < BLOCKS_PER_MODE; ++block)
+          {
+            for (uint32_t i = 0; i < 16 * 3; ++i)
+            {
+              uint32_t texel = i / 3;
+              uint16_t decoded = image[((texel / 4) * BLOCKS_PER_MODE * 4 + block * 4 + texel % 4) * 4 + i % 3];
+              uint16_t reference = expected[block * 16 * 3 + i];
+              if (decoded == reference)
+                continue;
+              fprintf(stderr, "  %s mode 0x%02x, block %u texel %u channel %u: %s decoded %04x, expected %04x\n", format, layout.m_mode, block,
+                texel, i % 3, BC6HEncoderSIMD::GetISAName(isa), decoded, reference);
+              return false;
+            }
+          }
+        }
+      }
+    }
+    return true;
+  }
+
+  // width x height RGBA32F texels, random HDR blocks with some of them repeated
+  std::vector<float> GenerateImage(uint32_t width, uint32_t height, uint32_t seed)
+  {
+    uint32_t widthInBlocks = (width + 3) / 4;
+    uint32_t heightInBlocks = (height + 3) / 4;
+    std::vector<float> blocks = GenerateBlocks(BlockKind::HDR, widthInBlocks * heightInBlocks, seed);
+
+    // A quarter of the blocks repeat one of the first 16
+    std::mt19937 rng(seed);
+    std::vector<uint32_t> sources(widthInBlocks * heightInBlocks);
+    for (uint32_t block = 0; block < sources.size(); ++block)
+      sources[block] = rng() % 4 == 0 ? block % 16 : block;
+
+    std::vector<float> texels(static_cast<size_t>(width) * height * 4);
+    for (uint32_t y = 0; y < height; ++y)
+    {
+      for (uint32_t x = 0; x < width; ++x)
+      {
+        uint32_t block = sources[(y / 4) * widthInBlocks + x / 4];
+        const float* texel = &blocks[(block * 16 + (y % 4) * 4 + x % 4) * 3];
+        float* dst = &texels[(static_cast<size_t>(y) * width + x) * 4];
+        memcpy(dst, texel, 3 * sizeof(float));
+        dst[3] = 1.0f;
+      }
+    }
+    return texels;
+  }
+
+  SImage MakeSourceImage(std::vector<float>& texels, uint32_t width, uint32_t height)
+  {
+    SImage image;
+    image.m_format = SImage::ImageFormat::RGBA32F;
+    image.m_width = width;
+    image.m_height = height;
+    image.m_data = reinterpret_cast<uint8_t*>(texels.data());
+    image.m_dataSize = static_cast<unsigned>(texels.size() * sizeof(float));
+    return image;
+  }
+
+  bool CompareImages(const char* what, const SImage& image, const SImage& expected)
+  {
+    if (image.m_dataSize != expected.m_dataSize)
+    {
+      fprintf(stderr, "  %s: %u bytes instead of %u\n", what, image.m_dataSize, expected.m_dataSize);
+      return false;
+    }
+    return CompareBlocks(what, std::vector<uint8_t>(image.m_data, image.m_data + image.m_dataSize),
+      std::vector<uint8_t>(expected.m_data, expected.m_data + expected.m_dataSize));
+  }
+
+  // Recompressing the dirty rectangles of an edited image has to give the blocks of compressing all of it again,
+  // including rectangles over the partial edge blocks, overlapping ones and ones sticking out of the image
+  bool TestCompressRects()
+  {
+    const uint32_t WIDTH = 70;
+    const uint32_t HEIGHT = 45;
+    const SRect RECTS[] = { { 3, 2, 9, 5 }, { 8, 4, 20, 3 }, { 64, 40, 30, 30 }, { 0, 20, 1, 1 }, { 33, 0, 4, 45 } };
+
+    GPURealTimeBC6H compressor;
+    compressor.Init(GPURealTimeBC6H::Preset::Quality, GPURealTimeBC6H::Backend::CPU);
+
+    std::vector<float> texels = GenerateImage(WIDTH, HEIGHT, 7);
+    SImage src = MakeSourceImage(texels, WIDTH, HEIGHT);
+    SImage patched = {};
+    if (!compressor.Compress(&src, &patched))
+      return false;
+
+    // Edits stay inside of the rectangles
+    std::vector<float> edits = GenerateImage(WIDTH, HEIGHT, 8);
+    for (const SRect& rect : RECTS)
+    {
+      for (uint32_t y = rect.m_y; y < rect.m_y + rect.m_height && y < HEIGHT; ++y)
+      {
+        for (uint32_t x = rect.m_x; x < rect.m_x + rect.m_width && x < WIDTH; ++x)
+          memcpy(&texels[(y * WIDTH + x) * 4], &edits[(y * WIDTH + x) * 4], 4 * sizeof(float));
+      }
+    }
+
+    SImage full = {};
+    bool ok = compressor.CompressRects(&src, RECTS, sizeof(RECTS) / sizeof(RECTS[0]), &patched) && compressor.Compress(&src, &full) &&
+      CompareImages("patched image", patched, full);
+    compressor.FreeImage(&patched);
+    compressor.FreeImage(&full);
+    return ok;
+  }
+
+  // Blocks copied from the block cache have to be the ones a fresh encode writes: an image compressed twice with a
+  // cache (the second time almost all hits) against the same image compressed without one
+  bool TestBlockCacheHits()
+  {
+    const uint32_t WIDTH = 256;
+    const uint32_t HEIGHT = 128;
+
+    GPURealTimeBC6H compressor;
+    compressor.Init(GPURealTimeBC6H::Preset::Quality, GPURealTimeBC6H::Backend::CPU);
+
+    std::vector<float> texels = GenerateImage(WIDTH, HEIGHT, 9);
+    SImage src = MakeSourceImage(texels, WIDTH, HEIGHT);
+    SImage fresh = {};
+    if (!compressor.Compress(&src, &fresh))
+      return false;
+
+    compressor.SetBlockCache(65536);
+    bool ok = true;
+    for (uint32_t pass = 0; pass < 2 && ok; ++pass)
+    {
+      compressor.ResetStats();
+      SImage cached = {};
+      ok = compressor.Compress(&src, &cached) && CompareImages(pass == 0 ? "first cached pass" : "second cached pass", cached, fresh);
+      compressor.FreeImage(&cached);
+
+      BC6HStats::SStats stats;
+      compressor.GetStats(stats);
+      if (ok && (pass == 0 ? stats.m_blocks.m_cached == 0 : stats.m_blocks.m_encoded != 0))
+      {
+        fprintf(stderr, "  pass %u: %llu cached and %llu encoded blocks\n", pass, static_cast<unsigned long long>(stats.m_blocks.m_cached),
+          static_cast<unsigned long long>(stats.m_blocks.m_encoded));
+        ok = false;
+      }
+    }
+    compressor.FreeImage(&fresh);
+    return ok;
+  }
+
+  struct STest
+  {
+    const char* m_name;
+    bool (*m_run)();
+  };
+
+  const STest TESTS[] =
+  {
+    { "encoder-isas", TestEncoderISAs },
+    { "block-cache-isas", TestBlockCacheISAs },
+    { "block-cache-hits", TestBlockCacheHits },
+    { "decoder-modes", TestDecoderModes },
+    { "compress-rects", TestCompressRects },
+  };
+}
+
+int main(int argc, char** argv)
+{
+  uint32_t failedNum = 0;
+  uint32_t runNum = 0;
+  for (const STest& test : TESTS)
+  {
+    bool selected = argc < 2;
+    for (int i = 1; i < argc; ++i)
+      selected = selected || strcmp(argv[i], test.m_name) == 0;
+    if (!selected)
+      continue;
+
+    bool ok = test.m_run();
+    printf("%-32s %s\n", test.m_name, ok ? "ok" : "FAILED");
+    failedNum += ok ? 0 : 1;
+    ++runNum;
+  }
+
+  if (runNum == 0)
+  {
+    fprintf(stderr, "No test matches, the tests are:\n");
+    for (const STest& test : TESTS)
+      fprintf(stderr, "  %s\n", test.m_name);
+    return 1;
+  }
+  printf("%u of %u tests failed\n", failedNum, runNum);
+  return failedNum > 0 ? 1 : 0;
+}